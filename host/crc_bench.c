@@ -0,0 +1,138 @@
+// Microbenchmark of the CRC-8 implementations and the Sensirion word codec.
+// Checks that every implementation agrees before timing them.
+//
+//   ./crc_bench [iterations]
+
+#include "crc.h"
+#include "sensirion_codec.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef uint8_t (*crc_fn_t)(const uint8_t *data, uint16_t count);
+
+static const struct {
+    const char *name;
+    crc_fn_t fn;
+} variants[] = {
+    {"bitwise", crc8_bitwise},
+    {"nibble", crc8_nibble},
+    {"table", crc8_table},
+};
+#define VARIANT_COUNT (sizeof(variants) / sizeof(variants[0]))
+
+static volatile uint32_t sink;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Every two-byte word and a spread of longer buffers must give the same CRC
+static int check_agreement(void) {
+    uint8_t buf[64];
+    for (uint32_t word = 0; word < 0x10000; word++) {
+        buf[0] = (uint8_t)(word >> 8);
+        buf[1] = (uint8_t)word;
+        uint8_t expected = crc8_bitwise(buf, 2);
+        for (size_t v = 1; v < VARIANT_COUNT; v++) {
+            if (variants[v].fn(buf, 2) != expected) {
+                fprintf(stderr, "%s disagrees on 0x%04" PRIX32 "\n", variants[v].name, word);
+                return 1;
+            }
+        }
+    }
+    srand(1);
+    for (int trial = 0; trial < 10000; trial++) {
+        uint16_t len = (uint16_t)(rand() % sizeof(buf));
+        for (uint16_t i = 0; i < len; i++) {
+            buf[i] = (uint8_t)rand();
+        }
+        uint8_t expected = crc8_bitwise(buf, len);
+        for (size_t v = 1; v < VARIANT_COUNT; v++) {
+            if (variants[v].fn(buf, len) != expected) {
+                fprintf(stderr, "%s disagrees on a %u byte buffer\n", variants[v].name, len);
+                return 1;
+            }
+        }
+    }
+
+    // Known answer from the SCD41 datasheet
+    const uint8_t beef[2] = {0xBE, 0xEF};
+    if (calculate_crc(beef, 2) != 0x92) {
+        fprintf(stderr, "calculate_crc(0xBEEF) = 0x%02X, expected 0x92\n", calculate_crc(beef, 2));
+        return 1;
+    }
+
+    // CRC-16/CCITT-FALSE check value, as telemetry_decode computes it
+    const uint8_t check[9] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    if (crc16_ccitt(check, sizeof(check)) != 0x29B1) {
+        fprintf(stderr, "crc16_ccitt(\"123456789\") = 0x%04X, expected 0x29B1\n", crc16_ccitt(check, sizeof(check)));
+        return 1;
+    }
+    return 0;
+}
+
+// The per-word decode loop the SCD41 driver used before the codec
+static int decode_by_hand(const uint8_t *data, size_t count, uint16_t *words) {
+    for (size_t i = 0; i < count; i++) {
+        uint8_t calculated_crc = crc8_bitwise(data + (i * 3), 2);
+        if (calculated_crc != data[2 + 3 * i]) {
+            return -1;
+        }
+        words[i] = (data[3 * i] << 8) | data[3 * i + 1];
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 4000000;
+    if (check_agreement() != 0) {
+        return 1;
+    }
+    printf("all implementations agree; calculate_crc uses implementation %d\n", CRC8_IMPLEMENTATION);
+
+    // One CRC per Sensirion word, the shape of all real traffic
+    printf("\n%-10s %12s %12s\n", "crc8", "ns/word", "Mword/s");
+    for (size_t v = 0; v < VARIANT_COUNT; v++) {
+        uint8_t word[2] = {0, 0};
+        uint32_t acc = 0;
+        double start = now_ns();
+        for (uint32_t i = 0; i < iterations; i++) {
+            word[0] = (uint8_t)(i >> 8);
+            word[1] = (uint8_t)i;
+            acc += variants[v].fn(word, 2);
+        }
+        double ns = (now_ns() - start) / iterations;
+        sink = acc;
+        printf("%-10s %12.2f %12.1f\n", variants[v].name, ns, 1e3 / ns);
+    }
+
+    // A full SCD41 measurement reply: three words, three CRCs
+    uint16_t values[3] = {650, 0x6667, 0x5EB8};
+    uint8_t reply[9];
+    sensirion_encode_words(values, 3, reply);
+    uint16_t decoded[3];
+    printf("\n%-10s %12s\n", "decode x3", "ns/reply");
+
+    uint32_t acc = 0;
+    double start = now_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        reply[1] = (uint8_t)i;
+        reply[2] = crc8_table(reply, 2);
+        acc += decode_by_hand(reply, 3, decoded) == 0 ? decoded[0] : 0;
+    }
+    printf("%-10s %12.2f\n", "by hand", (now_ns() - start) / iterations);
+
+    start = now_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        reply[1] = (uint8_t)i;
+        reply[2] = crc8_table(reply, 2);
+        acc += sensirion_decode_words(reply, 3, decoded, NULL) == ESP_OK ? decoded[0] : 0;
+    }
+    printf("%-10s %12.2f\n", "codec", (now_ns() - start) / iterations);
+    sink = acc;
+    return 0;
+}
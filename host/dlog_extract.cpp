@@ -0,0 +1,290 @@
+// Pulls the DLOGx call sites out of the firmware sources (see src/dlog.h)
+// into the dictionary telemetry_decode --sites expands deferred log frames
+// with. One line per site, tab-separated:
+//
+//   id  level  tag  file:line  format
+//
+// The format keeps the source's escapes, with the <inttypes.h> macros
+// resolved to plain conversions. A site is listed under its first and last
+// line, as compilers differ in which one __LINE__ names. Run at build time:
+//
+//   ./dlog_extract [-o FILE] SOURCE...
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct site {
+    char level;
+    std::string tag;
+    std::string location;
+    std::string format;
+};
+
+// Must match dlog_file_hash()
+uint16_t file_hash(const std::string &path) {
+    size_t slash = path.find_last_of("/\\");
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * 16777619u;
+    }
+    return static_cast<uint16_t>((hash >> 16) ^ hash);
+}
+
+std::string base_name(const std::string &path) {
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// PRId32 and friends as the conversion they stand for; 64-bit ones keep their ll
+bool resolve_inttypes(const std::string &name, std::string &out) {
+    static const std::regex pattern("PRI([diouxX])(8|16|32|64|MAX|PTR|LEAST\\d+|FAST\\d+)");
+    std::smatch match;
+    if (!std::regex_match(name, match, pattern)) {
+        return false;
+    }
+    std::string size = match[2];
+    bool wide = size == "64" || size == "MAX" || size.find("64") != std::string::npos;
+    out = (wide ? "ll" : "") + match[1].str();
+    return true;
+}
+
+class extractor {
+public:
+    explicit extractor(const std::string &path) : path_(path) {
+        std::ifstream in(path, std::ios::binary);
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        text_ = buffer.str();
+        ok_ = static_cast<bool>(in);
+    }
+
+    bool ok() const { return ok_; }
+
+    // Append every call site; false on one that cannot be read
+    bool extract(std::vector<std::pair<int, site>> &sites) {
+        int line = 1;
+        size_t i = 0;
+        while (i < text_.size()) {
+            char c = text_[i];
+            if (c == '\n') {
+                line++;
+                i++;
+            } else if (text_.compare(i, 2, "//") == 0) {
+                i = text_.find('\n', i);
+                i = i == std::string::npos ? text_.size() : i;
+            } else if (text_.compare(i, 2, "/*") == 0) {
+                size_t end = text_.find("*/", i + 2);
+                end = end == std::string::npos ? text_.size() : end + 2;
+                line += static_cast<int>(std::count(text_.begin() + static_cast<long>(i), text_.begin() + static_cast<long>(end), '\n'));
+                i = end;
+            } else if (c == '"' || c == '\'') {
+                i = skip_literal(i);
+            } else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+                size_t start = i;
+                while (i < text_.size() && (std::isalnum(static_cast<unsigned char>(text_[i])) || text_[i] == '_')) {
+                    i++;
+                }
+                std::string word = text_.substr(start, i - start);
+                if (word.size() == 5 && word.compare(0, 4, "DLOG") == 0 && std::strchr("EWID", word[4]) != nullptr) {
+                    int end_line = line;
+                    site found;
+                    found.level = word[4];
+                    if (!parse_call(i, end_line, found)) {
+                        std::fprintf(stderr, "%s:%d: cannot read the %s call\n", path_.c_str(), line, word.c_str());
+                        return false;
+                    }
+                    found.location = base_name(path_) + ":" + std::to_string(line);
+                    sites.emplace_back(line, found);
+                    if (end_line != line) {
+                        sites.emplace_back(end_line, found);
+                    }
+                    line = end_line;
+                }
+            } else {
+                i++;
+            }
+        }
+        return true;
+    }
+
+private:
+    size_t skip_literal(size_t i) const {
+        char quote = text_[i++];
+        while (i < text_.size() && text_[i] != quote) {
+            i += text_[i] == '\\' ? 2 : 1;
+        }
+        return i + 1;
+    }
+
+    // Read "(tag, format, ...)" from just after the macro name, moving i past it
+    bool parse_call(size_t &i, int &line, site &found) {
+        while (i < text_.size() && std::isspace(static_cast<unsigned char>(text_[i]))) {
+            line += text_[i++] == '\n';
+        }
+        if (i >= text_.size() || text_[i] != '(') {
+            return false;
+        }
+        i++;
+        std::vector<std::string> args(1);
+        int depth = 0;
+        while (i < text_.size()) {
+            char c = text_[i];
+            if (c == '"' || c == '\'') {
+                size_t end = skip_literal(i);
+                args.back() += text_.substr(i, end - i);
+                i = end;
+                continue;
+            }
+            i++;
+            if (c == '\n') {
+                line++;
+            }
+            if (c == '(') {
+                depth++;
+            } else if (c == ')' && depth-- == 0) {
+                break;
+            } else if (c == ',' && depth == 0) {
+                args.emplace_back();
+                continue;
+            }
+            args.back() += c;
+        }
+        if (args.size() < 2) {
+            return false;
+        }
+        found.tag = resolve_tag(trim(args[0]));
+        return concatenate(args[1], found.format);
+    }
+
+    // The format argument: string literals, perhaps with PRI macros between them
+    bool concatenate(const std::string &arg, std::string &format) const {
+        size_t i = 0;
+        bool any = false;
+        while (i < arg.size()) {
+            char c = arg[i];
+            if (std::isspace(static_cast<unsigned char>(c))) {
+                i++;
+            } else if (c == '"') {
+                size_t start = ++i;
+                while (i < arg.size() && arg[i] != '"') {
+                    i += arg[i] == '\\' ? 2 : 1;
+                }
+                format += arg.substr(start, i - start);
+                i++;
+                any = true;
+            } else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+                size_t start = i;
+                while (i < arg.size() && (std::isalnum(static_cast<unsigned char>(arg[i])) || arg[i] == '_')) {
+                    i++;
+                }
+                std::string conversion;
+                if (!resolve_inttypes(arg.substr(start, i - start), conversion)) {
+                    return false;
+                }
+                format += conversion;
+            } else {
+                return false;
+            }
+        }
+        return any;
+    }
+
+    std::string resolve_tag(const std::string &expression) const {
+        if (expression.size() >= 2 && expression.front() == '"' && expression.back() == '"') {
+            return expression.substr(1, expression.size() - 2);
+        }
+        // static const char *TAG = "..." or #define TAG "..."
+        std::regex pattern("\\b" + expression + "(\\s*=)?\\s*\"([^\"]*)\"");
+        std::smatch match;
+        if (std::regex_search(text_, match, pattern)) {
+            return match[2];
+        }
+        return "?";
+    }
+
+    static std::string trim(const std::string &s) {
+        size_t start = s.find_first_not_of(" \t\r\n");
+        size_t end = s.find_last_not_of(" \t\r\n");
+        return start == std::string::npos ? "" : s.substr(start, end - start + 1);
+    }
+
+    std::string path_;
+    std::string text_;
+    bool ok_ = false;
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const char *output = nullptr;
+    std::vector<std::string> sources;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (argv[i][0] != '-') {
+            sources.emplace_back(argv[i]);
+        } else {
+            std::fprintf(stderr, "usage: %s [-o FILE] SOURCE...\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::map<uint32_t, site> sites;
+    std::map<uint16_t, std::string> files;
+    for (const std::string &source : sources) {
+        extractor reader(source);
+        if (!reader.ok()) {
+            std::perror(source.c_str());
+            return 1;
+        }
+        std::vector<std::pair<int, site>> found;
+        if (!reader.extract(found)) {
+            return 1;
+        }
+        if (found.empty()) {
+            continue;
+        }
+        uint16_t hash = file_hash(source);
+        auto file = files.emplace(hash, base_name(source));
+        if (!file.second && file.first->second != base_name(source)) {
+            std::fprintf(stderr, "%s and %s hash alike; rename one\n", file.first->second.c_str(), source.c_str());
+            return 1;
+        }
+        for (const auto &entry : found) {
+            uint32_t id = static_cast<uint32_t>(hash) << 16 | (static_cast<uint32_t>(entry.first) & 0xFFFF);
+            auto placed = sites.emplace(id, entry.second);
+            // A one-line site after a multi-line one can land on its last line
+            if (!placed.second && placed.first->second.location != entry.second.location) {
+                std::fprintf(stderr, "%s and %s share site ID %08x; put them on separate lines\n",
+                             placed.first->second.location.c_str(), entry.second.location.c_str(), id);
+                return 1;
+            }
+        }
+    }
+
+    FILE *out = output != nullptr ? std::fopen(output, "w") : stdout;
+    if (out == nullptr) {
+        std::perror(output);
+        return 1;
+    }
+    for (const auto &entry : sites) {
+        const site &s = entry.second;
+        std::fprintf(out, "%08x\t%c\t%s\t%s\t%s\n", entry.first, s.level, s.tag.c_str(), s.location.c_str(), s.format.c_str());
+    }
+    if (out != stdout) {
+        std::fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,455 @@
+#include "i2c_service.h"
+#include "sim_bus.h"
+#include "sim_kernel.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+// The bus arbiter against fake slaves on the simulated bus, without any of
+// the sensor drivers: batch atomicity and order, poll accounting and backoff,
+// the throughput and tail latency with every submitter at full rate, and the
+// retries and bus recovery under injected NACKs and a stuck SDA line.
+//
+//   ./build-host/i2c_arbiter_test
+
+#define FAKE_A_ADDRESS 0x30
+#define FAKE_B_ADDRESS 0x31
+#define FAKE_C_ADDRESS 0x32
+#define FAKE_READY 0x01              // Status bit a poll waits for
+#define TRACE_MAX 4096
+
+#define ORDER_BATCHES 8              // Per submitter
+#define ORDER_OPS 4                  // Writes per batch, all tagged with the batch
+#define LOAD_SECONDS 1
+#define LOAD_SUBMITTERS 3
+
+// A slave that logs every write and reports busy for a set number of status reads
+typedef struct {
+    sim_i2c_model_t model;
+    uint32_t busy_reads;
+} fake_device_t;
+
+static fake_device_t fakes[] = {
+    {.model = {.name = "fake_a", .address = FAKE_A_ADDRESS}},
+    {.model = {.name = "fake_b", .address = FAKE_B_ADDRESS}},
+    {.model = {.name = "fake_c", .address = FAKE_C_ADDRESS}},
+};
+
+// Order in which writes reached the wire, as address and first byte
+static struct {
+    uint16_t address;
+    uint8_t tag;
+} trace[TRACE_MAX];
+static size_t trace_length;
+
+static i2c_master_dev_handle_t fake_devs[3];
+static uint32_t check_failures;
+
+// Report a broken expectation; the run still goes on so every failure shows
+static void test_check(bool ok, const char *format, ...) {
+    if (ok) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    printf("check failed: ");
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+    check_failures++;
+}
+
+static esp_err_t fake_write(sim_i2c_model_t *model, const uint8_t *data, size_t len) {
+    if (len > 0 && trace_length < TRACE_MAX) {
+        trace[trace_length].address = model->address;
+        trace[trace_length].tag = data[0];
+        trace_length++;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t fake_read(sim_i2c_model_t *model, uint8_t *data, size_t len) {
+    fake_device_t *fake = (fake_device_t *)model;
+    for (size_t i = 0; i < len; i++) {
+        data[i] = 0xA5;
+    }
+    if (len > 0) {
+        data[0] = fake->busy_reads > 0 ? 0 : FAKE_READY;
+        fake->busy_reads -= fake->busy_reads > 0;
+    }
+    return ESP_OK;
+}
+
+static i2c_device_stats_t device_stats(uint16_t address) {
+    i2c_device_stats_t stats[4] = {0};
+    size_t count = i2c_get_device_stats(stats, 4, false);
+    for (size_t i = 0; i < count; i++) {
+        if (stats[i].address == address) {
+            return stats[i];
+        }
+    }
+    return (i2c_device_stats_t) {0};
+}
+
+static void reset_stats(void) {
+    i2c_device_stats_t stats[4];
+    i2c_arbiter_stats_t arbiter;
+    i2c_get_device_stats(stats, 4, true);
+    i2c_get_arbiter_stats(&arbiter, true);
+    trace_length = 0;
+}
+
+// Batches of one submitter for the order test, and the order they completed in
+typedef struct {
+    i2c_master_dev_handle_t dev;
+    uint8_t base_tag;
+    uint8_t tags[ORDER_BATCHES][ORDER_OPS];
+    i2c_op_t ops[ORDER_BATCHES][ORDER_OPS];
+    uint8_t completed[ORDER_BATCHES];
+    size_t completions;
+    SemaphoreHandle_t done;
+} order_submitter_t;
+
+typedef struct {
+    order_submitter_t *submitter;
+    size_t batch;
+} order_ctx_t;
+
+static order_ctx_t order_ctx[2][ORDER_BATCHES];
+
+static void order_done(esp_err_t result, void *ctx) {
+    order_ctx_t *order = ctx;
+    order_submitter_t *submitter = order->submitter;
+    test_check(result == ESP_OK, "order batch %zu failed: %s", order->batch, esp_err_to_name(result));
+    if (submitter->completions < ORDER_BATCHES) {
+        submitter->completed[submitter->completions] = (uint8_t)order->batch;
+    }
+    if (++submitter->completions == ORDER_BATCHES) {
+        xSemaphoreGive(submitter->done);
+    }
+}
+
+// Queue every batch at once without waiting, as a driver with callbacks would
+static void order_task(void *arg) {
+    order_submitter_t *submitter = arg;
+    size_t index = submitter->base_tag == 0x10 ? 0 : 1;
+    for (size_t batch = 0; batch < ORDER_BATCHES; batch++) {
+        for (size_t op = 0; op < ORDER_OPS; op++) {
+            submitter->tags[batch][op] = (uint8_t)(submitter->base_tag + batch);
+            submitter->ops[batch][op] = (i2c_op_t) {.type = I2C_OP_WRITE, .write_buf = &submitter->tags[batch][op], .write_size = 1};
+        }
+        order_ctx[index][batch] = (order_ctx_t) {.submitter = submitter, .batch = batch};
+        esp_err_t ret = i2c_submit(submitter->dev, submitter->ops[batch], ORDER_OPS, order_done, &order_ctx[index][batch]);
+        test_check(ret == ESP_OK, "submit of batch %zu failed: %s", batch, esp_err_to_name(ret));
+    }
+    vTaskDelete(NULL);
+}
+
+// Two tasks queue batches to two devices at the same time: every batch must
+// reach the wire whole, and each submitter's batches complete in the order queued
+static void test_batch_order(void) {
+    reset_stats();
+    static order_submitter_t submitters[2];
+    StaticSemaphore_t done_buffers[2];
+    for (int i = 0; i < 2; i++) {
+        memset(&submitters[i], 0, sizeof(submitters[i]));
+        submitters[i].dev = fake_devs[i];
+        submitters[i].base_tag = (uint8_t)(0x10 * (i + 1));
+        submitters[i].done = xSemaphoreCreateBinaryStatic(&done_buffers[i]);
+        xTaskCreate(order_task, i == 0 ? "order_a" : "order_b", 4096, &submitters[i], 4, NULL);
+    }
+    for (int i = 0; i < 2; i++) {
+        test_check(xSemaphoreTake(submitters[i].done, pdMS_TO_TICKS(1000)) == pdTRUE, "submitter %d did not complete", i);
+        for (size_t batch = 0; batch < ORDER_BATCHES; batch++) {
+            test_check(submitters[i].completed[batch] == batch, "submitter %d batch %zu completed in place %u", i, batch,
+                       (unsigned)submitters[i].completed[batch]);
+        }
+        vSemaphoreDelete(submitters[i].done);
+    }
+
+    test_check(trace_length == 2 * ORDER_BATCHES * ORDER_OPS, "%zu writes on the wire, expected %d", trace_length, 2 * ORDER_BATCHES * ORDER_OPS);
+    for (size_t i = 0; i + ORDER_OPS <= trace_length; i += ORDER_OPS) {
+        for (size_t op = 1; op < ORDER_OPS; op++) {
+            test_check(trace[i + op].address == trace[i].address && trace[i + op].tag == trace[i].tag,
+                       "batch 0x%02X interleaved with 0x%02X at write %zu", trace[i].tag, trace[i + op].tag, i + op);
+        }
+    }
+    printf("order: %zu batches from 2 submitters, %zu writes, each batch whole and in order\n", (size_t)2 * ORDER_BATCHES, trace_length);
+}
+
+// A poll that sees busy a few times: each iteration is a transaction that moves
+// the pointer byte and one status byte, and the later ones back off
+static void test_poll_accounting(void) {
+    reset_stats();
+    static const uint8_t status_pointer = 0x00;
+    uint8_t status;
+    const uint32_t busy = 4;
+    fakes[0].busy_reads = busy;
+    i2c_op_t op = {
+        .type = I2C_OP_POLL,
+        .write_buf = &status_pointer, .write_size = 1,
+        .read_buf = &status, .read_size = 1,
+        .poll_mask = FAKE_READY, .poll_value = FAKE_READY,
+        .max_polls = 10,
+        .spin_polls = 1,
+        .yield_polls = 2,
+    };
+    i2c_batch_info_t info = {0};
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = i2c_transfer_info(fake_devs[0], &op, 1, &info);
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+    i2c_device_stats_t stats = device_stats(FAKE_A_ADDRESS);
+
+    uint32_t polls = busy + 1;
+    test_check(ret == ESP_OK, "poll failed: %s", esp_err_to_name(ret));
+    test_check(info.polls == polls && info.transactions == polls, "batch reported %" PRIu32 " polls in %" PRIu32 " transactions, expected %" PRIu32,
+               info.polls, info.transactions, polls);
+    test_check(stats.transactions == polls && stats.poll_iterations == polls, "device counted %" PRIu32 " transactions and %" PRIu32 " polls",
+               stats.transactions, stats.poll_iterations);
+    test_check(stats.bytes_written == polls && stats.bytes_read == polls, "device counted %" PRIu32 " bytes written and %" PRIu32 " read, expected %" PRIu32 " each",
+               stats.bytes_written, stats.bytes_read, polls);
+    // Polls from yield_polls on sleep until the next tick, the last one excepted;
+    // the first sleep may end at a tick boundary that was already close
+    int64_t sleeps = polls - 1 - op.yield_polls;
+    test_check(elapsed_us > (sleeps - 1) * portTICK_PERIOD_MS * 1000, "%" PRId64 " tick sleeps took only %" PRId64 " us", sleeps, elapsed_us);
+    printf("poll: %" PRIu32 " polls, %" PRIu32 " bytes each way, %" PRId64 " us with backoff\n", info.polls, stats.bytes_read, elapsed_us);
+
+    // One that never sees its value gives up after max_polls
+    fakes[0].busy_reads = 100;
+    op.max_polls = 3;
+    op.spin_polls = 3;
+    ret = i2c_transfer_info(fake_devs[0], &op, 1, &info);
+    fakes[0].busy_reads = 0;
+    test_check(ret == ESP_ERR_INVALID_RESPONSE, "exhausted poll returned %s", esp_err_to_name(ret));
+    test_check(info.polls == op.max_polls * info.attempts, "exhausted poll made %" PRIu32 " polls over %u attempts", info.polls, info.attempts);
+}
+
+// Submitter that reads its device back to back for the load test
+typedef struct {
+    i2c_master_dev_handle_t dev;
+    int64_t end_us;
+    uint32_t batches;
+    uint32_t failures;
+    SemaphoreHandle_t done;
+} load_submitter_t;
+
+static void load_task(void *arg) {
+    load_submitter_t *submitter = arg;
+    static const uint8_t command[2] = {0xEC, 0x05};
+    uint8_t reply[6];
+    i2c_op_t op = {.type = I2C_OP_WRITE_READ, .write_buf = command, .write_size = sizeof(command), .read_buf = reply, .read_size = sizeof(reply)};
+    while (esp_timer_get_time() < submitter->end_us) {
+        if (i2c_transfer(submitter->dev, &op, 1) != ESP_OK) {
+            submitter->failures++;
+        }
+        submitter->batches++;
+    }
+    xSemaphoreGive(submitter->done);
+    vTaskDelete(NULL);
+}
+
+// Every device read as fast as the arbiter allows: the bus should never idle,
+// and no batch should wait for more than one batch per other submitter
+static void test_load(void) {
+    reset_stats();
+    static load_submitter_t submitters[LOAD_SUBMITTERS];
+    StaticSemaphore_t done_buffers[LOAD_SUBMITTERS];
+    int64_t start_us = esp_timer_get_time();
+    for (int i = 0; i < LOAD_SUBMITTERS; i++) {
+        submitters[i] = (load_submitter_t) {
+            .dev = fake_devs[i],
+            .end_us = start_us + LOAD_SECONDS * 1000000LL,
+            .done = xSemaphoreCreateBinaryStatic(&done_buffers[i]),
+        };
+        xTaskCreate(load_task, "load", 4096, &submitters[i], 4, NULL);
+    }
+    for (int i = 0; i < LOAD_SUBMITTERS; i++) {
+        xSemaphoreTake(submitters[i].done, portMAX_DELAY);
+        vSemaphoreDelete(submitters[i].done);
+        test_check(submitters[i].failures == 0, "submitter %d saw %" PRIu32 " failures", i, submitters[i].failures);
+    }
+    double seconds = (esp_timer_get_time() - start_us) / 1e6;
+
+    i2c_arbiter_stats_t arbiter;
+    i2c_get_arbiter_stats(&arbiter, false);
+    uint32_t transaction_us = 0;
+    for (int i = 0; i < LOAD_SUBMITTERS; i++) {
+        i2c_device_stats_t stats = device_stats(fakes[i].model.address);
+        uint32_t mean_us = stats.transactions > 0 ? (uint32_t)(stats.bus_time_us / stats.transactions) : 0;
+        transaction_us = mean_us > transaction_us ? mean_us : transaction_us;
+        test_check(stats.batches == submitters[i].batches, "device 0x%02X counted %" PRIu32 " of %" PRIu32 " batches",
+                   stats.address, stats.batches, submitters[i].batches);
+        printf("load 0x%02X: %" PRIu32 " transactions of %" PRIu32 " us, submit to done p50<=%" PRIu32 " us p99<=%" PRIu32 " us max<=%" PRIu32 " us\n",
+               stats.address, stats.transactions, mean_us,
+               i2c_latency_percentile(stats.batch_latency_histogram, 50),
+               i2c_latency_percentile(stats.batch_latency_histogram, 99),
+               i2c_latency_percentile(stats.batch_latency_histogram, 100));
+    }
+    double per_second = arbiter.transactions / seconds;
+    printf("load: %" PRIu32 " transactions in %.3f s (%.0f/s), bus busy %.1f%%, worst latency %" PRIu32 " us\n",
+           arbiter.transactions, seconds, per_second, arbiter.busy_us / (seconds * 1e4), arbiter.max_latency_us);
+    test_check(transaction_us > 0 && per_second >= 0.95e6 / transaction_us, "%.0f transactions/s, the bus fits %.0f/s",
+               per_second, transaction_us > 0 ? 1e6 / transaction_us : 0.0);
+    test_check(arbiter.max_latency_us <= LOAD_SUBMITTERS * transaction_us + portTICK_PERIOD_MS * 1000,
+               "a batch waited %" PRIu32 " us behind %d submitters of %" PRIu32 " us each", arbiter.max_latency_us, LOAD_SUBMITTERS, transaction_us);
+}
+
+// Write one byte to fake A under policy and report the result, the batch cost,
+// the time taken and how the arbiter and wire counters moved
+typedef struct {
+    esp_err_t result;
+    i2c_batch_info_t info;
+    int64_t elapsed_us;
+    i2c_arbiter_stats_t arbiter;
+    sim_bus_stats_t bus;
+} fault_run_t;
+
+static fault_run_t fault_write(const i2c_device_policy_t *policy) {
+    static const uint8_t byte = 0x42;
+    const i2c_op_t op = {.type = I2C_OP_WRITE, .write_buf = &byte, .write_size = 1};
+    fault_run_t run = {0};
+    sim_bus_stats_t bus_before;
+    reset_stats();
+    sim_bus_get_stats(&bus_before);
+    ESP_ERROR_CHECK(i2c_set_device_policy(fake_devs[0], policy));
+    int64_t start_us = esp_timer_get_time();
+    run.result = i2c_transfer_info(fake_devs[0], &op, 1, &run.info);
+    run.elapsed_us = esp_timer_get_time() - start_us;
+    i2c_get_arbiter_stats(&run.arbiter, false);
+    sim_bus_get_stats(&run.bus);
+    run.bus.nacks -= bus_before.nacks;
+    run.bus.timeouts -= bus_before.timeouts;
+    run.bus.resets -= bus_before.resets;
+    return run;
+}
+
+static uint32_t device_error_count(uint16_t address, esp_err_t code) {
+    i2c_device_stats_t stats = device_stats(address);
+    for (size_t i = 0; i < I2C_ERROR_SLOTS; i++) {
+        if (stats.errors[i].count > 0 && stats.errors[i].code == code) {
+            return stats.errors[i].count;
+        }
+    }
+    return 0;
+}
+
+// Injected NACKs and a stuck SDA line: retries, backoff, bus recovery and the
+// batch deadline must all show up exactly in the result and the counters
+static void test_faults(void) {
+    const i2c_device_policy_t policy = {
+        .timeout_ms = 20,
+        .budget_ms = 250,
+        .max_attempts = 3,
+        .backoff_ms = 20,
+        .max_backoff_ms = 40,
+        .recover_on_timeout = true,
+    };
+    const int64_t tick_us = portTICK_PERIOD_MS * 1000;
+
+    // Two NACKs: the third attempt gets through after backing off 20 then 40 ms
+    sim_bus_inject_nack(FAKE_A_ADDRESS, 2);
+    fault_run_t run = fault_write(&policy);
+    test_check(run.result == ESP_OK, "write after 2 NACKs failed: %s", esp_err_to_name(run.result));
+    test_check(run.info.attempts == 3 && run.arbiter.retries == 2, "2 NACKs took %u attempts and %" PRIu32 " retries", run.info.attempts, run.arbiter.retries);
+    test_check(run.bus.nacks == 2 && device_error_count(FAKE_A_ADDRESS, ESP_FAIL) == 2, "%" PRIu32 " NACKs on the wire, %" PRIu32 " counted",
+               run.bus.nacks, device_error_count(FAKE_A_ADDRESS, ESP_FAIL));
+    test_check(run.arbiter.bus_recoveries == 0 && run.bus.resets == 0, "a NACK ran bus recovery");
+    test_check(run.elapsed_us >= (20 + 40) * 1000 - tick_us, "backoff of 20 + 40 ms took only %" PRId64 " us", run.elapsed_us);
+    printf("faults: 2 NACKs recovered in %u attempts, %" PRId64 " us\n", run.info.attempts, run.elapsed_us);
+
+    // More NACKs than attempts: the batch fails once, as an error and not a deadline miss
+    sim_bus_inject_nack(FAKE_A_ADDRESS, 5);
+    run = fault_write(&policy);
+    sim_bus_inject_nack(FAKE_A_ADDRESS, 0);
+    test_check(run.result == ESP_FAIL, "write under 5 NACKs returned %s", esp_err_to_name(run.result));
+    test_check(run.info.attempts == policy.max_attempts && run.arbiter.errors == 1 && run.arbiter.deadline_misses == 0,
+               "exhausted NACK retries: %u attempts, %" PRIu32 " errors, %" PRIu32 " deadline misses", run.info.attempts, run.arbiter.errors,
+               run.arbiter.deadline_misses);
+
+    // SDA held low until recovery: one timeout, one bus reset, then success
+    sim_bus_set_sda_stuck(true, true);
+    run = fault_write(&policy);
+    test_check(run.result == ESP_OK, "write after a released stuck bus failed: %s", esp_err_to_name(run.result));
+    test_check(run.bus.timeouts == 1 && device_error_count(FAKE_A_ADDRESS, ESP_ERR_TIMEOUT) == 1, "%" PRIu32 " timeouts on the wire", run.bus.timeouts);
+    test_check(run.arbiter.bus_recoveries == 1 && run.bus.resets == 1, "%" PRIu32 " recoveries, %" PRIu32 " bus resets, expected 1",
+               run.arbiter.bus_recoveries, run.bus.resets);
+    test_check(run.info.attempts == 2 && run.arbiter.retries == 1, "released bus took %u attempts", run.info.attempts);
+    printf("faults: stuck SDA released by bus reset, %u attempts, %" PRId64 " us\n", run.info.attempts, run.elapsed_us);
+
+    // SDA that stays low: every attempt times out and recovers, and the batch fails
+    sim_bus_set_sda_stuck(true, false);
+    run = fault_write(&policy);
+    test_check(run.result == ESP_ERR_TIMEOUT, "write on a stuck bus returned %s", esp_err_to_name(run.result));
+    test_check(run.arbiter.bus_recoveries == policy.max_attempts && run.bus.resets == policy.max_attempts,
+               "%" PRIu32 " recoveries and %" PRIu32 " resets for %u attempts", run.arbiter.bus_recoveries, run.bus.resets, policy.max_attempts);
+    test_check(run.elapsed_us <= (int64_t)policy.budget_ms * 1000 + tick_us, "stuck bus held the batch for %" PRId64 " us", run.elapsed_us);
+
+    // A budget too short for the backoff ends the batch as a deadline miss
+    i2c_device_policy_t tight = policy;
+    tight.budget_ms = 30;
+    run = fault_write(&tight);
+    sim_bus_set_sda_stuck(false, false);
+    test_check(run.result == ESP_ERR_TIMEOUT && run.arbiter.deadline_misses == 1, "tight budget: %s with %" PRIu32 " deadline misses",
+               esp_err_to_name(run.result), run.arbiter.deadline_misses);
+    test_check(run.info.attempts == 1 && run.elapsed_us <= (int64_t)tight.budget_ms * 1000, "tight budget: %u attempts over %" PRId64 " us",
+               run.info.attempts, run.elapsed_us);
+    printf("faults: stuck SDA failed after %u recoveries; a %" PRIu32 " ms budget ends after %u attempt\n",
+           policy.max_attempts, tight.budget_ms, run.info.attempts);
+
+    // The bus works again afterwards
+    run = fault_write(&policy);
+    test_check(run.result == ESP_OK && run.info.attempts == 1, "write after the faults: %s in %u attempts", esp_err_to_name(run.result), run.info.attempts);
+}
+
+// An operator's bus recovery resets the bus without showing up on any device
+static void test_recover_bus(void) {
+    sim_bus_stats_t bus_before, bus_after;
+    reset_stats();
+    sim_bus_get_stats(&bus_before);
+    esp_err_t ret = i2c_recover_bus();
+    sim_bus_get_stats(&bus_after);
+    i2c_arbiter_stats_t arbiter;
+    i2c_get_arbiter_stats(&arbiter, false);
+    test_check(ret == ESP_OK && arbiter.bus_recoveries == 1 && bus_after.resets == bus_before.resets + 1,
+               "recovery: %s, %" PRIu32 " recoveries, %" PRIu32 " bus resets", esp_err_to_name(ret), arbiter.bus_recoveries,
+               bus_after.resets - bus_before.resets);
+    test_check(arbiter.batches == 0 && arbiter.transactions == 0, "recovery counted as %" PRIu32 " batches", arbiter.batches);
+    for (size_t i = 0; i < sizeof(fakes) / sizeof(fakes[0]); i++) {
+        i2c_device_stats_t stats = device_stats(fakes[i].model.address);
+        test_check(stats.batches == 0 && stats.transactions == 0, "recovery charged to 0x%02X: %" PRIu32 " batches",
+                   fakes[i].model.address, stats.batches);
+    }
+    printf("recover: one bus reset, no device charged\n");
+}
+
+static void test_task(void *arg) {
+    i2c_master_bus_handle_t bus;
+    ESP_ERROR_CHECK(initialize_i2c_master(&bus));
+    for (int i = 0; i < 3; i++) {
+        ESP_ERROR_CHECK(add_i2c_device(bus, &fake_devs[i], fakes[i].model.address));
+    }
+
+    test_batch_order();
+    test_poll_accounting();
+    test_load();
+    test_faults();
+    test_recover_bus();
+
+    printf("checks: %s\n", check_failures > 0 ? "FAILED" : "all passed");
+    sim_kernel_stop(check_failures > 0 ? 1 : 0);
+}
+
+int main(void) {
+    for (size_t i = 0; i < sizeof(fakes) / sizeof(fakes[0]); i++) {
+        fakes[i].model.write = fake_write;
+        fakes[i].model.read = fake_read;
+        sim_bus_attach(&fakes[i].model);
+    }
+    return sim_kernel_run(test_task, NULL, 5);
+}
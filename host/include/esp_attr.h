@@ -0,0 +1,8 @@
+#ifndef HOST_ESP_ATTR_H
+#define HOST_ESP_ATTR_H
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+#endif // HOST_ESP_ATTR_H
@@ -0,0 +1,307 @@
+#include "sim_devices.h"
+#include "sim_kernel.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_continuous.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "freertos/semphr.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_ADC_CHANNELS 10
+#define SIM_ADC_MAX_RAW 4095
+#define SIM_ADC_CONVERSION_US 40
+#define SIM_ADC_FULL_SCALE_MV 950    // 0 dB attenuation, as characterised by line fitting
+
+struct adc_cali_scheme_t {
+    adc_atten_t atten;
+};
+
+struct adc_oneshot_unit_ctx_t {
+    adc_unit_t unit_id;
+    bool configured[SIM_ADC_CHANNELS];
+};
+
+// A continuous unit: a model task fills frames on time and queues them in the pool
+struct adc_continuous_ctx_t {
+    uint32_t frame_size;
+    uint32_t pool_size;
+    bool flush_pool;
+    uint8_t *pool;                 // Ring of whole frames
+    uint32_t pool_head;
+    uint32_t pool_count;
+    uint8_t *frame;
+    adc_channel_t pattern[SIM_ADC_CHANNELS];
+    uint32_t pattern_num;
+    uint32_t sample_freq_hz;
+    adc_continuous_evt_cbs_t cbs;
+    void *user_data;
+    TaskHandle_t task;
+    volatile bool running;
+    SemaphoreHandle_t data;        // Given whenever a frame lands in the pool
+    SemaphoreHandle_t stopped;
+};
+
+typedef struct {
+    int mean_raw;
+    int noise_raw;
+    uint32_t spike_every;          // Every n-th sample reads spike_raw high, 0 for none
+    int spike_raw;
+    uint32_t samples;
+} adc_input_t;
+
+static adc_input_t inputs[SIM_ADC_CHANNELS] = {
+    [ADC_CHANNEL_6] = {.mean_raw = 1200, .noise_raw = 25},
+};
+static uint32_t noise_state = 0x12345678;
+
+// Deterministic noise in [-noise, noise], roughly bell-shaped (sum of four uniforms)
+static int next_noise(int noise_raw) {
+    if (noise_raw <= 0) {
+        return 0;
+    }
+    int sum = 0;
+    for (int i = 0; i < 4; i++) {
+        noise_state = noise_state * 1664525u + 1013904223u;
+        sum += (int)((noise_state >> 16) % (uint32_t)(2 * noise_raw + 1)) - noise_raw;
+    }
+    return sum / 2;
+}
+
+void sim_adc_set_input(adc_channel_t channel, int mean_raw, int noise_raw) {
+    if ((int)channel < SIM_ADC_CHANNELS) {
+        inputs[channel].mean_raw = mean_raw;
+        inputs[channel].noise_raw = noise_raw;
+    }
+}
+
+void sim_adc_set_spikes(adc_channel_t channel, uint32_t every, int spike_raw) {
+    if ((int)channel < SIM_ADC_CHANNELS) {
+        inputs[channel].spike_every = every;
+        inputs[channel].spike_raw = spike_raw;
+    }
+}
+
+// One conversion of a channel, clamped to 12 bits
+static int sample_input(adc_channel_t chan) {
+    adc_input_t *input = &inputs[chan];
+    int raw = input->mean_raw + next_noise(input->noise_raw);
+    input->samples++;
+    if (input->spike_every != 0 && input->samples % input->spike_every == 0) {
+        raw += input->spike_raw;
+    }
+    return raw < 0 ? 0 : (raw > SIM_ADC_MAX_RAW ? SIM_ADC_MAX_RAW : raw);
+}
+
+esp_err_t adc_oneshot_new_unit(const adc_oneshot_unit_init_cfg_t *init_config, adc_oneshot_unit_handle_t *ret_unit) {
+    struct adc_oneshot_unit_ctx_t *unit = calloc(1, sizeof(*unit));
+    if (unit == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    unit->unit_id = init_config->unit_id;
+    *ret_unit = unit;
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_config_channel(adc_oneshot_unit_handle_t handle, adc_channel_t channel, const adc_oneshot_chan_cfg_t *config) {
+    (void)config;
+    if (handle == NULL || (int)channel >= SIM_ADC_CHANNELS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    handle->configured[channel] = true;
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_read(adc_oneshot_unit_handle_t handle, adc_channel_t chan, int *out_raw) {
+    if (handle == NULL || (int)chan >= SIM_ADC_CHANNELS || !handle->configured[chan]) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_kernel_block_us(SIM_ADC_CONVERSION_US);
+    *out_raw = sample_input(chan);
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_del_unit(adc_oneshot_unit_handle_t handle) {
+    free(handle);
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_new_handle(const adc_continuous_handle_cfg_t *hdl_config, adc_continuous_handle_t *ret_handle) {
+    if (hdl_config == NULL || ret_handle == NULL || hdl_config->conv_frame_size == 0 ||
+        hdl_config->conv_frame_size % SOC_ADC_DIGI_RESULT_BYTES != 0 || hdl_config->max_store_buf_size < hdl_config->conv_frame_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct adc_continuous_ctx_t *handle = calloc(1, sizeof(*handle));
+    if (handle == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    handle->frame_size = hdl_config->conv_frame_size;
+    // Whole frames only, like the driver's ring buffer
+    handle->pool_size = hdl_config->max_store_buf_size / hdl_config->conv_frame_size * hdl_config->conv_frame_size;
+    handle->flush_pool = hdl_config->flags.flush_pool;
+    handle->pool = malloc(handle->pool_size);
+    handle->frame = malloc(handle->frame_size);
+    handle->data = xSemaphoreCreateBinary();
+    handle->stopped = xSemaphoreCreateBinary();
+    *ret_handle = handle;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_config(adc_continuous_handle_t handle, const adc_continuous_config_t *config) {
+    if (handle == NULL || config == NULL || config->pattern_num == 0 || config->pattern_num > SIM_ADC_CHANNELS ||
+        config->sample_freq_hz < SOC_ADC_SAMPLE_FREQ_THRES_LOW || config->sample_freq_hz > SOC_ADC_SAMPLE_FREQ_THRES_HIGH) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (uint32_t i = 0; i < config->pattern_num; i++) {
+        if (config->adc_pattern[i].channel >= SIM_ADC_CHANNELS) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        handle->pattern[i] = (adc_channel_t)config->adc_pattern[i].channel;
+    }
+    handle->pattern_num = config->pattern_num;
+    handle->sample_freq_hz = config->sample_freq_hz;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_register_event_callbacks(adc_continuous_handle_t handle, const adc_continuous_evt_cbs_t *cbs, void *user_data) {
+    if (handle == NULL || cbs == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    handle->cbs = *cbs;
+    handle->user_data = user_data;
+    return ESP_OK;
+}
+
+// Fills one frame per frame period; the callbacks run here as they would from the DMA ISR
+static void adc_continuous_task(void *arg) {
+    struct adc_continuous_ctx_t *handle = arg;
+    uint32_t samples = handle->frame_size / SOC_ADC_DIGI_RESULT_BYTES;
+    int64_t frame_us = (int64_t)samples * 1000000 / handle->sample_freq_hz;
+    int64_t due_us = sim_kernel_now_us() + frame_us;
+    uint32_t pattern_index = 0;
+
+    while (handle->running) {
+        sim_kernel_notify_take_until(due_us);
+        if (!handle->running) {
+            break;
+        }
+        if (sim_kernel_now_us() < due_us) {
+            continue;
+        }
+        due_us += frame_us;
+
+        adc_digi_output_data_t *out = (adc_digi_output_data_t *)handle->frame;
+        for (uint32_t i = 0; i < samples; i++) {
+            adc_channel_t chan = handle->pattern[pattern_index];
+            pattern_index = (pattern_index + 1) % handle->pattern_num;
+            out[i].val = 0;
+            out[i].type1.channel = chan;
+            out[i].type1.data = (uint16_t)sample_input(chan);
+        }
+
+        adc_continuous_evt_data_t edata = {
+            .conv_frame_buffer = handle->frame,
+            .size = handle->frame_size,
+        };
+        if (handle->pool_size - handle->pool_count < handle->frame_size) {
+            if (handle->cbs.on_pool_ovf != NULL) {
+                handle->cbs.on_pool_ovf(handle, &edata, handle->user_data);
+            }
+            if (!handle->flush_pool) {
+                continue;
+            }
+            handle->pool_head = (handle->pool_head + handle->frame_size) % handle->pool_size;
+            handle->pool_count -= handle->frame_size;
+        }
+        uint32_t tail = (handle->pool_head + handle->pool_count) % handle->pool_size;
+        memcpy(handle->pool + tail, handle->frame, handle->frame_size);
+        handle->pool_count += handle->frame_size;
+        if (handle->cbs.on_conv_done != NULL) {
+            handle->cbs.on_conv_done(handle, &edata, handle->user_data);
+        }
+        xSemaphoreGive(handle->data);
+    }
+    xSemaphoreGive(handle->stopped);
+    vTaskDelete(NULL);
+}
+
+esp_err_t adc_continuous_start(adc_continuous_handle_t handle) {
+    if (handle == NULL || handle->pattern_num == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (handle->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    handle->running = true;
+    xTaskCreate(adc_continuous_task, "adc_dma", 4096, handle, 24, &handle->task);
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_read(adc_continuous_handle_t handle, uint8_t *buf, uint32_t length_max, uint32_t *out_length, uint32_t timeout_ms) {
+    if (handle == NULL || buf == NULL || out_length == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    while (handle->pool_count == 0) {
+        if (timeout_ms == 0 || xSemaphoreTake(handle->data, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+            *out_length = 0;
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+    uint32_t length = length_max < handle->pool_count ? length_max : handle->pool_count;
+    for (uint32_t i = 0; i < length; i++) {
+        buf[i] = handle->pool[(handle->pool_head + i) % handle->pool_size];
+    }
+    handle->pool_head = (handle->pool_head + length) % handle->pool_size;
+    handle->pool_count -= length;
+    *out_length = length;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_stop(adc_continuous_handle_t handle) {
+    if (handle == NULL || !handle->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    handle->running = false;
+    xTaskNotifyGive(handle->task);
+    xSemaphoreTake(handle->stopped, portMAX_DELAY);
+    handle->task = NULL;
+    return ESP_OK;
+}
+
+esp_err_t adc_continuous_deinit(adc_continuous_handle_t handle) {
+    if (handle == NULL || handle->running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    vSemaphoreDelete(handle->data);
+    vSemaphoreDelete(handle->stopped);
+    free(handle->pool);
+    free(handle->frame);
+    free(handle);
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_create_scheme_line_fitting(const adc_cali_line_fitting_config_t *config, adc_cali_handle_t *ret_handle) {
+    if (config == NULL || ret_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct adc_cali_scheme_t *handle = calloc(1, sizeof(*handle));
+    if (handle == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    handle->atten = config->atten;
+    *ret_handle = handle;
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_delete_scheme_line_fitting(adc_cali_handle_t handle) {
+    free(handle);
+    return ESP_OK;
+}
+
+// Ideal line: full scale of a 12-bit conversion maps to SIM_ADC_FULL_SCALE_MV
+esp_err_t adc_cali_raw_to_voltage(adc_cali_handle_t handle, int raw, int *voltage) {
+    if (handle == NULL || voltage == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *voltage = (raw * SIM_ADC_FULL_SCALE_MV + SIM_ADC_MAX_RAW / 2) / SIM_ADC_MAX_RAW;
+    return ESP_OK;
+}
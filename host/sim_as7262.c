@@ -0,0 +1,268 @@
+#include "sim_devices.h"
+#include "sim_kernel.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+
+#define AS7262_ADDRESS 0x49
+
+// Slave (physical) registers
+#define REG_STATUS 0x00
+#define REG_WRITE 0x01
+#define REG_READ 0x02
+
+#define STATUS_RX_VALID 0x01
+#define STATUS_TX_VALID 0x02
+
+// Virtual registers
+#define VREG_CONTROL 0x04
+#define VREG_INT_T 0x05
+#define VREG_TEMP 0x06
+#define VREG_LED 0x07
+#define VREG_RAW_BASE 0x08
+#define VREG_CAL_BASE 0x14
+#define VREG_COUNT 0x2C
+
+#define CONTROL_DATA_RDY 0x02
+#define CONTROL_GAIN_BANK 0x3C
+#define CONTROL_INT 0x40
+#define CONTROL_RST 0x80
+
+#define INTEGRATION_STEP_US 2800   // One INT_T step is 2.8 ms
+#define SLAVE_PROCESSING_US 150    // Time the slave takes to consume a WRITE register byte
+
+typedef struct {
+    sim_i2c_model_t model;
+    uint8_t pointer;
+    uint8_t status;
+    uint8_t read_value;
+    bool rx_pending;               // A virtual read finishes when processing ends
+    bool address_pending;          // A virtual write address is waiting for its data byte
+    uint8_t write_address;
+    int64_t busy_until_us;
+    uint8_t vregs[VREG_COUNT];
+    int64_t conversion_due_us;     // 0 when the sensor is idle
+    float light;
+    uint32_t conversions;
+    int int_gpio;                  // -1 when INT is not wired
+    TaskHandle_t int_task;         // Runs conversions on time while INT is enabled
+} as7262_model_t;
+
+static as7262_model_t as7262 = {
+    .light = 1.0f,
+    .int_gpio = -1,
+};
+
+// Relative response of the V, B, G, Y, O, R channels to the simulated lamp
+static const float channel_weights[6] = {0.35f, 0.55f, 0.80f, 0.95f, 0.85f, 0.60f};
+static const float gain_factors[4] = {1.0f, 3.7f, 16.0f, 64.0f};
+
+static uint8_t bank_mode(void) {
+    return (as7262.vregs[VREG_CONTROL] >> 2) & 0x03;
+}
+
+// Integration of one conversion; bank mode 2 needs two integration periods
+static int64_t conversion_us(void) {
+    int64_t integration = (int64_t)(as7262.vregs[VREG_INT_T] ? as7262.vregs[VREG_INT_T] : 1) * INTEGRATION_STEP_US;
+    return bank_mode() >= 2 ? 2 * integration : integration;
+}
+
+static void put_float_be(uint8_t *dst, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    dst[0] = (uint8_t)(bits >> 24);
+    dst[1] = (uint8_t)(bits >> 16);
+    dst[2] = (uint8_t)(bits >> 8);
+    dst[3] = (uint8_t)bits;
+}
+
+// INT is active low and held while DATA_RDY is set, so a flag nobody clears
+// leaves the line low and a falling-edge interrupt never fires again
+static void update_int_pin(void) {
+    if (as7262.int_gpio < 0) {
+        return;
+    }
+    uint8_t control = as7262.vregs[VREG_CONTROL];
+    bool asserted = (control & CONTROL_INT) && (control & CONTROL_DATA_RDY);
+    sim_gpio_drive(as7262.int_gpio, asserted ? 0 : 1);
+}
+
+// Latch a finished conversion into the channel registers
+static void complete_conversion(void) {
+    float gain = gain_factors[(as7262.vregs[VREG_CONTROL] >> 4) & 0x03];
+    float integration_ms = (float)as7262.vregs[VREG_INT_T] * 2.8f;
+    for (int i = 0; i < 6; i++) {
+        float counts = as7262.light * channel_weights[i] * gain * integration_ms * 20.0f;
+        uint16_t raw = counts > 65535.0f ? 65535 : (uint16_t)counts;
+        as7262.vregs[VREG_RAW_BASE + 2 * i] = (uint8_t)(raw >> 8);
+        as7262.vregs[VREG_RAW_BASE + 2 * i + 1] = (uint8_t)raw;
+        put_float_be(&as7262.vregs[VREG_CAL_BASE + 4 * i], (float)raw / (gain * integration_ms) * 45.0f);
+    }
+    as7262.vregs[VREG_CONTROL] |= CONTROL_DATA_RDY;
+    as7262.conversions++;
+
+    update_int_pin();
+}
+
+// Run conversions up to now; bank modes 0-2 are continuous, mode 3 is one-shot
+static void update_conversions(int64_t now) {
+    while (as7262.conversion_due_us != 0 && now >= as7262.conversion_due_us) {
+        complete_conversion();
+        if (bank_mode() == 3) {
+            as7262.conversion_due_us = 0;
+        } else {
+            as7262.conversion_due_us += conversion_us();
+        }
+    }
+}
+
+static void reset_registers(int64_t now) {
+    memset(as7262.vregs, 0, sizeof(as7262.vregs));
+    as7262.vregs[0x00] = 0x40;                // Hardware version
+    as7262.vregs[VREG_CONTROL] = 0x02 << 2;   // Bank mode 2, gain 1x
+    as7262.vregs[VREG_INT_T] = 0xFF;
+    as7262.vregs[VREG_TEMP] = 25;
+    as7262.conversion_due_us = now + conversion_us();
+}
+
+// With INT enabled nobody polls the part, so conversions are driven on time here
+static void as7262_int_task(void *arg) {
+    (void)arg;
+    while (true) {
+        update_conversions(sim_kernel_now_us());
+        bool interrupt_mode = (as7262.vregs[VREG_CONTROL] & CONTROL_INT) && as7262.conversion_due_us != 0;
+        sim_kernel_notify_take_until(interrupt_mode ? as7262.conversion_due_us : INT64_MAX);
+    }
+}
+
+static uint8_t read_virtual(uint8_t address) {
+    if (address >= VREG_COUNT) {
+        return 0;
+    }
+    // Reading the data leaves DATA_RDY set; only a CONTROL_SETUP write clears it
+    return as7262.vregs[address];
+}
+
+static void write_virtual(uint8_t address, uint8_t value, int64_t now) {
+    if (address == VREG_CONTROL) {
+        if (value & CONTROL_RST) {
+            reset_registers(now);
+            update_int_pin();
+            return;
+        }
+        // DATA_RDY can only be cleared by the host, never set
+        uint8_t previous = as7262.vregs[VREG_CONTROL];
+        uint8_t data_ready = previous & value & CONTROL_DATA_RDY;
+        as7262.vregs[VREG_CONTROL] = (uint8_t)((value & ~CONTROL_DATA_RDY) | data_ready);
+        // A new gain or bank mode restarts the conversion; clearing DATA_RDY or toggling INT does not
+        if (((previous ^ value) & CONTROL_GAIN_BANK) != 0 || as7262.conversion_due_us == 0) {
+            as7262.conversion_due_us = now + conversion_us();
+        }
+        update_int_pin();
+        if ((value & CONTROL_INT) && as7262.int_gpio >= 0) {
+            if (as7262.int_task == NULL) {
+                xTaskCreate(as7262_int_task, "as7262_model", 4096, NULL, 23, &as7262.int_task);
+            } else {
+                xTaskNotifyGive(as7262.int_task);
+            }
+        }
+    } else if (address == VREG_INT_T) {
+        as7262.vregs[VREG_INT_T] = value;
+        as7262.conversion_due_us = now + conversion_us();
+    } else if (address == VREG_LED) {
+        as7262.vregs[VREG_LED] = value;
+    }
+}
+
+// Finish slave-side processing of the last WRITE register byte once its time is up
+static void update_status(int64_t now) {
+    if ((as7262.status & STATUS_TX_VALID) && now >= as7262.busy_until_us) {
+        as7262.status &= (uint8_t)~STATUS_TX_VALID;
+        if (as7262.rx_pending) {
+            as7262.status |= STATUS_RX_VALID;
+            as7262.rx_pending = false;
+        }
+    }
+}
+
+static esp_err_t as7262_write(sim_i2c_model_t *model, const uint8_t *data, size_t len) {
+    (void)model;
+    int64_t now = sim_kernel_now_us();
+    update_conversions(now);
+    update_status(now);
+    if (len == 0) {
+        return ESP_OK;
+    }
+
+    as7262.pointer = data[0];
+    if (len < 2 || as7262.pointer != REG_WRITE) {
+        return ESP_OK;
+    }
+
+    // A byte written while TX_VALID is still set is lost, as on the real part
+    if (as7262.status & STATUS_TX_VALID) {
+        return ESP_OK;
+    }
+    uint8_t byte = data[1];
+    as7262.status |= STATUS_TX_VALID;
+    as7262.busy_until_us = now + SLAVE_PROCESSING_US;
+
+    if (as7262.address_pending) {
+        write_virtual(as7262.write_address, byte, now);
+        as7262.address_pending = false;
+    } else if (byte & 0x80) {
+        as7262.write_address = byte & 0x7F;
+        as7262.address_pending = true;
+    } else {
+        as7262.read_value = read_virtual(byte);
+        as7262.rx_pending = true;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t as7262_read(sim_i2c_model_t *model, uint8_t *data, size_t len) {
+    (void)model;
+    int64_t now = sim_kernel_now_us();
+    update_conversions(now);
+    update_status(now);
+
+    // The register pointer does not auto-increment
+    for (size_t i = 0; i < len; i++) {
+        switch (as7262.pointer) {
+        case REG_STATUS:
+            data[i] = as7262.status;
+            break;
+        case REG_READ:
+            data[i] = as7262.read_value;
+            as7262.status &= (uint8_t)~STATUS_RX_VALID;
+            break;
+        default:
+            data[i] = 0;
+            break;
+        }
+    }
+    return ESP_OK;
+}
+
+sim_i2c_model_t *sim_as7262_model(void) {
+    as7262.model = (sim_i2c_model_t) {
+        .name = "as7262",
+        .address = AS7262_ADDRESS,
+        .write = as7262_write,
+        .read = as7262_read,
+    };
+    reset_registers(sim_kernel_now_us());
+    return &as7262.model;
+}
+
+void sim_as7262_set_light(float level) {
+    as7262.light = level;
+}
+
+void sim_as7262_wire_int(int gpio_num) {
+    as7262.int_gpio = gpio_num;
+}
+
+uint32_t sim_as7262_conversions(void) {
+    return as7262.conversions;
+}
@@ -0,0 +1,191 @@
+#include "sim_bus.h"
+#include "sim_kernel.h"
+#include "driver/i2c_master.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_MAX_MODELS 8
+#define SIM_FOREVER_US (3600LL * 1000000LL)  // Stand-in for an unbounded driver timeout
+
+struct i2c_master_bus_t {
+    i2c_master_bus_config_t config;
+};
+
+struct i2c_master_dev_t {
+    struct i2c_master_bus_t *bus;
+    uint16_t address;
+    uint32_t scl_speed_hz;
+    sim_i2c_model_t *model;
+};
+
+typedef struct {
+    uint16_t address;
+    uint32_t count;
+} nack_injection_t;
+
+static sim_i2c_model_t *models[SIM_MAX_MODELS];
+static size_t model_count = 0;
+static nack_injection_t nack_injections[SIM_MAX_MODELS];
+static bool sda_stuck = false;
+static bool sda_release_on_reset = false;
+static sim_bus_stats_t bus_stats;
+
+void sim_bus_attach(sim_i2c_model_t *model) {
+    if (model_count < SIM_MAX_MODELS) {
+        models[model_count++] = model;
+    }
+}
+
+void sim_bus_inject_nack(uint16_t address, uint32_t count) {
+    for (size_t i = 0; i < SIM_MAX_MODELS; i++) {
+        if (nack_injections[i].count == 0 || nack_injections[i].address == address) {
+            nack_injections[i].address = address;
+            nack_injections[i].count = count;
+            return;
+        }
+    }
+}
+
+void sim_bus_set_sda_stuck(bool stuck, bool release_on_reset) {
+    sda_stuck = stuck;
+    sda_release_on_reset = release_on_reset;
+}
+
+void sim_bus_get_stats(sim_bus_stats_t *stats) {
+    *stats = bus_stats;
+}
+
+static sim_i2c_model_t *find_model(uint16_t address) {
+    for (size_t i = 0; i < model_count; i++) {
+        if (models[i]->address == address) {
+            return models[i];
+        }
+    }
+    return NULL;
+}
+
+static bool take_injected_nack(uint16_t address) {
+    for (size_t i = 0; i < SIM_MAX_MODELS; i++) {
+        if (nack_injections[i].address == address && nack_injections[i].count > 0) {
+            nack_injections[i].count--;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Wire time of one segment: start, address byte and payload, 9 clocks per byte
+static int64_t segment_us(const struct i2c_master_dev_t *dev, size_t len) {
+    uint64_t bits = 2 + 9 * (1 + (uint64_t)len);
+    return (int64_t)((bits * 1000000ULL + dev->scl_speed_hz - 1) / dev->scl_speed_hz);
+}
+
+static int64_t timeout_us(int xfer_timeout_ms) {
+    return xfer_timeout_ms < 0 ? SIM_FOREVER_US : (int64_t)xfer_timeout_ms * 1000;
+}
+
+// Common transfer path: account wire time, apply faults, then run the model
+static esp_err_t transfer(struct i2c_master_dev_t *dev, const uint8_t *write_buffer, size_t write_size,
+                          uint8_t *read_buffer, size_t read_size, int xfer_timeout_ms) {
+    if (dev == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    bus_stats.transfers++;
+
+    if (sda_stuck) {
+        bus_stats.timeouts++;
+        bus_stats.busy_us += timeout_us(xfer_timeout_ms);
+        sim_kernel_block_us(timeout_us(xfer_timeout_ms));
+        return ESP_ERR_TIMEOUT;
+    }
+
+    if (dev->model == NULL || take_injected_nack(dev->address)) {
+        bus_stats.nacks++;
+        int64_t address_only_us = segment_us(dev, 0);
+        bus_stats.busy_us += address_only_us;
+        sim_kernel_block_us(address_only_us);
+        return ESP_FAIL;
+    }
+
+    esp_err_t ret = ESP_OK;
+    int64_t duration_us = 0;
+    if (write_buffer != NULL) {
+        duration_us += segment_us(dev, write_size);
+        ret = dev->model->write(dev->model, write_buffer, write_size);
+    }
+    if (ret == ESP_OK && read_buffer != NULL) {
+        duration_us += segment_us(dev, read_size);
+        ret = dev->model->read(dev->model, read_buffer, read_size);
+    }
+    if (ret != ESP_OK) {
+        bus_stats.nacks++;
+    } else {
+        bus_stats.bytes += write_size + read_size;
+    }
+
+    bus_stats.busy_us += duration_us;
+    sim_kernel_block_us(duration_us);
+    return ret;
+}
+
+esp_err_t i2c_new_master_bus(const i2c_master_bus_config_t *bus_config, i2c_master_bus_handle_t *ret_bus_handle) {
+    struct i2c_master_bus_t *bus = calloc(1, sizeof(*bus));
+    if (bus == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    bus->config = *bus_config;
+    *ret_bus_handle = bus;
+    return ESP_OK;
+}
+
+esp_err_t i2c_del_master_bus(i2c_master_bus_handle_t bus_handle) {
+    free(bus_handle);
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t bus_handle, const i2c_device_config_t *dev_config, i2c_master_dev_handle_t *ret_handle) {
+    struct i2c_master_dev_t *dev = calloc(1, sizeof(*dev));
+    if (dev == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    dev->bus = bus_handle;
+    dev->address = dev_config->device_address;
+    dev->scl_speed_hz = dev_config->scl_speed_hz ? dev_config->scl_speed_hz : 100000;
+    dev->model = find_model(dev->address);
+    *ret_handle = dev;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_rm_device(i2c_master_dev_handle_t handle) {
+    free(handle);
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_reset(i2c_master_bus_handle_t bus_handle) {
+    (void)bus_handle;
+    bus_stats.resets++;
+    // Nine SCL pulses plus a STOP at 100 kHz
+    sim_kernel_block_us(100);
+    if (sda_stuck && sda_release_on_reset) {
+        sda_stuck = false;
+    }
+    return sda_stuck ? ESP_ERR_INVALID_STATE : ESP_OK;
+}
+
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t i2c_dev, const uint8_t *write_buffer, size_t write_size, int xfer_timeout_ms) {
+    return transfer(i2c_dev, write_buffer, write_size, NULL, 0, xfer_timeout_ms);
+}
+
+esp_err_t i2c_master_receive(i2c_master_dev_handle_t i2c_dev, uint8_t *read_buffer, size_t read_size, int xfer_timeout_ms) {
+    return transfer(i2c_dev, NULL, 0, read_buffer, read_size, xfer_timeout_ms);
+}
+
+esp_err_t i2c_master_transmit_receive(i2c_master_dev_handle_t i2c_dev, const uint8_t *write_buffer, size_t write_size, uint8_t *read_buffer, size_t read_size, int xfer_timeout_ms) {
+    return transfer(i2c_dev, write_buffer, write_size, read_buffer, read_size, xfer_timeout_ms);
+}
+
+esp_err_t i2c_master_probe(i2c_master_bus_handle_t bus_handle, uint16_t address, int xfer_timeout_ms) {
+    (void)bus_handle;
+    (void)xfer_timeout_ms;
+    return find_model(address) != NULL ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
@@ -0,0 +1,38 @@
+#ifndef SIM_BUS_H
+#define SIM_BUS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Behavioural model of one I2C slave. Handlers return ESP_FAIL to NACK.
+typedef struct sim_i2c_model {
+    const char *name;
+    uint16_t address;
+    esp_err_t (*write)(struct sim_i2c_model *model, const uint8_t *data, size_t len);
+    esp_err_t (*read)(struct sim_i2c_model *model, uint8_t *data, size_t len);
+} sim_i2c_model_t;
+
+// Wire-level counters of the simulated bus
+typedef struct {
+    uint32_t transfers;
+    uint32_t nacks;
+    uint32_t timeouts;
+    uint32_t resets;
+    uint64_t bytes;
+    uint64_t busy_us;
+} sim_bus_stats_t;
+
+// Attach a device model; drivers reach it through i2c_master_bus_add_device()
+void sim_bus_attach(sim_i2c_model_t *model);
+
+// Make the next count transfers to address NACK
+void sim_bus_inject_nack(uint16_t address, uint32_t count);
+
+// Hold SDA low so every transfer times out; a bus reset releases it if asked to
+void sim_bus_set_sda_stuck(bool stuck, bool release_on_reset);
+
+void sim_bus_get_stats(sim_bus_stats_t *stats);
+
+#endif // SIM_BUS_H
@@ -0,0 +1,62 @@
+#ifndef SIM_DEVICES_H
+#define SIM_DEVICES_H
+
+#include <stdint.h>
+#include "sim_bus.h"
+#include "hal/adc_types.h"
+#include "esp_err.h"
+#include <stdbool.h>
+
+// SCD41: command words, CRC-framed replies, execution times and 5 s / 30 s data cadence
+sim_i2c_model_t *sim_scd41_model(void);
+void sim_scd41_set_environment(uint16_t co2_ppm, float temperature_c, float humidity_pct);
+uint32_t sim_scd41_samples_produced(void);
+
+// AS7262: STATUS/WRITE/READ slave registers in front of the virtual register file
+sim_i2c_model_t *sim_as7262_model(void);
+void sim_as7262_set_light(float level);
+void sim_as7262_wire_int(int gpio_num);
+uint32_t sim_as7262_conversions(void);
+
+// Drive a GPIO input from a model; runs the registered ISR on a matching edge
+void sim_gpio_drive(int gpio_num, int level);
+
+// Fake ADC: Gaussian-ish noise around a mean raw count per channel
+void sim_adc_set_input(adc_channel_t channel, int mean_raw, int noise_raw);
+
+// Add an outlier of spike_raw counts on every n-th conversion of a channel (0 disables)
+void sim_adc_set_spikes(adc_channel_t channel, uint32_t every, int spike_raw);
+
+// NOR flash behind the partition API: the log partition, optionally kept in an image file
+typedef struct {
+    bool image_loaded;                  // Started from an existing image
+    uint32_t reads;
+    uint64_t read_bytes;
+    uint32_t writes;
+    uint64_t write_bytes;
+    uint32_t erases;
+    uint32_t min_sector_erases;
+    uint32_t max_sector_erases;
+    uint32_t program_conflicts;         // Bytes written without an erase in between
+    uint32_t torn_writes;
+    int64_t busy_us;
+} sim_flash_stats_t;
+
+esp_err_t sim_flash_open(const char *image_path, uint32_t size);
+void sim_flash_get_stats(sim_flash_stats_t *stats);
+
+// Program only the first half of the n-th write, as if power failed mid-write
+void sim_flash_tear_write(uint32_t write_number);
+
+// NVS behind nvs_service.h, in RAM. Every set programs entries at once, as in
+// ESP-IDF, so the entries written are the wear; commits are only counted.
+typedef struct {
+    uint32_t sets;
+    uint32_t entries_written;           // 32-byte NVS entries
+    uint32_t commits;
+    int64_t busy_us;
+} sim_nvs_stats_t;
+
+void sim_nvs_get_stats(sim_nvs_stats_t *stats);
+
+#endif // SIM_DEVICES_H
@@ -0,0 +1,208 @@
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+#include "esp_rom_crc.h"
+#include "sim_kernel.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_MAX_TIMERS 16
+#define SIM_TIMER_TASK_PRIORITY 22  // Matches the esp_timer task priority on target
+
+// ---- Error names ----
+
+typedef struct {
+    esp_err_t code;
+    const char *name;
+} err_name_t;
+
+static const err_name_t err_names[] = {
+    {ESP_OK, "ESP_OK"},
+    {ESP_FAIL, "ESP_FAIL"},
+    {ESP_ERR_NO_MEM, "ESP_ERR_NO_MEM"},
+    {ESP_ERR_INVALID_ARG, "ESP_ERR_INVALID_ARG"},
+    {ESP_ERR_INVALID_STATE, "ESP_ERR_INVALID_STATE"},
+    {ESP_ERR_INVALID_SIZE, "ESP_ERR_INVALID_SIZE"},
+    {ESP_ERR_NOT_FOUND, "ESP_ERR_NOT_FOUND"},
+    {ESP_ERR_NOT_SUPPORTED, "ESP_ERR_NOT_SUPPORTED"},
+    {ESP_ERR_TIMEOUT, "ESP_ERR_TIMEOUT"},
+    {ESP_ERR_INVALID_RESPONSE, "ESP_ERR_INVALID_RESPONSE"},
+    {ESP_ERR_INVALID_CRC, "ESP_ERR_INVALID_CRC"},
+    {ESP_ERR_INVALID_VERSION, "ESP_ERR_INVALID_VERSION"},
+    {ESP_ERR_NOT_FINISHED, "ESP_ERR_NOT_FINISHED"},
+    {ESP_ERR_NVS_NOT_FOUND, "ESP_ERR_NVS_NOT_FOUND"},
+    {ESP_ERR_NVS_NO_FREE_PAGES, "ESP_ERR_NVS_NO_FREE_PAGES"},
+    {ESP_ERR_NVS_NEW_VERSION_FOUND, "ESP_ERR_NVS_NEW_VERSION_FOUND"},
+};
+
+const char *esp_err_to_name(esp_err_t code) {
+    for (size_t i = 0; i < sizeof(err_names) / sizeof(err_names[0]); i++) {
+        if (err_names[i].code == code) {
+            return err_names[i].name;
+        }
+    }
+    return "UNKNOWN ERROR";
+}
+
+// ---- Logging ----
+
+static esp_log_level_t log_level = ESP_LOG_WARN;
+static vprintf_like_t log_vprintf = vprintf;
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) {
+    (void)tag;
+    if (level > log_level) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    log_vprintf(format, args);
+    va_end(args);
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level) {
+    // Per-tag levels are not modelled; "*" and any tag set the global level
+    (void)tag;
+    log_level = level;
+}
+
+esp_log_level_t esp_log_level_get(const char *tag) {
+    (void)tag;
+    return log_level;
+}
+
+vprintf_like_t esp_log_set_vprintf(vprintf_like_t func) {
+    vprintf_like_t previous = log_vprintf;
+    log_vprintf = func;
+    return previous;
+}
+
+uint32_t esp_log_timestamp(void) {
+    return (uint32_t)(sim_kernel_now_us() / 1000);
+}
+
+// ---- esp_timer ----
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void *arg;
+    bool armed;
+    int64_t due_us;
+    uint64_t period_us;  // 0 for one-shot timers
+};
+
+static struct esp_timer timers[SIM_MAX_TIMERS];
+static TaskHandle_t timer_task = NULL;
+
+int64_t esp_timer_get_time(void) {
+    return sim_kernel_now_us();
+}
+
+void esp_rom_delay_us(uint32_t us) {
+    sim_kernel_block_us(us);
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+// Dispatch task: sleeps until the earliest armed timer and runs due callbacks
+static void esp_timer_task(void *arg) {
+    (void)arg;
+    while (true) {
+        int64_t earliest = INT64_MAX;
+        for (size_t i = 0; i < SIM_MAX_TIMERS; i++) {
+            if (timers[i].armed && timers[i].due_us < earliest) {
+                earliest = timers[i].due_us;
+            }
+        }
+        if (earliest > sim_kernel_now_us()) {
+            sim_kernel_notify_take_until(earliest);
+        }
+
+        int64_t now = sim_kernel_now_us();
+        for (size_t i = 0; i < SIM_MAX_TIMERS; i++) {
+            struct esp_timer *timer = &timers[i];
+            if (!timer->armed || timer->due_us > now) {
+                continue;
+            }
+            if (timer->period_us > 0) {
+                timer->due_us += (int64_t)timer->period_us;
+            } else {
+                timer->armed = false;
+            }
+            timer->callback(timer->arg);
+        }
+    }
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle) {
+    if (create_args == NULL || create_args->callback == NULL || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (timer_task == NULL &&
+        xTaskCreate(esp_timer_task, "esp_timer", 4096, NULL, SIM_TIMER_TASK_PRIORITY, &timer_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (size_t i = 0; i < SIM_MAX_TIMERS; i++) {
+        if (timers[i].callback == NULL) {
+            timers[i] = (struct esp_timer) {
+                .callback = create_args->callback,
+                .arg = create_args->arg,
+            };
+            *out_handle = &timers[i];
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+static esp_err_t esp_timer_arm(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us) {
+    if (timer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->due_us = sim_kernel_now_us() + (int64_t)timeout_us;
+    timer->period_us = period_us;
+    timer->armed = true;
+    xTaskNotifyGive(timer_task);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    return esp_timer_arm(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period) {
+    return esp_timer_arm(timer, period, period);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (timer == NULL || !timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->armed = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    if (timer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(timer, 0, sizeof(*timer));
+    return ESP_OK;
+}
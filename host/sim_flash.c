@@ -0,0 +1,159 @@
+#include "sim_devices.h"
+#include "sim_kernel.h"
+#include "esp_partition.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_FLASH_SECTOR_SIZE 4096
+#define SIM_FLASH_PAGE_SIZE 256
+#define SIM_FLASH_ADDRESS 0x110000       // Where partitions.csv puts the log
+#define SIM_FLASH_READ_SETUP_US 5        // Command and address at 40 MHz DIO
+#define SIM_FLASH_READ_NS_PER_BYTE 100
+#define SIM_FLASH_PAGE_PROGRAM_US 700    // Typical for 25Q-series NOR
+#define SIM_FLASH_SECTOR_ERASE_US 45000
+
+// The one data partition and its contents; every change is written through to
+// the image file, so a run can be cut short and the next one recovers from it
+static esp_partition_t sim_partition = {
+    .type = ESP_PARTITION_TYPE_DATA,
+    .subtype = (esp_partition_subtype_t)0x40,
+    .address = SIM_FLASH_ADDRESS,
+    .erase_size = SIM_FLASH_SECTOR_SIZE,
+    .label = "tslog",
+};
+static uint8_t *contents = NULL;
+static uint32_t *sector_erases = NULL;
+static FILE *image = NULL;
+static uint32_t tear_write = 0;          // 1-based page write to cut short, 0 for none
+static sim_flash_stats_t flash_stats;
+
+esp_err_t sim_flash_open(const char *image_path, uint32_t size) {
+    if (size == 0 || size % SIM_FLASH_SECTOR_SIZE != 0 || contents != NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    contents = malloc(size);
+    sector_erases = calloc(size / SIM_FLASH_SECTOR_SIZE, sizeof(uint32_t));
+    if (contents == NULL || sector_erases == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memset(contents, 0xFF, size);
+    sim_partition.size = size;
+    if (image_path == NULL) {
+        return ESP_OK;
+    }
+
+    // An image of another size starts over, like a re-flashed partition table
+    image = fopen(image_path, "r+b");
+    if (image != NULL) {
+        fseek(image, 0, SEEK_END);
+        if (ftell(image) == (long)size) {
+            fseek(image, 0, SEEK_SET);
+            flash_stats.image_loaded = fread(contents, 1, size, image) == size;
+        }
+        if (!flash_stats.image_loaded) {
+            fclose(image);
+            image = NULL;
+        }
+    }
+    if (image == NULL) {
+        image = fopen(image_path, "w+b");
+        if (image == NULL || fwrite(contents, 1, size, image) != size) {
+            return ESP_FAIL;
+        }
+    }
+    fflush(image);
+    return ESP_OK;
+}
+
+void sim_flash_tear_write(uint32_t write_number) {
+    tear_write = write_number;
+}
+
+void sim_flash_get_stats(sim_flash_stats_t *stats) {
+    *stats = flash_stats;
+    uint32_t sectors = sim_partition.size / SIM_FLASH_SECTOR_SIZE;
+    stats->min_sector_erases = sectors > 0 ? sector_erases[0] : 0;
+    stats->max_sector_erases = 0;
+    for (uint32_t i = 0; i < sectors; i++) {
+        stats->min_sector_erases = sector_erases[i] < stats->min_sector_erases ? sector_erases[i] : stats->min_sector_erases;
+        stats->max_sector_erases = sector_erases[i] > stats->max_sector_erases ? sector_erases[i] : stats->max_sector_erases;
+    }
+}
+
+// Mirror a changed range into the image file
+static void sim_flash_sync(size_t offset, size_t size) {
+    if (image != NULL) {
+        fseek(image, (long)offset, SEEK_SET);
+        fwrite(contents + offset, 1, size, image);
+        fflush(image);
+    }
+}
+
+static bool sim_flash_in_range(const esp_partition_t *partition, size_t offset, size_t size) {
+    return partition == &sim_partition && contents != NULL && offset <= partition->size && size <= partition->size - offset;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label) {
+    if (contents == NULL || type != sim_partition.type ||
+        (subtype != ESP_PARTITION_SUBTYPE_ANY && subtype != sim_partition.subtype) ||
+        (label != NULL && strcmp(label, sim_partition.label) != 0)) {
+        return NULL;
+    }
+    return &sim_partition;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size) {
+    if (!sim_flash_in_range(partition, src_offset, size) || dst == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int64_t duration_us = SIM_FLASH_READ_SETUP_US + (int64_t)size * SIM_FLASH_READ_NS_PER_BYTE / 1000;
+    sim_kernel_block_us(duration_us);
+    memcpy(dst, contents + src_offset, size);
+    flash_stats.reads++;
+    flash_stats.read_bytes += size;
+    flash_stats.busy_us += duration_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size) {
+    if (!sim_flash_in_range(partition, dst_offset, size) || src == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // NOR programming only clears bits; a 0 -> 1 flip means the range was not erased
+    const uint8_t *bytes = src;
+    size_t programmed = size;
+    flash_stats.writes++;
+    if (tear_write != 0 && flash_stats.writes == tear_write) {
+        programmed = size / 2;          // Power lost half way through
+        flash_stats.torn_writes++;
+    }
+    for (size_t i = 0; i < programmed; i++) {
+        uint8_t *cell = &contents[dst_offset + i];
+        flash_stats.program_conflicts += (bytes[i] & ~*cell) != 0;
+        *cell &= bytes[i];
+    }
+    int64_t pages = (int64_t)((dst_offset + size + SIM_FLASH_PAGE_SIZE - 1) / SIM_FLASH_PAGE_SIZE - dst_offset / SIM_FLASH_PAGE_SIZE);
+    int64_t duration_us = pages * SIM_FLASH_PAGE_PROGRAM_US;
+    sim_kernel_block_us(duration_us);
+    sim_flash_sync(dst_offset, size);
+    flash_stats.write_bytes += size;
+    flash_stats.busy_us += duration_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size) {
+    if (!sim_flash_in_range(partition, offset, size) || offset % SIM_FLASH_SECTOR_SIZE != 0 || size % SIM_FLASH_SECTOR_SIZE != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(contents + offset, 0xFF, size);
+    for (size_t sector = offset / SIM_FLASH_SECTOR_SIZE; sector < (offset + size) / SIM_FLASH_SECTOR_SIZE; sector++) {
+        sector_erases[sector]++;
+        flash_stats.erases++;
+    }
+    int64_t duration_us = (int64_t)(size / SIM_FLASH_SECTOR_SIZE) * SIM_FLASH_SECTOR_ERASE_US;
+    sim_kernel_block_us(duration_us);
+    sim_flash_sync(offset, size);
+    flash_stats.busy_us += duration_us;
+    return ESP_OK;
+}
@@ -0,0 +1,521 @@
+#include "sim_kernel.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TICK_US ((int64_t)portTICK_PERIOD_MS * 1000)
+#define NO_DEADLINE INT64_MAX
+
+typedef enum {
+    TASK_READY,
+    TASK_BLOCKED,
+    TASK_DELETED,
+} task_state_t;
+
+typedef enum {
+    WAIT_NONE,
+    WAIT_DELAY,
+    WAIT_RECV,
+    WAIT_SEND,
+    WAIT_NOTIFY,
+} wait_kind_t;
+
+struct host_task {
+    char name[16];
+    TaskFunction_t fn;
+    void *arg;
+    UBaseType_t priority;
+    pthread_t thread;
+    pthread_cond_t cond;
+    task_state_t state;
+    wait_kind_t wait_kind;
+    struct host_queue *wait_queue;
+    int64_t wake_us;
+    bool timed_out;
+    uint32_t notify_value;
+    uint64_t ready_seq;
+    struct host_task *next;
+};
+
+// Queues, semaphores and mutexes share one control block; item_size 0 is a semaphore
+struct host_queue {
+    uint8_t *storage;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;
+    bool is_static;
+};
+
+_Static_assert(sizeof(struct host_queue) <= sizeof(StaticSemaphore_t), "StaticSemaphore_t too small");
+
+static pthread_mutex_t kernel_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stop_cond = PTHREAD_COND_INITIALIZER;
+static struct host_task *task_list = NULL;
+static struct host_task *current_task = NULL;
+static int64_t now_us = 0;
+static uint64_t ready_counter = 0;
+static bool stopping = false;
+static int stop_code = 0;
+static __thread struct host_task *self_task = NULL;
+
+static void make_ready_locked(struct host_task *task, bool timed_out) {
+    task->state = TASK_READY;
+    task->wait_kind = WAIT_NONE;
+    task->wait_queue = NULL;
+    task->wake_us = NO_DEADLINE;
+    task->timed_out = timed_out;
+    task->ready_seq = ++ready_counter;
+}
+
+// Pick the highest-priority ready task, advancing virtual time if nobody is ready
+static struct host_task *pick_next_locked(void) {
+    while (true) {
+        struct host_task *best = NULL;
+        for (struct host_task *t = task_list; t != NULL; t = t->next) {
+            if (t->state != TASK_READY) {
+                continue;
+            }
+            if (best == NULL || t->priority > best->priority ||
+                (t->priority == best->priority && t->ready_seq < best->ready_seq)) {
+                best = t;
+            }
+        }
+        if (best != NULL) {
+            return best;
+        }
+
+        int64_t earliest = NO_DEADLINE;
+        for (struct host_task *t = task_list; t != NULL; t = t->next) {
+            if (t->state == TASK_BLOCKED && t->wake_us < earliest) {
+                earliest = t->wake_us;
+            }
+        }
+        if (earliest == NO_DEADLINE) {
+            return NULL;
+        }
+
+        now_us = earliest;
+        for (struct host_task *t = task_list; t != NULL; t = t->next) {
+            if (t->state == TASK_BLOCKED && t->wake_us <= now_us) {
+                make_ready_locked(t, true);
+            }
+        }
+    }
+}
+
+// Hand the CPU to the next task and wait until the caller is scheduled again
+static void reschedule_locked(struct host_task *self) {
+    struct host_task *next = pick_next_locked();
+    if (next == NULL) {
+        fprintf(stderr, "sim: every task is blocked with no timeout (deadlock)\n");
+        stopping = true;
+        stop_code = 2;
+        pthread_cond_signal(&stop_cond);
+        while (true) {
+            pthread_cond_wait(&self->cond, &kernel_lock);
+        }
+    }
+
+    current_task = next;
+    if (next == self) {
+        return;
+    }
+    pthread_cond_signal(&next->cond);
+    if (self->state == TASK_DELETED) {
+        return;
+    }
+    while (current_task != self) {
+        pthread_cond_wait(&self->cond, &kernel_lock);
+    }
+}
+
+// Give way if an event just readied a task of higher priority than the caller
+static void maybe_preempt_locked(struct host_task *self) {
+    if (self == NULL) {
+        return;
+    }
+    for (struct host_task *t = task_list; t != NULL; t = t->next) {
+        if (t->state == TASK_READY && t != self && t->priority > self->priority) {
+            self->ready_seq = ++ready_counter;
+            reschedule_locked(self);
+            return;
+        }
+    }
+}
+
+// Block the caller until woken or until deadline; returns false on timeout
+static bool block_locked(struct host_task *self, wait_kind_t kind, struct host_queue *queue, int64_t deadline) {
+    if (self == NULL) {
+        fprintf(stderr, "sim: blocking call made outside a task\n");
+        abort();
+    }
+    self->state = TASK_BLOCKED;
+    self->wait_kind = kind;
+    self->wait_queue = queue;
+    self->wake_us = deadline;
+    self->timed_out = false;
+    reschedule_locked(self);
+    return !self->timed_out;
+}
+
+static int64_t deadline_from_ticks(TickType_t ticks) {
+    return ticks == portMAX_DELAY ? NO_DEADLINE : now_us + (int64_t)ticks * TICK_US;
+}
+
+// Wake the highest-priority task waiting on queue for the given reason
+static void wake_waiter_locked(struct host_queue *queue, wait_kind_t kind) {
+    struct host_task *best = NULL;
+    for (struct host_task *t = task_list; t != NULL; t = t->next) {
+        if (t->state == TASK_BLOCKED && t->wait_queue == queue && t->wait_kind == kind) {
+            if (best == NULL || t->priority > best->priority) {
+                best = t;
+            }
+        }
+    }
+    if (best != NULL) {
+        make_ready_locked(best, false);
+    }
+}
+
+static void *task_entry(void *param) {
+    struct host_task *task = (struct host_task *)param;
+    self_task = task;
+
+    pthread_mutex_lock(&kernel_lock);
+    while (current_task != task) {
+        pthread_cond_wait(&task->cond, &kernel_lock);
+    }
+    pthread_mutex_unlock(&kernel_lock);
+
+    task->fn(task->arg);
+
+    // Returning from a task function is not allowed on target; treat it as a delete
+    vTaskDelete(NULL);
+    return NULL;
+}
+
+// ---- Simulator control ----
+
+int sim_kernel_run(TaskFunction_t app, void *arg, UBaseType_t priority) {
+    if (xTaskCreate(app, "app", 4096, arg, priority, NULL) != pdPASS) {
+        return 1;
+    }
+
+    pthread_mutex_lock(&kernel_lock);
+    current_task = pick_next_locked();
+    pthread_cond_signal(&current_task->cond);
+    while (!stopping) {
+        pthread_cond_wait(&stop_cond, &kernel_lock);
+    }
+    int code = stop_code;
+    pthread_mutex_unlock(&kernel_lock);
+    return code;
+}
+
+void sim_kernel_stop(int exit_code) {
+    pthread_mutex_lock(&kernel_lock);
+    stopping = true;
+    stop_code = exit_code;
+    pthread_cond_signal(&stop_cond);
+    // Keep the CPU so no other task runs while the host tears down
+    while (true) {
+        pthread_cond_wait(&self_task->cond, &kernel_lock);
+    }
+}
+
+int64_t sim_kernel_now_us(void) {
+    pthread_mutex_lock(&kernel_lock);
+    int64_t now = now_us;
+    pthread_mutex_unlock(&kernel_lock);
+    return now;
+}
+
+void sim_kernel_block_us(int64_t duration_us) {
+    pthread_mutex_lock(&kernel_lock);
+    block_locked(self_task, WAIT_DELAY, NULL, now_us + (duration_us > 0 ? duration_us : 0));
+    pthread_mutex_unlock(&kernel_lock);
+}
+
+uint32_t sim_kernel_notify_take_until(int64_t deadline_us) {
+    pthread_mutex_lock(&kernel_lock);
+    struct host_task *self = self_task;
+    if (self->notify_value == 0) {
+        block_locked(self, WAIT_NOTIFY, NULL, deadline_us);
+    }
+    uint32_t value = self->notify_value;
+    self->notify_value = 0;
+    pthread_mutex_unlock(&kernel_lock);
+    return value;
+}
+
+// ---- Tasks ----
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg, UBaseType_t priority, TaskHandle_t *handle) {
+    (void)stack_depth;
+    struct host_task *task = calloc(1, sizeof(*task));
+    if (task == NULL) {
+        return pdFAIL;
+    }
+    snprintf(task->name, sizeof(task->name), "%s", name);
+    task->fn = fn;
+    task->arg = arg;
+    task->priority = priority;
+    pthread_cond_init(&task->cond, NULL);
+
+    pthread_mutex_lock(&kernel_lock);
+    make_ready_locked(task, false);
+    task->next = task_list;
+    task_list = task;
+    if (handle != NULL) {
+        *handle = task;
+    }
+    if (pthread_create(&task->thread, NULL, task_entry, task) != 0) {
+        pthread_mutex_unlock(&kernel_lock);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    maybe_preempt_locked(self_task);
+    pthread_mutex_unlock(&kernel_lock);
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg, UBaseType_t priority, TaskHandle_t *handle, BaseType_t core_id) {
+    (void)core_id;
+    return xTaskCreate(fn, name, stack_depth, arg, priority, handle);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    pthread_mutex_lock(&kernel_lock);
+    struct host_task *target = task != NULL ? task : self_task;
+    target->state = TASK_DELETED;
+    if (target == self_task) {
+        reschedule_locked(target);
+        pthread_mutex_unlock(&kernel_lock);
+        pthread_exit(NULL);
+    }
+    pthread_mutex_unlock(&kernel_lock);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    if (ticks == 0) {
+        taskYIELD();
+        return;
+    }
+    pthread_mutex_lock(&kernel_lock);
+    int64_t tick_start = (now_us / TICK_US) * TICK_US;
+    block_locked(self_task, WAIT_DELAY, NULL, tick_start + (int64_t)ticks * TICK_US);
+    pthread_mutex_unlock(&kernel_lock);
+}
+
+BaseType_t xTaskDelayUntil(TickType_t *previous_wake, TickType_t increment) {
+    pthread_mutex_lock(&kernel_lock);
+    TickType_t target = *previous_wake + increment;
+    TickType_t now_ticks = (TickType_t)(now_us / TICK_US);
+    *previous_wake = target;
+    BaseType_t delayed = pdFALSE;
+    if ((int32_t)(target - now_ticks) > 0) {
+        block_locked(self_task, WAIT_DELAY, NULL, (int64_t)target * TICK_US);
+        delayed = pdTRUE;
+    }
+    pthread_mutex_unlock(&kernel_lock);
+    return delayed;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(sim_kernel_now_us() / TICK_US);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return self_task;
+}
+
+void taskYIELD(void) {
+    pthread_mutex_lock(&kernel_lock);
+    if (self_task != NULL) {
+        self_task->ready_seq = ++ready_counter;
+        reschedule_locked(self_task);
+    }
+    pthread_mutex_unlock(&kernel_lock);
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    pthread_mutex_lock(&kernel_lock);
+    task->notify_value++;
+    if (task->state == TASK_BLOCKED && task->wait_kind == WAIT_NOTIFY) {
+        make_ready_locked(task, false);
+        maybe_preempt_locked(self_task);
+    }
+    pthread_mutex_unlock(&kernel_lock);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_woken) {
+    pthread_mutex_lock(&kernel_lock);
+    task->notify_value++;
+    if (task->state == TASK_BLOCKED && task->wait_kind == WAIT_NOTIFY) {
+        make_ready_locked(task, false);
+        if (higher_priority_woken != NULL && self_task != NULL && task->priority > self_task->priority) {
+            *higher_priority_woken = pdTRUE;
+        }
+    }
+    pthread_mutex_unlock(&kernel_lock);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+    pthread_mutex_lock(&kernel_lock);
+    struct host_task *self = self_task;
+    if (self->notify_value == 0 && ticks != 0) {
+        block_locked(self, WAIT_NOTIFY, NULL, deadline_from_ticks(ticks));
+    }
+    uint32_t value = self->notify_value;
+    if (value > 0) {
+        self->notify_value = clear_on_exit ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&kernel_lock);
+    return value;
+}
+
+// ---- Queues and semaphores ----
+
+static void queue_init(struct host_queue *queue, UBaseType_t length, UBaseType_t item_size, uint8_t *storage, bool is_static) {
+    memset(queue, 0, sizeof(*queue));
+    queue->length = length;
+    queue->item_size = item_size;
+    queue->storage = storage;
+    queue->is_static = is_static;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    struct host_queue *queue = malloc(sizeof(*queue));
+    uint8_t *storage = item_size > 0 ? malloc((size_t)length * item_size) : NULL;
+    if (queue == NULL || (item_size > 0 && storage == NULL)) {
+        free(queue);
+        free(storage);
+        return NULL;
+    }
+    queue_init(queue, length, item_size, storage, false);
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    if (queue != NULL && !queue->is_static) {
+        free(queue->storage);
+        free(queue);
+    }
+}
+
+static BaseType_t queue_send_locked(struct host_queue *queue, const void *item, int64_t deadline, bool may_block) {
+    while (queue->count >= queue->length) {
+        if (!may_block || !block_locked(self_task, WAIT_SEND, queue, deadline)) {
+            return pdFALSE;
+        }
+    }
+    if (queue->item_size > 0) {
+        UBaseType_t tail = (queue->head + queue->count) % queue->length;
+        memcpy(queue->storage + (size_t)tail * queue->item_size, item, queue->item_size);
+    }
+    queue->count++;
+    wake_waiter_locked(queue, WAIT_RECV);
+    return pdTRUE;
+}
+
+static BaseType_t queue_receive_locked(struct host_queue *queue, void *item, int64_t deadline, bool may_block, bool peek) {
+    while (queue->count == 0) {
+        if (!may_block || !block_locked(self_task, WAIT_RECV, queue, deadline)) {
+            return pdFALSE;
+        }
+    }
+    if (queue->item_size > 0) {
+        memcpy(item, queue->storage + (size_t)queue->head * queue->item_size, queue->item_size);
+    }
+    if (!peek) {
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        wake_waiter_locked(queue, WAIT_SEND);
+    }
+    return pdTRUE;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks) {
+    pthread_mutex_lock(&kernel_lock);
+    BaseType_t ret = queue_send_locked(queue, item, deadline_from_ticks(ticks), ticks != 0);
+    if (ret == pdTRUE) {
+        maybe_preempt_locked(self_task);
+    }
+    pthread_mutex_unlock(&kernel_lock);
+    return ret;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *higher_priority_woken) {
+    pthread_mutex_lock(&kernel_lock);
+    BaseType_t ret = queue_send_locked(queue, item, now_us, false);
+    if (higher_priority_woken != NULL) {
+        *higher_priority_woken = pdFALSE;
+    }
+    pthread_mutex_unlock(&kernel_lock);
+    return ret;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks) {
+    pthread_mutex_lock(&kernel_lock);
+    BaseType_t ret = queue_receive_locked(queue, item, deadline_from_ticks(ticks), ticks != 0, false);
+    if (ret == pdTRUE) {
+        maybe_preempt_locked(self_task);
+    }
+    pthread_mutex_unlock(&kernel_lock);
+    return ret;
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t ticks) {
+    pthread_mutex_lock(&kernel_lock);
+    BaseType_t ret = queue_receive_locked(queue, item, deadline_from_ticks(ticks), ticks != 0, true);
+    pthread_mutex_unlock(&kernel_lock);
+    return ret;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    pthread_mutex_lock(&kernel_lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&kernel_lock);
+    return count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer) {
+    struct host_queue *queue = (struct host_queue *)buffer;
+    queue_init(queue, 1, 0, NULL, true);
+    return queue;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    SemaphoreHandle_t mutex = xQueueCreate(1, 0);
+    if (mutex != NULL) {
+        mutex->count = 1;
+    }
+    return mutex;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    return xQueueSend(sem, NULL, 0);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t *higher_priority_woken) {
+    return xQueueSendFromISR(sem, NULL, higher_priority_woken);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+    return xQueueReceive(sem, NULL, ticks);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) {
+    vQueueDelete(sem);
+}
@@ -0,0 +1,95 @@
+#include "sim_devices.h"
+#include "driver/gpio.h"
+#include <stdbool.h>
+
+#define SIM_GPIO_COUNT 40
+
+typedef struct {
+    gpio_int_type_t intr_type;
+    gpio_isr_t handler;
+    void *arg;
+    int level;
+} sim_pin_t;
+
+static sim_pin_t pins[SIM_GPIO_COUNT];
+static bool isr_service_installed = false;
+
+static bool edge_matches(gpio_int_type_t type, int from, int to) {
+    switch (type) {
+    case GPIO_INTR_POSEDGE:
+        return from == 0 && to == 1;
+    case GPIO_INTR_NEGEDGE:
+        return from == 1 && to == 0;
+    case GPIO_INTR_ANYEDGE:
+        return from != to;
+    case GPIO_INTR_LOW_LEVEL:
+        return to == 0;
+    case GPIO_INTR_HIGH_LEVEL:
+        return to == 1;
+    default:
+        return false;
+    }
+}
+
+// Models drive their output pins through this; matching edges run the ISR inline
+void sim_gpio_drive(int gpio_num, int level) {
+    if (gpio_num < 0 || gpio_num >= SIM_GPIO_COUNT) {
+        return;
+    }
+    sim_pin_t *pin = &pins[gpio_num];
+    int previous = pin->level;
+    pin->level = level;
+    if (pin->handler != NULL && edge_matches(pin->intr_type, previous, level)) {
+        pin->handler(pin->arg);
+    }
+}
+
+esp_err_t gpio_config(const gpio_config_t *config) {
+    for (int i = 0; i < SIM_GPIO_COUNT; i++) {
+        if (config->pin_bit_mask & (1ULL << i)) {
+            pins[i].intr_type = config->intr_type;
+            if (config->pull_up_en == GPIO_PULLUP_ENABLE) {
+                pins[i].level = 1;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags) {
+    (void)intr_alloc_flags;
+    if (isr_service_installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    isr_service_installed = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args) {
+    if (!isr_service_installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (gpio_num < 0 || gpio_num >= SIM_GPIO_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pins[gpio_num].handler = isr_handler;
+    pins[gpio_num].arg = args;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num) {
+    if (gpio_num < 0 || gpio_num >= SIM_GPIO_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pins[gpio_num].handler = NULL;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
+    sim_gpio_drive(gpio_num, level ? 1 : 0);
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num) {
+    return (gpio_num >= 0 && gpio_num < SIM_GPIO_COUNT) ? pins[gpio_num].level : 0;
+}
@@ -0,0 +1,27 @@
+#ifndef SIM_KERNEL_H
+#define SIM_KERNEL_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// The simulated kernel runs exactly one task at a time on a virtual clock.
+// Time only advances while every task is blocked, so a run is deterministic
+// and as fast as the host CPU allows.
+
+// Start app as the first task and return once sim_kernel_stop() is called
+int sim_kernel_run(TaskFunction_t app, void *arg, UBaseType_t priority);
+
+// End the simulation; the calling task never returns from this
+void sim_kernel_stop(int exit_code);
+
+// Current virtual time in microseconds
+int64_t sim_kernel_now_us(void);
+
+// Block the calling task for a span of virtual time, e.g. a bus transfer
+void sim_kernel_block_us(int64_t duration_us);
+
+// Block until notified or until deadline_us; returns the notification count taken
+uint32_t sim_kernel_notify_take_until(int64_t deadline_us);
+
+#endif // SIM_KERNEL_H
@@ -0,0 +1,1199 @@
+#include "sim_kernel.h"
+#include "sim_bus.h"
+#include "sim_devices.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "i2c_service.h"
+#include "scd41_driver.h"
+#include "as7262_driver.h"
+#include "as7262_stream.h"
+#include "tds_sensor.h"
+#include "tds_calibration.h"
+#include "sensor_scheduler.h"
+#include "sensor_jobs.h"
+#include "sample_bus.h"
+#include "window_stats.h"
+#include "sample_log.h"
+#include "telemetry.h"
+#include "console_out.h"
+#include "dlog.h"
+#include "config_store.h"
+#include "nvs_service.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define AS7262_INT_GPIO 4
+#define TDS_CHECK_MS 100                // Samples the TDS filter output between the firmware's reads
+#define AUDIT_MS 1000                 // Reads every source, checks nothing is lost
+#define LAGGARD_MS 10000              // Reads the AS7262 too slowly on purpose
+
+// Spacing of the AS7262 frames the audit saw on the bus
+typedef struct {
+    int64_t min_interval_us;
+    int64_t max_interval_us;
+} stream_check_t;
+
+// Light levels of the --light-sweep profile, dark to far brighter than full HPS
+static const float light_levels[] = {1.0f, 0.02f, 30.0f, 400.0f, 0.0005f, 5.0f};
+#define LIGHT_LEVEL_COUNT (sizeof(light_levels) / sizeof(light_levels[0]))
+#define LIGHT_STEP_MS 10000
+
+// Frames seen at one light level once the range has settled
+typedef struct {
+    uint32_t frames;
+    uint32_t saturated;
+    double green_sum;
+    as7262_range_t last_range;
+} light_step_t;
+
+static struct {
+    int seconds;
+    bool faults;
+    int integration_time;
+    bool as7262_int;
+    bool auto_range;
+    bool light_sweep;
+    bool low_power;
+    bool scd41_commands;
+    tds_filter_t tds_filter;
+    bool tds_spikes;
+    int tds_reference_ppm;
+    const char *flash_image;
+    int flash_kb;
+    int flash_tear;
+    int log_backfill_days;
+    const char *telemetry_path;
+    int console_baud;
+    console_out_policy_t console_policy;
+    const char *console_capture;
+    bool log_deferred;
+    int watch_ms;
+    bool watch_direct;
+    int config_tuning_ms;
+    bool config_direct;
+    bool nvs_legacy;
+} options = {
+    .seconds = 60,
+    .faults = false,
+    .integration_time = AS7262_STREAM_DEFAULT_INT_T,
+    .as7262_int = true,
+    .auto_range = false,
+    .light_sweep = false,
+    .low_power = false,
+    .scd41_commands = false,
+    .tds_filter = TDS_FILTER_TRIMMED_MEAN,
+    .tds_spikes = false,
+    .tds_reference_ppm = 0,
+    .flash_image = NULL,
+    .flash_kb = 960,                    // The tslog partition in partitions.csv
+    .flash_tear = 0,
+    .log_backfill_days = 0,
+    .telemetry_path = NULL,
+    .console_baud = 115200,
+    .console_policy = CONSOLE_OUT_DROP,
+    .console_capture = NULL,
+    .log_deferred = false,
+    .watch_ms = 0,
+    .watch_direct = false,
+    .config_tuning_ms = 0,
+    .config_direct = false,
+    .nvs_legacy = false,
+};
+
+static i2c_master_dev_handle_t scd41_dev;
+static i2c_master_dev_handle_t as7262_dev;
+
+// Spread of the filtered TDS values, and the last reading published
+static struct {
+    uint32_t count;
+    double sum;
+    double sum_squares;
+    uint32_t last_sequence;
+    uint16_t raw_min;
+    uint16_t raw_max;
+    int last_ppm;
+} tds_check = {
+    .raw_min = UINT16_MAX,
+};
+static stream_check_t stream_check = {
+    .min_interval_us = INT64_MAX,
+};
+static light_step_t light_steps[LIGHT_LEVEL_COUNT];
+static volatile size_t light_index = 0;
+static volatile int64_t light_changed_us = 0;
+static struct timespec wall_start;
+
+static double wall_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - wall_start.tv_sec) + (double)(now.tv_nsec - wall_start.tv_nsec) / 1e9;
+}
+
+// Invariants the run is held to; grow_sim exits with 1 if any of them fails
+static uint32_t check_failures;
+
+static void sim_check(bool ok, const char *format, ...) __attribute__((format(printf, 2, 3)));
+static void sim_check(bool ok, const char *format, ...) {
+    if (ok) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    printf("check failed: ");
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+    check_failures++;
+}
+
+// Steps the lamp through dark, dim, bright and overexposed levels
+static void light_sweep_task(void *arg) {
+    for (size_t i = 0; ; i = (i + 1) % LIGHT_LEVEL_COUNT) {
+        sim_as7262_set_light(light_levels[i]);
+        light_index = i;
+        light_changed_us = esp_timer_get_time();
+        vTaskDelay(pdMS_TO_TICKS(LIGHT_STEP_MS));
+    }
+}
+
+// Follows the TDS filter output between the firmware's reads, to check it against the input
+static void tds_check_job(void *arg) {
+    tds_adc_value_t value;
+    if (tds_adc_get_latest(&value) == ESP_OK && value.sequence != tds_check.last_sequence) {
+        double counts = (double)value.value / (1 << TDS_ADC_VALUE_SHIFT);
+        tds_check.count++;
+        tds_check.sum += counts;
+        tds_check.sum_squares += counts * counts;
+        tds_check.last_sequence = value.sequence;
+        tds_check.raw_min = value.min < tds_check.raw_min ? value.min : tds_check.raw_min;
+        tds_check.raw_max = value.max > tds_check.raw_max ? value.max : tds_check.raw_max;
+    }
+}
+
+// Sample bus consumers: the audit sees every source in order, the laggard falls behind
+static sample_consumer_t *audit_cursors[SAMPLE_SOURCE_COUNT];
+static sample_consumer_t *laggard_cursor;
+static struct {
+    uint32_t records;
+    uint32_t sequence_errors;
+    uint32_t time_errors;
+    uint32_t next_sequence[SAMPLE_SOURCE_COUNT];
+    int64_t last_us[SAMPLE_SOURCE_COUNT];
+    running_stats_t co2;                   // Whole run, to check the windowed statistics against
+    running_stats_t tds;
+} bus_check;
+
+// Binary telemetry written by the audit job, against the console text it replaces
+static struct {
+    FILE *file;
+    uint64_t text_bytes;
+    uint32_t log_lines;
+} telemetry_check;
+
+static void telemetry_file_write(const uint8_t *data, size_t length, void *ctx) {
+    fwrite(data, 1, length, ctx);
+}
+
+// Length of the console line a record would print as text. The firmware only
+// summarises the AS7262, so its frames are costed as a line of the raw counts.
+static size_t telemetry_text_length(const sample_record_t *record) {
+    char stamp[24];
+    snprintf(stamp, sizeof(stamp), "%" PRId64 ".%06" PRId64, record->timestamp_us / 1000000, record->timestamp_us % 1000000);
+    switch (record->source) {
+    case SAMPLE_SOURCE_SCD41:
+        return (size_t)snprintf(NULL, 0, "[%s] SCD41 - CO2: %u ppm, Temperature: %.2f °C, Humidity: %.2f %%\n", stamp,
+                                record->scd41.co2_ppm, record->scd41.temperature_mc / 1000.0, record->scd41.humidity_mpct / 1000.0);
+    case SAMPLE_SOURCE_AS7262: {
+        const uint16_t *raw = record->as7262.raw;
+        return (size_t)snprintf(NULL, 0, "[%s] AS7262 - gain %u, int %u, V=%u, B=%u, G=%u, Y=%u, O=%u, R=%u%s\n", stamp,
+                                record->as7262.range.gain, record->as7262.range.integration_time, raw[0], raw[1], raw[2], raw[3],
+                                raw[4], raw[5], record->as7262.saturated ? " (saturated)" : "");
+    }
+    default:
+        return (size_t)snprintf(NULL, 0, "[%s] TDS Value: %" PRId32 " ppm\n", stamp, record->tds.ppm);
+    }
+}
+
+// The firmware's stats and console jobs feed the statistics, the log and the
+// telemetry; the audit only checks what went onto the bus
+static void audit_job(void *arg) {
+    for (int source = 0; source < SAMPLE_SOURCE_COUNT; source++) {
+        const sample_record_t *records;
+        size_t count;
+        while ((count = sample_bus_peek(audit_cursors[source], &records)) > 0) {
+            for (size_t i = 0; i < count; i++) {
+                bus_check.sequence_errors += records[i].sequence != bus_check.next_sequence[source];
+                bus_check.time_errors += records[i].timestamp_us < bus_check.last_us[source];
+                if (source == SAMPLE_SOURCE_AS7262 && records[i].sequence > 0) {
+                    int64_t interval = records[i].timestamp_us - bus_check.last_us[source];
+                    stream_check.min_interval_us = interval < stream_check.min_interval_us ? interval : stream_check.min_interval_us;
+                    stream_check.max_interval_us = interval > stream_check.max_interval_us ? interval : stream_check.max_interval_us;
+                }
+                bus_check.next_sequence[source] = records[i].sequence + 1;
+                bus_check.last_us[source] = records[i].timestamp_us;
+                if (source == SAMPLE_SOURCE_SCD41) {
+                    running_stats_add(&bus_check.co2, records[i].scd41.co2_ppm);
+                } else if (source == SAMPLE_SOURCE_TDS) {
+                    running_stats_add(&bus_check.tds, records[i].tds.ppm);
+                    tds_check.last_ppm = records[i].tds.ppm;
+                } else if (options.light_sweep && records[i].timestamp_us - light_changed_us > 1000000) {
+                    // Skip the first second after a light change while the range settles
+                    light_step_t *step = &light_steps[light_index];
+                    step->frames++;
+                    step->saturated += records[i].as7262.saturated;
+                    uint32_t normalized[AS7262_CHANNEL_COUNT];
+                    as7262_normalize(records[i].as7262.raw, records[i].as7262.range, normalized);
+                    step->green_sum += (double)normalized[2] / (1 << AS7262_NORMALIZED_SHIFT);
+                    step->last_range = records[i].as7262.range;
+                }
+                telemetry_check.text_bytes += telemetry_enabled() ? telemetry_text_length(&records[i]) : 0;
+            }
+            bus_check.records += count;
+            sample_bus_release(audit_cursors[source], count);
+        }
+    }
+    // Log output shares the UART with the frames; the decoder has to step over it
+    if (telemetry_check.file != NULL && ++telemetry_check.log_lines % 10 == 0) {
+        fprintf(telemetry_check.file, "I (%" PRId64 ") Main: %" PRIu32 " records audited\n", esp_timer_get_time() / 1000, bus_check.records);
+    }
+}
+
+// The console UART: 10 bits a byte at 8N1, and the writer waits for all of them
+static struct {
+    uint64_t bytes;
+    FILE *capture;                         // What went onto the UART, for telemetry_decode
+    uint32_t log_lines;                    // Formatted by esp_log, deferred sites in text mode included
+    uint64_t log_bytes;
+} console_check;
+
+static void sim_uart_write(const uint8_t *data, size_t length, void *ctx) {
+    sim_kernel_block_us((int64_t)length * 10 * 1000000 / options.console_baud);
+    console_check.bytes += length;
+    if (console_check.capture != NULL) {
+        fwrite(data, 1, length, console_check.capture);
+    }
+}
+
+// With --console-capture, log lines go onto the UART as on the firmware, counted on the way
+static int sim_log_vprintf(const char *format, va_list args) {
+    va_list copy;
+    va_copy(copy, args);
+    int length = vsnprintf(NULL, 0, format, copy);
+    va_end(copy);
+    console_check.log_lines++;
+    console_check.log_bytes += length > 0 ? (uint64_t)length : 0;
+    return console_out_vprintf(format, args);
+}
+
+static void laggard_job(void *arg) {
+    const sample_record_t *records;
+    size_t count;
+    while ((count = sample_bus_peek(laggard_cursor, &records)) > 0) {
+        sample_bus_release(laggard_cursor, count);
+    }
+}
+
+// An operator running `watch all <ms>`: every source's latest value from the
+// cache, or with --watch-direct an AS7262 frame read on demand as the read
+// commands used to do
+static struct {
+    uint32_t reads;
+    uint32_t invalid[SAMPLE_SOURCE_COUNT];
+    int64_t max_age_us[SAMPLE_SOURCE_COUNT];
+    uint32_t errors;
+    uint64_t transactions;
+    uint64_t bus_us;
+} watch_check;
+
+static void watch_task(void *arg) {
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(options.watch_ms));
+        watch_check.reads++;
+        if (options.watch_direct) {
+            as7262_frame_t frame;
+            if (as7262_read_frame(as7262_dev, AS7262_FRAME_RAW, &frame) == ESP_OK) {
+                watch_check.transactions += frame.transactions;
+                watch_check.bus_us += frame.bus_us;
+            } else {
+                watch_check.errors++;
+            }
+            continue;
+        }
+        for (int source = 0; source < SAMPLE_SOURCE_COUNT; source++) {
+            sample_latest_t latest;
+            if (sample_bus_get_latest((sample_source_t)source, &latest) != ESP_OK || !latest.valid) {
+                watch_check.invalid[source]++;
+                continue;
+            }
+            if (latest.age_us > watch_check.max_age_us[source]) {
+                watch_check.max_age_us[source] = latest.age_us;
+            }
+        }
+    }
+}
+
+// An operator tuning from the console: a calibration factor or a job period
+// changed every --config-tuning ms. With --config-direct every change is
+// written and committed at once, as the save helpers used to do.
+static struct {
+    uint32_t sets;
+    uint32_t failures;
+    uint32_t reads;
+    sim_nvs_stats_t boot;               // NVS activity before the run started
+} config_check;
+
+static void config_tuning_task(void *arg) {
+    for (uint32_t step = 0;; step++) {
+        vTaskDelay(pdMS_TO_TICKS(options.config_tuning_ms));
+        esp_err_t ret;
+        if (step % 2 == 0) {
+            as7262_calibration_t calibration;
+            config_get(CONFIG_AS7262_CAL, &calibration, sizeof(calibration));
+            calibration.correction_factors[step / 2 % AS7262_CHANNEL_COUNT] = 1.0f + (float)(step % 10) / 100.0f;
+            ret = config_set(CONFIG_AS7262_CAL, &calibration, sizeof(calibration));
+        } else {
+            ret = config_set_i32(CONFIG_SCHED_CONSOLE, CONSOLE_JOB_PERIOD_MS + (int32_t)(step % 5) * 100);
+        }
+        if (ret == ESP_OK && options.config_direct) {
+            ret = config_store_flush();
+        }
+        config_check.sets++;
+        config_check.failures += ret != ESP_OK;
+    }
+}
+
+// Settings as firmware before the config store left them, for --nvs-legacy,
+// and a store record cut short, which must fall back to the default
+static void nvs_preload_legacy(void) {
+    const uint8_t torn[] = {TDS_CAL_VERSION, 0, sizeof(tds_calibration_t), 0, 0x12, 0x34};
+    ESP_ERROR_CHECK(nvs_service_set_blob(CONFIG_STORE_KEY_PREFIX "tds_cal", torn, sizeof(torn)));
+    as7262_calibration_t calibration = {{1.10f, 0.95f, 1.00f, 1.05f, 0.90f, 1.20f}};
+    ESP_ERROR_CHECK(nvs_service_set_blob("calibration", &calibration, sizeof(calibration)));
+    ESP_ERROR_CHECK(nvs_service_set_i32("period_console", 2000));
+    ESP_ERROR_CHECK(nvs_service_set_i32("period_tds", 5));           // Out of range, so ignored
+    ESP_ERROR_CHECK(nvs_service_set_i32("log_mode", DLOG_MODE_TEXT));
+    ESP_ERROR_CHECK(nvs_service_commit());
+}
+
+// Captures one reference solution a few seconds in, like `tds_cal add <ppm>`
+static void tds_calibration_task(void *arg) {
+    vTaskDelay(pdMS_TO_TICKS(3000));
+    tds_calibration_t calibration;
+    tds_adc_value_t reading;
+    tds_calibration_get(&calibration);
+    ESP_ERROR_CHECK(read_tds_raw(&reading));
+    ESP_ERROR_CHECK(tds_calibration_add_point(&calibration, reading.value, (uint16_t)options.tds_reference_ppm));
+    ESP_ERROR_CHECK(tds_calibration_apply(&calibration));
+    printf("[%7.3fs] tds calibrated to %d ppm at %.2f mV, %.1f °C\n", esp_timer_get_time() / 1e6, options.tds_reference_ppm,
+           (double)tds_calibration_raw_to_mv(reading.value) / (1 << TDS_MV_SHIFT), tds_calibration_get_temperature() / 1000.0);
+    vTaskDelete(NULL);
+}
+
+// Injects NACK bursts and stuck-SDA episodes on the AS7262 while the readers run
+// Where the sensors stood once the bus came back, to check they recovered
+static struct {
+    bool done;
+    int64_t time_us;
+    uint32_t frames;
+    uint32_t scd41_samples;
+} fault_end;
+
+static void fault_injector_task(void *arg) {
+    vTaskDelay(pdMS_TO_TICKS(2000));
+    printf("[%7.3fs] inject 20 NACKs on 0x%02X\n", esp_timer_get_time() / 1e6, AS7262_I2C_ADDRESS);
+    sim_bus_inject_nack(AS7262_I2C_ADDRESS, 20);
+
+    vTaskDelay(pdMS_TO_TICKS(2000));
+    printf("[%7.3fs] SDA stuck low, released by bus recovery\n", esp_timer_get_time() / 1e6);
+    sim_bus_set_sda_stuck(true, true);
+
+    vTaskDelay(pdMS_TO_TICKS(2000));
+    printf("[%7.3fs] SDA stuck low for 1 s regardless of recovery\n", esp_timer_get_time() / 1e6);
+    sim_bus_set_sda_stuck(true, false);
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    sim_bus_set_sda_stuck(false, false);
+
+    as7262_stream_stats_t stream;
+    scd41_stats_t scd41;
+    as7262_stream_get_stats(&stream);
+    scd41_get_stats(&scd41);
+    fault_end.time_us = esp_timer_get_time();
+    fault_end.frames = stream.frames;
+    fault_end.scd41_samples = scd41.samples;
+    fault_end.done = true;
+    vTaskDelete(NULL);
+}
+
+static void scd41_command_done(esp_err_t result, const uint16_t *words, size_t count, void *ctx) {
+    printf("[%7.3fs] %s done: %s, reply 0x%04X\n", esp_timer_get_time() / 1e6, (const char *)ctx,
+           esp_err_to_name(result), count > 0 ? words[0] : 0);
+}
+
+// Runs the long SCD41 commands in the background while acquisition continues.
+// The self-test goes in 200 ms before the job polls for the sample due at
+// 16.5 s, so that poll lands in the 500 ms stop phase ahead of the test.
+static void scd41_command_task(void *arg) {
+    vTaskDelay(pdMS_TO_TICKS(15800));
+    printf("[%7.3fs] start self-test\n", esp_timer_get_time() / 1e6);
+    ESP_ERROR_CHECK(scd41_start_self_test(scd41_dev, scd41_command_done, "self-test"));
+
+    vTaskDelay(pdMS_TO_TICKS(20000));
+    printf("[%7.3fs] start forced recalibration to 420 ppm\n", esp_timer_get_time() / 1e6);
+    ESP_ERROR_CHECK(scd41_start_forced_recalibration(scd41_dev, 420, scd41_command_done, "forced recalibration"));
+    vTaskDelete(NULL);
+}
+
+// Records the firmware's job for a source put on the bus
+static void print_source(sample_source_t source, double sim_s, double wall_s) {
+    sample_source_stats_t stats;
+    sample_bus_get_source_stats(source, &stats);
+    printf("%-7s published=%-9" PRIu32 " %10.1f/s simulated %12.1f/s wall\n",
+           sample_bus_source_name(source), stats.published, stats.published / sim_s, stats.published / wall_s);
+}
+
+// What a walk over one tier of the flash log found
+typedef struct {
+    uint32_t records;
+    uint32_t out_of_order;
+    uint32_t first_s;
+    uint32_t last_s;
+} log_walk_t;
+
+static bool log_walk_visit(const sample_log_record_t *record, void *ctx) {
+    log_walk_t *walk = ctx;
+    if (walk->records == 0) {
+        walk->first_s = record->time_s;
+    }
+    walk->out_of_order += walk->records > 0 && record->time_s < walk->last_s;
+    walk->last_s = record->time_s;
+    walk->records++;
+    return true;
+}
+
+// A run with --flash-image leaves what its log held in <image>.expect; the
+// next run on the image must recover every one of those records
+static void log_walk_all(log_walk_t walks[SAMPLE_LOG_TIER_COUNT]) {
+    for (int tier = 0; tier < SAMPLE_LOG_TIER_COUNT; tier++) {
+        memset(&walks[tier], 0, sizeof(walks[tier]));
+        sample_log_for_each((uint8_t)tier, log_walk_visit, &walks[tier]);
+    }
+}
+
+static void log_expect_path(char *path, size_t size) {
+    snprintf(path, size, "%s.expect", options.flash_image);
+}
+
+static void log_save_expected(void) {
+    char path[256];
+    log_expect_path(path, sizeof(path));
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        perror(path);
+        return;
+    }
+    log_walk_t walks[SAMPLE_LOG_TIER_COUNT];
+    log_walk_all(walks);
+    for (int tier = 0; tier < SAMPLE_LOG_TIER_COUNT; tier++) {
+        fprintf(file, "%" PRIu32 " %" PRIu32 " %" PRIu32 "\n", walks[tier].records, walks[tier].first_s, walks[tier].last_s);
+    }
+    fclose(file);
+}
+
+static void log_check_recovered(void) {
+    char path[256];
+    log_expect_path(path, sizeof(path));
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return;
+    }
+    log_walk_t walks[SAMPLE_LOG_TIER_COUNT];
+    log_walk_all(walks);
+    for (int tier = 0; tier < SAMPLE_LOG_TIER_COUNT; tier++) {
+        uint32_t records, first_s, last_s;
+        if (fscanf(file, "%" SCNu32 " %" SCNu32 " %" SCNu32, &records, &first_s, &last_s) != 3) {
+            sim_check(false, "%s is not a log expectation", path);
+            break;
+        }
+        printf("log: tier %d recovered %" PRIu32 "/%" PRIu32 " records\n", tier, walks[tier].records, records);
+        sim_check(walks[tier].records == records && (records == 0 || (walks[tier].first_s == first_s && walks[tier].last_s == last_s)),
+                  "log tier %d recovered %" PRIu32 " records over %" PRIu32 "-%" PRIu32 " s, the last run left %" PRIu32 " over %" PRIu32 "-%" PRIu32 " s",
+                  tier, walks[tier].records, walks[tier].first_s, walks[tier].last_s, records, first_s, last_s);
+    }
+    fclose(file);
+}
+
+// What a history query handed back
+typedef struct {
+    uint32_t rows;
+    uint32_t out_of_order;
+    uint32_t last_s;
+    int32_t min;
+    int32_t max;
+} log_query_check_t;
+
+static bool log_query_visit(const sample_log_record_t *record, void *ctx) {
+    log_query_check_t *check = ctx;
+    check->out_of_order += check->rows > 0 && record->time_s <= check->last_s;
+    check->min = check->rows == 0 || record->min < check->min ? record->min : check->min;
+    check->max = check->rows == 0 || record->max > check->max ? record->max : check->max;
+    check->last_s = record->time_s;
+    check->rows++;
+    return true;
+}
+
+// Time a few "history" range queries ending at the newest stored record
+static void print_log_queries(const sample_log_stats_t *log) {
+    static const struct {
+        const char *name;
+        uint32_t span_s;
+        uint32_t step_s;
+    } queries[] = {
+        {"6h as stored", 6 * 3600, 0},
+        {"6h by 15m", 6 * 3600, 900},
+        {"30d by 1d", 30 * 86400, 86400},
+    };
+    uint32_t end_s = 0;
+    for (int tier = 0; tier < SAMPLE_LOG_TIER_COUNT; tier++) {
+        end_s = log->tiers[tier].newest_time_s > end_s ? log->tiers[tier].newest_time_s : end_s;
+    }
+    for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++) {
+        sample_log_query_t query = {
+            .channel = WINDOW_STATS_CO2,
+            .from_s = end_s > queries[i].span_s ? end_s - queries[i].span_s : 0,
+            .to_s = end_s,
+            .step_s = queries[i].step_s,
+        };
+        log_query_check_t check = {0};
+        sample_log_query_stats_t result;
+        if (sample_log_query(&query, log_query_visit, &check, &result) != ESP_OK) {
+            printf("     query co2 %s failed\n", queries[i].name);
+            continue;
+        }
+        printf("     query co2 %-12s tier %u, %4" PRIu32 " rows (%" PRId32 "-%" PRId32 " ppm, %" PRIu32 " out of order), %3" PRIu32 " segments skipped, %3" PRIu32 " summarised, %3" PRIu32 " pages read, %7" PRId64 " us\n",
+               queries[i].name, result.tier, check.rows, check.min, check.max, check.out_of_order, result.segments_skipped,
+               result.segments_summarised, result.pages_read, result.elapsed_us);
+    }
+}
+
+static void print_log_report(void) {
+    sample_log_stats_t log;
+    sample_log_get_stats(&log);
+    if (!log.mounted) {
+        printf("log: not mounted\n");
+        return;
+    }
+    sim_flash_stats_t flash;
+    sim_flash_get_stats(&flash);
+    double days = options.seconds / 86400.0;
+    printf("log: %s image, recovered in %" PRId64 " us with %" PRIu32 " reads, clock from %" PRIu32 " s, %" PRIu32 " corrupt pages\n",
+           flash.image_loaded ? "existing" : "blank", log.recovery_us, log.recovery_reads, log.clock_offset_s, log.corrupt_pages);
+    printf("     %" PRIu32 " records in %" PRIu32 " pages (%" PRIu32 " dropped), %" PRIu32 " segment erases, writer busy %" PRId64 " us\n",
+           log.records, log.pages_written, log.pages_dropped, log.segments_erased, log.write_us);
+    printf("     flash: %" PRIu64 " bytes written (%.0f per day), %" PRIu32 " reads, %" PRIu32 " program conflicts, %" PRIu32 " torn writes\n",
+           flash.write_bytes, flash.write_bytes / days, flash.reads, flash.program_conflicts, flash.torn_writes);
+    printf("     wear: %" PRIu32 "-%" PRIu32 " erases per sector", flash.min_sector_erases, flash.max_sector_erases);
+    if (flash.max_sector_erases > 0) {
+        // 100k erase cycles is the usual rating for the sectors of a 25Q-series NOR
+        printf(", 100k cycles last %.0f years at this rate", 100000.0 / (flash.max_sector_erases / days) / 365.0);
+    }
+    printf("\n");
+    for (int tier = 0; tier < SAMPLE_LOG_TIER_COUNT; tier++) {
+        const sample_log_tier_stats_t *stats = &log.tiers[tier];
+        log_walk_t walk = {0};
+        sample_log_for_each((uint8_t)tier, log_walk_visit, &walk);
+        printf("     tier %d every %4" PRIu32 " s: %3" PRIu32 "/%3" PRIu32 " segments, head %" PRIu32 ":%" PRIu32 ", %6" PRIu32 " records readable over %" PRIu32 "-%" PRIu32 " s, %" PRIu32 " out of order\n",
+               tier, stats->interval_s, stats->segments_used, stats->segment_count, stats->head_segment, stats->head_page,
+               walk.records, walk.first_s, walk.last_s, walk.out_of_order);
+    }
+    print_log_queries(&log);
+}
+
+// Feed the log days of made-up readings every 10 s, so a long-running node's
+// history can be queried without simulating the sensors for that long
+static void log_backfill(int days) {
+    const int64_t step_us = 10 * 1000000LL;
+    const int64_t end_us = days * 86400LL * 1000000;
+    for (int64_t timestamp_us = 0; timestamp_us < end_us; timestamp_us += step_us) {
+        double phase = 2 * M_PI * (double)(timestamp_us % (86400LL * 1000000)) / (86400.0 * 1000000);
+        sample_log_add(WINDOW_STATS_CO2, timestamp_us, (int32_t)(800 + 300 * sin(phase)));
+        sample_log_add(WINDOW_STATS_TEMPERATURE, timestamp_us, (int32_t)(24000 + 3000 * sin(phase)));
+        sample_log_add(WINDOW_STATS_HUMIDITY, timestamp_us, (int32_t)(55000 - 10000 * sin(phase)));
+        for (int channel = WINDOW_STATS_VIOLET; channel <= WINDOW_STATS_RED; channel++) {
+            sample_log_add((window_stats_channel_t)channel, timestamp_us, sin(phase) > 0 ? (int32_t)(50000 * sin(phase)) : 0);
+        }
+        sample_log_add(WINDOW_STATS_TDS, timestamp_us, 650 + (int32_t)(timestamp_us / (86400LL * 1000000)));
+        // Give the writer time for its pages, an erase included, every simulated minute
+        if (timestamp_us % (60 * 1000000LL) == 0) {
+            vTaskDelay(pdMS_TO_TICKS(20));
+        }
+    }
+}
+
+static void print_report(void) {
+    double sim_s = esp_timer_get_time() / 1e6;
+    double wall_s = wall_seconds();
+
+    printf("\nSimulated %.1f s in %.3f s wall\n", sim_s, wall_s);
+    for (int source = 0; source < SAMPLE_SOURCE_COUNT; source++) {
+        print_source((sample_source_t)source, sim_s, wall_s);
+    }
+
+    i2c_arbiter_stats_t arbiter;
+    i2c_get_arbiter_stats(&arbiter, false);
+    printf("\narbiter: %" PRIu32 " transactions (%.0f/s), busy %.1f%%, max latency %" PRIu32 " us\n",
+           arbiter.transactions, arbiter.transactions / sim_s, arbiter.busy_us / (sim_s * 1e4), arbiter.max_latency_us);
+    printf("         errors=%" PRIu32 " retries=%" PRIu32 " deadline_misses=%" PRIu32 " recoveries=%" PRIu32 "\n",
+           arbiter.errors, arbiter.retries, arbiter.deadline_misses, arbiter.bus_recoveries);
+
+    i2c_device_stats_t devices[4];
+    size_t count = i2c_get_device_stats(devices, 4, false);
+    for (size_t i = 0; i < count; i++) {
+        printf("  0x%02X: %" PRIu32 " txn, %" PRIu32 " polls, p50<=%" PRIu32 " us p99<=%" PRIu32 " us max<=%" PRIu32 " us\n",
+               devices[i].address, devices[i].transactions, devices[i].poll_iterations,
+               i2c_latency_percentile(devices[i].latency_histogram, 50),
+               i2c_latency_percentile(devices[i].latency_histogram, 99),
+               i2c_latency_percentile(devices[i].latency_histogram, 100));
+        printf("        %" PRIu32 " batches, submit to done p50<=%" PRIu32 " us p99<=%" PRIu32 " us max<=%" PRIu32 " us\n",
+               devices[i].batches,
+               i2c_latency_percentile(devices[i].batch_latency_histogram, 50),
+               i2c_latency_percentile(devices[i].batch_latency_histogram, 99),
+               i2c_latency_percentile(devices[i].batch_latency_histogram, 100));
+    }
+
+    sim_bus_stats_t bus;
+    sim_bus_get_stats(&bus);
+    printf("bus: %" PRIu32 " transfers, %" PRIu32 " NACKs, %" PRIu32 " timeouts, %" PRIu32 " resets, wire busy %.1f%%\n",
+           bus.transfers, bus.nacks, bus.timeouts, bus.resets, bus.busy_us / (sim_s * 1e4));
+    scd41_stats_t scd41;
+    scd41_get_stats(&scd41);
+    printf("scd41: %" PRIu32 " samples, %" PRIu32 " ready checks (%" PRIu32 " late), %" PRIu32 " polls skipped while busy, %" PRIu32 " errors\n",
+           scd41.samples, scd41.ready_checks, scd41.late_checks, scd41.busy_skips, scd41.errors);
+    scd41_sample_t sample;
+    uint32_t age_ms;
+    if (scd41_get_last_measurement(&sample, &age_ms) == ESP_OK) {
+        printf("       last %u ppm, %" PRId32 " m°C, %" PRId32 " m%%RH\n", sample.co2_ppm, sample.temperature_mc, sample.humidity_mpct);
+    }
+    printf("models: scd41 produced %" PRIu32 " samples, as7262 ran %" PRIu32 " conversions\n",
+           sim_scd41_samples_produced(), sim_as7262_conversions());
+    sample_source_stats_t as7262;
+    sample_bus_get_source_stats(SAMPLE_SOURCE_AS7262, &as7262);
+    for (size_t i = 0; i < count; i++) {
+        if (devices[i].address == AS7262_I2C_ADDRESS && as7262.published > 0) {
+            printf("as7262: %.1f bus transactions per spectral sample\n", (double)devices[i].transactions / as7262.published);
+        }
+    }
+
+    sensor_job_stats_t jobs[SENSOR_SCHED_MAX_JOBS];
+    size_t job_count = sensor_scheduler_get_stats(jobs, SENSOR_SCHED_MAX_JOBS, false);
+    for (size_t i = 0; i < job_count; i++) {
+        printf("sched %-6s every %5" PRIu32 " ms: %6" PRIu32 " runs, %" PRIu32 " missed, jitter avg %" PRIu64 " us max %" PRIu32 " us, run max %" PRIu32 " us, %" PRIu32 " overruns\n",
+               jobs[i].name, jobs[i].period_ms, jobs[i].runs, jobs[i].missed,
+               jobs[i].runs > 0 ? jobs[i].total_jitter_us / jobs[i].runs : 0, jobs[i].max_jitter_us, jobs[i].max_run_us, jobs[i].overruns);
+    }
+
+    for (int source = 0; source < SAMPLE_SOURCE_COUNT; source++) {
+        sample_source_stats_t bus;
+        sample_bus_get_source_stats((sample_source_t)source, &bus);
+        printf("bus %-7s %6" PRIu32 " published, ring %" PRIu32 "\n", sample_bus_source_name((sample_source_t)source), bus.published, bus.capacity);
+    }
+    sample_consumer_t consumers[SAMPLE_BUS_MAX_CONSUMERS];
+    size_t consumer_count = sample_bus_get_consumers(consumers, SAMPLE_BUS_MAX_CONSUMERS);
+    for (size_t i = 0; i < consumer_count; i++) {
+        printf("    %-8s <- %-7s %6" PRIu32 " consumed, %" PRIu32 " overruns, %" PRIu32 " dropped\n", consumers[i].name,
+               sample_bus_source_name(consumers[i].source), consumers[i].consumed, consumers[i].overruns, consumers[i].dropped);
+    }
+    for (int source = 0; source < SAMPLE_SOURCE_COUNT; source++) {
+        sample_timing_t timing;
+        sample_bus_get_timing((sample_source_t)source, &timing, false);
+        if (timing.latency.count > 0 && timing.interval.count > 0) {
+            printf("    %-7s latency mean %" PRId64 " us sd %" PRIu32 " max %" PRId64 "; interval mean %" PRId64 " us jitter sd %" PRIu32 " range %" PRId64 "-%" PRId64 "\n",
+                   sample_bus_source_name((sample_source_t)source), running_stats_mean(&timing.latency), running_stats_stddev(&timing.latency),
+                   timing.latency.max, running_stats_mean(&timing.interval), running_stats_stddev(&timing.interval),
+                   timing.interval.min, timing.interval.max);
+        }
+    }
+    int64_t now_us = esp_timer_get_time();
+    const window_stats_channel_t shown[] = {WINDOW_STATS_CO2, WINDOW_STATS_TEMPERATURE, WINDOW_STATS_GREEN, WINDOW_STATS_TDS};
+    for (size_t i = 0; i < sizeof(shown) / sizeof(shown[0]); i++) {
+        const window_stats_channel_info_t *info = window_stats_channel_info(shown[i]);
+        printf("stats %-8s", info->name);
+        for (int window = 0; window < WINDOW_STATS_WINDOW_COUNT; window++) {
+            running_stats_t stats;
+            window_stats_query(shown[i], (window_stats_window_t)window, now_us, &stats);
+            printf(" %s: n=%" PRIu32 " mean %.2f sd %.2f [%.2f, %.2f];", window_stats_window_name((window_stats_window_t)window), stats.count,
+                   running_stats_mean_double(&stats) / info->scale, running_stats_stddev_double(&stats) / info->scale,
+                   (double)stats.min / info->scale, (double)stats.max / info->scale);
+        }
+        printf(" %s\n", info->unit);
+    }
+    running_stats_t day;
+    window_stats_query(WINDOW_STATS_CO2, WINDOW_STATS_DAY, now_us, &day);
+    printf("      24h co2 vs whole run: n %" PRIu32 "/%" PRIu32 ", mean %.4f/%.4f, sd %.4f/%.4f\n",
+           day.count, bus_check.co2.count, running_stats_mean_double(&day), running_stats_mean_double(&bus_check.co2),
+           running_stats_stddev_double(&day), running_stats_stddev_double(&bus_check.co2));
+    window_stats_query(WINDOW_STATS_TDS, WINDOW_STATS_DAY, now_us, &day);
+    printf("      24h tds vs whole run: n %" PRIu32 "/%" PRIu32 ", mean %.4f/%.4f, sd %.4f/%.4f\n",
+           day.count, bus_check.tds.count, running_stats_mean_double(&day), running_stats_mean_double(&bus_check.tds),
+           running_stats_stddev_double(&day), running_stats_stddev_double(&bus_check.tds));
+    printf("    audit: %" PRIu32 " records, %" PRIu32 " sequence errors, %" PRIu32 " time reversals\n",
+           bus_check.records, bus_check.sequence_errors, bus_check.time_errors);
+
+    print_log_report();
+
+    console_out_stats_t console;
+    console_out_get_stats(&console, false);
+    printf("console: %" PRIu64 " bytes on the UART at %d baud (%.0f%% busy)\n", console_check.bytes, options.console_baud,
+           console_check.bytes * 10.0 / options.console_baud / options.seconds * 100);
+    if (console.started) {
+        printf("         policy %s: %" PRIu32 " messages (%" PRIu32 " deferred), %" PRIu32 " dropped (%" PRIu64 " bytes), %" PRIu32 " blocked for %" PRId64 " us, high water %" PRIu32 "/%d bytes\n",
+               console_out_policy_name(console.policy), console.messages, console.deferred, console.dropped, console.dropped_bytes, console.blocked,
+               console.blocked_us, console.high_water, CONSOLE_OUT_BUFFER_SIZE);
+    }
+
+    if (watch_check.reads > 0 && options.watch_direct) {
+        printf("watch: %" PRIu32 " AS7262 frames read on demand every %d ms, %" PRIu32 " failed, %" PRIu64 " transactions and %" PRIu64 " us on the bus\n",
+               watch_check.reads, options.watch_ms, watch_check.errors, watch_check.transactions, watch_check.bus_us);
+    } else if (watch_check.reads > 0) {
+        printf("watch: %" PRIu32 " cache reads every %d ms, no bus traffic;", watch_check.reads, options.watch_ms);
+        for (int source = 0; source < SAMPLE_SOURCE_COUNT; source++) {
+            printf(" %s %" PRIu32 " invalid, oldest %" PRId64 " ms;", sample_bus_source_name((sample_source_t)source),
+                   watch_check.invalid[source], watch_check.max_age_us[source] / 1000);
+        }
+        printf("\n");
+    }
+
+    config_store_stats_t config;
+    config_store_get_stats(&config, false);
+    sim_nvs_stats_t nvs;
+    sim_nvs_get_stats(&nvs);
+    if (config.migrated > 0 || config.corrupt > 0) {
+        printf("config: at boot %" PRIu32 " settings migrated, %" PRIu32 " rejected;", config.migrated, config.corrupt);
+        for (int id = 0; id < CONFIG_ID_COUNT; id++) {
+            config_info_t info;
+            config_store_get_info((config_id_t)id, &info);
+            if (info.origin == CONFIG_ORIGIN_MIGRATED) {
+                printf(" %s", info.name);
+            }
+        }
+        printf("\n");
+    }
+    if (config_check.sets > 0) {
+        uint32_t pending = 0;
+        for (int id = 0; id < CONFIG_ID_COUNT; id++) {
+            config_info_t info;
+            config_store_get_info((config_id_t)id, &info);
+            pending += info.dirty;
+        }
+        printf("config: %" PRIu32 " changes every %d ms (%" PRIu32 " failed), %s: %" PRIu32 " coalesced, %" PRIu32 " record writes, %" PRIu32 " commits, %" PRIu32 " pending\n",
+               config_check.sets, options.config_tuning_ms, config_check.failures, options.config_direct ? "written at once" : "batched",
+               config.coalesced, config.writes, config.commits, pending);
+        printf("        nvs %" PRIu32 " sets, %" PRIu32 " entries written, %" PRIu32 " commits, %" PRId64 " us busy during the run\n",
+               nvs.sets - config_check.boot.sets, nvs.entries_written - config_check.boot.entries_written,
+               nvs.commits - config_check.boot.commits, nvs.busy_us - config_check.boot.busy_us);
+    }
+
+    dlog_stats_t dlog;
+    dlog_get_stats(&dlog, false);
+    if (console_check.capture != NULL) {
+        printf("logs: %s mode, %" PRIu32 " text lines (%" PRIu64 " bytes), %" PRIu32 " deferred records (%" PRIu64 " bytes), %" PRIu32 " dropped, %" PRIu32 " truncated\n",
+               dlog_mode_name(dlog.mode), console_check.log_lines, console_check.log_bytes, dlog.records, dlog.bytes,
+               dlog.dropped, dlog.truncated);
+    }
+
+    telemetry_stats_t telemetry;
+    telemetry_get_stats(&telemetry);
+    if (telemetry.records > 0) {
+        // 10 bits a byte on the wire at 8N1
+        double bytes_per_s = 115200 / 10.0;
+        double binary = (double)telemetry.bytes / telemetry.records;
+        double text = (double)telemetry_check.text_bytes / telemetry.records;
+        printf("telemetry: %" PRIu32 " records in %" PRIu32 " frames, %" PRIu64 " bytes: %.1f per record against %.1f as text\n",
+               telemetry.records, telemetry.frames, telemetry.bytes, binary, text);
+        printf("           at 115200 baud %.0f records/s binary, %.0f as text (%.1fx)\n", bytes_per_s / binary, bytes_per_s / text, text / binary);
+    }
+
+    tds_adc_stats_t tds;
+    tds_adc_get_stats(&tds);
+    printf("tds adc: %" PRIu32 " frames (task wakes), %" PRIu32 " samples, %" PRIu32 " windows, %" PRIu32 " pool overflows\n",
+           tds.frames, tds.samples, tds.windows, tds.pool_overflows);
+    if (tds_check.count > 0) {
+        double mean = tds_check.sum / tds_check.count;
+        double variance = tds_check.sum_squares / tds_check.count - mean * mean;
+        printf("         filtered mean %.3f, std dev %.3f counts over %" PRIu32 " values; raw range %u-%u\n",
+               mean, variance > 0 ? sqrt(variance) : 0.0, tds_check.count, tds_check.raw_min, tds_check.raw_max);
+    }
+    printf("         last %d ppm at %.1f °C water temperature\n", tds_check.last_ppm, tds_calibration_get_temperature() / 1000.0);
+
+    as7262_stream_stats_t stream;
+    as7262_stream_get_stats(&stream);
+    printf("stream: period %" PRIu32 " us (%s), %" PRIu32 " frames, %" PRIu32 " overwritten, %" PRIu32 " read errors, %" PRIu32 " overruns\n",
+           stream.period_us, stream.interrupt_paced ? "DATA_RDY" : "timer", stream.frames, stream.overwritten,
+           stream.read_errors, stream.overruns);
+    if (stream.frames > 0) {
+        printf("        %.1f transactions and %.0f us on the bus per frame\n",
+               (double)stream.transactions / stream.frames, (double)stream.bus_us / stream.frames);
+    }
+    if (stream_check.max_interval_us > 0) {
+        printf("        frame interval %" PRId64 "-%" PRId64 " us, %" PRIu32 " range changes\n",
+               stream_check.min_interval_us, stream_check.max_interval_us, stream.range_changes);
+    }
+    if (options.light_sweep) {
+        printf("light    frames  saturated  gain  int_ms  green/ms@1x  per unit light\n");
+        for (size_t i = 0; i < LIGHT_LEVEL_COUNT; i++) {
+            const light_step_t *step = &light_steps[i];
+            if (step->frames == 0) {
+                continue;
+            }
+            double green = step->green_sum / step->frames;
+            printf("%-8g %6" PRIu32 " %10" PRIu32 " %5.1f %7.1f %12.3f %15.3f\n", light_levels[i], step->frames, step->saturated,
+                   as7262_gain_factor(step->last_range.gain), as7262_integration_ms(step->last_range), green, green / light_levels[i]);
+        }
+    }
+}
+
+// Invariants every scenario must hold to; scenario-specific ones sit with their injectors
+static void check_run(void) {
+    sensor_job_stats_t jobs[SENSOR_SCHED_MAX_JOBS];
+    size_t job_count = sensor_scheduler_get_stats(jobs, SENSOR_SCHED_MAX_JOBS, false);
+    for (size_t i = 0; i < job_count; i++) {
+        sim_check(jobs[i].missed == 0, "job %s missed %" PRIu32 " deadlines", jobs[i].name, jobs[i].missed);
+        sim_check(jobs[i].overruns == 0, "job %s overran its %" PRIu32 " ms budget %" PRIu32 " times", jobs[i].name, jobs[i].budget_ms, jobs[i].overruns);
+    }
+
+    sim_check(bus_check.sequence_errors == 0 && bus_check.time_errors == 0, "sample bus delivered %" PRIu32 " records out of sequence and %" PRIu32 " back in time",
+              bus_check.sequence_errors, bus_check.time_errors);
+    for (int source = 0; source < SAMPLE_SOURCE_COUNT; source++) {
+        sample_source_stats_t stats;
+        sample_bus_get_source_stats((sample_source_t)source, &stats);
+        sim_check(stats.published > 0, "nothing published for %s", sample_bus_source_name((sample_source_t)source));
+    }
+    sample_consumer_t consumers[SAMPLE_BUS_MAX_CONSUMERS];
+    size_t consumer_count = sample_bus_get_consumers(consumers, SAMPLE_BUS_MAX_CONSUMERS);
+    for (size_t i = 0; i < consumer_count; i++) {
+        // Only the laggard is slow enough to be lapped
+        bool laggard = strcmp(consumers[i].name, "laggard") == 0;
+        sim_check(laggard || consumers[i].dropped == 0, "%s lost %" PRIu32 " %s records", consumers[i].name, consumers[i].dropped,
+                  sample_bus_source_name(consumers[i].source));
+        if (strcmp(consumers[i].name, "stats") == 0 && consumers[i].source == SAMPLE_SOURCE_SCD41) {
+            running_stats_t day;
+            window_stats_query(WINDOW_STATS_CO2, WINDOW_STATS_DAY, esp_timer_get_time(), &day);
+            sim_check(options.seconds >= 86400 || day.count == consumers[i].consumed, "24h co2 window holds %" PRIu32 " of %" PRIu32 " readings",
+                      day.count, consumers[i].consumed);
+            // The same readings under different shifts; only the final division and root round
+            double mean_error = fabs(running_stats_mean_double(&day) - running_stats_mean_double(&bus_check.co2));
+            double sd_error = fabs(running_stats_stddev_double(&day) - running_stats_stddev_double(&bus_check.co2));
+            sim_check(options.seconds >= 86400 || (mean_error < 1e-6 && sd_error < 1e-6), "24h co2 window is off the whole run by %g mean, %g sd",
+                      mean_error, sd_error);
+        }
+    }
+
+    scd41_stats_t scd41;
+    scd41_get_stats(&scd41);
+    sim_check(options.faults || scd41.errors == 0, "%" PRIu32 " SCD41 read errors", scd41.errors);
+    if (options.scd41_commands) {
+        // The overlap has to actually happen for the scenario to prove anything
+        sim_check(scd41.busy_skips > 0, "no SCD41 poll fell into a long command");
+        for (size_t i = 0; i < job_count; i++) {
+            sim_check(strcmp(jobs[i].name, "scd41") != 0 || jobs[i].max_run_us < 2 * SCD41_POLL_WAIT_MS * 1000,
+                      "scd41 job ran for %" PRIu32 " us", jobs[i].max_run_us);
+        }
+    }
+    as7262_stream_stats_t stream;
+    as7262_stream_get_stats(&stream);
+    sim_check(stream.overwritten == 0, "%" PRIu32 " AS7262 frames overwritten before the drain", stream.overwritten);
+    sim_check(options.faults || stream.read_errors == 0, "%" PRIu32 " AS7262 read errors", stream.read_errors);
+    if (stream.interrupt_paced) {
+        // A DATA_RDY left set holds INT low and stalls the stream; each range change
+        // drops a settling frame and each failed read can cost a timeout of conversions
+        uint32_t allowed = 2 + 2 * stream.range_changes + 4 * stream.read_errors;
+        sim_check(stream.frames + allowed >= sim_as7262_conversions(), "AS7262 stream read %" PRIu32 " frames of %" PRIu32 " conversions",
+                  stream.frames, sim_as7262_conversions());
+    }
+
+    if (options.faults) {
+        // Every injected fault has to reach the wire and be handled as its kind:
+        // NACKs retried, timeouts recovered with a bus reset
+        i2c_arbiter_stats_t arbiter;
+        sim_bus_stats_t bus;
+        i2c_get_arbiter_stats(&arbiter, false);
+        sim_bus_get_stats(&bus);
+        sim_check(!fault_end.done || bus.nacks >= 20, "only %" PRIu32 " of 20 injected NACKs seen", bus.nacks);
+        sim_check(!fault_end.done || (bus.timeouts > 0 && arbiter.bus_recoveries > 0), "%" PRIu32 " bus timeouts, %" PRIu32 " recoveries",
+                  bus.timeouts, arbiter.bus_recoveries);
+        sim_check(bus.resets == arbiter.bus_recoveries, "%" PRIu32 " recoveries but %" PRIu32 " bus resets", arbiter.bus_recoveries, bus.resets);
+        sim_check(!fault_end.done || arbiter.retries > 0, "no retries under injected faults");
+        if (fault_end.done) {
+            // Once the bus is back the stream runs at full rate and the SCD41 keeps sampling
+            double after_s = (esp_timer_get_time() - fault_end.time_us) / 1e6;
+            uint32_t expected = (uint32_t)(after_s * 1e6 / stream.period_us);
+            uint32_t frames = stream.frames - fault_end.frames;
+            sim_check(frames + 2 + expected / 10 >= expected, "AS7262 read %" PRIu32 " of %" PRIu32 " frames after the faults", frames, expected);
+            uint32_t scd41_interval_ms = options.low_power ? SCD41_LOW_POWER_INTERVAL_MS : SCD41_PERIODIC_INTERVAL_MS;
+            sim_check(after_s < 2 * scd41_interval_ms / 1000.0 || scd41.samples > fault_end.scd41_samples,
+                      "no SCD41 samples in %.1f s after the faults", after_s);
+        }
+    }
+
+    if (options.faults) {
+        // Every injected fault has to reach the wire and be handled as its kind:
+        // NACKs retried, timeouts recovered with a bus reset
+        i2c_arbiter_stats_t arbiter;
+        sim_bus_stats_t bus;
+        i2c_get_arbiter_stats(&arbiter, false);
+        sim_bus_get_stats(&bus);
+        sim_check(!fault_end.done || bus.nacks >= 20, "only %" PRIu32 " of 20 injected NACKs seen", bus.nacks);
+        sim_check(!fault_end.done || (bus.timeouts > 0 && arbiter.bus_recoveries > 0), "%" PRIu32 " bus timeouts, %" PRIu32 " recoveries",
+                  bus.timeouts, arbiter.bus_recoveries);
+        sim_check(bus.resets == arbiter.bus_recoveries, "%" PRIu32 " recoveries but %" PRIu32 " bus resets", arbiter.bus_recoveries, bus.resets);
+        sim_check(!fault_end.done || arbiter.retries > 0, "no retries under injected faults");
+        if (fault_end.done) {
+            // Once the bus is back the stream runs at full rate and the SCD41 keeps sampling
+            double after_s = (esp_timer_get_time() - fault_end.time_us) / 1e6;
+            uint32_t expected = (uint32_t)(after_s * 1e6 / stream.period_us);
+            uint32_t frames = stream.frames - fault_end.frames;
+            sim_check(frames + 2 + expected / 10 >= expected, "AS7262 read %" PRIu32 " of %" PRIu32 " frames after the faults", frames, expected);
+            uint32_t scd41_interval_ms = options.low_power ? SCD41_LOW_POWER_INTERVAL_MS : SCD41_PERIODIC_INTERVAL_MS;
+            sim_check(after_s < 2 * scd41_interval_ms / 1000.0 || scd41.samples > fault_end.scd41_samples,
+                      "no SCD41 samples in %.1f s after the faults", after_s);
+        }
+    }
+
+    sample_log_stats_t log;
+    sample_log_get_stats(&log);
+    log_walk_t walks[SAMPLE_LOG_TIER_COUNT];
+    log_walk_all(walks);
+    for (int tier = 0; tier < SAMPLE_LOG_TIER_COUNT; tier++) {
+        sim_check(walks[tier].out_of_order == 0, "log tier %d has %" PRIu32 " records out of order", tier, walks[tier].out_of_order);
+    }
+    sim_check(log.pages_dropped == 0, "log dropped %" PRIu32 " pages", log.pages_dropped);
+
+    console_out_stats_t console;
+    console_out_get_stats(&console, false);
+    sim_check(console.policy != CONSOLE_OUT_BLOCK || console.dropped == 0, "%" PRIu32 " console messages dropped under the block policy", console.dropped);
+
+    sim_check(config_check.failures == 0, "%" PRIu32 " config changes failed", config_check.failures);
+    for (int id = 0; id < CONFIG_ID_COUNT; id++) {
+        config_info_t info;
+        config_store_get_info((config_id_t)id, &info);
+        sim_check(!info.dirty, "setting %s still dirty after the final flush", info.name);
+    }
+}
+
+static void app_task(void *arg) {
+    if (options.nvs_legacy) {
+        nvs_preload_legacy();
+    }
+    ESP_ERROR_CHECK(config_store_init());
+    ESP_ERROR_CHECK(console_out_start(sim_uart_write, NULL, options.console_policy));
+    if (console_check.capture != NULL) {
+        esp_log_set_vprintf(sim_log_vprintf);
+    }
+    dlog_set_mode(options.log_deferred ? DLOG_MODE_DEFERRED : DLOG_MODE_TEXT);
+    i2c_master_bus_handle_t bus;
+    ESP_ERROR_CHECK(initialize_i2c_master(&bus));
+    ESP_ERROR_CHECK(scd41_init(bus, &scd41_dev));
+    ESP_ERROR_CHECK(as7262_init(bus, &as7262_dev));
+    tds_calibration_t tds_calibration;
+    ESP_ERROR_CHECK(config_get(CONFIG_TDS_CAL, &tds_calibration, sizeof(tds_calibration)));
+    ESP_ERROR_CHECK(tds_calibration_apply(&tds_calibration));
+    ESP_ERROR_CHECK(initialize_tds_sensor());
+    if (options.tds_filter != TDS_FILTER_TRIMMED_MEAN) {
+        tds_adc_stats_t tds;
+        tds_adc_get_stats(&tds);
+        tds.config.filter = options.tds_filter;
+        ESP_ERROR_CHECK(tds_adc_stop());
+        ESP_ERROR_CHECK(tds_adc_start(&tds.config));
+    }
+    if (options.low_power) {
+        ESP_ERROR_CHECK(scd41_set_mode(scd41_dev, SCD41_MODE_LOW_POWER_PERIODIC));
+    }
+
+    ESP_ERROR_CHECK(sample_log_init());
+    if (options.flash_image != NULL) {
+        log_check_recovered();
+    }
+    if (options.log_backfill_days > 0) {
+        log_backfill(options.log_backfill_days);
+        if (sample_log_flush(5000) != ESP_OK) {
+            printf("log: flush timed out\n");
+        }
+        options.seconds = options.log_backfill_days * 86400;
+        print_log_report();
+        if (options.flash_image != NULL) {
+            log_save_expected();
+        }
+        sim_kernel_stop(check_failures > 0 ? 1 : 0);
+        return;
+    }
+
+    // The firmware's own jobs, then the checks, all on the one scheduler task
+    as7262_stream_config_t stream_config = {
+        .integration_time = (uint8_t)options.integration_time,
+        .gain = AS7262_STREAM_DEFAULT_GAIN,
+        .int_gpio = options.as7262_int ? AS7262_INT_GPIO : GPIO_NUM_NC,
+        .auto_range = options.auto_range,
+    };
+    ESP_ERROR_CHECK(sensor_jobs_start(scd41_dev, as7262_dev, &stream_config));
+    for (int source = 0; source < SAMPLE_SOURCE_COUNT; source++) {
+        ESP_ERROR_CHECK(sample_bus_subscribe("audit", (sample_source_t)source, &audit_cursors[source]));
+    }
+    ESP_ERROR_CHECK(sample_bus_subscribe("laggard", SAMPLE_SOURCE_AS7262, &laggard_cursor));
+    const sensor_job_config_t jobs[] = {
+        {"tdscheck", TDS_CHECK_MS, 40, tds_check_job, NULL},
+        {"audit", AUDIT_MS, 60, audit_job, NULL},
+        {"laggard", LAGGARD_MS, 80, laggard_job, NULL},
+    };
+    for (size_t i = 0; i < sizeof(jobs) / sizeof(jobs[0]); i++) {
+        ESP_ERROR_CHECK(sensor_scheduler_add(&jobs[i]));
+    }
+    ESP_ERROR_CHECK(sensor_scheduler_start());
+    if (options.light_sweep) {
+        xTaskCreate(light_sweep_task, "light", 4096, NULL, 7, NULL);
+    }
+    if (options.tds_reference_ppm > 0) {
+        xTaskCreate(tds_calibration_task, "tds_cal", 4096, NULL, 4, NULL);
+    }
+    if (options.scd41_commands) {
+        xTaskCreate(scd41_command_task, "scd41_cmds", 4096, NULL, 6, NULL);
+    }
+    if (options.faults) {
+        xTaskCreate(fault_injector_task, "faults", 4096, NULL, 7, NULL);
+    }
+    if (options.watch_ms > 0) {
+        xTaskCreate(watch_task, "watch", 4096, NULL, 2, NULL);
+    }
+    if (options.config_tuning_ms > 0) {
+        // Migrated settings go out in the first batch; count from after it
+        config_store_flush();
+        sim_nvs_get_stats(&config_check.boot);
+        xTaskCreate(config_tuning_task, "tuning", 4096, NULL, 5, NULL);
+    }
+
+    vTaskDelay(pdMS_TO_TICKS(options.seconds * 1000));
+    ESP_ERROR_CHECK(as7262_stream_stop());
+    sim_check(sample_log_flush(5000) == ESP_OK, "log flush timed out");
+    sim_check(config_store_flush() == ESP_OK, "config flush failed");
+    print_report();
+    check_run();
+    if (options.flash_image != NULL) {
+        log_save_expected();
+    }
+    if (telemetry_check.file != NULL) {
+        fclose(telemetry_check.file);
+    }
+    if (console_check.capture != NULL) {
+        console_out_flush(CONSOLE_OUT_BLOCK_TIMEOUT_MS);
+        fclose(console_check.capture);
+    }
+    printf("\nchecks: %s\n", check_failures == 0 ? "all passed" : "FAILED");
+    sim_kernel_stop(check_failures > 0 ? 1 : 0);
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [--seconds N] [--faults] [--int-t N] [--no-int] [--auto] [--light-sweep] [--low-power] [--scd41-commands] [--tds-filter mean|median|trimmed] [--tds-spikes] [--tds-cal PPM] [--flash-image FILE] [--flash-kb N] [--flash-tear N] [--log-backfill DAYS] [--telemetry FILE] [--console-baud N] [--console-block] [--console-capture FILE] [--log-deferred] [--watch MS] [--watch-direct] [--config-tuning MS] [--config-direct] [--nvs-legacy] [--verbose]\n", argv0);
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            options.seconds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--faults") == 0) {
+            options.faults = true;
+        } else if (strcmp(argv[i], "--int-t") == 0 && i + 1 < argc) {
+            options.integration_time = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--no-int") == 0) {
+            options.as7262_int = false;
+        } else if (strcmp(argv[i], "--auto") == 0) {
+            options.auto_range = true;
+        } else if (strcmp(argv[i], "--light-sweep") == 0) {
+            options.light_sweep = true;
+        } else if (strcmp(argv[i], "--low-power") == 0) {
+            options.low_power = true;
+        } else if (strcmp(argv[i], "--scd41-commands") == 0) {
+            options.scd41_commands = true;
+        } else if (strcmp(argv[i], "--tds-filter") == 0 && i + 1 < argc) {
+            i++;
+            options.tds_filter = strcmp(argv[i], "mean") == 0 ? TDS_FILTER_MEAN :
+                                 strcmp(argv[i], "median") == 0 ? TDS_FILTER_MEDIAN : TDS_FILTER_TRIMMED_MEAN;
+        } else if (strcmp(argv[i], "--tds-spikes") == 0) {
+            options.tds_spikes = true;
+        } else if (strcmp(argv[i], "--tds-cal") == 0 && i + 1 < argc) {
+            options.tds_reference_ppm = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--flash-image") == 0 && i + 1 < argc) {
+            options.flash_image = argv[++i];
+        } else if (strcmp(argv[i], "--flash-kb") == 0 && i + 1 < argc) {
+            options.flash_kb = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--flash-tear") == 0 && i + 1 < argc) {
+            options.flash_tear = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--log-backfill") == 0 && i + 1 < argc) {
+            options.log_backfill_days = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--telemetry") == 0 && i + 1 < argc) {
+            options.telemetry_path = argv[++i];
+        } else if (strcmp(argv[i], "--console-baud") == 0 && i + 1 < argc) {
+            options.console_baud = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--console-block") == 0) {
+            options.console_policy = CONSOLE_OUT_BLOCK;
+        } else if (strcmp(argv[i], "--console-capture") == 0 && i + 1 < argc) {
+            options.console_capture = argv[++i];
+        } else if (strcmp(argv[i], "--log-deferred") == 0) {
+            options.log_deferred = true;
+        } else if (strcmp(argv[i], "--watch") == 0 && i + 1 < argc) {
+            options.watch_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--watch-direct") == 0) {
+            options.watch_direct = true;
+        } else if (strcmp(argv[i], "--config-tuning") == 0 && i + 1 < argc) {
+            options.config_tuning_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--config-direct") == 0) {
+            options.config_direct = true;
+        } else if (strcmp(argv[i], "--nvs-legacy") == 0) {
+            options.nvs_legacy = true;
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            esp_log_level_set("*", ESP_LOG_INFO);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (options.seconds <= 0 || options.integration_time < 1 || options.integration_time > 255 || options.console_baud <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (sim_flash_open(options.flash_image, (uint32_t)options.flash_kb * 1024) != ESP_OK) {
+        fprintf(stderr, "cannot open a %d KB flash image\n", options.flash_kb);
+        return 1;
+    }
+    sim_flash_tear_write((uint32_t)options.flash_tear);
+    if (options.telemetry_path != NULL) {
+        telemetry_check.file = fopen(options.telemetry_path, "wb");
+        if (telemetry_check.file == NULL) {
+            perror(options.telemetry_path);
+            return 1;
+        }
+        telemetry_start(telemetry_file_write, telemetry_check.file);
+    }
+    if (options.console_capture != NULL) {
+        console_check.capture = fopen(options.console_capture, "wb");
+        if (console_check.capture == NULL) {
+            perror(options.console_capture);
+            return 1;
+        }
+    }
+    sim_bus_attach(sim_scd41_model());
+    sim_bus_attach(sim_as7262_model());
+    sim_as7262_wire_int(AS7262_INT_GPIO);
+    if (options.tds_spikes) {
+        // Pump EMI: a large positive outlier on one conversion in 200
+        sim_adc_set_spikes(TDS_ADC_CHANNEL, 200, 1500);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+    return sim_kernel_run(app_task, NULL, 5);
+}
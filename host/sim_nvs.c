@@ -0,0 +1,120 @@
+#include "sim_devices.h"
+#include "sim_kernel.h"
+#include "nvs_service.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SIM_NVS_MAX_KEYS 64
+#define SIM_NVS_KEY_SIZE 16              // 15 characters, as in ESP-IDF
+#define SIM_NVS_MAX_VALUE 512
+#define SIM_NVS_ENTRY_SIZE 32
+#define SIM_NVS_ENTRY_PROGRAM_US 60      // One 32-byte entry and its state bits
+
+typedef enum {
+    SIM_NVS_I32,
+    SIM_NVS_STR,
+    SIM_NVS_BLOB,
+} sim_nvs_type_t;
+
+typedef struct {
+    char key[SIM_NVS_KEY_SIZE];
+    sim_nvs_type_t type;
+    size_t length;
+    uint8_t value[SIM_NVS_MAX_VALUE];
+} sim_nvs_item_t;
+
+// The one namespace nvs_service opens, kept in RAM for the run
+static sim_nvs_item_t items[SIM_NVS_MAX_KEYS];
+static size_t item_count;
+static sim_nvs_stats_t nvs_stats;
+
+static sim_nvs_item_t *sim_nvs_find(const char *key) {
+    for (size_t i = 0; i < item_count; i++) {
+        if (strcmp(items[i].key, key) == 0) {
+            return &items[i];
+        }
+    }
+    return NULL;
+}
+
+// ESP-IDF writes the new entries at once and retires the old ones; the commit adds nothing
+static esp_err_t sim_nvs_set(const char *key, sim_nvs_type_t type, const void *value, size_t length) {
+    if (key == NULL || strlen(key) >= SIM_NVS_KEY_SIZE || length > SIM_NVS_MAX_VALUE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_nvs_item_t *item = sim_nvs_find(key);
+    if (item == NULL) {
+        if (item_count == SIM_NVS_MAX_KEYS) {
+            return ESP_ERR_NO_MEM;
+        }
+        item = &items[item_count++];
+        snprintf(item->key, sizeof(item->key), "%s", key);
+    }
+    item->type = type;
+    item->length = length;
+    memcpy(item->value, value, length);
+
+    uint32_t entries = 1 + (type == SIM_NVS_I32 ? 0 : (uint32_t)((length + SIM_NVS_ENTRY_SIZE - 1) / SIM_NVS_ENTRY_SIZE));
+    int64_t duration_us = (int64_t)entries * SIM_NVS_ENTRY_PROGRAM_US;
+    sim_kernel_block_us(duration_us);
+    nvs_stats.sets++;
+    nvs_stats.entries_written += entries;
+    nvs_stats.busy_us += duration_us;
+    return ESP_OK;
+}
+
+static esp_err_t sim_nvs_get(const char *key, sim_nvs_type_t type, void *value, size_t *length) {
+    sim_nvs_item_t *item = sim_nvs_find(key);
+    if (item == NULL || item->type != type) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (*length < item->length) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(value, item->value, item->length);
+    *length = item->length;
+    return ESP_OK;
+}
+
+esp_err_t nvs_service_init(void) {
+    return ESP_OK;
+}
+
+esp_err_t nvs_service_commit(void) {
+    nvs_stats.commits++;
+    return ESP_OK;
+}
+
+esp_err_t nvs_service_set_i32(const char *key, int32_t value) {
+    return sim_nvs_set(key, SIM_NVS_I32, &value, sizeof(value));
+}
+
+esp_err_t nvs_service_get_i32(const char *key, int32_t *value) {
+    size_t length = sizeof(*value);
+    return sim_nvs_get(key, SIM_NVS_I32, value, &length);
+}
+
+esp_err_t nvs_service_set_str(const char *key, const char *value) {
+    return sim_nvs_set(key, SIM_NVS_STR, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_service_get_str(const char *key, char *value, size_t length) {
+    return sim_nvs_get(key, SIM_NVS_STR, value, &length);
+}
+
+esp_err_t nvs_service_set_blob(const char *key, const void *value, size_t length) {
+    return sim_nvs_set(key, SIM_NVS_BLOB, value, length);
+}
+
+esp_err_t nvs_service_get_blob(const char *key, void *value, size_t *length) {
+    return sim_nvs_get(key, SIM_NVS_BLOB, value, length);
+}
+
+void print_nvs_stats(void) {
+    printf("NVS: %zu keys, %" PRIu32 " entries written\n", item_count, nvs_stats.entries_written);
+}
+
+void sim_nvs_get_stats(sim_nvs_stats_t *stats) {
+    *stats = nvs_stats;
+}
@@ -0,0 +1,212 @@
+#include "sim_devices.h"
+#include "sim_kernel.h"
+#include <string.h>
+
+#define SCD41_ADDRESS 0x62
+
+#define CMD_START_PERIODIC 0x21B1
+#define CMD_START_LOW_POWER_PERIODIC 0x21AC
+#define CMD_STOP_PERIODIC 0x3F86
+#define CMD_READ_MEASUREMENT 0xEC05
+#define CMD_GET_DATA_READY 0xE4B8
+#define CMD_MEASURE_SINGLE_SHOT 0x219D
+#define CMD_PERFORM_SELF_TEST 0x3639
+#define CMD_FORCED_RECALIBRATION 0x362F
+#define CMD_SET_ASC_ENABLED 0x2416
+#define CMD_FACTORY_RESET 0x3632
+#define CMD_REINIT 0x3646
+
+#define PERIODIC_INTERVAL_US 5000000LL
+#define LOW_POWER_INTERVAL_US 30000000LL
+
+typedef struct {
+    sim_i2c_model_t model;
+    bool periodic;
+    int64_t interval_us;
+    int64_t next_sample_us;
+    int64_t single_shot_due_us;    // 0 when no single shot is pending
+    int64_t busy_until_us;         // Sensor NACKs until its current command finishes
+    bool data_ready;
+    uint16_t sample_words[3];
+    uint8_t response[9];
+    size_t response_len;
+    uint16_t co2_ppm;
+    float temperature_c;
+    float humidity_pct;
+    uint32_t samples;
+} scd41_model_t;
+
+// Independent of src/crc.c so a driver-side CRC bug cannot hide itself
+static uint8_t sensirion_crc(uint8_t msb, uint8_t lsb) {
+    uint8_t data[2] = {msb, lsb};
+    uint8_t crc = 0xFF;
+    for (int i = 0; i < 2; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static scd41_model_t scd41 = {
+    .co2_ppm = 650,
+    .temperature_c = 23.5f,
+    .humidity_pct = 48.0f,
+};
+
+static void set_response(const uint16_t *words, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        scd41.response[3 * i] = (uint8_t)(words[i] >> 8);
+        scd41.response[3 * i + 1] = (uint8_t)(words[i] & 0xFF);
+        scd41.response[3 * i + 2] = sensirion_crc(scd41.response[3 * i], scd41.response[3 * i + 1]);
+    }
+    scd41.response_len = 3 * count;
+}
+
+// Latch a fresh sample; values wander a little so consecutive samples differ
+static void produce_sample(void) {
+    uint16_t co2 = (uint16_t)(scd41.co2_ppm + (scd41.samples % 7) * 3);
+    float temperature = scd41.temperature_c + 0.01f * (float)(scd41.samples % 5);
+    float humidity = scd41.humidity_pct + 0.1f * (float)(scd41.samples % 3);
+
+    scd41.sample_words[0] = co2;
+    scd41.sample_words[1] = (uint16_t)((temperature + 45.0f) * 65535.0f / 175.0f + 0.5f);
+    scd41.sample_words[2] = (uint16_t)(humidity * 65535.0f / 100.0f + 0.5f);
+    scd41.data_ready = true;
+    scd41.samples++;
+}
+
+static void update_measurements(int64_t now) {
+    if (scd41.periodic) {
+        while (now >= scd41.next_sample_us) {
+            produce_sample();
+            scd41.next_sample_us += scd41.interval_us;
+        }
+    }
+    if (scd41.single_shot_due_us != 0 && now >= scd41.single_shot_due_us) {
+        produce_sample();
+        scd41.single_shot_due_us = 0;
+    }
+}
+
+static esp_err_t scd41_write(sim_i2c_model_t *model, const uint8_t *data, size_t len) {
+    (void)model;
+    int64_t now = sim_kernel_now_us();
+    update_measurements(now);
+    if (now < scd41.busy_until_us || len < 2) {
+        return ESP_FAIL;
+    }
+
+    uint16_t command = (uint16_t)((data[0] << 8) | data[1]);
+    uint16_t argument = 0;
+    bool has_argument = len >= 5;
+    if (has_argument) {
+        if (sensirion_crc(data[2], data[3]) != data[4]) {
+            return ESP_FAIL;
+        }
+        argument = (uint16_t)((data[2] << 8) | data[3]);
+    }
+
+    scd41.response_len = 0;
+    int64_t exec_us = 1000;
+
+    // While measuring periodically the sensor only accepts a few commands
+    if (scd41.periodic && command != CMD_READ_MEASUREMENT && command != CMD_GET_DATA_READY &&
+        command != CMD_STOP_PERIODIC && command != CMD_SET_ASC_ENABLED) {
+        return ESP_FAIL;
+    }
+
+    switch (command) {
+    case CMD_START_PERIODIC:
+    case CMD_START_LOW_POWER_PERIODIC:
+        scd41.periodic = true;
+        scd41.interval_us = command == CMD_START_PERIODIC ? PERIODIC_INTERVAL_US : LOW_POWER_INTERVAL_US;
+        scd41.next_sample_us = now + scd41.interval_us;
+        exec_us = 0;
+        break;
+    case CMD_STOP_PERIODIC:
+        scd41.periodic = false;
+        exec_us = 500000;
+        break;
+    case CMD_READ_MEASUREMENT:
+        // Without fresh data the following read is NACKed
+        if (scd41.data_ready) {
+            set_response(scd41.sample_words, 3);
+            scd41.data_ready = false;
+        }
+        break;
+    case CMD_GET_DATA_READY: {
+        uint16_t status = scd41.data_ready ? 0x8006 : 0x8000;
+        set_response(&status, 1);
+        break;
+    }
+    case CMD_MEASURE_SINGLE_SHOT:
+        scd41.single_shot_due_us = now + 5000000;
+        exec_us = 5000000;
+        break;
+    case CMD_PERFORM_SELF_TEST: {
+        uint16_t result = 0;
+        set_response(&result, 1);
+        exec_us = 10000000;
+        break;
+    }
+    case CMD_FORCED_RECALIBRATION: {
+        if (!has_argument) {
+            return ESP_FAIL;
+        }
+        uint16_t correction = (uint16_t)(0x8000 + (int)argument - (int)scd41.co2_ppm);
+        set_response(&correction, 1);
+        exec_us = 400000;
+        break;
+    }
+    case CMD_SET_ASC_ENABLED:
+        break;
+    case CMD_FACTORY_RESET:
+        exec_us = 1200000;
+        break;
+    case CMD_REINIT:
+        exec_us = 20000;
+        break;
+    default:
+        return ESP_FAIL;
+    }
+
+    scd41.busy_until_us = now + exec_us;
+    return ESP_OK;
+}
+
+static esp_err_t scd41_read(sim_i2c_model_t *model, uint8_t *data, size_t len) {
+    (void)model;
+    int64_t now = sim_kernel_now_us();
+    update_measurements(now);
+    if (now < scd41.busy_until_us || scd41.response_len == 0) {
+        return ESP_FAIL;
+    }
+
+    // Bytes beyond the reply read back as an idle bus
+    memset(data, 0xFF, len);
+    memcpy(data, scd41.response, len < scd41.response_len ? len : scd41.response_len);
+    scd41.response_len = 0;
+    return ESP_OK;
+}
+
+sim_i2c_model_t *sim_scd41_model(void) {
+    scd41.model = (sim_i2c_model_t) {
+        .name = "scd41",
+        .address = SCD41_ADDRESS,
+        .write = scd41_write,
+        .read = scd41_read,
+    };
+    return &scd41.model;
+}
+
+void sim_scd41_set_environment(uint16_t co2_ppm, float temperature_c, float humidity_pct) {
+    scd41.co2_ppm = co2_ppm;
+    scd41.temperature_c = temperature_c;
+    scd41.humidity_pct = humidity_pct;
+}
+
+uint32_t sim_scd41_samples_produced(void) {
+    return scd41.samples;
+}
@@ -0,0 +1,537 @@
+// Decoder for the binary telemetry stream (see src/telemetry.h). Reads a
+// capture of the console UART, or stdin, and prints one CSV line per record:
+//
+//   source,sequence,time_ms,field...
+//
+// Anything between frames that fails to decode is counted, and printed to
+// stderr with --text when it looks like a log line. Deferred log frames
+// (see src/dlog.h) are expanded to stderr with the site dictionary from
+// dlog_extract. A summary of frames, records and sequence gaps per source
+// goes to stderr at the end.
+//
+//   ./telemetry_decode [--summary] [--text] [--sites FILE] [FILE|-]
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int telemetry_version = 1;
+constexpr size_t header_size = 10;
+constexpr size_t crc_size = 2;
+constexpr uint8_t log_frame_type = 0xF0;
+constexpr uint8_t log_frame_truncated = 0x08;
+constexpr size_t log_header_size = 9;
+
+struct source_info {
+    const char *name;
+    size_t fields;
+};
+
+// Indexed by the low nibble of the frame type, which is the sample source + 1
+constexpr std::array<source_info, 4> sources = {{
+    {"?", 0},
+    {"scd41", 3},
+    {"as7262", 9},
+    {"tds", 2},
+}};
+
+struct record {
+    int source;
+    uint32_t sequence;
+    uint64_t time_ms;
+    std::array<int32_t, 9> fields;
+    size_t field_count;
+};
+
+struct source_totals {
+    uint64_t records = 0;
+    uint64_t frames = 0;
+    uint64_t gaps = 0;
+    uint64_t lost = 0;                         // Records missing in those gaps
+    bool have_next = false;
+    uint32_t next_sequence = 0;
+};
+
+// A deferred log call site, from the dlog_extract dictionary
+struct log_site {
+    char level;
+    std::string tag;
+    std::string location;
+    std::string format;
+};
+
+// Undo the C escapes the dictionary keeps from the source
+std::string unescape(const std::string &in) {
+    std::string out;
+    for (size_t i = 0; i < in.size(); i++) {
+        if (in[i] != '\\' || i + 1 == in.size()) {
+            out += in[i];
+            continue;
+        }
+        char c = in[++i];
+        switch (c) {
+        case 'n': out += '\n'; break;
+        case 't': out += '\t'; break;
+        case 'r': out += '\r'; break;
+        case 'x': {
+            size_t used = 0;
+            out += static_cast<char>(std::stoi(in.substr(i + 1, 2), &used, 16));
+            i += used;
+            break;
+        }
+        default: out += c; break;
+        }
+    }
+    return out;
+}
+
+bool load_sites(const char *path, std::map<uint32_t, log_site> &sites) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t fields[4];
+        size_t at = 0;
+        for (size_t &field : fields) {
+            at = line.find('\t', at);
+            if (at == std::string::npos) {
+                return false;
+            }
+            field = at++;
+        }
+        log_site site;
+        site.level = line[fields[0] + 1];
+        site.tag = line.substr(fields[1] + 1, fields[2] - fields[1] - 1);
+        site.location = line.substr(fields[2] + 1, fields[3] - fields[2] - 1);
+        site.format = unescape(line.substr(fields[3] + 1));
+        sites[static_cast<uint32_t>(std::stoul(line.substr(0, fields[0]), nullptr, 16))] = site;
+    }
+    return true;
+}
+
+uint16_t crc16_ccitt(const uint8_t *data, size_t count) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < count; i++) {
+        crc ^= static_cast<uint16_t>(data[i] << 8);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+        }
+    }
+    return crc;
+}
+
+// Undo COBS; false if a code byte points past the end
+bool cobs_decode(const std::vector<uint8_t> &in, std::vector<uint8_t> &out) {
+    out.clear();
+    size_t i = 0;
+    while (i < in.size()) {
+        uint8_t code = in[i++];
+        if (code == 0 || i + code - 1 > in.size()) {
+            return false;
+        }
+        out.insert(out.end(), in.begin() + static_cast<long>(i), in.begin() + static_cast<long>(i + code - 1));
+        i += code - 1;
+        if (code < 0xFF && i < in.size()) {
+            out.push_back(0);
+        }
+    }
+    return true;
+}
+
+class varint_reader {
+public:
+    varint_reader(const uint8_t *data, size_t size) : data_(data), size_(size) {}
+
+    bool read64(uint64_t &value) {
+        value = 0;
+        for (int shift = 0; shift < 70; shift += 7) {
+            if (pos_ >= size_) {
+                return false;
+            }
+            uint8_t byte = data_[pos_++];
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool read_bytes(size_t count, const uint8_t *&bytes) {
+        if (size_ - pos_ < count) {
+            return false;
+        }
+        bytes = &data_[pos_];
+        pos_ += count;
+        return true;
+    }
+
+    bool read(uint32_t &value) {
+        value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (pos_ >= size_) {
+                return false;
+            }
+            uint8_t byte = data_[pos_++];
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool done() const { return pos_ == size_; }
+
+private:
+    const uint8_t *data_;
+    size_t size_;
+    size_t pos_ = 0;
+};
+
+uint32_t get_le32(const uint8_t *data) {
+    return static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 |
+           static_cast<uint32_t>(data[2]) << 16 | static_cast<uint32_t>(data[3]) << 24;
+}
+
+int32_t unzigzag(uint32_t value) {
+    return static_cast<int32_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+class decoder {
+public:
+    decoder(bool print_records, bool print_text, const std::map<uint32_t, log_site> *sites)
+        : print_records_(print_records), print_text_(print_text), sites_(sites) {}
+
+    void feed(const uint8_t *data, size_t size) {
+        bytes_ += size;
+        for (size_t i = 0; i < size; i++) {
+            if (data[i] == 0) {
+                end_chunk();
+            } else {
+                chunk_.push_back(data[i]);
+            }
+        }
+    }
+
+    void finish() {
+        end_chunk();
+        uint64_t records = 0, lost = 0;
+        std::fprintf(stderr, "%-8s %10s %10s %8s %8s\n", "source", "frames", "records", "gaps", "lost");
+        for (size_t source = 1; source < sources.size(); source++) {
+            const source_totals &totals = totals_[source];
+            std::fprintf(stderr, "%-8s %10llu %10llu %8llu %8llu\n", sources[source].name,
+                         static_cast<unsigned long long>(totals.frames), static_cast<unsigned long long>(totals.records),
+                         static_cast<unsigned long long>(totals.gaps), static_cast<unsigned long long>(totals.lost));
+            records += totals.records;
+            lost += totals.lost;
+        }
+        std::fprintf(stderr, "%llu bytes, %llu records, %llu lost, %llu bad frames, %llu text chunks, %llu log records (%llu bytes)\n",
+                     static_cast<unsigned long long>(bytes_), static_cast<unsigned long long>(records),
+                     static_cast<unsigned long long>(lost), static_cast<unsigned long long>(bad_frames_),
+                     static_cast<unsigned long long>(text_chunks_), static_cast<unsigned long long>(log_records_),
+                     static_cast<unsigned long long>(log_bytes_));
+        if (unknown_sites_ > 0) {
+            std::fprintf(stderr, "%llu log records from sites missing from the dictionary\n", static_cast<unsigned long long>(unknown_sites_));
+        }
+    }
+
+    bool clean() const { return bad_frames_ == 0; }
+
+private:
+    void end_chunk() {
+        if (!chunk_.empty() && !decode_chunk()) {
+            if (looks_like_text()) {
+                text_chunks_++;
+                if (print_text_) {
+                    std::fprintf(stderr, "%.*s", static_cast<int>(chunk_.size()), reinterpret_cast<const char *>(chunk_.data()));
+                }
+            } else {
+                bad_frames_++;
+            }
+        }
+        chunk_.clear();
+    }
+
+    bool looks_like_text() const {
+        for (uint8_t byte : chunk_) {
+            if (byte < 0x20 && byte != '\n' && byte != '\r' && byte != '\t' && byte != 0x1B) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool decode_chunk() {
+        if (!cobs_decode(chunk_, payload_) || payload_.size() < 1 + crc_size) {
+            return false;
+        }
+        size_t body_end = payload_.size() - crc_size;
+        uint16_t crc = static_cast<uint16_t>(payload_[body_end] | payload_[body_end + 1] << 8);
+        if (crc16_ccitt(payload_.data(), body_end) != crc) {
+            return false;
+        }
+        if ((payload_[0] & 0xF0) == log_frame_type) {
+            return decode_log(body_end);
+        }
+        return decode_frame(body_end);
+    }
+
+    bool decode_frame(size_t body_end) {
+        if (body_end < header_size) {
+            return false;
+        }
+        int version = payload_[0] >> 4;
+        int source = payload_[0] & 0x0F;
+        if (version != telemetry_version || source == 0 || static_cast<size_t>(source) >= sources.size()) {
+            return false;
+        }
+
+        record current{};
+        current.source = source;
+        current.field_count = sources[source].fields;
+        current.sequence = get_le32(&payload_[2]);
+        uint32_t time_ms = get_le32(&payload_[6]);
+        uint8_t count = payload_[1];
+        varint_reader reader(&payload_[header_size], body_end - header_size);
+        std::vector<record> records;
+        for (uint8_t i = 0; i < count; i++) {
+            uint32_t value;
+            if (i > 0) {
+                if (!reader.read(value)) {
+                    return false;
+                }
+                time_ms += value;
+                current.sequence++;
+            }
+            for (size_t field = 0; field < current.field_count; field++) {
+                if (!reader.read(value)) {
+                    return false;
+                }
+                current.fields[field] = static_cast<int32_t>(static_cast<uint32_t>(current.fields[field]) + static_cast<uint32_t>(unzigzag(value)));
+            }
+            current.time_ms = time_ms;
+            records.push_back(current);
+        }
+        if (!reader.done()) {
+            return false;
+        }
+
+        // Only a frame that decoded whole counts
+        source_totals &totals = totals_[source];
+        totals.frames++;
+        for (record &r : records) {
+            r.time_ms = unwrap_time(source, static_cast<uint32_t>(r.time_ms));
+            if (totals.have_next && r.sequence != totals.next_sequence) {
+                totals.gaps++;
+                totals.lost += r.sequence - totals.next_sequence;
+            }
+            totals.have_next = true;
+            totals.next_sequence = r.sequence + 1;
+            totals.records++;
+            if (print_records_) {
+                print(r);
+            }
+        }
+        return true;
+    }
+
+    // Frame times are ms since boot in 32 bits; carry the wraps so the output keeps rising
+    uint64_t unwrap_time(int source, uint32_t time_ms) {
+        uint64_t &last = last_time_ms_[static_cast<size_t>(source)];
+        uint64_t time = (last & ~0xFFFFFFFFULL) | time_ms;
+        if (time + 0x80000000ULL < last) {
+            time += 0x100000000ULL;
+        }
+        last = time;
+        return time;
+    }
+
+    bool decode_log(size_t body_end) {
+        if (body_end < log_header_size) {
+            return false;
+        }
+        int level = payload_[0] & 0x07;
+        uint32_t id = get_le32(&payload_[1]);
+        uint32_t time_ms = get_le32(&payload_[5]);
+        log_records_++;
+        log_bytes_ += chunk_.size() + 2;
+        if (sites_ == nullptr) {
+            return true;
+        }
+        varint_reader args(&payload_[log_header_size], body_end - log_header_size);
+        auto found = sites_->find(id);
+        if (found == sites_->end()) {
+            unknown_sites_++;
+            std::fprintf(stderr, "%c (%u) ?: site %08x with %zu bytes of arguments\n", "NEWIDV"[level % 6], time_ms, id,
+                         body_end - log_header_size);
+            return true;
+        }
+        const log_site &site = found->second;
+        std::string message = expand(site.format, args);
+        if (payload_[0] & log_frame_truncated) {
+            message += " [arguments cut]";
+        }
+        std::fprintf(stderr, "%c (%u) %s: %s\n", site.level, time_ms, site.tag.c_str(), message.c_str());
+        return true;
+    }
+
+    // printf the format against the captured arguments, each conversion widened
+    // to the 64-bit value or the double the firmware sent
+    static std::string expand(const std::string &format, varint_reader &args) {
+        std::string out;
+        char text[128];
+        for (size_t i = 0; i < format.size(); i++) {
+            if (format[i] != '%') {
+                out += format[i];
+                continue;
+            }
+            if (i + 1 < format.size() && format[i + 1] == '%') {
+                out += '%';
+                i++;
+                continue;
+            }
+            // Flags, width and precision carry over; * takes its own argument
+            std::string spec = "%";
+            size_t j = i + 1;
+            bool missing = false;
+            while (j < format.size() && std::strchr("-+ #0123456789.*", format[j]) != nullptr) {
+                if (format[j] == '*') {
+                    uint64_t value = 0;
+                    missing |= !args.read64(value);
+                    spec += std::to_string(static_cast<int>(unzigzag64(value)));
+                } else {
+                    spec += format[j];
+                }
+                j++;
+            }
+            // int, long, size_t and pointers are all 32 bits on the ESP32
+            std::string length;
+            while (j < format.size() && std::strchr("hlLqjzt", format[j]) != nullptr) {
+                length += format[j++];
+            }
+            int bits = length == "hh" ? 8 : length == "h" ? 16 : length == "ll" || length == "j" || length == "q" ? 64 : 32;
+            if (j >= format.size()) {
+                break;
+            }
+            char conversion = format[j];
+            i = j;
+            uint64_t value = 0;
+            const uint8_t *bytes = nullptr;
+            if (std::strchr("diouxXcp", conversion) != nullptr) {
+                missing |= !args.read64(value);
+                int64_t number = unzigzag64(value);
+                uint64_t mask = bits >= 64 ? ~0ULL : (1ULL << bits) - 1;
+                if (conversion == 'd' || conversion == 'i') {
+                    std::snprintf(text, sizeof(text), (spec + "lld").c_str(), static_cast<long long>(number));
+                } else if (conversion == 'c') {
+                    std::snprintf(text, sizeof(text), (spec + "c").c_str(), static_cast<int>(number));
+                } else if (conversion == 'p') {
+                    std::snprintf(text, sizeof(text), "0x%llx", static_cast<unsigned long long>(number) & mask);
+                } else {
+                    std::snprintf(text, sizeof(text), (spec + "ll" + conversion).c_str(), static_cast<unsigned long long>(number) & mask);
+                }
+            } else if (std::strchr("fFeEgGaA", conversion) != nullptr) {
+                missing |= !args.read_bytes(8, bytes);
+                double number = 0;
+                if (bytes != nullptr) {
+                    uint64_t raw = 0;
+                    for (int k = 7; k >= 0; k--) {
+                        raw = raw << 8 | bytes[k];
+                    }
+                    std::memcpy(&number, &raw, sizeof(number));
+                }
+                std::snprintf(text, sizeof(text), (spec + conversion).c_str(), number);
+            } else if (conversion == 's') {
+                const uint8_t *length = nullptr;
+                missing |= !args.read_bytes(1, length) || !args.read_bytes(*length, bytes);
+                std::string s = bytes != nullptr ? std::string(reinterpret_cast<const char *>(bytes), *length) : "";
+                std::snprintf(text, sizeof(text), (spec + "s").c_str(), s.c_str());
+            } else {
+                text[0] = '\0';
+            }
+            out += missing ? "?" : text;
+        }
+        return out;
+    }
+
+    static int64_t unzigzag64(uint64_t value) {
+        return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+    }
+
+    void print(const record &r) {
+        std::printf("%s,%u,%llu", sources[static_cast<size_t>(r.source)].name, r.sequence, static_cast<unsigned long long>(r.time_ms));
+        for (size_t field = 0; field < r.field_count; field++) {
+            std::printf(",%d", r.fields[field]);
+        }
+        std::printf("\n");
+    }
+
+    bool print_records_;
+    bool print_text_;
+    const std::map<uint32_t, log_site> *sites_;
+    std::vector<uint8_t> chunk_;
+    std::vector<uint8_t> payload_;
+    std::array<source_totals, sources.size()> totals_{};
+    std::array<uint64_t, sources.size()> last_time_ms_{};
+    uint64_t bytes_ = 0;
+    uint64_t bad_frames_ = 0;
+    uint64_t text_chunks_ = 0;
+    uint64_t log_records_ = 0;
+    uint64_t log_bytes_ = 0;
+    uint64_t unknown_sites_ = 0;
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    bool print_records = true;
+    bool print_text = false;
+    const char *path = "-";
+    const char *sites_path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--summary") == 0) {
+            print_records = false;
+        } else if (std::strcmp(argv[i], "--text") == 0) {
+            print_text = true;
+        } else if (std::strcmp(argv[i], "--sites") == 0 && i + 1 < argc) {
+            sites_path = argv[++i];
+        } else if (argv[i][0] != '-' || std::strcmp(argv[i], "-") == 0) {
+            path = argv[i];
+        } else {
+            std::fprintf(stderr, "usage: %s [--summary] [--text] [--sites FILE] [FILE|-]\n", argv[0]);
+            return 2;
+        }
+    }
+    FILE *in = std::strcmp(path, "-") == 0 ? stdin : std::fopen(path, "rb");
+    if (in == nullptr) {
+        std::perror(path);
+        return 1;
+    }
+
+    std::map<uint32_t, log_site> sites;
+    if (sites_path != nullptr && !load_sites(sites_path, sites)) {
+        std::fprintf(stderr, "%s: not a dlog_extract dictionary\n", sites_path);
+        return 1;
+    }
+    decoder decode(print_records, print_text, sites_path != nullptr ? &sites : nullptr);
+    std::array<uint8_t, 4096> buffer;
+    size_t size;
+    while ((size = std::fread(buffer.data(), 1, buffer.size(), in)) > 0) {
+        decode.feed(buffer.data(), size);
+    }
+    decode.finish();
+    if (in != stdin) {
+        std::fclose(in);
+    }
+    return decode.clean() ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+#include "window_stats.h"
+#include "running_stats.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// The running and windowed statistics against means and deviations worked out
+// directly: non-integer results, buckets merged under different shifts, and a
+// channel that drifts far from its first value.
+//
+//   ./build-host/window_stats_test
+
+#define TEST_SAMPLES_MAX 64
+#define TEST_TOLERANCE 1e-9
+
+static uint32_t check_failures;
+
+// Report a broken expectation; the run still goes on so every failure shows
+static void test_check(bool ok, const char *format, ...) {
+    if (ok) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    printf("check failed: ");
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+    check_failures++;
+}
+
+// Mean and population deviation of values the two-pass way
+static void reference_stats(const int32_t *values, size_t count, double *mean, double *stddev) {
+    double sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        sum += values[i];
+    }
+    *mean = sum / count;
+    double squares = 0;
+    for (size_t i = 0; i < count; i++) {
+        squares += (values[i] - *mean) * (values[i] - *mean);
+    }
+    *stddev = sqrt(squares / count);
+}
+
+static bool close_to(double value, double expected) {
+    return fabs(value - expected) <= TEST_TOLERANCE * (fabs(expected) > 1 ? fabs(expected) : 1);
+}
+
+// {1, 2, 2, 4}: mean 2.25 and deviation sqrt(1.1875), neither a whole number
+static void test_running_stats(void) {
+    static const int32_t values[] = {1, 2, 2, 4};
+    running_stats_t stats;
+    running_stats_reset(&stats);
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        running_stats_add(&stats, values[i]);
+    }
+    test_check(close_to(running_stats_mean_double(&stats), 2.25), "mean %.9f, expected 2.25", running_stats_mean_double(&stats));
+    test_check(close_to(running_stats_stddev_double(&stats), sqrt(1.1875)), "sd %.9f, expected %.9f",
+               running_stats_stddev_double(&stats), sqrt(1.1875));
+    test_check(running_stats_mean(&stats) == 2 && running_stats_stddev(&stats) == 1, "rounded mean %" PRId64 " sd %" PRIu32,
+               running_stats_mean(&stats), running_stats_stddev(&stats));
+
+    // Rounded, not truncated: 5/3 is 2 and a negative mean rounds away from zero too
+    running_stats_reset(&stats);
+    running_stats_add(&stats, 1);
+    running_stats_add(&stats, 2);
+    running_stats_add(&stats, 2);
+    test_check(running_stats_mean(&stats) == 2, "mean of {1, 2, 2} rounded to %" PRId64, running_stats_mean(&stats));
+    running_stats_reset(&stats);
+    running_stats_add(&stats, -1);
+    running_stats_add(&stats, -2);
+    running_stats_add(&stats, -2);
+    test_check(running_stats_mean(&stats) == -2, "mean of {-1, -2, -2} rounded to %" PRId64, running_stats_mean(&stats));
+    printf("running: mean 2.25 and sd %.6f exact, integer views rounded\n", sqrt(1.1875));
+}
+
+// Put values into a channel one bucket of the day window apart and compare every window with the reference
+static void check_windows(const char *name, const int32_t *values, size_t count, int64_t step_us) {
+    window_stats_reset();
+    int64_t timestamp_us = 0;
+    for (size_t i = 0; i < count; i++) {
+        window_stats_add(WINDOW_STATS_TDS, timestamp_us, values[i]);
+        timestamp_us += step_us;
+    }
+    double mean, stddev;
+    reference_stats(values, count, &mean, &stddev);
+    for (int window = 0; window < WINDOW_STATS_WINDOW_COUNT; window++) {
+        int64_t span_us = window_stats_window_span_us((window_stats_window_t)window);
+        if ((int64_t)count * step_us > span_us) {
+            continue;
+        }
+        running_stats_t stats;
+        window_stats_query(WINDOW_STATS_TDS, (window_stats_window_t)window, timestamp_us - step_us, &stats);
+        test_check(stats.count == count, "%s %s: %" PRIu32 " of %zu values", name, window_stats_window_name((window_stats_window_t)window),
+                   stats.count, count);
+        test_check(close_to(running_stats_mean_double(&stats), mean), "%s %s: mean %.9f, expected %.9f", name,
+                   window_stats_window_name((window_stats_window_t)window), running_stats_mean_double(&stats), mean);
+        test_check(close_to(running_stats_stddev_double(&stats), stddev), "%s %s: sd %.9f, expected %.9f", name,
+                   window_stats_window_name((window_stats_window_t)window), running_stats_stddev_double(&stats), stddev);
+    }
+    printf("windows %s: %zu values, mean %.6f sd %.6f in every window\n", name, count, mean, stddev);
+}
+
+static void test_window_stats(void) {
+    // The sim's TDS case: a few ppm around 111, spread over several buckets of each window
+    static const int32_t tds[] = {110, 113, 111, 112, 110, 111, 113, 112, 111, 110, 112};
+    check_windows("tds", tds, sizeof(tds) / sizeof(tds[0]), 2000000);
+
+    // A channel that starts at 0 and settles a million units away
+    int32_t drift[TEST_SAMPLES_MAX];
+    size_t count = 0;
+    drift[count++] = 0;
+    while (count < 48) {
+        drift[count] = 1000000 + (int32_t)(count % 7) * 3 - (int32_t)(count % 3);
+        count++;
+    }
+    check_windows("drift", drift, count, 1000000);
+
+    // Spread across the buckets of the day, each with its own first value
+    int32_t day[TEST_SAMPLES_MAX];
+    for (size_t i = 0; i < 24; i++) {
+        day[i] = 20000 + (int32_t)i * 150 + (int32_t)(i % 4);
+    }
+    check_windows("day", day, 24, window_stats_window_span_us(WINDOW_STATS_DAY) / WINDOW_STATS_BUCKETS);
+}
+
+int main(void) {
+    test_running_stats();
+    test_window_stats();
+    printf("checks: %s\n", check_failures == 0 ? "all passed" : "FAILED");
+    return check_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+#include "as7262_autorange.h"
+
+// Datasheet gain factors for the GAIN field of the control setup register
+static const float gain_factors[4] = {1.0f, 3.7f, 16.0f, 64.0f};
+
+// Function to look up the amplification of a gain setting
+float as7262_gain_factor(uint8_t gain) {
+    return gain_factors[gain & 0x03];
+}
+
+// Function to convert INT_T steps to milliseconds
+float as7262_integration_ms(as7262_range_t range) {
+    return (float)(range.integration_time ? range.integration_time : 1) * (AS7262_INTEGRATION_STEP_US / 1000.0f);
+}
+
+// Gain factors in tenths, for the fixed-point path
+static const uint32_t gain_tenths[4] = {10, 37, 160, 640};
+
+// Function to normalise raw counts by gain and integration time
+void as7262_normalize(const uint16_t* raw, as7262_range_t range, uint32_t* normalized) {
+    // Exposure in hundredths of ms at 1x; one divide per frame, then a multiply-shift per channel
+    uint32_t exposure = gain_tenths[range.gain & 0x03] * (range.integration_time ? range.integration_time : 1) * (AS7262_INTEGRATION_STEP_US / 100);
+    uint32_t scale = (uint32_t)((100ULL << 32) / exposure);
+    for (int i = 0; i < AS7262_CHANNEL_COUNT; i++) {
+        normalized[i] = (uint32_t)(((uint64_t)raw[i] * scale) >> (32 - AS7262_NORMALIZED_SHIFT));
+    }
+}
+
+// Function to choose the range for the next frame
+bool as7262_autorange_next(const as7262_autorange_config_t* config, as7262_range_t current, const uint16_t* raw, as7262_range_t* next) {
+    uint16_t peak = 0;
+    for (int i = 0; i < AS7262_CHANNEL_COUNT; i++) {
+        peak = raw[i] > peak ? raw[i] : peak;
+    }
+    *next = current;
+    if (peak >= config->target_low && peak <= config->target_high) {
+        return false;
+    }
+
+    // Light rate in counts per ms at 1x. A clipped reading only gives a lower
+    // bound, so assume four times as much light to step down quickly.
+    float exposure = as7262_gain_factor(current.gain) * as7262_integration_ms(current);
+    float rate = (float)peak / exposure;
+    if (peak >= AS7262_FULL_SCALE) {
+        rate *= 4.0f;
+    }
+
+    // In the dark there is nothing to measure, so use the most sensitive range
+    if (rate <= 0.0f) {
+        next->gain = 3;
+        next->integration_time = config->max_integration_time;
+        return next->gain != current.gain || next->integration_time != current.integration_time;
+    }
+
+    // Aim a quarter into the window so small changes in light do not re-range at once
+    float aim = config->target_low + (config->target_high - config->target_low) / 4.0f;
+    float step_ms = AS7262_INTEGRATION_STEP_US / 1000.0f;
+    bool found = false;
+    bool best_in_window = false;
+    float best_predicted = 0.0f;
+    as7262_range_t best = {0};
+    for (int gain = 0; gain < 4; gain++) {
+        float steps = aim / (rate * gain_factors[gain] * step_ms);
+        uint32_t integration_time = steps < 255.0f ? (uint32_t)steps + 1 : 255;
+        if (integration_time < config->min_integration_time) {
+            integration_time = config->min_integration_time;
+        }
+        if (integration_time > config->max_integration_time) {
+            integration_time = config->max_integration_time;
+        }
+        float predicted = rate * gain_factors[gain] * integration_time * step_ms;
+        if (predicted > config->target_high) {
+            continue;
+        }
+
+        // In the window the shortest integration wins, lower gains first on a
+        // tie since they are quieter. Below it, the most signal wins.
+        bool in_window = predicted >= config->target_low;
+        bool better;
+        if (!found || in_window != best_in_window) {
+            better = !found || in_window;
+        } else if (in_window) {
+            better = integration_time < best.integration_time;
+        } else {
+            better = predicted > best_predicted;
+        }
+        if (better) {
+            best = (as7262_range_t) { .gain = (uint8_t)gain, .integration_time = (uint8_t)integration_time };
+            best_in_window = in_window;
+            best_predicted = predicted;
+            found = true;
+        }
+    }
+
+    // Too bright for every range: shortest integration at the lowest gain
+    if (!found) {
+        best = (as7262_range_t) { .gain = 0, .integration_time = config->min_integration_time };
+    }
+    *next = best;
+    return next->gain != current.gain || next->integration_time != current.integration_time;
+}
+
+// Function to write gain and integration time to the sensor
+esp_err_t as7262_apply_range(i2c_master_dev_handle_t dev_handle, as7262_range_t range) {
+    esp_err_t ret = as7262_set_integration_time(dev_handle, range.integration_time);
+    if (ret != ESP_OK) return ret;
+    return as7262_set_gain(dev_handle, range.gain);
+}
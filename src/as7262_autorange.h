@@ -0,0 +1,50 @@
+#ifndef AS7262_AUTORANGE_H
+#define AS7262_AUTORANGE_H
+
+#include "as7262_driver.h"
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define AS7262_FULL_SCALE 65535
+
+// Default target window for the brightest channel, 25% to 75% of full scale
+#define AS7262_AUTORANGE_DEFAULT_LOW 16384
+#define AS7262_AUTORANGE_DEFAULT_HIGH 49152
+
+// Gain and integration time the sensor is running with
+typedef struct {
+    uint8_t gain;                      // 0: 1x, 1: 3.7x, 2: 16x, 3: 64x
+    uint8_t integration_time;          // INT_T steps of 2.8 ms
+} as7262_range_t;
+
+// Auto-ranging limits
+typedef struct {
+    uint16_t target_low;               // Brightest channel should read at least this
+    uint16_t target_high;              // ... and at most this
+    uint8_t min_integration_time;      // Keep a conversion longer than a frame read
+    uint8_t max_integration_time;
+} as7262_autorange_config_t;
+
+// Normalised counts are fixed point with this many fraction bits
+#define AS7262_NORMALIZED_SHIFT 16
+
+// Amplification of a gain setting, for display
+float as7262_gain_factor(uint8_t gain);
+
+// Integration time of a range in milliseconds, for display
+float as7262_integration_ms(as7262_range_t range);
+
+// Scale raw counts to counts per millisecond at 1x gain, comparable across
+// ranges, as Q16.16 fixed point (AS7262_NORMALIZED_SHIFT fraction bits)
+void as7262_normalize(const uint16_t* raw, as7262_range_t range, uint32_t* normalized);
+
+// Pick the range for the next frame from the last one. Returns true when it
+// differs from current. Among ranges that put the brightest channel inside
+// the window, the one with the shortest integration wins.
+bool as7262_autorange_next(const as7262_autorange_config_t* config, as7262_range_t current, const uint16_t* raw, as7262_range_t* next);
+
+// Write a range to the sensor
+esp_err_t as7262_apply_range(i2c_master_dev_handle_t dev_handle, as7262_range_t range);
+
+#endif // AS7262_AUTORANGE_H
@@ -1,21 +1,58 @@
 #include "as7262_driver.h"
+#include "esp_attr.h"
 #include "esp_log.h"
+#include "dlog.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include <stdio.h>
+#include <string.h>
 #include "i2c_service.h"
 
 // Internal helper functions
 static esp_err_t as7262_write_register(i2c_master_dev_handle_t dev_handle, uint8_t reg, uint8_t value);
 static esp_err_t as7262_read_register(i2c_master_dev_handle_t dev_handle, uint8_t reg, uint8_t* value);
-static esp_err_t as7262_read_calibrated_register(i2c_master_dev_handle_t dev_handle, uint8_t reg, float* value);
+static esp_err_t as7262_read_slave_register(i2c_master_dev_handle_t dev_handle, uint8_t reg, uint8_t* value);
+static esp_err_t as7262_wait_status(i2c_master_dev_handle_t dev_handle, uint8_t mask, bool want_set);
+
+static const char* TAG = "AS7262_DRIVER";
+
+// Most registers one frame reads (six calibrated floats)
+#define AS7262_FRAME_MAX_REGS (AS7262_CHANNEL_COUNT * 4)
+// One TX_VALID poll up front, then address write, RX_VALID poll and data read
+// per register, CONTROL_SETUP included
+#define AS7262_FRAME_MAX_OPS (1 + 3 * (AS7262_FRAME_MAX_REGS + 1))
+
+// Descriptor and buffers of the frame batch. Too large for a task stack, so
+// they live here and frame reads are serialised by lock.
+static struct {
+    SemaphoreHandle_t lock;
+    i2c_op_t ops[AS7262_FRAME_MAX_OPS];
+    uint8_t address_writes[AS7262_FRAME_MAX_REGS][2];
+    uint8_t data[AS7262_FRAME_MAX_REGS];
+    uint8_t control_address[2];
+    uint8_t control;
+    uint8_t control_write[2][2];
+    uint8_t status;
+} frame_engine;
+
+static const uint8_t status_pointer = AS7262_STATUS_REG;
+static const uint8_t read_pointer = AS7262_READ_REG;
 
 // Buffer to store the bus handle
 static i2c_master_bus_handle_t internal_bus_handle;
 
+// Task notified by the DATA_RDY interrupt, NULL while polling
+static TaskHandle_t data_ready_task = NULL;
+static gpio_num_t data_ready_gpio;
+
 // Initialize the AS7262
 esp_err_t as7262_init(i2c_master_bus_handle_t bus_handle, i2c_master_dev_handle_t* dev_handle) {
     internal_bus_handle = bus_handle;  // Load bus handle into internal buffer
+    if (frame_engine.lock == NULL) {
+        frame_engine.lock = xSemaphoreCreateMutex();
+        if (frame_engine.lock == NULL) return ESP_ERR_NO_MEM;
+    }
     return add_i2c_device(internal_bus_handle, dev_handle, AS7262_I2C_ADDRESS);
 }
 
@@ -44,71 +81,260 @@ esp_err_t as7262_start_measurement(i2c_master_dev_handle_t dev_handle, uint8_t m
 
 // Read measurement
 esp_err_t as7262_read_measurement(i2c_master_dev_handle_t dev_handle, uint16_t* channels) {
-    uint8_t high, low;
-    for (uint8_t i = 0; i < 6; i++) {
-        esp_err_t ret = as7262_read_register(dev_handle, 0x08 + 2 * i, &high);
-        if (ret != ESP_OK) return ret;
-        ret = as7262_read_register(dev_handle, 0x09 + 2 * i, &low);
-        if (ret != ESP_OK) return ret;
-        channels[i] = (high << 8) | low;
-    }
+    as7262_frame_t frame;
+    esp_err_t ret = as7262_read_frame(dev_handle, AS7262_FRAME_RAW, &frame);
+    if (ret != ESP_OK) return ret;
+    memcpy(channels, frame.raw, sizeof(frame.raw));
     return ESP_OK;
 }
 
 // Read calibrated data
 esp_err_t as7262_read_calibrated_data(i2c_master_dev_handle_t dev_handle, float* channels) {
-    for (uint8_t i = 0; i < 6; i++) {
-        esp_err_t ret = as7262_read_calibrated_register(dev_handle, 0x14 + 4 * i, &channels[i]);
-        if (ret != ESP_OK) return ret;
+    as7262_frame_t frame;
+    esp_err_t ret = as7262_read_frame(dev_handle, AS7262_FRAME_CALIBRATED, &frame);
+    if (ret != ESP_OK) return ret;
+    memcpy(channels, frame.calibrated, sizeof(frame.calibrated));
+    return ESP_OK;
+}
+
+// Batch step that polls STATUS with the same backoff as as7262_wait_status
+static i2c_op_t as7262_status_poll(uint8_t mask, uint8_t value) {
+    return (i2c_op_t) {
+        .type = I2C_OP_POLL,
+        .write_buf = &status_pointer, .write_size = 1,
+        .read_buf = &frame_engine.status, .read_size = 1,
+        .poll_mask = mask, .poll_value = value,
+        .max_polls = AS7262_HANDSHAKE_MAX_POLLS,
+        .spin_polls = AS7262_HANDSHAKE_SPIN_POLLS,
+        .yield_polls = AS7262_HANDSHAKE_YIELD_POLLS,
+    };
+}
+
+// Write CONTROL_SETUP back with DATA_RDY cleared, in one batch; the frame lock
+// must be held and frame_engine.control hold the value read with the frame
+static esp_err_t as7262_clear_data_ready(i2c_master_dev_handle_t dev_handle, i2c_batch_info_t* info) {
+    frame_engine.control_write[0][0] = AS7262_WRITE_REG;
+    frame_engine.control_write[0][1] = AS7262_CONTROL_SETUP_REG | 0x80;
+    frame_engine.control_write[1][0] = AS7262_WRITE_REG;
+    frame_engine.control_write[1][1] = frame_engine.control & ~AS7262_CONTROL_DATA_RDY;
+    size_t op_count = 0;
+    for (int i = 0; i < 2; i++) {
+        frame_engine.ops[op_count++] = as7262_status_poll(AS7262_TX_VALID, 0);
+        frame_engine.ops[op_count++] = (i2c_op_t) {
+            .type = I2C_OP_WRITE,
+            .write_buf = frame_engine.control_write[i], .write_size = 2,
+        };
+    }
+    return i2c_transfer_info(dev_handle, frame_engine.ops, op_count, info);
+}
+
+// Read a whole frame of channel registers in one batch
+esp_err_t as7262_read_frame(i2c_master_dev_handle_t dev_handle, as7262_frame_type_t type, as7262_frame_t* frame) {
+    if (frame == NULL || frame_engine.lock == NULL) return ESP_ERR_INVALID_STATE;
+    uint8_t first_reg = type == AS7262_FRAME_RAW ? AS7262_RAW_DATA_REG : AS7262_CALIBRATED_DATA_REG;
+    size_t reg_count = type == AS7262_FRAME_RAW ? 2 * AS7262_CHANNEL_COUNT : 4 * AS7262_CHANNEL_COUNT;
+
+    xSemaphoreTake(frame_engine.lock, portMAX_DELAY);
+
+    // TX_VALID only needs checking once: by the time RX_VALID is set the slave
+    // has consumed the address, so the next address write can follow the data read
+    size_t op_count = 0;
+    frame_engine.ops[op_count++] = as7262_status_poll(AS7262_TX_VALID, 0);
+    for (size_t i = 0; i < reg_count; i++) {
+        frame_engine.address_writes[i][0] = AS7262_WRITE_REG;
+        frame_engine.address_writes[i][1] = (uint8_t)(first_reg + i);
+        frame_engine.ops[op_count++] = (i2c_op_t) {
+            .type = I2C_OP_WRITE,
+            .write_buf = frame_engine.address_writes[i], .write_size = 2,
+        };
+        frame_engine.ops[op_count++] = as7262_status_poll(AS7262_RX_VALID, AS7262_RX_VALID);
+        frame_engine.ops[op_count++] = (i2c_op_t) {
+            .type = I2C_OP_WRITE_READ,
+            .write_buf = &read_pointer, .write_size = 1,
+            .read_buf = &frame_engine.data[i], .read_size = 1,
+        };
+    }
+    // CONTROL_SETUP rides along so DATA_RDY can be cleared without a separate read
+    frame_engine.control_address[0] = AS7262_WRITE_REG;
+    frame_engine.control_address[1] = AS7262_CONTROL_SETUP_REG;
+    frame_engine.ops[op_count++] = (i2c_op_t) {
+        .type = I2C_OP_WRITE,
+        .write_buf = frame_engine.control_address, .write_size = 2,
+    };
+    frame_engine.ops[op_count++] = as7262_status_poll(AS7262_RX_VALID, AS7262_RX_VALID);
+    frame_engine.ops[op_count++] = (i2c_op_t) {
+        .type = I2C_OP_WRITE_READ,
+        .write_buf = &read_pointer, .write_size = 1,
+        .read_buf = &frame_engine.control, .read_size = 1,
+    };
+
+    i2c_batch_info_t info = {0};
+    esp_err_t ret = i2c_transfer_info(dev_handle, frame_engine.ops, op_count, &info);
+    if (ret == ESP_OK && (frame_engine.control & AS7262_CONTROL_DATA_RDY)) {
+        // Reading the data does not clear DATA_RDY, and INT stays asserted until it is.
+        // A conversion finishing in between loses its flag, so at worst one frame is skipped.
+        i2c_batch_info_t clear_info = {0};
+        ret = as7262_clear_data_ready(dev_handle, &clear_info);
+        info.transactions += clear_info.transactions;
+        info.polls += clear_info.polls;
+        info.bus_us += clear_info.bus_us;
+    }
+    if (ret == ESP_OK) {
+        // Both register banks are big-endian regardless of host byte order
+        for (size_t i = 0; i < AS7262_CHANNEL_COUNT; i++) {
+            if (type == AS7262_FRAME_RAW) {
+                frame->raw[i] = (uint16_t)((frame_engine.data[2 * i] << 8) | frame_engine.data[2 * i + 1]);
+            } else {
+                const uint8_t* bytes = &frame_engine.data[4 * i];
+                uint32_t bits = ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+                memcpy(&frame->calibrated[i], &bits, sizeof(float));
+            }
+        }
+    }
+    xSemaphoreGive(frame_engine.lock);
+
+    frame->transactions = info.transactions;
+    frame->polls = info.polls;
+    frame->bus_us = info.bus_us;
+    if (ret != ESP_OK) {
+        DLOGW(TAG, "Frame read failed after %u transactions: %s", (unsigned)info.transactions, esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+// DATA_RDY interrupt: hand the new conversion to the acquisition task
+static void IRAM_ATTR as7262_int_isr(void* arg) {
+    BaseType_t higher_priority_woken = pdFALSE;
+    vTaskNotifyGiveFromISR((TaskHandle_t)arg, &higher_priority_woken);
+    portYIELD_FROM_ISR(higher_priority_woken);
+}
+
+// Enable the DATA_RDY interrupt
+esp_err_t as7262_enable_data_ready_interrupt(i2c_master_dev_handle_t dev_handle, gpio_num_t int_gpio, TaskHandle_t notify_task) {
+    gpio_config_t io_conf = {
+        .pin_bit_mask = 1ULL << int_gpio,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_NEGEDGE,
+    };
+    esp_err_t ret = gpio_config(&io_conf);
+    if (ret != ESP_OK) return ret;
+
+    // The ISR service may already be installed by another driver
+    ret = gpio_install_isr_service(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) return ret;
+    ret = gpio_isr_handler_add(int_gpio, as7262_int_isr, notify_task);
+    if (ret != ESP_OK) return ret;
+
+    uint8_t control;
+    ret = as7262_read_register(dev_handle, AS7262_CONTROL_SETUP_REG, &control);
+    if (ret == ESP_OK) {
+        ret = as7262_write_register(dev_handle, AS7262_CONTROL_SETUP_REG, (control | AS7262_CONTROL_INT) & ~AS7262_CONTROL_DATA_RDY);
+    }
+    if (ret != ESP_OK) {
+        gpio_isr_handler_remove(int_gpio);
+        return ret;
     }
+
+    data_ready_task = notify_task;
+    data_ready_gpio = int_gpio;
+    DLOGI(TAG, "DATA_RDY interrupt enabled on GPIO %d", int_gpio);
     return ESP_OK;
 }
 
+// Disable the DATA_RDY interrupt and go back to polling
+esp_err_t as7262_disable_data_ready_interrupt(i2c_master_dev_handle_t dev_handle) {
+    if (data_ready_task == NULL) return ESP_OK;
+    gpio_isr_handler_remove(data_ready_gpio);
+    data_ready_task = NULL;
+
+    uint8_t control;
+    esp_err_t ret = as7262_read_register(dev_handle, AS7262_CONTROL_SETUP_REG, &control);
+    if (ret != ESP_OK) return ret;
+    return as7262_write_register(dev_handle, AS7262_CONTROL_SETUP_REG, control & ~(AS7262_CONTROL_INT | AS7262_CONTROL_DATA_RDY));
+}
+
+// Wait for a fresh conversion
+esp_err_t as7262_wait_data_ready(i2c_master_dev_handle_t dev_handle, uint32_t timeout_ms) {
+    if (data_ready_task != NULL) {
+        // A notification left over from before the call still marks unread data
+        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout_ms)) > 0) return ESP_OK;
+        // INT is held while DATA_RDY is set, so a flag a failed read left behind
+        // blocks every later edge; report it as ready so the next read clears it
+        uint8_t control;
+        esp_err_t ret = as7262_read_register(dev_handle, AS7262_CONTROL_SETUP_REG, &control);
+        if (ret != ESP_OK) return ret;
+        return (control & AS7262_CONTROL_DATA_RDY) ? ESP_OK : ESP_ERR_TIMEOUT;
+    }
+
+    TickType_t start = xTaskGetTickCount();
+    while (true) {
+        uint8_t control;
+        esp_err_t ret = as7262_read_register(dev_handle, AS7262_CONTROL_SETUP_REG, &control);
+        if (ret != ESP_OK) return ret;
+        if (control & AS7262_CONTROL_DATA_RDY) return ESP_OK;
+        if (xTaskGetTickCount() - start >= pdMS_TO_TICKS(timeout_ms)) return ESP_ERR_TIMEOUT;
+        // A conversion takes at least one 2.8 ms integration step, so sleep between checks
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+}
+
 // Internal helper functions
-static esp_err_t as7262_write_register(i2c_master_dev_handle_t dev_handle, uint8_t reg, uint8_t value) {
-    uint8_t status;
-    do {
-        esp_err_t ret = i2c_read_from_device(dev_handle, &status, sizeof(status));
+
+// Read one of the physical STATUS/READ registers; the slave pointer must be set first
+static esp_err_t as7262_read_slave_register(i2c_master_dev_handle_t dev_handle, uint8_t reg, uint8_t* value) {
+    return i2c_write_read_device(dev_handle, &reg, sizeof(reg), value, sizeof(uint8_t));
+}
+
+// Poll STATUS until the mask bit reaches the wanted state, backing off so the
+// task does not monopolise the bus or its core
+static esp_err_t as7262_wait_status(i2c_master_dev_handle_t dev_handle, uint8_t mask, bool want_set) {
+    for (int poll = 0; poll < AS7262_HANDSHAKE_MAX_POLLS; poll++) {
+        uint8_t status;
+        i2c_record_poll(dev_handle);
+        esp_err_t ret = as7262_read_slave_register(dev_handle, AS7262_STATUS_REG, &status);
         if (ret != ESP_OK) return ret;
-    } while (status & AS7262_TX_VALID);
+        if (((status & mask) != 0) == want_set) return ESP_OK;
+
+        if (poll >= AS7262_HANDSHAKE_YIELD_POLLS) {
+            vTaskDelay(1);
+        } else if (poll >= AS7262_HANDSHAKE_SPIN_POLLS) {
+            taskYIELD();
+        }
+    }
+    DLOGW(TAG, "Handshake timed out waiting for status 0x%02X", mask);
+    return ESP_ERR_TIMEOUT;
+}
+
+static esp_err_t as7262_write_register(i2c_master_dev_handle_t dev_handle, uint8_t reg, uint8_t value) {
+    esp_err_t ret = as7262_wait_status(dev_handle, AS7262_TX_VALID, false);
+    if (ret != ESP_OK) return ret;
 
     // Write the register address
     uint8_t reg_data[2] = {AS7262_WRITE_REG, reg | 0x80};
-    esp_err_t ret = i2c_write_to_device(dev_handle, reg_data, sizeof(reg_data));
+    ret = i2c_write_to_device(dev_handle, reg_data, sizeof(reg_data));
     if (ret != ESP_OK) return ret;
 
     // Write the value
+    ret = as7262_wait_status(dev_handle, AS7262_TX_VALID, false);
+    if (ret != ESP_OK) return ret;
     reg_data[1] = value;
     return i2c_write_to_device(dev_handle, reg_data, sizeof(reg_data));
 }
 
 static esp_err_t as7262_read_register(i2c_master_dev_handle_t dev_handle, uint8_t reg, uint8_t* value) {
-    uint8_t status;
-    do {
-        esp_err_t ret = i2c_read_from_device(dev_handle, &status, sizeof(status));
-        if (ret != ESP_OK) return ret;
-    } while (status & AS7262_TX_VALID);
+    esp_err_t ret = as7262_wait_status(dev_handle, AS7262_TX_VALID, false);
+    if (ret != ESP_OK) return ret;
 
     // Write the register address
     uint8_t reg_data[2] = {AS7262_WRITE_REG, reg};
-    esp_err_t ret = i2c_write_to_device(dev_handle, reg_data, sizeof(reg_data));
+    ret = i2c_write_to_device(dev_handle, reg_data, sizeof(reg_data));
     if (ret != ESP_OK) return ret;
 
-    do {
-        ret = i2c_read_from_device(dev_handle, &status, sizeof(status));
-        if (ret != ESP_OK) return ret;
-    } while (!(status & AS7262_RX_VALID));
+    ret = as7262_wait_status(dev_handle, AS7262_RX_VALID, true);
+    if (ret != ESP_OK) return ret;
 
     // Read the value
-    return i2c_read_from_device(dev_handle, value, sizeof(uint8_t));
-}
-
-static esp_err_t as7262_read_calibrated_register(i2c_master_dev_handle_t dev_handle, uint8_t reg, float* value) {
-    uint8_t data[4];
-    for (uint8_t i = 0; i < 4; i++) {
-        esp_err_t ret = as7262_read_register(dev_handle, reg + i, &data[i]);
-        if (ret != ESP_OK) return ret;
-    }
-    *value = *(float*)data;
-    return ESP_OK;
+    return as7262_read_slave_register(dev_handle, AS7262_READ_REG, value);
 }
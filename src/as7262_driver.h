@@ -3,6 +3,10 @@
 
 #include "esp_err.h"
 #include "i2c_service.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdint.h>
 
 #define AS7262_I2C_ADDRESS           0x49
 
@@ -19,6 +23,48 @@
 #define AS7262_TX_VALID              0x02
 #define AS7262_RX_VALID              0x01
 
+// Control setup register bits
+#define AS7262_CONTROL_RST           0x80
+#define AS7262_CONTROL_INT           0x40
+#define AS7262_CONTROL_DATA_RDY      0x02
+
+// Channel data registers: six big-endian raw words, then six big-endian floats
+#define AS7262_CHANNEL_COUNT         6
+#define AS7262_RAW_DATA_REG          0x08
+#define AS7262_CALIBRATED_DATA_REG   0x14
+
+// Bank modes of the control setup register
+#define AS7262_BANK_MODE_CONTINUOUS_ALL 2   // All six channels continuously, two integrations per frame
+#define AS7262_BANK_MODE_ONE_SHOT       3
+
+// One INT_T step of the integration time
+#define AS7262_INTEGRATION_STEP_US   2800
+
+// Handshake polling: a few immediate polls, then yield, then sleep a tick between polls
+#define AS7262_HANDSHAKE_MAX_POLLS   40
+#define AS7262_HANDSHAKE_SPIN_POLLS  2
+#define AS7262_HANDSHAKE_YIELD_POLLS 8
+
+// Which channel registers a frame read fetches
+typedef enum {
+    AS7262_FRAME_RAW,         // 12 registers, fills raw
+    AS7262_FRAME_CALIBRATED,  // 24 registers, fills calibrated
+} as7262_frame_type_t;
+
+// One spectral frame and what it cost to fetch
+typedef struct {
+    uint16_t raw[AS7262_CHANNEL_COUNT];
+    float calibrated[AS7262_CHANNEL_COUNT];
+    uint32_t transactions;    // I2C transactions issued for the frame, polls included
+    uint32_t polls;           // STATUS polls among them
+    uint32_t bus_us;          // Time the frame held the bus
+} as7262_frame_t;
+
+// Per-channel factors the console applies to raw counts
+typedef struct {
+    float correction_factors[AS7262_CHANNEL_COUNT];
+} as7262_calibration_t;
+
 // Function prototypes
 esp_err_t as7262_init(i2c_master_bus_handle_t bus_handle, i2c_master_dev_handle_t* dev_handle);
 esp_err_t as7262_set_integration_time(i2c_master_dev_handle_t dev_handle, uint8_t integration_time);
@@ -27,4 +73,21 @@ esp_err_t as7262_start_measurement(i2c_master_dev_handle_t dev_handle, uint8_t m
 esp_err_t as7262_read_measurement(i2c_master_dev_handle_t dev_handle, uint16_t* channels);
 esp_err_t as7262_read_calibrated_data(i2c_master_dev_handle_t dev_handle, float* channels);
 
+// Fetch all six channels in a single arbiter batch. The handshake polls run
+// inside the batch, so the frame costs one queue round trip instead of one per
+// bus transaction. CONTROL_SETUP is read with the frame and written back with
+// DATA_RDY cleared in a second batch, which also releases the INT pin.
+esp_err_t as7262_read_frame(i2c_master_dev_handle_t dev_handle, as7262_frame_type_t type, as7262_frame_t* frame);
+
+// Enable the INT pin on DATA_RDY and notify notify_task (xTaskNotifyGive) from its GPIO ISR
+esp_err_t as7262_enable_data_ready_interrupt(i2c_master_dev_handle_t dev_handle, gpio_num_t int_gpio, TaskHandle_t notify_task);
+
+// Detach the GPIO ISR and clear the INT bit; later waits poll DATA_RDY
+esp_err_t as7262_disable_data_ready_interrupt(i2c_master_dev_handle_t dev_handle);
+
+// Wait until a conversion newer than the last read is available. Uses the
+// interrupt notification when enabled, otherwise polls DATA_RDY with backoff.
+// Must be called from the task passed to as7262_enable_data_ready_interrupt.
+esp_err_t as7262_wait_data_ready(i2c_master_dev_handle_t dev_handle, uint32_t timeout_ms);
+
 #endif // AS7262_DRIVER_H
@@ -0,0 +1,254 @@
+#include "as7262_stream.h"
+#include "esp_log.h"
+#include "dlog.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <string.h>
+
+static const char *TAG = "AS7262_STREAM";
+
+// Ring of the most recent frames; the writer overwrites the oldest when full
+static struct {
+    as7262_stream_frame_t frames[AS7262_STREAM_CAPACITY];
+    size_t head;                       // Slot the next frame goes to
+    size_t count;
+} ring;
+
+static i2c_master_dev_handle_t stream_dev = NULL;
+static as7262_stream_config_t stream_config;
+static TaskHandle_t stream_task_handle = NULL;
+static SemaphoreHandle_t stream_exit = NULL;
+static volatile bool stop_requested = false;
+static as7262_stream_stats_t stream_stats;
+static portMUX_TYPE stream_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Function to compute the frame period; bank mode 2 integrates twice per frame
+uint32_t as7262_stream_period_us(uint8_t integration_time) {
+    return 2u * (uint32_t)(integration_time ? integration_time : 1) * AS7262_INTEGRATION_STEP_US;
+}
+
+// Append a frame, dropping the oldest one if the ring is full
+static void as7262_stream_push(const as7262_stream_frame_t *frame) {
+    portENTER_CRITICAL(&stream_lock);
+    ring.frames[ring.head] = *frame;
+    ring.head = (ring.head + 1) % AS7262_STREAM_CAPACITY;
+    if (ring.count < AS7262_STREAM_CAPACITY) {
+        ring.count++;
+    } else {
+        stream_stats.overwritten++;
+    }
+    stream_stats.frames++;
+    portEXIT_CRITICAL(&stream_lock);
+}
+
+// Task that reads one frame per conversion, paced by DATA_RDY or by the frame period
+static void as7262_stream_task(void *arg) {
+    uint32_t period_us = stream_stats.period_us;
+
+    // The interrupt notifies whoever enabled it, so it is enabled from here
+    bool interrupt_paced = false;
+    if (stream_config.int_gpio != GPIO_NUM_NC) {
+        esp_err_t ret = as7262_enable_data_ready_interrupt(stream_dev, stream_config.int_gpio, xTaskGetCurrentTaskHandle());
+        if (ret == ESP_OK) {
+            interrupt_paced = true;
+        } else {
+            DLOGW(TAG, "DATA_RDY interrupt unavailable (%s), pacing by timer", esp_err_to_name(ret));
+        }
+    }
+    portENTER_CRITICAL(&stream_lock);
+    stream_stats.interrupt_paced = interrupt_paced;
+    portEXIT_CRITICAL(&stream_lock);
+    DLOGI(TAG, "Streaming every %lu us (INT_T=%u, gain=%u, %s)", (unsigned long)period_us,
+          stream_config.integration_time, stream_config.gain, interrupt_paced ? "DATA_RDY" : "timer");
+
+    as7262_range_t range = {
+        .gain = stream_config.gain,
+        .integration_time = stream_config.integration_time,
+    };
+    as7262_autorange_config_t autorange = {
+        .target_low = AS7262_AUTORANGE_DEFAULT_LOW,
+        .target_high = AS7262_AUTORANGE_DEFAULT_HIGH,
+        .min_integration_time = AS7262_STREAM_MIN_INT_T,
+        .max_integration_time = 255,
+    };
+    bool settling = false;
+
+    // Round the period up to whole ticks so the timer never outruns the sensor
+    TickType_t period_ticks = (TickType_t)((period_us + portTICK_PERIOD_MS * 1000 - 1) / (portTICK_PERIOD_MS * 1000));
+    uint32_t timeout_ms = 2 * period_us / 1000 + 100;
+    TickType_t last_wake = xTaskGetTickCount();
+    uint32_t sequence = 0;
+
+    while (!stop_requested) {
+        esp_err_t ret = ESP_OK;
+        if (interrupt_paced) {
+            ret = as7262_wait_data_ready(stream_dev, timeout_ms);
+        } else {
+            vTaskDelayUntil(&last_wake, period_ticks);
+        }
+        if (stop_requested) {
+            break;
+        }
+
+        as7262_stream_frame_t frame = {
+            .requested_us = esp_timer_get_time(),
+            .range = range,
+        };
+        as7262_frame_t data;
+        if (ret == ESP_OK) {
+            ret = as7262_read_frame(stream_dev, AS7262_FRAME_RAW, &data);
+        }
+        if (ret != ESP_OK) {
+            portENTER_CRITICAL(&stream_lock);
+            stream_stats.read_errors++;
+            portEXIT_CRITICAL(&stream_lock);
+            continue;
+        }
+
+        frame.timestamp_us = esp_timer_get_time();
+        portENTER_CRITICAL(&stream_lock);
+        stream_stats.transactions += data.transactions;
+        stream_stats.bus_us += data.bus_us;
+        if (frame.timestamp_us - frame.requested_us > period_us) {
+            stream_stats.overruns++;
+        }
+        portEXIT_CRITICAL(&stream_lock);
+
+        // The conversion running while the range changed mixes both settings, so drop it
+        if (settling) {
+            settling = false;
+            continue;
+        }
+
+        frame.sequence = sequence++;
+        memcpy(frame.raw, data.raw, sizeof(frame.raw));
+        for (int i = 0; i < AS7262_CHANNEL_COUNT; i++) {
+            frame.saturated |= frame.raw[i] >= AS7262_FULL_SCALE;
+        }
+        as7262_stream_push(&frame);
+
+        as7262_range_t next;
+        if (!stream_config.auto_range || !as7262_autorange_next(&autorange, range, frame.raw, &next)) {
+            continue;
+        }
+        if (as7262_apply_range(stream_dev, next) != ESP_OK) {
+            portENTER_CRITICAL(&stream_lock);
+            stream_stats.read_errors++;
+            portEXIT_CRITICAL(&stream_lock);
+            continue;
+        }
+        DLOGD(TAG, "Range gain=%u INT_T=%u -> gain=%u INT_T=%u", range.gain, range.integration_time, next.gain, next.integration_time);
+        range = next;
+        settling = true;
+        period_us = as7262_stream_period_us(range.integration_time);
+        period_ticks = (TickType_t)((period_us + portTICK_PERIOD_MS * 1000 - 1) / (portTICK_PERIOD_MS * 1000));
+        timeout_ms = 2 * period_us / 1000 + 100;
+        last_wake = xTaskGetTickCount();
+
+        portENTER_CRITICAL(&stream_lock);
+        stream_stats.period_us = period_us;
+        stream_stats.range = range;
+        stream_stats.range_changes++;
+        portEXIT_CRITICAL(&stream_lock);
+    }
+
+    if (interrupt_paced) {
+        as7262_disable_data_ready_interrupt(stream_dev);
+    }
+    xSemaphoreGive(stream_exit);
+    vTaskDelete(NULL);
+}
+
+// Function to configure continuous mode and start streaming
+esp_err_t as7262_stream_start(i2c_master_dev_handle_t dev_handle, const as7262_stream_config_t *config) {
+    if (dev_handle == NULL || config == NULL || config->integration_time == 0 || config->gain > 3 ||
+        (config->auto_range && config->integration_time < AS7262_STREAM_MIN_INT_T)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (stream_task_handle != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (stream_exit == NULL) {
+        stream_exit = xSemaphoreCreateBinary();
+        if (stream_exit == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    esp_err_t ret = as7262_set_integration_time(dev_handle, config->integration_time);
+    if (ret == ESP_OK) {
+        ret = as7262_set_gain(dev_handle, config->gain);
+    }
+    if (ret == ESP_OK) {
+        ret = as7262_start_measurement(dev_handle, AS7262_BANK_MODE_CONTINUOUS_ALL);
+    }
+    if (ret != ESP_OK) {
+        DLOGE(TAG, "Failed to configure continuous mode: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    portENTER_CRITICAL(&stream_lock);
+    memset(&stream_stats, 0, sizeof(stream_stats));
+    stream_stats.period_us = as7262_stream_period_us(config->integration_time);
+    stream_stats.range = (as7262_range_t) { .gain = config->gain, .integration_time = config->integration_time };
+    stream_stats.running = true;
+    ring.head = 0;
+    ring.count = 0;
+    portEXIT_CRITICAL(&stream_lock);
+
+    stream_dev = dev_handle;
+    stream_config = *config;
+    stop_requested = false;
+    if (xTaskCreate(as7262_stream_task, "as7262_stream", AS7262_STREAM_STACK_SIZE, NULL, AS7262_STREAM_PRIORITY, &stream_task_handle) != pdPASS) {
+        stream_task_handle = NULL;
+        stream_stats.running = false;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+// Function to stop streaming and wait for the stream task to exit
+esp_err_t as7262_stream_stop(void) {
+    if (stream_task_handle == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    stop_requested = true;
+    xTaskNotifyGive(stream_task_handle);  // Cut short an interrupt wait
+    xSemaphoreTake(stream_exit, portMAX_DELAY);
+    stream_task_handle = NULL;
+
+    portENTER_CRITICAL(&stream_lock);
+    stream_stats.running = false;
+    portEXIT_CRITICAL(&stream_lock);
+    return ESP_OK;
+}
+
+// Function to move the oldest frames out of the ring
+size_t as7262_stream_drain(as7262_stream_frame_t *frames, size_t max_frames) {
+    portENTER_CRITICAL(&stream_lock);
+    size_t count = ring.count < max_frames ? ring.count : max_frames;
+    size_t tail = (ring.head + AS7262_STREAM_CAPACITY - ring.count) % AS7262_STREAM_CAPACITY;
+    for (size_t i = 0; i < count; i++) {
+        frames[i] = ring.frames[(tail + i) % AS7262_STREAM_CAPACITY];
+    }
+    ring.count -= count;
+    portEXIT_CRITICAL(&stream_lock);
+    return count;
+}
+
+// Function to count the frames waiting in the ring
+size_t as7262_stream_available(void) {
+    portENTER_CRITICAL(&stream_lock);
+    size_t count = ring.count;
+    portEXIT_CRITICAL(&stream_lock);
+    return count;
+}
+
+// Function to read the streaming counters
+void as7262_stream_get_stats(as7262_stream_stats_t *stats) {
+    portENTER_CRITICAL(&stream_lock);
+    *stats = stream_stats;
+    portEXIT_CRITICAL(&stream_lock);
+}
@@ -0,0 +1,73 @@
+#ifndef AS7262_STREAM_H
+#define AS7262_STREAM_H
+
+#include "as7262_driver.h"
+#include "as7262_autorange.h"
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define AS7262_STREAM_CAPACITY 64      // Frames kept before the oldest is overwritten
+#define AS7262_STREAM_STACK_SIZE 3072
+#define AS7262_STREAM_PRIORITY 5
+
+// INT_T 18 is 50.4 ms, so a frame every ~100 ms, at 3.7x gain
+#define AS7262_STREAM_DEFAULT_INT_T 18
+#define AS7262_STREAM_DEFAULT_GAIN 1
+
+// Shortest integration auto-ranging may pick: a 33.6 ms frame leaves room for the 13.5 ms read
+#define AS7262_STREAM_MIN_INT_T 6
+
+// One timestamped spectral frame
+typedef struct {
+    int64_t requested_us;              // esp_timer time DATA_RDY (or the pacing timer) was seen
+    int64_t timestamp_us;              // esp_timer time the frame read completed
+    uint32_t sequence;                 // Increments per frame, gaps mean frames were overwritten
+    as7262_range_t range;              // Gain and integration time of this frame
+    bool saturated;                    // A channel hit full scale, the reading is a lower bound
+    uint16_t raw[AS7262_CHANNEL_COUNT];  // Raw counts; as7262_normalize makes them comparable across ranges
+} as7262_stream_frame_t;
+
+// Streaming setup
+typedef struct {
+    uint8_t integration_time;          // INT_T register value, 2.8 ms per step, 1-255
+    uint8_t gain;                      // 0: 1x, 1: 3.7x, 2: 16x, 3: 64x
+    gpio_num_t int_gpio;               // DATA_RDY interrupt pin, or GPIO_NUM_NC to pace by timer
+    bool auto_range;                   // Re-pick gain and integration after every frame; the above is the start range
+} as7262_stream_config_t;
+
+// Streaming counters since the last start
+typedef struct {
+    bool running;
+    bool interrupt_paced;
+    uint32_t period_us;                // Time between frames in continuous bank mode
+    as7262_range_t range;              // Range the sensor is running with now
+    uint32_t range_changes;
+    uint32_t frames;                   // Frames pushed into the ring
+    uint32_t overwritten;              // Frames lost because nobody drained them in time
+    uint32_t read_errors;
+    uint32_t overruns;                 // Reads that took longer than one period
+    uint64_t transactions;             // I2C transactions spent on frame reads
+    uint64_t bus_us;                   // Bus time spent on frame reads
+} as7262_stream_stats_t;
+
+// Put the sensor in continuous bank mode and start pushing frames into the ring
+esp_err_t as7262_stream_start(i2c_master_dev_handle_t dev_handle, const as7262_stream_config_t *config);
+
+// Stop the stream task; frames already in the ring can still be drained
+esp_err_t as7262_stream_stop(void);
+
+// Move up to max_frames of the oldest frames into frames and return how many were moved
+size_t as7262_stream_drain(as7262_stream_frame_t *frames, size_t max_frames);
+
+// Number of frames waiting in the ring
+size_t as7262_stream_available(void);
+
+// Read the streaming counters
+void as7262_stream_get_stats(as7262_stream_stats_t *stats);
+
+// Frame period of continuous all-channel mode for an INT_T value
+uint32_t as7262_stream_period_us(uint8_t integration_time);
+
+#endif // AS7262_STREAM_H
@@ -0,0 +1,459 @@
+#include "config_store.h"
+#include "nvs_service.h"
+#include "crc.h"
+#include "as7262_driver.h"
+#include "tds_calibration.h"
+#include "console_out.h"
+#include "sensor_scheduler.h"
+#include "esp_log.h"
+#include "dlog.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "CONFIG_STORE";
+
+#define CONFIG_STORE_RECORD_MAX (CONFIG_STORE_HEADER_SIZE + CONFIG_STORE_MAX_SIZE + CONFIG_STORE_CRC_SIZE)
+
+// One stored setting. Names stay within 13 characters, as NVS keys are 15 at most.
+typedef struct {
+    const char *name;
+    config_type_t type;
+    uint16_t version;                      // Layout version of the value
+    uint16_t size;
+    const char *legacy_key;                // Where the setting was kept before the store, or NULL
+    int32_t min;                           // CONFIG_TYPE_I32 range and default
+    int32_t max;
+    int32_t default_i32;
+    void (*defaults)(void *value);         // CONFIG_TYPE_BLOB
+    esp_err_t (*validate)(const void *value);
+    // Convert a record of an older version; without it such records fall back to the default
+    esp_err_t (*migrate)(uint16_t version, const void *old, size_t length, void *value);
+} config_entry_t;
+
+static void as7262_cal_defaults(void *value) {
+    as7262_calibration_t *cal = value;
+    for (int i = 0; i < AS7262_CHANNEL_COUNT; i++) {
+        cal->correction_factors[i] = 1.0f;
+    }
+}
+
+static esp_err_t as7262_cal_validate(const void *value) {
+    const as7262_calibration_t *cal = value;
+    for (int i = 0; i < AS7262_CHANNEL_COUNT; i++) {
+        if (!(isfinite(cal->correction_factors[i]) && cal->correction_factors[i] >= 0.0f)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    return ESP_OK;
+}
+
+static void tds_cal_defaults(void *value) {
+    tds_calibration_defaults(value);
+}
+
+static esp_err_t tds_cal_validate(const void *value) {
+    return tds_calibration_validate(value);
+}
+
+#define CONFIG_I32(name_, legacy_key_, min_, max_, default_) {              \
+    .name = (name_), .type = CONFIG_TYPE_I32, .version = 1,                  \
+    .size = sizeof(int32_t), .legacy_key = (legacy_key_),                    \
+    .min = (min_), .max = (max_), .default_i32 = (default_),                 \
+}
+
+// The schema. A setting that changes layout bumps its version and gains a migrate.
+static const config_entry_t schema[CONFIG_ID_COUNT] = {
+    [CONFIG_AS7262_CAL] = {
+        .name = "as7262_cal", .type = CONFIG_TYPE_BLOB, .version = 1,
+        .size = sizeof(as7262_calibration_t), .legacy_key = "calibration",
+        .defaults = as7262_cal_defaults, .validate = as7262_cal_validate,
+    },
+    [CONFIG_TDS_CAL] = {
+        .name = "tds_cal", .type = CONFIG_TYPE_BLOB, .version = TDS_CAL_VERSION,
+        .size = sizeof(tds_calibration_t), .legacy_key = "tds_cal",
+        .defaults = tds_cal_defaults, .validate = tds_cal_validate,
+    },
+    [CONFIG_SCHED_SCD41] = CONFIG_I32("sched_scd41", "period_scd41", SENSOR_SCHED_MIN_PERIOD_MS, SENSOR_SCHED_MAX_PERIOD_MS, SCD41_JOB_PERIOD_MS),
+    [CONFIG_SCHED_AS7262] = CONFIG_I32("sched_as7262", "period_as7262", SENSOR_SCHED_MIN_PERIOD_MS, SENSOR_SCHED_MAX_PERIOD_MS, AS7262_JOB_PERIOD_MS),
+    [CONFIG_SCHED_TDS] = CONFIG_I32("sched_tds", "period_tds", SENSOR_SCHED_MIN_PERIOD_MS, SENSOR_SCHED_MAX_PERIOD_MS, TDS_JOB_PERIOD_MS),
+    [CONFIG_SCHED_CONSOLE] = CONFIG_I32("sched_console", "period_console", SENSOR_SCHED_MIN_PERIOD_MS, SENSOR_SCHED_MAX_PERIOD_MS, CONSOLE_JOB_PERIOD_MS),
+    [CONFIG_SCHED_STATS] = CONFIG_I32("sched_stats", "period_stats", SENSOR_SCHED_MIN_PERIOD_MS, SENSOR_SCHED_MAX_PERIOD_MS, STATS_JOB_PERIOD_MS),
+    [CONFIG_CONSOLE_OUT_POLICY] = CONFIG_I32("out_policy", "out_policy", 0, CONSOLE_OUT_POLICY_COUNT - 1, CONSOLE_OUT_DROP),
+    [CONFIG_LOG_MODE] = CONFIG_I32("log_mode", "log_mode", 0, DLOG_MODE_COUNT - 1, DLOG_MODE_TEXT),
+    [CONFIG_TDS_AIR_COMP] = CONFIG_I32("tds_air_comp", NULL, 0, 1, 0),
+};
+
+_Static_assert(sizeof(as7262_calibration_t) <= CONFIG_STORE_MAX_SIZE, "AS7262 calibration too large");
+_Static_assert(sizeof(tds_calibration_t) <= CONFIG_STORE_MAX_SIZE, "TDS calibration too large");
+
+// A setting's value in RAM
+typedef struct {
+    _Atomic uint32_t seq;                  // Odd while a writer updates value
+    uint8_t value[CONFIG_STORE_MAX_SIZE];
+    config_origin_t origin;                // These two under config_lock
+    bool dirty;
+} config_slot_t;
+
+static config_slot_t slots[CONFIG_ID_COUNT];
+static SemaphoreHandle_t config_lock;      // Serialises setters and the batch writer
+static TaskHandle_t writer_task;
+static atomic_bool raw_pending = false;    // Raw NVS writes waiting for a commit
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static config_store_stats_t store_stats;
+
+static void config_key(const config_entry_t *entry, char *key, size_t size) {
+    snprintf(key, size, CONFIG_STORE_KEY_PREFIX "%s", entry->name);
+}
+
+static esp_err_t config_validate(const config_entry_t *entry, const void *value) {
+    if (entry->type == CONFIG_TYPE_I32) {
+        int32_t number;
+        memcpy(&number, value, sizeof(number));
+        return number >= entry->min && number <= entry->max ? ESP_OK : ESP_ERR_INVALID_ARG;
+    }
+    return entry->validate != NULL ? entry->validate(value) : ESP_OK;
+}
+
+static void config_default(const config_entry_t *entry, void *value) {
+    memset(value, 0, entry->size);
+    if (entry->type == CONFIG_TYPE_I32) {
+        memcpy(value, &entry->default_i32, sizeof(entry->default_i32));
+    } else {
+        entry->defaults(value);
+    }
+}
+
+// Readers retry rather than block a setter
+static void config_read_slot(config_id_t id, void *value) {
+    config_slot_t *slot = &slots[id];
+    while (true) {
+        uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq & 1) {
+            vTaskDelay(1);  // The setter may be preempted mid-update on this core
+            continue;
+        }
+        memcpy(value, slot->value, schema[id].size);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->seq, memory_order_relaxed) == seq) {
+            return;
+        }
+    }
+}
+
+// Caller holds config_lock
+static void config_write_slot(config_id_t id, const void *value) {
+    config_slot_t *slot = &slots[id];
+    uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+    atomic_store_explicit(&slot->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(slot->value, value, schema[id].size);
+    atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+}
+
+static size_t config_encode(const config_entry_t *entry, const uint8_t *value, uint8_t *record) {
+    record[0] = (uint8_t)entry->version;
+    record[1] = (uint8_t)(entry->version >> 8);
+    record[2] = (uint8_t)entry->size;
+    record[3] = (uint8_t)(entry->size >> 8);
+    memcpy(&record[CONFIG_STORE_HEADER_SIZE], value, entry->size);
+    size_t length = CONFIG_STORE_HEADER_SIZE + entry->size;
+    uint16_t crc = crc16_ccitt(record, length);
+    record[length++] = (uint8_t)crc;
+    record[length++] = (uint8_t)(crc >> 8);
+    return length;
+}
+
+// Fill value from the setting's record or its pre-store key; value holds the default
+// on entry and keeps it, with rejected set, when the record is unusable
+static config_origin_t config_load(const config_entry_t *entry, uint8_t *value, bool *rejected) {
+    char key[16];
+    config_key(entry, key, sizeof(key));
+    uint8_t record[CONFIG_STORE_RECORD_MAX];
+    size_t length = sizeof(record);
+    if (nvs_service_get_blob(key, record, &length) == ESP_OK) {
+        size_t size = length > CONFIG_STORE_HEADER_SIZE + CONFIG_STORE_CRC_SIZE ?
+                      length - CONFIG_STORE_HEADER_SIZE - CONFIG_STORE_CRC_SIZE : 0;
+        uint16_t version = (uint16_t)(record[0] | record[1] << 8);
+        if (size == 0 || (size_t)(record[2] | record[3] << 8) != size ||
+            crc16_ccitt(record, length - CONFIG_STORE_CRC_SIZE) != (uint16_t)(record[length - 2] | record[length - 1] << 8)) {
+            DLOGW(TAG, "Setting %s failed its check, using the default", entry->name);
+            *rejected = true;
+            return CONFIG_ORIGIN_DEFAULT;
+        }
+        const uint8_t *stored = &record[CONFIG_STORE_HEADER_SIZE];
+        if (version == entry->version && size == entry->size && config_validate(entry, stored) == ESP_OK) {
+            memcpy(value, stored, size);
+            return CONFIG_ORIGIN_STORED;
+        }
+        uint8_t migrated[CONFIG_STORE_MAX_SIZE];
+        memcpy(migrated, value, entry->size);
+        if (version != entry->version && entry->migrate != NULL &&
+            entry->migrate(version, stored, size, migrated) == ESP_OK && config_validate(entry, migrated) == ESP_OK) {
+            memcpy(value, migrated, entry->size);
+            return CONFIG_ORIGIN_MIGRATED;
+        }
+        DLOGW(TAG, "Setting %s has an unusable version %u record, using the default", entry->name, version);
+        *rejected = true;
+        return CONFIG_ORIGIN_DEFAULT;
+    }
+
+    // Before the store, integers were kept bare and blobs as a plain copy of the value;
+    // the old keys are left alone so older firmware still finds them
+    if (entry->legacy_key == NULL) {
+        return CONFIG_ORIGIN_DEFAULT;
+    }
+    uint8_t legacy[CONFIG_STORE_MAX_SIZE];
+    esp_err_t ret;
+    if (entry->type == CONFIG_TYPE_I32) {
+        int32_t number = 0;
+        ret = nvs_service_get_i32(entry->legacy_key, &number);
+        memcpy(legacy, &number, sizeof(number));
+    } else {
+        length = entry->size;
+        ret = nvs_service_get_blob(entry->legacy_key, legacy, &length);
+        ret = ret == ESP_OK && length != entry->size ? ESP_ERR_INVALID_SIZE : ret;
+    }
+    if (ret != ESP_OK || config_validate(entry, legacy) != ESP_OK) {
+        return CONFIG_ORIGIN_DEFAULT;
+    }
+    memcpy(value, legacy, entry->size);
+    return CONFIG_ORIGIN_MIGRATED;
+}
+
+// Task that writes changed settings once they have settled
+static void config_store_writer_task(void *arg) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        TickType_t first = xTaskGetTickCount();
+        while (xTaskGetTickCount() - first < pdMS_TO_TICKS(CONFIG_STORE_MAX_DELAY_MS) &&
+               ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_STORE_SETTLE_MS)) > 0) {
+        }
+        if (config_store_flush() != ESP_OK) {
+            // Nothing else may touch the settings again, so retry the failed batch on our own
+            vTaskDelay(pdMS_TO_TICKS(CONFIG_STORE_RETRY_MS));
+            xTaskNotifyGive(writer_task);
+        }
+    }
+}
+
+esp_err_t config_store_init(void) {
+    if (writer_task != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    config_lock = xSemaphoreCreateMutex();
+    if (config_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    uint32_t counts[CONFIG_ORIGIN_COUNT] = {0};
+    uint32_t rejected_count = 0;
+    for (int id = 0; id < CONFIG_ID_COUNT; id++) {
+        const config_entry_t *entry = &schema[id];
+        uint8_t value[CONFIG_STORE_MAX_SIZE];
+        config_default(entry, value);
+        bool rejected = false;
+        config_origin_t origin = config_load(entry, value, &rejected);
+        config_write_slot((config_id_t)id, value);
+        slots[id].origin = origin;
+        // Migrated settings are written back in the current layout with the first batch
+        slots[id].dirty = origin == CONFIG_ORIGIN_MIGRATED;
+        counts[origin]++;
+        rejected_count += rejected;
+    }
+    portENTER_CRITICAL(&stats_lock);
+    store_stats.migrated = counts[CONFIG_ORIGIN_MIGRATED];
+    store_stats.corrupt = rejected_count;
+    portEXIT_CRITICAL(&stats_lock);
+    DLOGI(TAG, "Loaded %d settings: %" PRIu32 " stored, %" PRIu32 " migrated, %" PRIu32 " default",
+          CONFIG_ID_COUNT, counts[CONFIG_ORIGIN_STORED], counts[CONFIG_ORIGIN_MIGRATED], counts[CONFIG_ORIGIN_DEFAULT]);
+
+    if (xTaskCreate(config_store_writer_task, "config_store", CONFIG_STORE_STACK_SIZE, NULL, CONFIG_STORE_PRIORITY, &writer_task) != pdPASS) {
+        writer_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    if (counts[CONFIG_ORIGIN_MIGRATED] > 0) {
+        xTaskNotifyGive(writer_task);
+    }
+    return ESP_OK;
+}
+
+esp_err_t config_get(config_id_t id, void *value, size_t size) {
+    if (id >= CONFIG_ID_COUNT || value == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (size != schema[id].size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    config_read_slot(id, value);
+    return ESP_OK;
+}
+
+int32_t config_get_i32(config_id_t id) {
+    int32_t value = 0;
+    if (id < CONFIG_ID_COUNT && schema[id].type == CONFIG_TYPE_I32) {
+        config_read_slot(id, &value);
+    }
+    return value;
+}
+
+esp_err_t config_set(config_id_t id, const void *value, size_t size) {
+    if (id >= CONFIG_ID_COUNT || value == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const config_entry_t *entry = &schema[id];
+    if (size != entry->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (config_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t ret = config_validate(entry, value);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    xSemaphoreTake(config_lock, portMAX_DELAY);
+    config_slot_t *slot = &slots[id];
+    bool changed = memcmp(slot->value, value, size) != 0;
+    bool replaced = changed && slot->dirty;
+    if (changed) {
+        config_write_slot(id, value);
+        slot->origin = CONFIG_ORIGIN_SET;
+        slot->dirty = true;
+    }
+    xSemaphoreGive(config_lock);
+
+    portENTER_CRITICAL(&stats_lock);
+    store_stats.changes += changed;
+    store_stats.unchanged += !changed;
+    store_stats.coalesced += replaced;
+    portEXIT_CRITICAL(&stats_lock);
+    if (changed) {
+        xTaskNotifyGive(writer_task);
+    }
+    return ESP_OK;
+}
+
+esp_err_t config_set_i32(config_id_t id, int32_t value) {
+    if (id >= CONFIG_ID_COUNT || schema[id].type != CONFIG_TYPE_I32) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return config_set(id, &value, sizeof(value));
+}
+
+void config_store_commit_later(void) {
+    atomic_store_explicit(&raw_pending, true, memory_order_relaxed);
+    if (writer_task != NULL) {
+        xTaskNotifyGive(writer_task);
+    }
+}
+
+esp_err_t config_store_flush(void) {
+    if (config_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(config_lock, portMAX_DELAY);
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t result = ESP_OK;
+    uint32_t writes = 0;
+    uint32_t errors = 0;
+    bool written[CONFIG_ID_COUNT] = {false};
+    for (int id = 0; id < CONFIG_ID_COUNT; id++) {
+        if (!slots[id].dirty) {
+            continue;
+        }
+        char key[16];
+        uint8_t record[CONFIG_STORE_RECORD_MAX];
+        config_key(&schema[id], key, sizeof(key));
+        size_t length = config_encode(&schema[id], slots[id].value, record);
+        // A failed write stays dirty and goes out with the next batch
+        esp_err_t ret = nvs_service_set_blob(key, record, length);
+        if (ret == ESP_OK) {
+            written[id] = true;
+            writes++;
+        } else {
+            result = ret;
+            errors++;
+        }
+    }
+    bool raw = atomic_exchange_explicit(&raw_pending, false, memory_order_relaxed);
+    bool commit = raw || writes > 0;
+    esp_err_t commit_ret = ESP_OK;
+    if (commit) {
+        commit_ret = nvs_service_commit();
+        if (commit_ret != ESP_OK) {
+            result = commit_ret;
+            errors++;
+        }
+    }
+    // Settings are only clean once the commit made them durable; otherwise the
+    // whole batch, raw writes included, goes out again with the next one
+    if (commit_ret == ESP_OK) {
+        for (int id = 0; id < CONFIG_ID_COUNT; id++) {
+            slots[id].dirty = slots[id].dirty && !written[id];
+        }
+    } else if (raw) {
+        atomic_store_explicit(&raw_pending, true, memory_order_relaxed);
+    }
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+    xSemaphoreGive(config_lock);
+
+    portENTER_CRITICAL(&stats_lock);
+    store_stats.writes += writes;
+    store_stats.commits += commit;
+    store_stats.write_errors += errors;
+    store_stats.write_us += elapsed_us;
+    portEXIT_CRITICAL(&stats_lock);
+    return result;
+}
+
+esp_err_t config_store_find(const char *name, config_id_t *id) {
+    for (int i = 0; i < CONFIG_ID_COUNT; i++) {
+        if (strcmp(schema[i].name, name) == 0) {
+            *id = (config_id_t)i;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+void config_store_get_info(config_id_t id, config_info_t *info) {
+    const config_entry_t *entry = &schema[id];
+    info->name = entry->name;
+    info->type = entry->type;
+    info->size = entry->size;
+    if (config_lock != NULL) {
+        xSemaphoreTake(config_lock, portMAX_DELAY);
+    }
+    info->origin = slots[id].origin;
+    info->dirty = slots[id].dirty;
+    if (config_lock != NULL) {
+        xSemaphoreGive(config_lock);
+    }
+}
+
+void config_store_get_stats(config_store_stats_t *stats, bool reset) {
+    portENTER_CRITICAL(&stats_lock);
+    *stats = store_stats;
+    if (reset) {
+        // What happened at boot stays
+        uint32_t migrated = store_stats.migrated;
+        uint32_t corrupt = store_stats.corrupt;
+        memset(&store_stats, 0, sizeof(store_stats));
+        store_stats.migrated = migrated;
+        store_stats.corrupt = corrupt;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+const char *config_origin_name(config_origin_t origin) {
+    static const char *names[CONFIG_ORIGIN_COUNT] = {"default", "stored", "migrated", "set"};
+    return origin < CONFIG_ORIGIN_COUNT ? names[origin] : "?";
+}
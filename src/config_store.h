@@ -0,0 +1,115 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Typed settings, loaded from NVS into RAM once at boot. Reads copy the RAM
+// value under a per-setting seqlock and never touch flash or take a lock.
+// Writes change RAM at once and mark the setting dirty; a low-priority task
+// writes dirty settings out together once changes have settled, so a burst
+// of tuning costs one NVS write per setting and one commit.
+//
+// Each setting is one NVS blob under "c_" + its name:
+//   version   LE16, layout version of the value
+//   length    LE16
+//   value     length bytes
+//   crc       LE16, CRC-16/CCITT-FALSE over everything before it
+// A record that fails its CRC or validation falls back to the default. An
+// older version, or a key written before the store existed, is migrated.
+#define CONFIG_STORE_KEY_PREFIX "c_"
+#define CONFIG_STORE_MAX_SIZE 64               // Largest value
+#define CONFIG_STORE_HEADER_SIZE 4
+#define CONFIG_STORE_CRC_SIZE 2
+#define CONFIG_STORE_SETTLE_MS 2000            // Quiet time before dirty settings are written
+#define CONFIG_STORE_MAX_DELAY_MS 10000        // Write anyway once changes have been pending this long
+#define CONFIG_STORE_RETRY_MS 5000             // Wait before writing a batch that failed again
+#define CONFIG_STORE_STACK_SIZE 3072
+#define CONFIG_STORE_PRIORITY 1                // Below every sensor and console task
+
+// Default job periods, until one is changed with the sched command. The
+// SCD41 job only polls: the driver skips the bus until a sample is due.
+#define SCD41_JOB_PERIOD_MS 1000
+#define AS7262_JOB_PERIOD_MS 1000    // Stream drain; must stay below capacity x period
+#define TDS_JOB_PERIOD_MS 5000
+#define CONSOLE_JOB_PERIOD_MS 1000  // Sample bus consumer that prints readings
+#define STATS_JOB_PERIOD_MS 1000    // Sample bus consumer that feeds the windowed statistics
+
+// The schema: every stored setting, see config_store.c
+typedef enum {
+    CONFIG_AS7262_CAL,                         // as7262_calibration_t
+    CONFIG_TDS_CAL,                            // tds_calibration_t
+    CONFIG_SCHED_SCD41,                        // Job periods in ms
+    CONFIG_SCHED_AS7262,
+    CONFIG_SCHED_TDS,
+    CONFIG_SCHED_CONSOLE,
+    CONFIG_SCHED_STATS,
+    CONFIG_CONSOLE_OUT_POLICY,                 // console_out_policy_t
+    CONFIG_LOG_MODE,                           // dlog_mode_t
+    CONFIG_TDS_AIR_COMP,                       // 1 to compensate TDS with the SCD41 air temperature
+    CONFIG_ID_COUNT,
+} config_id_t;
+
+typedef enum {
+    CONFIG_TYPE_I32,
+    CONFIG_TYPE_BLOB,
+} config_type_t;
+
+// Where a setting's value came from
+typedef enum {
+    CONFIG_ORIGIN_DEFAULT,                     // Nothing stored, or the record was unusable
+    CONFIG_ORIGIN_STORED,
+    CONFIG_ORIGIN_MIGRATED,                    // From an older version or a pre-store key
+    CONFIG_ORIGIN_SET,                         // Changed since boot
+    CONFIG_ORIGIN_COUNT,
+} config_origin_t;
+
+typedef struct {
+    const char *name;
+    config_type_t type;
+    size_t size;
+    config_origin_t origin;
+    bool dirty;                                // Changed in RAM, not yet written
+} config_info_t;
+
+typedef struct {
+    uint32_t changes;                          // Sets that changed a value
+    uint32_t unchanged;                        // Sets that matched the value in RAM
+    uint32_t coalesced;                        // Changes replaced before they were written
+    uint32_t writes;                           // Records written to NVS
+    uint32_t commits;
+    uint32_t write_errors;
+    uint32_t migrated;                         // Settings converted at boot
+    uint32_t corrupt;                          // Records rejected at boot
+    int64_t write_us;                          // Time spent writing and committing
+} config_store_stats_t;
+
+// Load every setting and start the writer; call right after nvs_service_init
+esp_err_t config_store_init(void);
+
+// Copy a setting; size must be the setting's size
+esp_err_t config_get(config_id_t id, void *value, size_t size);
+int32_t config_get_i32(config_id_t id);
+
+// Validate and change a setting; it reaches flash with the next batch
+esp_err_t config_set(config_id_t id, const void *value, size_t size);
+esp_err_t config_set_i32(config_id_t id, int32_t value);
+
+// Have raw NVS writes made outside the store committed with the next batch
+void config_store_commit_later(void);
+
+// Write dirty settings and commit now, e.g. before a restart
+esp_err_t config_store_flush(void);
+
+// Look a setting up by name
+esp_err_t config_store_find(const char *name, config_id_t *id);
+
+void config_store_get_info(config_id_t id, config_info_t *info);
+void config_store_get_stats(config_store_stats_t *stats, bool reset);
+
+// "default", "stored", "migrated" or "set"
+const char *config_origin_name(config_origin_t origin);
+
+#endif // CONFIG_STORE_H
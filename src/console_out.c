@@ -0,0 +1,321 @@
+#include "console_out.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CONSOLE_OUT_MASK (CONSOLE_OUT_BUFFER_SIZE - 1)
+#define CONSOLE_OUT_WRITE_CHUNK 128            // Per transport write, so room frees up as the bytes go out
+
+_Static_assert((CONSOLE_OUT_BUFFER_SIZE & CONSOLE_OUT_MASK) == 0, "the ring size must be a power of two");
+_Static_assert((CONSOLE_OUT_RECORD_SLOTS & (CONSOLE_OUT_RECORD_SLOTS - 1)) == 0, "the record slot count must be a power of two");
+
+// A message waiting to be formatted by the drain task
+typedef struct {
+    uint32_t position;                         // Ring head when queued; the text before it goes out first
+    console_out_format_fn_t format;
+    _Alignas(8) uint8_t record[CONSOLE_OUT_RECORD_MAX];
+} console_out_deferred_t;
+
+// Producers serialise only on the copy into the ring, never on the transport.
+// head and tail are running byte counts: the drain task reads from tail to
+// head without the lock and moves tail on once the bytes are written.
+static uint8_t buffer[CONSOLE_OUT_BUFFER_SIZE];
+static _Atomic uint32_t head = 0;
+static _Atomic uint32_t tail = 0;
+static portMUX_TYPE out_lock = portMUX_INITIALIZER_UNLOCKED;
+static console_out_stats_t out_stats;
+static console_out_write_fn_t out_write = NULL;
+static void *out_ctx = NULL;
+static TaskHandle_t drain_task = NULL;
+
+// Deferred messages, a second ring under out_lock with running counts like head and tail
+static console_out_deferred_t deferred[CONSOLE_OUT_RECORD_SLOTS];
+static _Atomic uint32_t deferred_head = 0;
+static _Atomic uint32_t deferred_tail = 0;
+
+// Copy a message into the ring if all of it fits, \n as \r\n when crlf; caller holds out_lock
+static bool console_out_put_locked(const uint8_t *data, size_t length, size_t needed, bool crlf) {
+    uint32_t position = atomic_load_explicit(&head, memory_order_relaxed);
+    uint32_t waiting = position - atomic_load_explicit(&tail, memory_order_acquire);
+    if (needed > CONSOLE_OUT_BUFFER_SIZE - waiting) {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++) {
+        if (crlf && data[i] == '\n') {
+            buffer[position++ & CONSOLE_OUT_MASK] = '\r';
+        }
+        buffer[position++ & CONSOLE_OUT_MASK] = data[i];
+    }
+    atomic_store_explicit(&head, position, memory_order_release);
+    waiting += (uint32_t)needed;
+    out_stats.messages++;
+    out_stats.bytes += needed;
+    out_stats.high_water = waiting > out_stats.high_water ? waiting : out_stats.high_water;
+    return true;
+}
+
+// Take a slot for a deferred record if one is free; caller holds out_lock
+static bool console_out_defer_locked(console_out_format_fn_t format, const uint8_t *record, size_t size) {
+    uint32_t slot = atomic_load_explicit(&deferred_head, memory_order_relaxed);
+    if (slot - atomic_load_explicit(&deferred_tail, memory_order_acquire) >= CONSOLE_OUT_RECORD_SLOTS) {
+        return false;
+    }
+    console_out_deferred_t *entry = &deferred[slot & (CONSOLE_OUT_RECORD_SLOTS - 1)];
+    entry->position = atomic_load_explicit(&head, memory_order_relaxed);
+    entry->format = format;
+    memcpy(entry->record, record, size);
+    atomic_store_explicit(&deferred_head, slot + 1, memory_order_release);
+    out_stats.messages++;
+    return true;
+}
+
+// Queue a message, or with format a deferred record, under the overflow policy
+static bool console_out_queue(const uint8_t *data, size_t length, bool crlf, console_out_format_fn_t format) {
+    size_t needed = length;
+    for (size_t i = 0; crlf && i < length; i++) {
+        needed += data[i] == '\n';
+    }
+    // The drain task would wait on itself
+    bool may_block = xTaskGetCurrentTaskHandle() != drain_task && needed <= CONSOLE_OUT_BUFFER_SIZE;
+    int64_t start_us = 0;
+    TickType_t waited = 0;
+    while (true) {
+        portENTER_CRITICAL(&out_lock);
+        bool queued = format != NULL ? console_out_defer_locked(format, data, length) : console_out_put_locked(data, length, needed, crlf);
+        bool wait = !queued && may_block && out_stats.policy == CONSOLE_OUT_BLOCK && waited < pdMS_TO_TICKS(CONSOLE_OUT_BLOCK_TIMEOUT_MS);
+        if (!queued && !wait) {
+            out_stats.dropped++;
+            out_stats.dropped_bytes += needed;
+        }
+        portEXIT_CRITICAL(&out_lock);
+        if (queued || !wait) {
+            if (waited > 0) {
+                int64_t blocked_us = esp_timer_get_time() - start_us;
+                portENTER_CRITICAL(&out_lock);
+                out_stats.blocked++;
+                out_stats.blocked_us += blocked_us;
+                portEXIT_CRITICAL(&out_lock);
+            }
+            if (queued) {
+                xTaskNotifyGive(drain_task);
+            }
+            return queued;
+        }
+        if (waited == 0) {
+            start_us = esp_timer_get_time();
+        }
+        vTaskDelay(1);
+        waited++;
+    }
+}
+
+// Format a deferred record into line, cut like console_out_vprintf cuts text
+static size_t console_out_format(const console_out_deferred_t *entry, char *line, bool *truncated) {
+    int length = entry->format(line, CONSOLE_OUT_LINE_MAX, entry->record);
+    *truncated = false;
+    if (length < 0) {
+        return 0;
+    }
+    if ((size_t)length >= CONSOLE_OUT_LINE_MAX) {
+        line[CONSOLE_OUT_LINE_MAX - 2] = '\n';
+        *truncated = true;
+        return CONSOLE_OUT_LINE_MAX - 1;
+    }
+    return (size_t)length;
+}
+
+// Format a deferred record on the drain task and write it out with \n as \r\n
+static void console_out_write_deferred(const console_out_deferred_t *entry, char *line) {
+    bool truncated;
+    size_t used = console_out_format(entry, line, &truncated);
+    int64_t start_us = esp_timer_get_time();
+    size_t written = 0;
+    size_t start = 0;
+    for (size_t i = 0; i <= used; i++) {
+        if (i < used && line[i] != '\n') {
+            continue;
+        }
+        if (i > start) {
+            out_write((const uint8_t *)&line[start], i - start, out_ctx);
+            written += i - start;
+        }
+        if (i < used) {
+            out_write((const uint8_t *)"\r\n", 2, out_ctx);
+            written += 2;
+        }
+        start = i + 1;
+    }
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+    portENTER_CRITICAL(&out_lock);
+    out_stats.deferred++;
+    out_stats.truncated += truncated;
+    out_stats.bytes += written;
+    out_stats.written += written;
+    out_stats.write_us += elapsed_us;
+    portEXIT_CRITICAL(&out_lock);
+}
+
+// Task that writes the ring out, a chunk at a time, formatting deferred
+// records as the text ahead of them is written
+static void console_out_drain_task(void *arg) {
+    char line[CONSOLE_OUT_LINE_MAX];
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        uint32_t position = atomic_load_explicit(&tail, memory_order_relaxed);
+        while (true) {
+            uint32_t end = atomic_load_explicit(&head, memory_order_acquire);
+            uint32_t slot = atomic_load_explicit(&deferred_tail, memory_order_relaxed);
+            if (slot != atomic_load_explicit(&deferred_head, memory_order_acquire)) {
+                const console_out_deferred_t *entry = &deferred[slot & (CONSOLE_OUT_RECORD_SLOTS - 1)];
+                if (entry->position == position) {
+                    console_out_write_deferred(entry, line);
+                    atomic_store_explicit(&deferred_tail, slot + 1, memory_order_release);
+                    continue;
+                }
+                end = entry->position;
+            }
+            if (end == position) {
+                break;
+            }
+            uint32_t offset = position & CONSOLE_OUT_MASK;
+            uint32_t length = end - position;
+            length = length < CONSOLE_OUT_BUFFER_SIZE - offset ? length : CONSOLE_OUT_BUFFER_SIZE - offset;
+            length = length < CONSOLE_OUT_WRITE_CHUNK ? length : CONSOLE_OUT_WRITE_CHUNK;
+            int64_t start_us = esp_timer_get_time();
+            out_write(&buffer[offset], length, out_ctx);
+            int64_t elapsed_us = esp_timer_get_time() - start_us;
+            position += length;
+            atomic_store_explicit(&tail, position, memory_order_release);
+            portENTER_CRITICAL(&out_lock);
+            out_stats.written += length;
+            out_stats.write_us += elapsed_us;
+            portEXIT_CRITICAL(&out_lock);
+        }
+    }
+}
+
+esp_err_t console_out_start(console_out_write_fn_t write, void *ctx, console_out_policy_t policy) {
+    if (write == NULL || policy >= CONSOLE_OUT_POLICY_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (drain_task != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    out_write = write;
+    out_ctx = ctx;
+    memset(&out_stats, 0, sizeof(out_stats));
+    out_stats.policy = policy;
+    if (xTaskCreate(console_out_drain_task, "console_out", CONSOLE_OUT_STACK_SIZE, NULL, CONSOLE_OUT_PRIORITY, &drain_task) != pdPASS) {
+        drain_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    out_stats.started = true;
+    return ESP_OK;
+}
+
+void console_out_set_policy(console_out_policy_t policy) {
+    if (policy >= CONSOLE_OUT_POLICY_COUNT) {
+        return;
+    }
+    portENTER_CRITICAL(&out_lock);
+    out_stats.policy = policy;
+    portEXIT_CRITICAL(&out_lock);
+}
+
+bool console_out_write(const void *data, size_t length) {
+    if (drain_task == NULL) {
+        portENTER_CRITICAL(&out_lock);
+        out_stats.dropped++;
+        out_stats.dropped_bytes += length;
+        portEXIT_CRITICAL(&out_lock);
+        return false;
+    }
+    return console_out_queue(data, length, false, NULL);
+}
+
+bool console_out_defer(console_out_format_fn_t format, const void *record, size_t size) {
+    if (format == NULL || size > CONSOLE_OUT_RECORD_MAX) {
+        return false;
+    }
+    // Before the drain task runs, the caller formats as it always did
+    if (drain_task == NULL) {
+        console_out_deferred_t entry = {.format = format};
+        char line[CONSOLE_OUT_LINE_MAX];
+        bool truncated;
+        memcpy(entry.record, record, size);
+        fwrite(line, 1, console_out_format(&entry, line, &truncated), stdout);
+        return true;
+    }
+    return console_out_queue(record, size, false, format);
+}
+
+int console_out_vprintf(const char *format, va_list args) {
+    char line[CONSOLE_OUT_LINE_MAX];
+    int length = vsnprintf(line, sizeof(line), format, args);
+    if (length < 0) {
+        return length;
+    }
+    size_t used = (size_t)length;
+    if (used >= sizeof(line)) {
+        // Keep the line break so the next message starts on its own line
+        used = sizeof(line) - 1;
+        line[used - 1] = '\n';
+        portENTER_CRITICAL(&out_lock);
+        out_stats.truncated++;
+        portEXIT_CRITICAL(&out_lock);
+    }
+    // Before the drain task runs, output is synchronous as it always was
+    if (drain_task == NULL) {
+        fwrite(line, 1, used, stdout);
+        return length;
+    }
+    console_out_queue((const uint8_t *)line, used, true, NULL);
+    return length;
+}
+
+int console_out_printf(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int length = console_out_vprintf(format, args);
+    va_end(args);
+    return length;
+}
+
+esp_err_t console_out_flush(uint32_t timeout_ms) {
+    if (drain_task == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    uint32_t target = atomic_load_explicit(&head, memory_order_acquire);
+    uint32_t deferred_target = atomic_load_explicit(&deferred_head, memory_order_acquire);
+    TickType_t waited = 0;
+    while ((int32_t)(atomic_load_explicit(&tail, memory_order_acquire) - target) < 0 ||
+           (int32_t)(atomic_load_explicit(&deferred_tail, memory_order_acquire) - deferred_target) < 0) {
+        if (waited >= pdMS_TO_TICKS(timeout_ms)) {
+            return ESP_ERR_TIMEOUT;
+        }
+        vTaskDelay(1);
+        waited++;
+    }
+    return ESP_OK;
+}
+
+void console_out_get_stats(console_out_stats_t *stats, bool reset) {
+    portENTER_CRITICAL(&out_lock);
+    *stats = out_stats;
+    if (reset) {
+        console_out_policy_t policy = out_stats.policy;
+        bool started = out_stats.started;
+        memset(&out_stats, 0, sizeof(out_stats));
+        out_stats.policy = policy;
+        out_stats.started = started;
+    }
+    portEXIT_CRITICAL(&out_lock);
+}
+
+const char *console_out_policy_name(console_out_policy_t policy) {
+    static const char *names[CONSOLE_OUT_POLICY_COUNT] = {"drop", "block"};
+    return policy < CONSOLE_OUT_POLICY_COUNT ? names[policy] : "?";
+}
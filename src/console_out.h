@@ -0,0 +1,80 @@
+#ifndef CONSOLE_OUT_H
+#define CONSOLE_OUT_H
+
+#include "esp_err.h"
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Asynchronous console output. Producers copy whole messages into one byte
+// ring and return at once; a low-priority drain task writes the ring to the
+// UART at whatever rate the line allows, so a job that prints or logs never
+// waits on the wire. When the ring is full the message is dropped or, with
+// the block policy, the producer waits for room. A deferred message is a raw
+// record plus a format function: the producer only copies the record, and the
+// drain task formats it when its turn comes, in order with the text around it.
+#define CONSOLE_OUT_BUFFER_SIZE 4096           // Power of two; about 0.35 s of output at 115200 baud
+#define CONSOLE_OUT_LINE_MAX 256               // Formatted messages are cut at this length
+#define CONSOLE_OUT_BLOCK_TIMEOUT_MS 1000      // Longest a blocking producer waits before dropping anyway
+#define CONSOLE_OUT_RECORD_MAX 64              // Largest record a deferred message carries
+#define CONSOLE_OUT_RECORD_SLOTS 8             // Power of two; deferred messages waiting at once
+#define CONSOLE_OUT_STACK_SIZE 3584            // Room for the line buffer and float formatting of deferred messages
+#define CONSOLE_OUT_PRIORITY 1                 // Below every sensor and console task
+
+typedef enum {
+    CONSOLE_OUT_DROP,                          // Full ring: drop the message and count it
+    CONSOLE_OUT_BLOCK,                         // Full ring: wait for the drain task to make room
+    CONSOLE_OUT_POLICY_COUNT,
+} console_out_policy_t;
+
+// Writes drained bytes to the transport; may block
+typedef void (*console_out_write_fn_t)(const uint8_t *data, size_t length, void *ctx);
+
+// Formats a deferred record into line, snprintf style; runs on the drain task
+typedef int (*console_out_format_fn_t)(char *line, size_t size, const void *record);
+
+typedef struct {
+    bool started;
+    console_out_policy_t policy;
+    uint32_t messages;                         // Accepted into the ring
+    uint64_t bytes;
+    uint32_t dropped;                          // Messages lost to a full ring
+    uint64_t dropped_bytes;
+    uint32_t truncated;                        // Formatted messages cut at CONSOLE_OUT_LINE_MAX
+    uint32_t deferred;                         // Records formatted by the drain task
+    uint32_t blocked;                          // Messages that waited for room
+    int64_t blocked_us;
+    uint32_t high_water;                       // Most bytes waiting at once
+    uint64_t written;                          // Bytes handed to the transport
+    int64_t write_us;                          // Drain task time spent writing
+} console_out_stats_t;
+
+// Start the drain task; output before this goes straight to stdout
+esp_err_t console_out_start(console_out_write_fn_t write, void *ctx, console_out_policy_t policy);
+
+void console_out_set_policy(console_out_policy_t policy);
+
+// Queue bytes as they are, e.g. a binary frame; all of them or none
+bool console_out_write(const void *data, size_t length);
+
+// Format a message and queue it with \n sent as \r\n, like the console's stdout
+int console_out_printf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+// Queue a copy of record (at most CONSOLE_OUT_RECORD_MAX bytes) to be turned
+// into text by format on the drain task, with \n sent as \r\n
+bool console_out_defer(console_out_format_fn_t format, const void *record, size_t size);
+
+// vprintf-compatible, for esp_log_set_vprintf
+int console_out_vprintf(const char *format, va_list args);
+
+// Wait up to timeout_ms for everything queued so far to be written
+esp_err_t console_out_flush(uint32_t timeout_ms);
+
+// Read and optionally clear the counters
+void console_out_get_stats(console_out_stats_t *stats, bool reset);
+
+// "drop" or "block"
+const char *console_out_policy_name(console_out_policy_t policy);
+
+#endif // CONSOLE_OUT_H
@@ -1,11 +1,33 @@
 #ifndef CRC_H
 #define CRC_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #define CRC8_POLYNOMIAL 0x31
 #define CRC8_INIT 0xFF
 
+// CRC-8 implementations; pick one for calculate_crc with -DCRC8_IMPLEMENTATION=...
+#define CRC8_IMPL_BITWISE 0   // Bit-serial loop, no table
+#define CRC8_IMPL_NIBBLE 1    // 16-byte table, two lookups per byte
+#define CRC8_IMPL_TABLE 2     // 256-byte table, one lookup per byte
+
+#ifndef CRC8_IMPLEMENTATION
+#define CRC8_IMPLEMENTATION CRC8_IMPL_TABLE
+#endif
+
 uint8_t calculate_crc(const uint8_t *data, uint16_t count);
 
-#endif // CRC_H
\ No newline at end of file
+// The individual implementations, all bit-for-bit identical; unused ones are
+// dropped by the linker
+uint8_t crc8_bitwise(const uint8_t *data, uint16_t count);
+uint8_t crc8_nibble(const uint8_t *data, uint16_t count);
+uint8_t crc8_table(const uint8_t *data, uint16_t count);
+
+// CRC-16/CCITT-FALSE, for framing data sent off the node
+#define CRC16_POLYNOMIAL 0x1021
+#define CRC16_INIT 0xFFFF
+
+uint16_t crc16_ccitt(const uint8_t *data, size_t count);
+
+#endif // CRC_H
@@ -0,0 +1,148 @@
+#include "dlog.h"
+#include "console_out.h"
+#include "crc.h"
+#include "telemetry.h"
+#include "freertos/FreeRTOS.h"
+#include <stdatomic.h>
+#include <string.h>
+
+_Static_assert(DLOG_MAX_PAYLOAD <= 254, "a frame must fit one COBS block");
+
+static _Atomic bool deferred = false;
+static portMUX_TYPE dlog_lock = portMUX_INITIALIZER_UNLOCKED;
+static dlog_stats_t dlog_stats;
+
+static size_t dlog_put_varint(uint8_t *out, uint64_t value) {
+    size_t length = 0;
+    while (value >= 0x80) {
+        out[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (uint8_t)value;
+    return length;
+}
+
+static void dlog_put_le(uint8_t *out, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+uint16_t dlog_file_hash(const char *path) {
+    const char *name = path;
+    for (const char *p = path; *p != '\0'; p++) {
+        if (*p == '/' || *p == '\\') {
+            name = p + 1;
+        }
+    }
+    // FNV-1a, folded to 16 bits
+    uint32_t hash = 2166136261u;
+    for (; *name != '\0'; name++) {
+        hash = (hash ^ (uint8_t)*name) * 16777619u;
+    }
+    return (uint16_t)((hash >> 16) ^ hash);
+}
+
+// Append one argument if it fits; false once the frame is full
+static bool dlog_put_arg(uint8_t *payload, size_t *length, const dlog_arg_t *arg) {
+    uint8_t encoded[1 + DLOG_STRING_MAX];
+    size_t size = 0;
+    switch (arg->type) {
+    case DLOG_ARG_INT:
+        // Zigzag, so small negative numbers stay short too
+        size = dlog_put_varint(encoded, ((uint64_t)arg->value.i << 1) ^ (uint64_t)(arg->value.i >> 63));
+        break;
+    case DLOG_ARG_DOUBLE: {
+        uint64_t bits;
+        memcpy(&bits, &arg->value.d, sizeof(bits));
+        dlog_put_le(encoded, bits, sizeof(bits));
+        size = sizeof(bits);
+        break;
+    }
+    case DLOG_ARG_STRING: {
+        const char *s = arg->value.s != NULL ? arg->value.s : "(null)";
+        size_t n = 0;
+        while (n < DLOG_STRING_MAX && s[n] != '\0') {
+            n++;
+        }
+        encoded[0] = (uint8_t)n;
+        memcpy(&encoded[1], s, n);
+        size = 1 + n;
+        break;
+    }
+    default:
+        return false;
+    }
+    if (*length + size + DLOG_CRC_SIZE > DLOG_MAX_PAYLOAD) {
+        return false;
+    }
+    memcpy(&payload[*length], encoded, size);
+    *length += size;
+    return true;
+}
+
+void dlog_write(dlog_site_t *site, esp_log_level_t level, const dlog_arg_t *args) {
+    // Every caller works out the same value, so a race on the first record is harmless
+    if (site->id == 0) {
+        site->id = DLOG_SITE_ID(dlog_file_hash(site->file), site->line);
+    }
+
+    uint8_t payload[DLOG_MAX_PAYLOAD];
+    uint8_t type = DLOG_FRAME_TYPE | (uint8_t)level;
+    dlog_put_le(&payload[1], site->id, 4);
+    dlog_put_le(&payload[5], esp_log_timestamp(), 4);
+    size_t length = DLOG_HEADER_SIZE;
+    for (; args->type != DLOG_ARG_END; args++) {
+        if (!dlog_put_arg(payload, &length, args)) {
+            type |= DLOG_FRAME_TRUNCATED;
+            break;
+        }
+    }
+    payload[0] = type;
+    uint16_t crc = crc16_ccitt(payload, length);
+    payload[length++] = (uint8_t)crc;
+    payload[length++] = (uint8_t)(crc >> 8);
+
+    // Delimiters either side, so a frame also ends any text before it
+    uint8_t wire[DLOG_MAX_PAYLOAD + 3];
+    wire[0] = 0;
+    size_t size = 1 + telemetry_cobs_encode(payload, length, wire + 1);
+    wire[size++] = 0;
+    bool queued = console_out_write(wire, size);
+
+    portENTER_CRITICAL(&dlog_lock);
+    if (queued) {
+        dlog_stats.records++;
+        dlog_stats.bytes += size;
+    } else {
+        dlog_stats.dropped++;
+    }
+    dlog_stats.truncated += (type & DLOG_FRAME_TRUNCATED) != 0;
+    portEXIT_CRITICAL(&dlog_lock);
+}
+
+void dlog_set_mode(dlog_mode_t mode) {
+    if (mode >= DLOG_MODE_COUNT) {
+        return;
+    }
+    atomic_store_explicit(&deferred, mode == DLOG_MODE_DEFERRED, memory_order_relaxed);
+}
+
+bool dlog_deferred(void) {
+    return atomic_load_explicit(&deferred, memory_order_relaxed);
+}
+
+void dlog_get_stats(dlog_stats_t *stats, bool reset) {
+    portENTER_CRITICAL(&dlog_lock);
+    *stats = dlog_stats;
+    if (reset) {
+        memset(&dlog_stats, 0, sizeof(dlog_stats));
+    }
+    portEXIT_CRITICAL(&dlog_lock);
+    stats->mode = dlog_deferred() ? DLOG_MODE_DEFERRED : DLOG_MODE_TEXT;
+}
+
+const char *dlog_mode_name(dlog_mode_t mode) {
+    static const char *names[DLOG_MODE_COUNT] = {"text", "deferred"};
+    return mode < DLOG_MODE_COUNT ? names[mode] : "?";
+}
@@ -0,0 +1,143 @@
+#ifndef DLOG_H
+#define DLOG_H
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Deferred logging. In deferred mode a DLOGx call site queues a COBS frame
+// carrying the site's ID and its raw arguments on the console output ring
+// instead of formatting text; host/telemetry_decode expands the frames with
+// the format strings host/dlog_extract pulls out of the sources at build
+// time. In text mode, the default, the same call is an ordinary ESP_LOGx.
+//
+// Frame payload:
+//   type      DLOG_FRAME_TYPE | level, DLOG_FRAME_TRUNCATED if arguments were cut
+//   site      LE32, DLOG_SITE_ID(file, line)
+//   time      LE32, ms since boot as esp_log_timestamp()
+//   arguments integers as zigzag varints, doubles as LE64, strings as a length byte and the bytes
+//   crc       LE16, CRC-16/CCITT-FALSE over everything before it
+#define DLOG_FRAME_TYPE 0xF0                   // High nibble; telemetry frames use their version there
+#define DLOG_FRAME_TRUNCATED 0x08
+#define DLOG_HEADER_SIZE 9
+#define DLOG_CRC_SIZE 2
+#define DLOG_MAX_PAYLOAD 96                    // One COBS block, kept small as it sits on the caller's stack
+#define DLOG_STRING_MAX 32                     // Longer string arguments are cut
+#define DLOG_MAX_ARGS 8                        // Most arguments a DLOGx call can take
+
+// A site is named by a 16-bit hash of its file's base name and its line:
+// (fnv1a(basename) folded to 16 bits) << 16 | line
+#define DLOG_SITE_ID(file_hash, line) (((uint32_t)(file_hash) << 16) | ((uint32_t)(line) & 0xFFFF))
+
+typedef enum {
+    DLOG_MODE_TEXT,
+    DLOG_MODE_DEFERRED,
+    DLOG_MODE_COUNT,
+} dlog_mode_t;
+
+typedef enum {
+    DLOG_ARG_END,
+    DLOG_ARG_INT,
+    DLOG_ARG_DOUBLE,
+    DLOG_ARG_STRING,
+} dlog_arg_type_t;
+
+typedef struct {
+    dlog_arg_type_t type;
+    union {
+        int64_t i;
+        double d;
+        const char *s;
+    } value;
+} dlog_arg_t;
+
+// One per call site; the ID is worked out on the site's first deferred record
+typedef struct {
+    const char *file;
+    uint16_t line;
+    uint32_t id;
+} dlog_site_t;
+
+typedef struct {
+    dlog_mode_t mode;
+    uint32_t records;                          // Frames accepted by the output ring
+    uint64_t bytes;
+    uint32_t dropped;                          // Frames lost to a full ring
+    uint32_t truncated;                        // Frames with arguments cut to fit
+} dlog_stats_t;
+
+static inline dlog_arg_t dlog_arg_int(int64_t value) {
+    return (dlog_arg_t){.type = DLOG_ARG_INT, .value.i = value};
+}
+
+static inline dlog_arg_t dlog_arg_double(double value) {
+    return (dlog_arg_t){.type = DLOG_ARG_DOUBLE, .value.d = value};
+}
+
+static inline dlog_arg_t dlog_arg_string(const char *value) {
+    return (dlog_arg_t){.type = DLOG_ARG_STRING, .value.s = value};
+}
+
+static inline dlog_arg_t dlog_arg_pointer(const void *value) {
+    return (dlog_arg_t){.type = DLOG_ARG_INT, .value.i = (int64_t)(uintptr_t)value};
+}
+
+// Capture an argument by its C type; the format string is only needed on the host
+#define DLOG_ARG(x) _Generic((x),                                            \
+    float: dlog_arg_double, double: dlog_arg_double,                         \
+    char *: dlog_arg_string, const char *: dlog_arg_string,                  \
+    void *: dlog_arg_pointer, const void *: dlog_arg_pointer,                \
+    default: dlog_arg_int)(x)
+
+// The format rides along as the first of __VA_ARGS__, so a call without
+// arguments needs no comma elision
+#define DLOG_COUNT(...) DLOG_COUNT_(__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0, _)
+#define DLOG_COUNT_(f, a1, a2, a3, a4, a5, a6, a7, a8, n, ...) n
+#define DLOG_CAT(a, b) DLOG_CAT_(a, b)
+#define DLOG_CAT_(a, b) a##b
+#define DLOG_ARGS(...) DLOG_CAT(DLOG_ARGS_, DLOG_COUNT(__VA_ARGS__))(__VA_ARGS__)
+#define DLOG_ARGS_0(f)
+#define DLOG_ARGS_1(f, a) DLOG_ARG(a),
+#define DLOG_ARGS_2(f, a, ...) DLOG_ARG(a), DLOG_ARGS_1(f, __VA_ARGS__)
+#define DLOG_ARGS_3(f, a, ...) DLOG_ARG(a), DLOG_ARGS_2(f, __VA_ARGS__)
+#define DLOG_ARGS_4(f, a, ...) DLOG_ARG(a), DLOG_ARGS_3(f, __VA_ARGS__)
+#define DLOG_ARGS_5(f, a, ...) DLOG_ARG(a), DLOG_ARGS_4(f, __VA_ARGS__)
+#define DLOG_ARGS_6(f, a, ...) DLOG_ARG(a), DLOG_ARGS_5(f, __VA_ARGS__)
+#define DLOG_ARGS_7(f, a, ...) DLOG_ARG(a), DLOG_ARGS_6(f, __VA_ARGS__)
+#define DLOG_ARGS_8(f, a, ...) DLOG_ARG(a), DLOG_ARGS_7(f, __VA_ARGS__)
+
+// The text branch keeps the compiler's format checking on every site
+#define DLOG_AT(level, text_log, tag, ...) do {                              \
+    if (dlog_deferred()) {                                                   \
+        static dlog_site_t dlog_site_ = {__FILE__, __LINE__, 0};             \
+        if (esp_log_level_get(tag) >= (level)) {                             \
+            const dlog_arg_t dlog_args_[] = {DLOG_ARGS(__VA_ARGS__) {DLOG_ARG_END, {0}}}; \
+            dlog_write(&dlog_site_, (level), dlog_args_);                    \
+        }                                                                    \
+    } else {                                                                 \
+        text_log(tag, __VA_ARGS__);                                          \
+    }                                                                        \
+} while (0)
+
+#define DLOGE(tag, ...) DLOG_AT(ESP_LOG_ERROR, ESP_LOGE, tag, __VA_ARGS__)
+#define DLOGW(tag, ...) DLOG_AT(ESP_LOG_WARN, ESP_LOGW, tag, __VA_ARGS__)
+#define DLOGI(tag, ...) DLOG_AT(ESP_LOG_INFO, ESP_LOGI, tag, __VA_ARGS__)
+#define DLOGD(tag, ...) DLOG_AT(ESP_LOG_DEBUG, ESP_LOGD, tag, __VA_ARGS__)
+
+void dlog_set_mode(dlog_mode_t mode);
+bool dlog_deferred(void);
+
+// Queue one record for a site; args ends with a DLOG_ARG_END entry
+void dlog_write(dlog_site_t *site, esp_log_level_t level, const dlog_arg_t *args);
+
+// The 16-bit hash of a file's base name that leads its sites' IDs
+uint16_t dlog_file_hash(const char *path);
+
+void dlog_get_stats(dlog_stats_t *stats, bool reset);
+
+// "text" or "deferred"
+const char *dlog_mode_name(dlog_mode_t mode);
+
+#endif // DLOG_H
@@ -1,11 +1,365 @@
 #include "i2c_service.h"
 #include "esp_log.h"
+#include "dlog.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include <string.h>
 
 #define I2C_MASTER_SDA_IO 21      // GPIO number for I2C Master data
 #define I2C_MASTER_SCL_IO 22      // GPIO number for I2C Master clock
 #define I2C_MASTER_FREQ_HZ 100000 // I2C Master clock frequency
 #define I2C_PORT_NUM I2C_NUM_0    // I2C port number for master dev
 
+#define I2C_ARBITER_QUEUE_LEN 16      // Pending batches before submitters block
+#define I2C_ARBITER_STACK_SIZE 3072
+#define I2C_ARBITER_PRIORITY 6        // Above the sensor tasks so the bus drains promptly
+#define I2C_MAX_DEVICES 8
+
+// Default policy: a transaction normally completes in well under 10 ms at 100 kHz
+#define I2C_DEFAULT_TIMEOUT_MS 20
+#define I2C_DEFAULT_BUDGET_MS 250
+#define I2C_DEFAULT_MAX_ATTEMPTS 3
+#define I2C_DEFAULT_BACKOFF_MS 5
+#define I2C_DEFAULT_MAX_BACKOFF_MS 40
+
+static const char *TAG = "I2C_SERVICE";
+
+// Registered device and its policy
+typedef struct {
+    i2c_master_dev_handle_t dev_handle;
+    uint16_t address;
+    i2c_device_policy_t policy;
+    i2c_device_stats_t stats;
+} i2c_device_entry_t;
+
+// Request handed to the arbiter task through the queue
+typedef struct {
+    i2c_master_dev_handle_t dev_handle;  // NULL asks the arbiter to exit
+    const i2c_op_t *ops;
+    size_t op_count;
+    i2c_done_cb_t done_cb;
+    void *ctx;
+    i2c_batch_info_t *info;              // Optional, filled in before done_cb runs
+    int64_t submit_us;
+    bool recover;                        // Run bus recovery instead of ops; no device is charged
+} i2c_job_t;
+
+// Context used to turn an asynchronous batch into a blocking call
+typedef struct {
+    SemaphoreHandle_t done;
+    esp_err_t result;
+} i2c_sync_ctx_t;
+
+static const i2c_device_policy_t default_policy = {
+    .timeout_ms = I2C_DEFAULT_TIMEOUT_MS,
+    .budget_ms = I2C_DEFAULT_BUDGET_MS,
+    .max_attempts = I2C_DEFAULT_MAX_ATTEMPTS,
+    .backoff_ms = I2C_DEFAULT_BACKOFF_MS,
+    .max_backoff_ms = I2C_DEFAULT_MAX_BACKOFF_MS,
+    .recover_on_timeout = true,
+};
+
+static i2c_master_bus_handle_t arbiter_bus = NULL;
+static i2c_device_entry_t devices[I2C_MAX_DEVICES];
+static size_t device_count = 0;
+static QueueHandle_t arbiter_queue = NULL;
+static TaskHandle_t arbiter_task_handle = NULL;
+static SemaphoreHandle_t arbiter_exit = NULL;
+static i2c_arbiter_stats_t arbiter_stats;
+static portMUX_TYPE arbiter_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Look up the registry entry of a device handle
+static i2c_device_entry_t *i2c_find_device(i2c_master_dev_handle_t dev_handle) {
+    for (size_t i = 0; i < device_count; i++) {
+        if (devices[i].dev_handle == dev_handle) {
+            return &devices[i];
+        }
+    }
+    return NULL;
+}
+
+// Bus errors worth another attempt; argument and state errors are not
+static bool i2c_is_retryable(esp_err_t err) {
+    return err == ESP_FAIL || err == ESP_ERR_TIMEOUT || err == ESP_ERR_INVALID_RESPONSE;
+}
+
+// Bus timeout for one transaction, clipped to what is left of the deadline
+static int i2c_op_timeout_ms(const i2c_device_policy_t *policy, int64_t deadline_us) {
+    int64_t remaining_ms = (deadline_us - esp_timer_get_time()) / 1000;
+    if (remaining_ms < 1) {
+        remaining_ms = 1;
+    }
+    return (int)(remaining_ms < policy->timeout_ms ? remaining_ms : policy->timeout_ms);
+}
+
+// Ticks an I2C_OP_DELAY sleeps: delay_ms rounded up to whole ticks, plus one for the tick already under way
+static TickType_t i2c_delay_ticks(uint32_t delay_ms) {
+    return (TickType_t)((delay_ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS) + 1;
+}
+
+// Bucket index of a latency in the log2 histogram
+static size_t i2c_latency_bucket(uint32_t latency_us) {
+    if (latency_us == 0) {
+        return 0;
+    }
+    size_t bucket = 31 - __builtin_clz(latency_us);
+    return bucket < I2C_LATENCY_BUCKETS ? bucket : I2C_LATENCY_BUCKETS - 1;
+}
+
+// Account one finished bus transaction, and the bytes it moved, to its device
+static void i2c_record_transaction(i2c_device_entry_t *entry, size_t written, size_t read, esp_err_t result, uint32_t latency_us) {
+    if (entry == NULL) {
+        return;
+    }
+
+    i2c_device_stats_t *stats = &entry->stats;
+    portENTER_CRITICAL(&arbiter_lock);
+    stats->transactions++;
+    stats->bus_time_us += latency_us;
+    stats->latency_histogram[i2c_latency_bucket(latency_us)]++;
+    if (result == ESP_OK) {
+        stats->bytes_written += written;
+        stats->bytes_read += read;
+    } else {
+        bool counted = false;
+        for (size_t i = 0; i < I2C_ERROR_SLOTS && !counted; i++) {
+            if (stats->errors[i].count == 0 || stats->errors[i].code == result) {
+                stats->errors[i].code = result;
+                stats->errors[i].count++;
+                counted = true;
+            }
+        }
+        if (!counted) {
+            stats->other_errors++;
+        }
+    }
+    portEXIT_CRITICAL(&arbiter_lock);
+}
+
+// Repeat a status read until it shows the wanted value. The bus stays with the
+// batch, but after spin_polls the arbiter yields and after yield_polls it sleeps
+// a tick between polls, so a slow device does not pin the arbiter's core.
+static esp_err_t i2c_execute_poll(i2c_device_entry_t *entry, i2c_master_dev_handle_t dev_handle, const i2c_op_t *op, const i2c_device_policy_t *policy, int64_t deadline_us, i2c_batch_info_t *info) {
+    uint16_t max_polls = op->max_polls ? op->max_polls : 1;
+    for (uint16_t poll = 0; poll < max_polls; poll++) {
+        if (esp_timer_get_time() >= deadline_us) {
+            return ESP_ERR_TIMEOUT;
+        }
+
+        int64_t start_us = esp_timer_get_time();
+        esp_err_t ret = i2c_master_transmit_receive(dev_handle, op->write_buf, op->write_size, op->read_buf, 1, i2c_op_timeout_ms(policy, deadline_us));
+        info->transactions++;
+        info->polls++;
+        // Every poll moves the status pointer and one status byte
+        i2c_record_transaction(entry, op->write_size, 1, ret, (uint32_t)(esp_timer_get_time() - start_us));
+        if (entry != NULL) {
+            portENTER_CRITICAL(&arbiter_lock);
+            entry->stats.poll_iterations++;
+            portEXIT_CRITICAL(&arbiter_lock);
+        }
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        if ((op->read_buf[0] & op->poll_mask) == op->poll_value) {
+            return ESP_OK;
+        }
+
+        if (poll + 1 >= max_polls) {
+            break;
+        }
+        if (poll >= op->yield_polls) {
+            vTaskDelay(1);
+        } else if (poll >= op->spin_polls) {
+            taskYIELD();
+        }
+    }
+    return ESP_ERR_INVALID_RESPONSE;
+}
+
+// Execute one operation on the bus. Runs only in the arbiter task.
+static esp_err_t i2c_execute_op(i2c_device_entry_t *entry, i2c_master_dev_handle_t dev_handle, const i2c_op_t *op, const i2c_device_policy_t *policy, int64_t deadline_us, i2c_batch_info_t *info) {
+    if (op->type != I2C_OP_DELAY && esp_timer_get_time() >= deadline_us) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret;
+    size_t written = 0;
+    size_t read = 0;
+    switch (op->type) {
+    case I2C_OP_WRITE:
+        ret = i2c_master_transmit(dev_handle, op->write_buf, op->write_size, i2c_op_timeout_ms(policy, deadline_us));
+        written = op->write_size;
+        break;
+    case I2C_OP_READ:
+        ret = i2c_master_receive(dev_handle, op->read_buf, op->read_size, i2c_op_timeout_ms(policy, deadline_us));
+        read = op->read_size;
+        break;
+    case I2C_OP_WRITE_READ:
+        ret = i2c_master_transmit_receive(dev_handle, op->write_buf, op->write_size, op->read_buf, op->read_size, i2c_op_timeout_ms(policy, deadline_us));
+        written = op->write_size;
+        read = op->read_size;
+        break;
+    case I2C_OP_DELAY:
+        // Never busy-wait at arbiter priority; a short gap costs a whole tick instead
+        if (op->delay_ms > 0) {
+            vTaskDelay(i2c_delay_ticks(op->delay_ms));
+        }
+        return ESP_OK;
+    case I2C_OP_POLL:
+        if (op->read_buf == NULL) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        return i2c_execute_poll(entry, dev_handle, op, policy, deadline_us, info);
+    default:
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    info->transactions++;
+    i2c_record_transaction(entry, written, read, ret, (uint32_t)(esp_timer_get_time() - start_us));
+    return ret;
+}
+
+// Run every step of a batch once, stopping at the first failure
+static esp_err_t i2c_execute_attempt(i2c_device_entry_t *entry, const i2c_job_t *job, const i2c_device_policy_t *policy, int64_t deadline_us, i2c_batch_info_t *info) {
+    esp_err_t ret = ESP_OK;
+    for (size_t i = 0; i < job->op_count && ret == ESP_OK; i++) {
+        ret = i2c_execute_op(entry, job->dev_handle, &job->ops[i], policy, deadline_us, info);
+    }
+    return ret;
+}
+
+// Clock the bus free and reset the controller. Runs only in the arbiter task.
+static esp_err_t i2c_run_recovery(void) {
+    esp_err_t ret = i2c_master_bus_reset(arbiter_bus);
+    portENTER_CRITICAL(&arbiter_lock);
+    arbiter_stats.bus_recoveries++;
+    portEXIT_CRITICAL(&arbiter_lock);
+    if (ret != ESP_OK) {
+        DLOGE(TAG, "Bus recovery failed: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+// Execute a whole batch back to back, retrying within its budget, and complete it
+static void i2c_execute_job(const i2c_job_t *job) {
+    int64_t start_us = esp_timer_get_time();
+    i2c_device_entry_t *entry = i2c_find_device(job->dev_handle);
+    i2c_device_policy_t policy_copy;
+    portENTER_CRITICAL(&arbiter_lock);
+    policy_copy = entry != NULL ? entry->policy : default_policy;
+    portEXIT_CRITICAL(&arbiter_lock);
+    const i2c_device_policy_t *policy = &policy_copy;
+
+    // Delay steps are part of the protocol, so they extend the deadline
+    int64_t deadline_us = job->submit_us + (int64_t)policy->budget_ms * 1000;
+    for (size_t i = 0; i < job->op_count; i++) {
+        if (job->ops[i].type == I2C_OP_DELAY) {
+            deadline_us += (int64_t)i2c_delay_ticks(job->ops[i].delay_ms) * portTICK_PERIOD_MS * 1000;
+        }
+    }
+
+    i2c_batch_info_t info = {0};
+    uint32_t retries = 0;
+    uint32_t backoff_ms = policy->backoff_ms;
+    bool deadline_missed = false;
+    esp_err_t ret = ESP_ERR_TIMEOUT;
+
+    for (uint8_t attempt = 0; attempt < (policy->max_attempts ? policy->max_attempts : 1); attempt++) {
+        if (esp_timer_get_time() >= deadline_us) {
+            ret = ESP_ERR_TIMEOUT;
+            deadline_missed = true;
+            break;
+        }
+        if (attempt > 0) {
+            retries++;
+        }
+        info.attempts++;
+
+        ret = i2c_execute_attempt(entry, job, policy, deadline_us, &info);
+        if (ret == ESP_OK || !i2c_is_retryable(ret)) {
+            break;
+        }
+
+        if (ret == ESP_ERR_TIMEOUT && policy->recover_on_timeout) {
+            i2c_run_recovery();
+        }
+
+        // Only back off if the pause still leaves room for another attempt
+        int64_t resume_us = esp_timer_get_time() + (int64_t)backoff_ms * 1000;
+        if (attempt + 1 >= policy->max_attempts || resume_us >= deadline_us) {
+            deadline_missed = resume_us >= deadline_us;
+            break;
+        }
+        if (backoff_ms > 0) {
+            vTaskDelay(pdMS_TO_TICKS(backoff_ms) ? pdMS_TO_TICKS(backoff_ms) : 1);
+        }
+        backoff_ms = backoff_ms * 2 > policy->max_backoff_ms ? policy->max_backoff_ms : backoff_ms * 2;
+    }
+
+    int64_t end_us = esp_timer_get_time();
+    uint32_t latency_us = (uint32_t)(end_us - job->submit_us);
+
+    portENTER_CRITICAL(&arbiter_lock);
+    arbiter_stats.batches++;
+    arbiter_stats.transactions += info.transactions;
+    arbiter_stats.retries += retries;
+    arbiter_stats.busy_us += (uint64_t)(end_us - start_us);
+    if (ret != ESP_OK) {
+        arbiter_stats.errors++;
+        if (deadline_missed) {
+            arbiter_stats.deadline_misses++;
+        }
+    }
+    if (latency_us > arbiter_stats.max_latency_us) {
+        arbiter_stats.max_latency_us = latency_us;
+    }
+    if (entry != NULL) {
+        entry->stats.batches++;
+        entry->stats.batch_latency_histogram[i2c_latency_bucket(latency_us)]++;
+    }
+    portEXIT_CRITICAL(&arbiter_lock);
+
+    if (job->info != NULL) {
+        info.bus_us = (uint32_t)(end_us - start_us);
+        *job->info = info;
+    }
+    if (job->done_cb != NULL) {
+        job->done_cb(ret, job->ctx);
+    }
+}
+
+// Task that owns the bus and serves queued batches in arrival order
+static void i2c_arbiter_task(void *arg) {
+    i2c_job_t job;
+    while (true) {
+        if (xQueueReceive(arbiter_queue, &job, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        if (job.recover) {
+            esp_err_t ret = i2c_run_recovery();
+            job.done_cb(ret, job.ctx);
+            continue;
+        }
+        if (job.dev_handle == NULL) {
+            break;
+        }
+        i2c_execute_job(&job);
+    }
+
+    xSemaphoreGive(arbiter_exit);
+    vTaskDelete(NULL);
+}
+
+static void i2c_sync_done(esp_err_t result, void *ctx) {
+    i2c_sync_ctx_t *sync = (i2c_sync_ctx_t *)ctx;
+    sync->result = result;
+    xSemaphoreGive(sync->done);
+}
+
 // Function for initializing the I2C master bus using provided configuration
 esp_err_t initialize_i2c_master(i2c_master_bus_handle_t *bus_handle) {
     i2c_master_bus_config_t i2c_master_config = {
@@ -17,7 +371,26 @@ esp_err_t initialize_i2c_master(i2c_master_bus_handle_t *bus_handle) {
         .flags.enable_internal_pullup = true,
     };
 
-    return i2c_new_master_bus(&i2c_master_config, bus_handle);
+    esp_err_t ret = i2c_new_master_bus(&i2c_master_config, bus_handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    arbiter_bus = *bus_handle;
+    device_count = 0;
+
+    arbiter_queue = xQueueCreate(I2C_ARBITER_QUEUE_LEN, sizeof(i2c_job_t));
+    arbiter_exit = xSemaphoreCreateBinary();
+    if (arbiter_queue == NULL || arbiter_exit == NULL) {
+        DLOGE(TAG, "Failed to allocate arbiter queue");
+        return ESP_ERR_NO_MEM;
+    }
+    memset(&arbiter_stats, 0, sizeof(arbiter_stats));
+
+    if (xTaskCreate(i2c_arbiter_task, "i2c_arbiter", I2C_ARBITER_STACK_SIZE, NULL, I2C_ARBITER_PRIORITY, &arbiter_task_handle) != pdPASS) {
+        DLOGE(TAG, "Failed to start arbiter task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
 }
 
 // Function for adding an I2C device to the master bus
@@ -28,20 +401,263 @@ esp_err_t add_i2c_device(i2c_master_bus_handle_t bus_handle, i2c_master_dev_hand
         .scl_speed_hz = I2C_MASTER_FREQ_HZ,
     };
 
-    return i2c_master_bus_add_device(bus_handle, &dev_cfg, dev_handle);
+    if (device_count >= I2C_MAX_DEVICES) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = i2c_master_bus_add_device(bus_handle, &dev_cfg, dev_handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // Devices are only added during start-up, before any batch is queued
+    devices[device_count] = (i2c_device_entry_t) {
+        .dev_handle = *dev_handle,
+        .address = device_address,
+        .policy = default_policy,
+        .stats = {
+            .address = device_address,
+            .since_us = esp_timer_get_time(),
+        },
+    };
+    device_count++;
+    return ESP_OK;
+}
+
+// Function to replace the timeout budget and retry policy of a device
+esp_err_t i2c_set_device_policy(i2c_master_dev_handle_t dev_handle, const i2c_device_policy_t *policy) {
+    i2c_device_entry_t *entry = i2c_find_device(dev_handle);
+    if (entry == NULL || policy == NULL || policy->timeout_ms == 0 || policy->budget_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&arbiter_lock);
+    entry->policy = *policy;
+    portEXIT_CRITICAL(&arbiter_lock);
+    return ESP_OK;
+}
+
+// Function to read the timeout budget and retry policy of a device
+esp_err_t i2c_get_device_policy(i2c_master_dev_handle_t dev_handle, i2c_device_policy_t *policy) {
+    i2c_device_entry_t *entry = i2c_find_device(dev_handle);
+    if (entry == NULL || policy == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&arbiter_lock);
+    *policy = entry->policy;
+    portEXIT_CRITICAL(&arbiter_lock);
+    return ESP_OK;
+}
+
+// Function to clock a stuck bus free, serialised with queued batches
+esp_err_t i2c_recover_bus(void) {
+    if (arbiter_bus == NULL || arbiter_queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // A callback already running on the arbiter owns the bus
+    if (xTaskGetCurrentTaskHandle() == arbiter_task_handle) {
+        return i2c_run_recovery();
+    }
+
+    // The arbiter runs recovery from its own context, in turn with the batches;
+    // it is not a batch, so no device's transactions or latencies include it
+    StaticSemaphore_t done_buffer;
+    i2c_sync_ctx_t sync = {
+        .done = xSemaphoreCreateBinaryStatic(&done_buffer),
+        .result = ESP_FAIL,
+    };
+    i2c_job_t job = {
+        .done_cb = i2c_sync_done,
+        .ctx = &sync,
+        .submit_us = esp_timer_get_time(),
+        .recover = true,
+    };
+    esp_err_t ret = ESP_OK;
+    if (xQueueSend(arbiter_queue, &job, portMAX_DELAY) != pdTRUE) {
+        ret = ESP_ERR_TIMEOUT;
+    } else {
+        xSemaphoreTake(sync.done, portMAX_DELAY);
+        ret = sync.result;
+    }
+    vSemaphoreDelete(sync.done);
+    return ret;
+}
+
+// Queue a batch, optionally asking for its cost to be reported in info
+static esp_err_t i2c_submit_job(i2c_master_dev_handle_t dev_handle, const i2c_op_t *ops, size_t op_count, i2c_done_cb_t done_cb, void *ctx, i2c_batch_info_t *info) {
+    if (dev_handle == NULL || ops == NULL || op_count == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (arbiter_queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    i2c_job_t job = {
+        .dev_handle = dev_handle,
+        .ops = ops,
+        .op_count = op_count,
+        .done_cb = done_cb,
+        .ctx = ctx,
+        .info = info,
+        .submit_us = esp_timer_get_time(),
+    };
+
+    // A callback already running on the arbiter owns the bus, so execute inline
+    if (xTaskGetCurrentTaskHandle() == arbiter_task_handle) {
+        i2c_execute_job(&job);
+        return ESP_OK;
+    }
+
+    // A full queue counts against the budget too
+    i2c_device_entry_t *entry = i2c_find_device(dev_handle);
+    uint32_t budget_ms = entry != NULL ? entry->policy.budget_ms : default_policy.budget_ms;
+    if (xQueueSend(arbiter_queue, &job, pdMS_TO_TICKS(budget_ms)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    uint32_t depth = (uint32_t)uxQueueMessagesWaiting(arbiter_queue);
+    portENTER_CRITICAL(&arbiter_lock);
+    if (depth > arbiter_stats.queue_high_water) {
+        arbiter_stats.queue_high_water = depth;
+    }
+    portEXIT_CRITICAL(&arbiter_lock);
+    return ESP_OK;
+}
+
+// Function to queue a batch of operations for the arbiter
+esp_err_t i2c_submit(i2c_master_dev_handle_t dev_handle, const i2c_op_t *ops, size_t op_count, i2c_done_cb_t done_cb, void *ctx) {
+    return i2c_submit_job(dev_handle, ops, op_count, done_cb, ctx, NULL);
+}
+
+// Function to run a batch of operations and wait for the result
+esp_err_t i2c_transfer(i2c_master_dev_handle_t dev_handle, const i2c_op_t *ops, size_t op_count) {
+    return i2c_transfer_info(dev_handle, ops, op_count, NULL);
+}
+
+// Function to run a batch of operations, wait for the result and report its cost
+esp_err_t i2c_transfer_info(i2c_master_dev_handle_t dev_handle, const i2c_op_t *ops, size_t op_count, i2c_batch_info_t *info) {
+    StaticSemaphore_t done_buffer;
+    i2c_sync_ctx_t sync = {
+        .done = xSemaphoreCreateBinaryStatic(&done_buffer),
+        .result = ESP_FAIL,
+    };
+
+    esp_err_t ret = i2c_submit_job(dev_handle, ops, op_count, i2c_sync_done, &sync, info);
+    if (ret == ESP_OK) {
+        xSemaphoreTake(sync.done, portMAX_DELAY);
+        ret = sync.result;
+    }
+    vSemaphoreDelete(sync.done);
+    return ret;
 }
 
 // Function to write data to the I2C device
 esp_err_t i2c_write_to_device(i2c_master_dev_handle_t dev_handle, const uint8_t *data_wr, size_t size) {
-    return i2c_master_transmit(dev_handle, data_wr, size, -1);
+    i2c_op_t op = {
+        .type = I2C_OP_WRITE,
+        .write_buf = data_wr,
+        .write_size = size,
+    };
+    return i2c_transfer(dev_handle, &op, 1);
 }
 
 // Function to read data from the I2C device
 esp_err_t i2c_read_from_device(i2c_master_dev_handle_t dev_handle, uint8_t *data_rd, size_t size) {
-    return i2c_master_receive(dev_handle, data_rd, size, -1);
+    i2c_op_t op = {
+        .type = I2C_OP_READ,
+        .read_buf = data_rd,
+        .read_size = size,
+    };
+    return i2c_transfer(dev_handle, &op, 1);
+}
+
+// Function to write a register address and read back from the I2C device
+esp_err_t i2c_write_read_device(i2c_master_dev_handle_t dev_handle, const uint8_t *data_wr, size_t write_size, uint8_t *data_rd, size_t read_size) {
+    i2c_op_t op = {
+        .type = I2C_OP_WRITE_READ,
+        .write_buf = data_wr,
+        .write_size = write_size,
+        .read_buf = data_rd,
+        .read_size = read_size,
+    };
+    return i2c_transfer(dev_handle, &op, 1);
+}
+
+// Function to read the arbiter counters
+void i2c_get_arbiter_stats(i2c_arbiter_stats_t *stats, bool reset) {
+    portENTER_CRITICAL(&arbiter_lock);
+    *stats = arbiter_stats;
+    if (reset) {
+        memset(&arbiter_stats, 0, sizeof(arbiter_stats));
+    }
+    portEXIT_CRITICAL(&arbiter_lock);
+}
+
+// Function to copy (and optionally clear) the per-device counters
+size_t i2c_get_device_stats(i2c_device_stats_t *stats, size_t max_devices, bool reset) {
+    size_t count = device_count < max_devices ? device_count : max_devices;
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&arbiter_lock);
+    for (size_t i = 0; i < count; i++) {
+        stats[i] = devices[i].stats;
+    }
+    if (reset) {
+        for (size_t i = 0; i < device_count; i++) {
+            memset(&devices[i].stats, 0, sizeof(devices[i].stats));
+            devices[i].stats.address = devices[i].address;
+            devices[i].stats.since_us = now_us;
+        }
+    }
+    portEXIT_CRITICAL(&arbiter_lock);
+    return count;
+}
+
+// Function to count one status-poll iteration against a device
+void i2c_record_poll(i2c_master_dev_handle_t dev_handle) {
+    i2c_device_entry_t *entry = i2c_find_device(dev_handle);
+    if (entry == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&arbiter_lock);
+    entry->stats.poll_iterations++;
+    portEXIT_CRITICAL(&arbiter_lock);
+}
+
+// Function to estimate a latency percentile, reported as the upper edge of its bucket
+uint32_t i2c_latency_percentile(const uint32_t *histogram, uint32_t percentile) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < I2C_LATENCY_BUCKETS; i++) {
+        total += histogram[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t target = (total * percentile + 99) / 100;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < I2C_LATENCY_BUCKETS; i++) {
+        seen += histogram[i];
+        if (seen >= target && histogram[i] > 0) {
+            return (uint32_t)(2u << i);
+        }
+    }
+    return (uint32_t)(2u << (I2C_LATENCY_BUCKETS - 1));
 }
 
 // Function to deinitialize the I2C master bus
 esp_err_t deinitialize_i2c_master(i2c_master_bus_handle_t bus_handle) {
+    if (arbiter_queue != NULL) {
+        // Queued batches ahead of the stop request still complete
+        i2c_job_t stop = {0};
+        xQueueSend(arbiter_queue, &stop, portMAX_DELAY);
+        xSemaphoreTake(arbiter_exit, portMAX_DELAY);
+        vQueueDelete(arbiter_queue);
+        vSemaphoreDelete(arbiter_exit);
+        arbiter_queue = NULL;
+        arbiter_exit = NULL;
+        arbiter_task_handle = NULL;
+    }
+    arbiter_bus = NULL;
+    device_count = 0;
     return i2c_del_master_bus(bus_handle);
 }
@@ -3,11 +3,136 @@
 
 #include "driver/i2c_master.h"
 #include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Operation types understood by the bus arbiter
+typedef enum {
+    I2C_OP_WRITE,       // Write write_size bytes from write_buf
+    I2C_OP_READ,        // Read read_size bytes into read_buf
+    I2C_OP_WRITE_READ,  // Write then read with a repeated start
+    I2C_OP_DELAY,       // Sleep at least delay_ms, in whole ticks, before the next step (keeps the bus)
+    I2C_OP_POLL,        // Write then read one byte until (byte & poll_mask) == poll_value, at most max_polls times, backing off between polls
+} i2c_op_type_t;
+
+// A single step of a transaction descriptor
+typedef struct {
+    i2c_op_type_t type;
+    const uint8_t *write_buf;
+    size_t write_size;
+    uint8_t *read_buf;
+    size_t read_size;
+    uint32_t delay_ms;
+    uint8_t poll_mask;
+    uint8_t poll_value;
+    uint16_t max_polls;
+    uint16_t spin_polls;   // Polls issued back to back before backing off
+    uint16_t yield_polls;  // Polls before the arbiter sleeps a tick between them instead of yielding
+} i2c_op_t;
+
+// What one batch cost on the bus, filled in just before its completion
+typedef struct {
+    uint32_t transactions;   // Bus transactions issued, including polls and retried attempts
+    uint32_t polls;          // I2C_OP_POLL iterations
+    uint32_t bus_us;         // Time the arbiter spent executing the batch
+    uint8_t attempts;        // Attempts made, 1 when the first one succeeded
+} i2c_batch_info_t;
+
+// Completion callback, invoked from the arbiter task once a batch has finished
+typedef void (*i2c_done_cb_t)(esp_err_t result, void *ctx);
+
+// Per-device timeout budget and retry policy
+typedef struct {
+    uint32_t timeout_ms;       // Bus timeout for a single transaction
+    uint32_t budget_ms;        // Hard deadline for a whole batch, measured from submission
+    uint8_t max_attempts;      // Attempts per batch, including the first one
+    uint32_t backoff_ms;       // Pause before the first retry
+    uint32_t max_backoff_ms;   // Backoff doubles after every retry up to this cap
+    bool recover_on_timeout;   // Run bus recovery when a transaction times out
+} i2c_device_policy_t;
+
+#define I2C_LATENCY_BUCKETS 16   // Bucket n counts latencies in [2^n, 2^(n+1)) us, the last one is open-ended
+#define I2C_ERROR_SLOTS 4        // Distinct esp_err_t codes tracked per device
+
+// Count of failures with one particular error code
+typedef struct {
+    esp_err_t code;
+    uint32_t count;
+} i2c_error_count_t;
+
+// Per-device transaction counters
+typedef struct {
+    uint16_t address;
+    uint32_t transactions;
+    uint32_t bytes_written;
+    uint32_t bytes_read;
+    uint32_t poll_iterations;                         // Status polls reported by the driver
+    uint64_t bus_time_us;                             // Time spent inside bus transactions
+    i2c_error_count_t errors[I2C_ERROR_SLOTS];
+    uint32_t other_errors;                            // Failures once all error slots are taken
+    uint32_t latency_histogram[I2C_LATENCY_BUCKETS];  // Bus time of each transaction
+    uint32_t batches;                                 // Completed batches
+    uint32_t batch_latency_histogram[I2C_LATENCY_BUCKETS];  // Submit to completion of each batch, queueing included
+    int64_t since_us;                                 // esp_timer time of the last reset
+} i2c_device_stats_t;
+
+// Bus-wide arbiter counters
+typedef struct {
+    uint32_t batches;            // Completed batches
+    uint32_t transactions;       // Completed bus transactions (delays excluded)
+    uint32_t errors;             // Batches that completed with an error
+    uint32_t retries;            // Batch attempts repeated after a failure
+    uint32_t deadline_misses;    // Batches failed because their budget ran out
+    uint32_t bus_recoveries;     // Bus recovery sequences issued
+    uint64_t busy_us;            // Time the arbiter spent executing batches
+    uint32_t max_latency_us;     // Worst submit-to-completion latency seen
+    uint32_t queue_high_water;   // Deepest the request queue has been
+} i2c_arbiter_stats_t;
 
 esp_err_t initialize_i2c_master(i2c_master_bus_handle_t *bus_handle);
 esp_err_t add_i2c_device(i2c_master_bus_handle_t bus_handle, i2c_master_dev_handle_t *dev_handle, uint16_t device_address);
 esp_err_t i2c_write_to_device(i2c_master_dev_handle_t dev_handle, const uint8_t *data_wr, size_t size);
 esp_err_t i2c_read_from_device(i2c_master_dev_handle_t dev_handle, uint8_t *data_rd, size_t size);
+esp_err_t i2c_write_read_device(i2c_master_dev_handle_t dev_handle, const uint8_t *data_wr, size_t write_size, uint8_t *data_rd, size_t read_size);
 esp_err_t deinitialize_i2c_master(i2c_master_bus_handle_t bus_handle);
 
-#endif // I2C_SERVICE_H
\ No newline at end of file
+// Queue a batch of operations for one device. The ops array and all buffers it
+// references must stay valid until done_cb runs. Batches execute back to back
+// without other devices being interleaved and always complete within the
+// device budget (plus any I2C_OP_DELAY time), failing with ESP_ERR_TIMEOUT
+// once it is spent. A failed batch is retried from its first step. An
+// I2C_OP_POLL step that never sees its value fails with ESP_ERR_INVALID_RESPONSE.
+// Batching is the caller's: one submission is one batch, and separate batches
+// for the same device run in arrival order, never merged or moved ahead.
+esp_err_t i2c_submit(i2c_master_dev_handle_t dev_handle, const i2c_op_t *ops, size_t op_count, i2c_done_cb_t done_cb, void *ctx);
+
+// Queue a batch and block the calling task until it has completed
+esp_err_t i2c_transfer(i2c_master_dev_handle_t dev_handle, const i2c_op_t *ops, size_t op_count);
+
+// Same as i2c_transfer, and report what the batch cost in info
+esp_err_t i2c_transfer_info(i2c_master_dev_handle_t dev_handle, const i2c_op_t *ops, size_t op_count, i2c_batch_info_t *info);
+
+// Replace the timeout budget and retry policy of a device
+esp_err_t i2c_set_device_policy(i2c_master_dev_handle_t dev_handle, const i2c_device_policy_t *policy);
+
+// Read the timeout budget and retry policy of a device
+esp_err_t i2c_get_device_policy(i2c_master_dev_handle_t dev_handle, i2c_device_policy_t *policy);
+
+// Clock SCL until a stuck slave releases SDA and reset the controller. It waits
+// its turn in the arbiter queue and is counted in bus_recoveries only, not
+// against any device.
+esp_err_t i2c_recover_bus(void);
+
+// Read and optionally clear the arbiter counters
+void i2c_get_arbiter_stats(i2c_arbiter_stats_t *stats, bool reset);
+
+// Copy the counters of up to max_devices devices and return how many were copied
+size_t i2c_get_device_stats(i2c_device_stats_t *stats, size_t max_devices, bool reset);
+
+// Note one iteration of a driver's status-polling loop against the device
+void i2c_record_poll(i2c_master_dev_handle_t dev_handle);
+
+// Approximate latency percentile (0-100) from a histogram, in microseconds
+uint32_t i2c_latency_percentile(const uint32_t *histogram, uint32_t percentile);
+
+#endif // I2C_SERVICE_H
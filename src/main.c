@@ -4,6 +4,8 @@
 #include "esp_log.h"
 #include "scd41_driver.h"
 #include "as7262_driver.h"
+#include "as7262_stream.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "i2c_service.h"
@@ -15,7 +17,17 @@
 #include "nvs_service.h"
 #include "uart_commands.h"
 #include <stdio.h>
+#include <string.h>
 #include "tds_sensor.h"
+#include "tds_calibration.h"
+#include "sensor_scheduler.h"
+#include "sensor_jobs.h"
+#include "config_store.h"
+#include "sample_log.h"
+#include "console_out.h"
+#include "dlog.h"
+#include <inttypes.h>
+#include "pins.h"
 
 #undef TAG
 #define TAG "Main"
@@ -24,6 +36,11 @@
 i2c_master_dev_handle_t scd41_dev; // Global to access from uart_commands.c
 i2c_master_dev_handle_t as7262_dev; // Global to access from uart_commands.c
 
+// Drain task side of the console output: only this task waits on the UART
+static void console_uart_write(const uint8_t *data, size_t length, void *ctx) {
+    uart_write_bytes(CONFIG_ESP_CONSOLE_UART_NUM, data, length);
+}
+
 // Initialize the console
 void initialize_console() {
     esp_console_config_t console_config = {
@@ -46,6 +63,12 @@ void initialize_console() {
     ESP_ERROR_CHECK(uart_driver_install(CONFIG_ESP_CONSOLE_UART_NUM, 256, 0, 0, NULL, 0));
     esp_vfs_dev_uart_use_driver(CONFIG_ESP_CONSOLE_UART_NUM);
 
+    // Readings and log lines go through the console_out ring, which is the TX
+    // buffer; command replies still print directly from the console task
+    ESP_ERROR_CHECK(console_out_start(console_uart_write, NULL, load_console_out_policy()));
+    esp_log_set_vprintf(console_out_vprintf);
+    dlog_set_mode(load_log_mode());
+
     // Initialize linenoise
     linenoiseSetMultiLine(1);
     linenoiseHistorySetMaxLen(100);
@@ -73,8 +96,8 @@ void console_task(void *arg) {
     }
 }
 
-// Task to initialize sensors
-void sensor_init_task(void *arg) {
+// Function to initialize the sensors and hand periodic reads to the scheduler
+static esp_err_t initialize_sensors(void) {
     esp_err_t ret;
 
     // Initialize I2C master bus
@@ -82,85 +105,60 @@ void sensor_init_task(void *arg) {
     ret = initialize_i2c_master(&i2c_bus);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize I2C master bus: %s", esp_err_to_name(ret));
-        vTaskDelete(NULL);
-        return;
+        return ret;
     }
 
     // Add the SCD41 device on the I2C bus
     ret = scd41_init(i2c_bus, &scd41_dev);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize SCD41 device: %s", esp_err_to_name(ret));
-        vTaskDelete(NULL);
-        return;
+        return ret;
     }
 
     // Add the AS7262 device on the I2C bus
     ret = as7262_init(i2c_bus, &as7262_dev);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize AS7262 device: %s", esp_err_to_name(ret));
-        vTaskDelete(NULL);
-        return;
+        return ret;
     }
 
+    // Build the TDS lookup tables from the stored calibration; the store validated
+    // it and falls back to the probe defaults
+    tds_calibration_t tds_calibration;
+    load_tds_calibration(&tds_calibration);
+    tds_calibration_apply(&tds_calibration);
+
     // Initialize the TDS sensor ADC
     ret = initialize_tds_sensor();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize TDS sensor ADC: %s", esp_err_to_name(ret));
-        vTaskDelete(NULL);
-        return;
+        return ret;
     }
 
-    ESP_LOGI(TAG, "Sensor initialization complete.");
-    vTaskDelete(NULL);
-}
-
-// Task to read SCD41 data
-void read_scd41_task(void *arg) {
-    while (true) {
-        uint16_t co2;
-        float temperature, humidity;
-        esp_err_t ret = scd41_read_measurement(scd41_dev, &co2, &temperature, &humidity);
-        if (ret == ESP_OK) {
-            printf("SCD41 - CO2: %u ppm, Temperature: %.2f °C, Humidity: %.2f %%\n", co2, temperature, humidity);
-        } else {
-            ESP_LOGE(TAG, "Error reading SCD41 measurement, code: %s", esp_err_to_name(ret));
-        }
-        vTaskDelay(pdMS_TO_TICKS(5000)); // Delay for 5 seconds
+    // Pick up the history log where it stopped; readings are still shown without it
+    ret = sample_log_init();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "History log unavailable: %s", esp_err_to_name(ret));
     }
-}
 
-// Task to read AS7262 data
-void read_as7262_task(void *arg) {
-    while (true) {
-        uint16_t raw_channels[6];
-        esp_err_t ret = as7262_read_measurement(as7262_dev, raw_channels);
-        if (ret == ESP_OK) {
-            float calibrated_data[6];
-            for (int i = 0; i < 6; i++) {
-                calibrated_data[i] = (float)raw_channels[i];
-            }
-            apply_correction_factors(calibrated_data);
-            printf("AS7262 - Corrected: V=%.2f, B=%.2f, G=%.2f, Y=%.2f, O=%.2f, R=%.2f\n",
-                   calibrated_data[0], calibrated_data[1], calibrated_data[2],
-                   calibrated_data[3], calibrated_data[4], calibrated_data[5]);
-        } else {
-            ESP_LOGE(TAG, "Error reading AS7262 measurement, code: %s", esp_err_to_name(ret));
-        }
-        vTaskDelay(pdMS_TO_TICKS(5000)); // Delay for 5 seconds
+    // Start the AS7262 stream and the periodic sensor jobs
+    as7262_stream_config_t stream_config = {
+        .integration_time = AS7262_STREAM_DEFAULT_INT_T,
+        .gain = AS7262_STREAM_DEFAULT_GAIN,
+        .int_gpio = AS7262_INT_IO,
+        .auto_range = true,
+    };
+    ret = sensor_jobs_start(scd41_dev, as7262_dev, &stream_config);
+    if (ret == ESP_OK) {
+        ret = sensor_scheduler_start();
     }
-}
-
-// Task to read TDS data
-void read_tds_task(void *arg) {
-    while (true) {
-        float tds_value = read_tds_sensor();
-        if (tds_value >= 0) {
-            printf("TDS Value: %.2f ppm\n", tds_value);
-        } else {
-            ESP_LOGE(TAG, "Failed to read TDS value.");
-        }
-        vTaskDelay(pdMS_TO_TICKS(5000)); // Delay for 5 seconds
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start sensor jobs: %s", esp_err_to_name(ret));
+        return ret;
     }
+
+    ESP_LOGI(TAG, "Sensor initialization complete.");
+    return ESP_OK;
 }
 
 void app_main(void) {
@@ -171,19 +169,19 @@ void app_main(void) {
         return;
     }
 
+    // Every stored setting is in RAM from here on
+    ret = config_store_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to load settings: %s", esp_err_to_name(ret));
+        return;
+    }
+
     // Initialize console
     initialize_console();
 
-    // Create sensor initialization task
-    xTaskCreate(sensor_init_task, "sensor_init_task", 4096, NULL, 5, NULL);
-
-    // Delay to ensure sensors are initialized before starting the read tasks
-    vTaskDelay(pdMS_TO_TICKS(1000)); // Delay for 1 second
-
-    // Create tasks for periodic sensor readings
-    xTaskCreate(read_scd41_task, "read_scd41_task", 4096, NULL, 5, NULL);
-    xTaskCreate(read_as7262_task, "read_as7262_task", 4096, NULL, 5, NULL);
-    xTaskCreate(read_tds_task, "read_tds_task", 4096, NULL, 5, NULL);
+    // Bring the sensors up on this task before the console takes commands; the
+    // console still starts on failure so the bus can be inspected
+    initialize_sensors();
 
     // Create console task
     xTaskCreate(console_task, "console_task", 4096, NULL, 5, NULL);
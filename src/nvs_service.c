@@ -2,6 +2,7 @@
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "esp_log.h"
+#include "dlog.h"
 #include <inttypes.h> // Include for PRId32
 
 static const char* TAG = "NVS_SERVICE";
@@ -17,7 +18,7 @@ esp_err_t nvs_service_init(void) {
 
     ret = nvs_open("storage", NVS_READWRITE, &my_nvs_handle);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error (%s) opening NVS handle!", esp_err_to_name(ret));
+        DLOGE(TAG, "Error (%s) opening NVS handle!", esp_err_to_name(ret));
     }
 
     return ret;
@@ -26,7 +27,7 @@ esp_err_t nvs_service_init(void) {
 esp_err_t nvs_service_set_i32(const char* key, int32_t value) {
     esp_err_t ret = nvs_set_i32(my_nvs_handle, key, value);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to write to NVS (%s)!", esp_err_to_name(ret));
+        DLOGE(TAG, "Failed to write to NVS (%s)!", esp_err_to_name(ret));
     }
     return ret;
 }
@@ -34,11 +35,11 @@ esp_err_t nvs_service_set_i32(const char* key, int32_t value) {
 esp_err_t nvs_service_get_i32(const char* key, int32_t* value) {
     esp_err_t ret = nvs_get_i32(my_nvs_handle, key, value);
     if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "Value for key %s = %" PRId32, key, *value); // Use PRId32
+        DLOGI(TAG, "Value for key %s = %" PRId32, key, *value); // Use PRId32
     } else if (ret == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGI(TAG, "The value for key %s is not initialized yet!", key);
+        DLOGI(TAG, "The value for key %s is not initialized yet!", key);
     } else {
-        ESP_LOGE(TAG, "Error (%s) reading key %s!", esp_err_to_name(ret), key);
+        DLOGE(TAG, "Error (%s) reading key %s!", esp_err_to_name(ret), key);
     }
     return ret;
 }
@@ -46,7 +47,7 @@ esp_err_t nvs_service_get_i32(const char* key, int32_t* value) {
 esp_err_t nvs_service_set_str(const char* key, const char* value) {
     esp_err_t ret = nvs_set_str(my_nvs_handle, key, value);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to write string to NVS (%s)!", esp_err_to_name(ret));
+        DLOGE(TAG, "Failed to write string to NVS (%s)!", esp_err_to_name(ret));
     }
     return ret;
 }
@@ -54,11 +55,11 @@ esp_err_t nvs_service_set_str(const char* key, const char* value) {
 esp_err_t nvs_service_get_str(const char* key, char* value, size_t max_len) {
     esp_err_t ret = nvs_get_str(my_nvs_handle, key, value, &max_len);
     if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "Value for key %s = %s", key, value);
+        DLOGI(TAG, "Value for key %s = %s", key, value);
     } else if (ret == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGI(TAG, "The value for key %s is not initialized yet!", key);
+        DLOGI(TAG, "The value for key %s is not initialized yet!", key);
     } else {
-        ESP_LOGE(TAG, "Error (%s) reading key %s!", esp_err_to_name(ret), key);
+        DLOGE(TAG, "Error (%s) reading key %s!", esp_err_to_name(ret), key);
     }
     return ret;
 }
@@ -66,7 +67,7 @@ esp_err_t nvs_service_get_str(const char* key, char* value, size_t max_len) {
 esp_err_t nvs_service_erase_key(const char* key) {
     esp_err_t ret = nvs_erase_key(my_nvs_handle, key);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to erase key from NVS (%s)!", esp_err_to_name(ret));
+        DLOGE(TAG, "Failed to erase key from NVS (%s)!", esp_err_to_name(ret));
     }
     return ret;
 }
@@ -74,7 +75,7 @@ esp_err_t nvs_service_erase_key(const char* key) {
 esp_err_t nvs_service_commit(void) {
     esp_err_t ret = nvs_commit(my_nvs_handle);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to commit changes to NVS (%s)!", esp_err_to_name(ret));
+        DLOGE(TAG, "Failed to commit changes to NVS (%s)!", esp_err_to_name(ret));
     }
     return ret;
 }
@@ -82,12 +83,7 @@ esp_err_t nvs_service_commit(void) {
 esp_err_t nvs_service_set_blob(const char* key, const void* value, size_t length) {
     esp_err_t ret = nvs_set_blob(my_nvs_handle, key, value, length);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to write blob to NVS (%s)!", esp_err_to_name(ret));
-    } else {
-        ret = nvs_commit(my_nvs_handle);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to commit blob to NVS (%s)!", esp_err_to_name(ret));
-        }
+        DLOGE(TAG, "Failed to write blob to NVS (%s)!", esp_err_to_name(ret));
     }
     return ret;
 }
@@ -95,11 +91,11 @@ esp_err_t nvs_service_set_blob(const char* key, const void* value, size_t length
 esp_err_t nvs_service_get_blob(const char* key, void* value, size_t* length) {
     esp_err_t ret = nvs_get_blob(my_nvs_handle, key, value, length);
     if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "Blob value for key %s read successfully", key);
+        DLOGI(TAG, "Blob value for key %s read successfully", key);
     } else if (ret == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGI(TAG, "The blob value for key %s is not initialized yet!", key);
+        DLOGI(TAG, "The blob value for key %s is not initialized yet!", key);
     } else {
-        ESP_LOGE(TAG, "Error (%s) reading blob key %s!", esp_err_to_name(ret), key);
+        DLOGE(TAG, "Error (%s) reading blob key %s!", esp_err_to_name(ret), key);
     }
     return ret;
 }
@@ -108,9 +104,9 @@ void print_nvs_stats(void) {
     nvs_stats_t nvs_stats;
     esp_err_t ret = nvs_get_stats(NULL, &nvs_stats); // NULL for default partition
     if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "NVS Stats: Used entries = %d, Free entries = %d, All entries = %d, Namespace entries = %d",
-                 nvs_stats.used_entries, nvs_stats.free_entries, nvs_stats.total_entries, nvs_stats.namespace_count);
+        DLOGI(TAG, "NVS Stats: Used entries = %d, Free entries = %d, All entries = %d, Namespace entries = %d",
+              nvs_stats.used_entries, nvs_stats.free_entries, nvs_stats.total_entries, nvs_stats.namespace_count);
     } else {
-        ESP_LOGE(TAG, "Error (%s) getting NVS stats", esp_err_to_name(ret));
+        DLOGE(TAG, "Error (%s) getting NVS stats", esp_err_to_name(ret));
     }
 }
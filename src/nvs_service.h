@@ -21,7 +21,7 @@ esp_err_t nvs_service_set_str(const char* key, const char* value);
 // Get a string value from NVS
 esp_err_t nvs_service_get_str(const char* key, char* value, size_t length);
 
-// Set a blob in NVS
+// Set a blob in NVS; like the other setters it leaves the commit to the caller
 esp_err_t nvs_service_set_blob(const char* key, const void* value, size_t length);
 
 // Get a blob from NVS
@@ -1,2 +1,3 @@
 #define I2C_MASTER_SCL_IO           22    // GPIO number for I2C master clock
-#define I2C_MASTER_SDA_IO           21    // GPIO number for I2C master data
\ No newline at end of file
+#define I2C_MASTER_SDA_IO           21    // GPIO number for I2C master data
+#define AS7262_INT_IO               4     // GPIO number for AS7262 INT (active low)
\ No newline at end of file
@@ -0,0 +1,46 @@
+#include "running_stats.h"
+#include <math.h>
+#include <string.h>
+
+void running_stats_reset(running_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+void running_stats_add(running_stats_t *stats, int64_t value) {
+    if (stats->count == 0) {
+        stats->shift = value;
+        stats->min = value;
+        stats->max = value;
+    }
+    int64_t delta = value - stats->shift;
+    stats->count++;
+    stats->sum += delta;
+    stats->sum_squares += (uint64_t)(delta * delta);
+    stats->min = value < stats->min ? value : stats->min;
+    stats->max = value > stats->max ? value : stats->max;
+}
+
+double running_stats_mean_double(const running_stats_t *stats) {
+    if (stats->count == 0) {
+        return 0;
+    }
+    return (double)stats->shift + (double)stats->sum / stats->count;
+}
+
+double running_stats_stddev_double(const running_stats_t *stats) {
+    if (stats->count == 0) {
+        return 0;
+    }
+    // (sum of d^2 - (sum of d)^2 / n) / n on the shifted values; only the last steps round
+    double sum = (double)stats->sum;
+    double variance = ((double)stats->sum_squares - sum * sum / stats->count) / stats->count;
+    return variance > 0 ? sqrt(variance) : 0;
+}
+
+int64_t running_stats_mean(const running_stats_t *stats) {
+    return llround(running_stats_mean_double(stats));
+}
+
+uint32_t running_stats_stddev(const running_stats_t *stats) {
+    return (uint32_t)lround(running_stats_stddev_double(stats));
+}
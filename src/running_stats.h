@@ -0,0 +1,35 @@
+#ifndef RUNNING_STATS_H
+#define RUNNING_STATS_H
+
+#include <stdint.h>
+
+// Count, extremes, mean and standard deviation of a stream of integer values.
+// The sums are kept exactly, in integers, relative to the first value, so the
+// squares stay small while the values sit close together; the mean and the
+// variance are only worked out in double when asked for.
+typedef struct {
+    uint32_t count;
+    int64_t min;
+    int64_t max;
+    int64_t shift;
+    int64_t sum;               // Sum of (value - shift)
+    uint64_t sum_squares;      // Sum of (value - shift)^2
+} running_stats_t;
+
+// Forget every value
+void running_stats_reset(running_stats_t *stats);
+
+// Add one value
+void running_stats_add(running_stats_t *stats, int64_t value);
+
+// Mean of the values so far, 0 when empty
+double running_stats_mean_double(const running_stats_t *stats);
+
+// Population standard deviation of the values so far, 0 when empty
+double running_stats_stddev_double(const running_stats_t *stats);
+
+// The same, rounded to the nearest integer
+int64_t running_stats_mean(const running_stats_t *stats);
+uint32_t running_stats_stddev(const running_stats_t *stats);
+
+#endif // RUNNING_STATS_H
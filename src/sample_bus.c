@@ -0,0 +1,186 @@
+#include "sample_bus.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include <stdatomic.h>
+#include <string.h>
+
+// One source's ring. The producer fills slot head & mask, then publishes it by
+// advancing head; consumers only ever read, so nothing on the hot path locks.
+typedef struct {
+    sample_record_t *slots;
+    uint32_t capacity;
+    _Atomic uint32_t head;                 // Records published so far
+    sample_timing_t timing;                // Written by the producer only, under timing_seq
+    _Atomic uint32_t timing_seq;           // Odd while the producer updates timing
+    atomic_bool timing_reset;              // Asked for by a reader, done by the producer
+    int64_t last_timestamp_us;
+    _Atomic int32_t last_error;            // Since the newest record, ESP_OK if none
+    _Atomic uint32_t failures;
+} sample_ring_t;
+
+static sample_record_t scd41_slots[SAMPLE_BUS_SCD41_CAPACITY];
+static sample_record_t as7262_slots[SAMPLE_BUS_AS7262_CAPACITY];
+static sample_record_t tds_slots[SAMPLE_BUS_TDS_CAPACITY];
+
+static sample_ring_t rings[SAMPLE_SOURCE_COUNT] = {
+    [SAMPLE_SOURCE_SCD41] = {scd41_slots, SAMPLE_BUS_SCD41_CAPACITY},
+    [SAMPLE_SOURCE_AS7262] = {as7262_slots, SAMPLE_BUS_AS7262_CAPACITY},
+    [SAMPLE_SOURCE_TDS] = {tds_slots, SAMPLE_BUS_TDS_CAPACITY},
+};
+
+// Consumers are only added, never removed; the lock guards registration only
+static sample_consumer_t consumers[SAMPLE_BUS_MAX_CONSUMERS];
+static size_t consumer_count = 0;
+static portMUX_TYPE consumers_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void sample_bus_publish(sample_source_t source, sample_record_t *record) {
+    sample_ring_t *ring = &rings[source];
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    record->sequence = head;
+    record->source = source;
+
+    // The previous head must be visible before the slot it frees is reused,
+    // so a reader that sees the old head knows its copy was not torn
+    atomic_thread_fence(memory_order_seq_cst);
+    ring->slots[head & (ring->capacity - 1)] = *record;
+    atomic_store_explicit(&ring->failures, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->last_error, ESP_OK, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    // Timing is a seqlock too, so readers retry rather than block the producer
+    uint32_t seq = atomic_load_explicit(&ring->timing_seq, memory_order_relaxed);
+    atomic_store_explicit(&ring->timing_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    if (atomic_exchange_explicit(&ring->timing_reset, false, memory_order_relaxed)) {
+        running_stats_reset(&ring->timing.latency);
+        running_stats_reset(&ring->timing.interval);
+        ring->timing.since_us = record->timestamp_us;
+    }
+    running_stats_add(&ring->timing.latency, record->timestamp_us - record->requested_us);
+    if (head > 0) {
+        running_stats_add(&ring->timing.interval, record->timestamp_us - ring->last_timestamp_us);
+    }
+    ring->last_timestamp_us = record->timestamp_us;
+    atomic_store_explicit(&ring->timing_seq, seq + 2, memory_order_release);
+}
+
+esp_err_t sample_bus_subscribe(const char *name, sample_source_t source, sample_consumer_t **consumer) {
+    if (name == NULL || source >= SAMPLE_SOURCE_COUNT || consumer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&consumers_lock);
+    if (consumer_count == SAMPLE_BUS_MAX_CONSUMERS) {
+        portEXIT_CRITICAL(&consumers_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    sample_consumer_t *entry = &consumers[consumer_count++];
+    memset(entry, 0, sizeof(*entry));
+    strncpy(entry->name, name, SAMPLE_BUS_NAME_LEN - 1);
+    entry->source = source;
+    entry->position = atomic_load_explicit(&rings[source].head, memory_order_acquire);
+    portEXIT_CRITICAL(&consumers_lock);
+    *consumer = entry;
+    return ESP_OK;
+}
+
+size_t sample_bus_peek(sample_consumer_t *consumer, const sample_record_t **records) {
+    sample_ring_t *ring = &rings[consumer->source];
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t available = head - consumer->position;
+    if (available > ring->capacity) {
+        // Lapped: jump to the newer half so the producer is not right behind us
+        uint32_t resume = head - ring->capacity / 2;
+        consumer->overruns++;
+        consumer->dropped += resume - consumer->position;
+        consumer->position = resume;
+        available = head - resume;
+    }
+    uint32_t index = consumer->position & (ring->capacity - 1);
+    uint32_t contiguous = ring->capacity - index;
+    *records = &ring->slots[index];
+    return available < contiguous ? available : contiguous;
+}
+
+bool sample_bus_release(sample_consumer_t *consumer, size_t count) {
+    sample_ring_t *ring = &rings[consumer->source];
+
+    // Reads of the records happen before the head is checked again
+    atomic_thread_fence(memory_order_acquire);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    bool intact = head - consumer->position < ring->capacity;
+    consumer->position += (uint32_t)count;
+    if (intact) {
+        consumer->consumed += (uint32_t)count;
+    } else {
+        consumer->overruns++;
+        consumer->dropped += (uint32_t)count;
+    }
+    return intact;
+}
+
+void sample_bus_report_error(sample_source_t source, esp_err_t error) {
+    sample_ring_t *ring = &rings[source];
+    atomic_store_explicit(&ring->last_error, error, memory_order_relaxed);
+    atomic_fetch_add_explicit(&ring->failures, 1, memory_order_relaxed);
+}
+
+esp_err_t sample_bus_get_latest(sample_source_t source, sample_latest_t *latest) {
+    sample_ring_t *ring = &rings[source];
+    memset(latest, 0, sizeof(*latest));
+    while (true) {
+        uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        latest->failures = atomic_load_explicit(&ring->failures, memory_order_relaxed);
+        latest->last_error = atomic_load_explicit(&ring->last_error, memory_order_relaxed);
+        if (head == 0) {
+            return ESP_ERR_NOT_FOUND;
+        }
+        latest->record = ring->slots[(head - 1) & (ring->capacity - 1)];
+        atomic_thread_fence(memory_order_acquire);
+        // Retry in the unlikely case the producer lapped the slot during the copy
+        if (atomic_load_explicit(&ring->head, memory_order_relaxed) - (head - 1) < ring->capacity) {
+            break;
+        }
+    }
+    latest->age_us = esp_timer_get_time() - latest->record.timestamp_us;
+    latest->valid = latest->failures == 0;
+    return ESP_OK;
+}
+
+void sample_bus_get_source_stats(sample_source_t source, sample_source_stats_t *stats) {
+    stats->capacity = rings[source].capacity;
+    stats->published = atomic_load_explicit(&rings[source].head, memory_order_relaxed);
+}
+
+void sample_bus_get_timing(sample_source_t source, sample_timing_t *timing, bool reset) {
+    sample_ring_t *ring = &rings[source];
+    while (true) {
+        uint32_t seq = atomic_load_explicit(&ring->timing_seq, memory_order_acquire);
+        if (seq & 1) {
+            vTaskDelay(1);  // The producer may be preempted mid-update on this core
+            continue;
+        }
+        *timing = ring->timing;
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&ring->timing_seq, memory_order_relaxed) == seq) {
+            break;
+        }
+    }
+    if (reset) {
+        // Cleared on the next publish, by the only writer
+        atomic_store_explicit(&ring->timing_reset, true, memory_order_relaxed);
+    }
+}
+
+size_t sample_bus_get_consumers(sample_consumer_t *copies, size_t max_consumers) {
+    portENTER_CRITICAL(&consumers_lock);
+    size_t count = consumer_count < max_consumers ? consumer_count : max_consumers;
+    memcpy(copies, consumers, count * sizeof(sample_consumer_t));
+    portEXIT_CRITICAL(&consumers_lock);
+    return count;
+}
+
+const char *sample_bus_source_name(sample_source_t source) {
+    static const char *names[SAMPLE_SOURCE_COUNT] = {"scd41", "as7262", "tds"};
+    return source < SAMPLE_SOURCE_COUNT ? names[source] : "?";
+}
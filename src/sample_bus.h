@@ -0,0 +1,118 @@
+#ifndef SAMPLE_BUS_H
+#define SAMPLE_BUS_H
+
+#include "esp_err.h"
+#include "scd41_driver.h"
+#include "as7262_stream.h"
+#include "running_stats.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Ring sizes per source, powers of two. They set how far a consumer may fall
+// behind: about 80 s of SCD41, 6 s of AS7262 and 3 minutes of 5 s TDS reads.
+#define SAMPLE_BUS_SCD41_CAPACITY 16
+#define SAMPLE_BUS_AS7262_CAPACITY 64
+#define SAMPLE_BUS_TDS_CAPACITY 32
+#define SAMPLE_BUS_MAX_CONSUMERS 12
+#define SAMPLE_BUS_NAME_LEN 12
+
+// Where a record came from; each source has its own ring and a single producer
+typedef enum {
+    SAMPLE_SOURCE_SCD41,
+    SAMPLE_SOURCE_AS7262,
+    SAMPLE_SOURCE_TDS,
+    SAMPLE_SOURCE_COUNT,
+} sample_source_t;
+
+// One timestamped reading. Both stamps are esp_timer microseconds, so records
+// from different sources share one timeline.
+typedef struct {
+    int64_t requested_us;                  // Acquisition started
+    int64_t timestamp_us;                  // Data in hand; records are ordered by this
+    uint32_t sequence;                     // Per-source publish count, filled in by sample_bus_publish
+    sample_source_t source;
+    union {
+        scd41_sample_t scd41;
+        struct {
+            as7262_range_t range;
+            bool saturated;
+            uint16_t raw[AS7262_CHANNEL_COUNT];
+        } as7262;
+        struct {
+            int32_t ppm;
+            uint32_t raw_q4;               // Filtered raw counts, TDS_ADC_VALUE_SHIFT fraction bits
+        } tds;
+    };
+} sample_record_t;
+
+// A consumer's position in one source's ring. Consumers never hold up the
+// producer; one that falls more than a ring behind skips ahead to the newer
+// half of the ring and counts what it lost.
+typedef struct {
+    char name[SAMPLE_BUS_NAME_LEN];
+    sample_source_t source;
+    uint32_t position;                     // Sequence of the next record to read
+    uint32_t consumed;
+    uint32_t overruns;                     // Times the consumer was lapped by the producer
+    uint32_t dropped;                      // Records lost to those overruns
+} sample_consumer_t;
+
+// Per-source counters
+typedef struct {
+    uint32_t capacity;
+    uint32_t published;
+} sample_source_stats_t;
+
+// A source's newest record as the acquisition path last left it
+typedef struct {
+    sample_record_t record;                // Zeroed before the first record
+    bool valid;                            // There is a record and no acquisition has failed since
+    int64_t age_us;                        // Since the record's timestamp_us
+    esp_err_t last_error;                  // Latest failure since the record, ESP_OK if none
+    uint32_t failures;                     // Failed acquisitions since the record
+} sample_latest_t;
+
+// Per-source acquisition timing, kept by the bus as records are published
+typedef struct {
+    running_stats_t latency;               // timestamp_us - requested_us
+    running_stats_t interval;              // Between consecutive timestamp_us; its spread is the jitter
+    int64_t since_us;                      // esp_timer time of the last reset
+} sample_timing_t;
+
+// Publish a record; never blocks. Only one task may publish to each source.
+void sample_bus_publish(sample_source_t source, sample_record_t *record);
+
+// Attach a consumer to a source, starting at the next record published
+esp_err_t sample_bus_subscribe(const char *name, sample_source_t source, sample_consumer_t **consumer);
+
+// Point records at the unread records that are contiguous in the ring and
+// return how many there are. The producer can overwrite them at any time, so a
+// consumer copies them out before use and calls sample_bus_release when done.
+size_t sample_bus_peek(sample_consumer_t *consumer, const sample_record_t **records);
+
+// Mark count peeked records as read. Returns false if the producer overwrote
+// them while they were being read, in which case they count as dropped and
+// the copy must be discarded.
+bool sample_bus_release(sample_consumer_t *consumer, size_t count);
+
+// Record a failed acquisition; only the source's producer may call this
+void sample_bus_report_error(sample_source_t source, esp_err_t error);
+
+// Copy the newest record of a source with its age and validity, without
+// touching the sensor; ESP_ERR_NOT_FOUND before the first one
+esp_err_t sample_bus_get_latest(sample_source_t source, sample_latest_t *latest);
+
+// Read the counters of a source
+void sample_bus_get_source_stats(sample_source_t source, sample_source_stats_t *stats);
+
+// Read and optionally clear the acquisition timing of a source
+void sample_bus_get_timing(sample_source_t source, sample_timing_t *timing, bool reset);
+
+// Copy up to max_consumers consumer states and return how many were copied
+size_t sample_bus_get_consumers(sample_consumer_t *consumers, size_t max_consumers);
+
+// Short source name for display
+const char *sample_bus_source_name(sample_source_t source);
+
+#endif // SAMPLE_BUS_H
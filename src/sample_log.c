@@ -0,0 +1,833 @@
+#include "sample_log.h"
+#include "esp_log.h"
+#include "dlog.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+
+static const char *TAG = "SAMPLE_LOG";
+
+#define SAMPLE_LOG_SEGMENT_MAGIC 0x474C4F47    // "GOLG" on flash
+#define SAMPLE_LOG_PAGE_MAGIC 0x5047
+#define SAMPLE_LOG_SUMMARY_MAGIC 0x4D4D5553    // "SUMM" on flash
+#define SAMPLE_LOG_SUMMARY_OFFSET 64
+#define SAMPLE_LOG_MIN_TIER_SEGMENTS 2
+
+// Start of every segment, in its first page
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t tier;
+    uint8_t record_size;
+    uint32_t sequence;                         // One more than the tier's previous segment
+    uint32_t first_time_s;                     // Log time of the first record
+    uint32_t page_sequence;                    // Sequence of the first page
+    uint32_t crc;                              // CRC-32 of the fields above
+} log_segment_header_t;
+
+// One page-sized flush; unused record slots stay erased
+typedef struct {
+    uint16_t magic;
+    uint8_t tier;
+    uint8_t count;
+    uint32_t sequence;                         // One more than the tier's previous page
+    uint32_t reserved;
+    uint32_t crc;                              // CRC-32 of the fields above and the used records
+    sample_log_record_t records[SAMPLE_LOG_RECORDS_PER_PAGE];
+} log_page_t;
+
+_Static_assert(sizeof(log_page_t) == SAMPLE_LOG_PAGE_SIZE, "a log page must fill one flash page");
+
+// One channel over a whole segment
+typedef struct {
+    int32_t min;
+    int32_t max;
+    int32_t mean;
+    uint32_t count;                            // Samples, not records
+} log_channel_summary_t;
+
+// Sparse index of a sealed segment, programmed into the spare end of its first
+// page when the next segment is started. Range queries use it to skip the
+// segment's pages entirely.
+typedef struct {
+    uint32_t magic;
+    uint32_t last_time_s;                      // Start of the newest interval in the segment
+    uint16_t channel_mask;                     // Channels with a summary below
+    uint16_t reserved;
+    log_channel_summary_t channels[WINDOW_STATS_CHANNEL_COUNT];
+    uint32_t crc;                              // CRC-32 of the fields above
+} log_segment_summary_t;
+
+// First page of a segment, read back in one go
+typedef struct {
+    log_segment_header_t header;
+    uint8_t unused[SAMPLE_LOG_SUMMARY_OFFSET - sizeof(log_segment_header_t)];
+    log_segment_summary_t summary;
+} log_segment_start_t;
+
+_Static_assert(offsetof(log_segment_start_t, summary) == SAMPLE_LOG_SUMMARY_OFFSET, "summary must sit at its offset");
+_Static_assert(sizeof(log_segment_start_t) <= SAMPLE_LOG_PAGE_SIZE, "segment start must fit in the first page");
+
+// In-RAM index entry of one segment, so queries find their segments without reading flash
+typedef struct {
+    uint32_t first_time_s;
+    uint32_t last_time_s;
+    bool valid;
+    bool summarised;                           // Summary on flash, pages can be skipped
+} log_index_entry_t;
+
+// Running aggregate of one channel over the open interval
+typedef struct {
+    uint32_t count;
+    int64_t sum;
+    int32_t min;
+    int32_t max;
+} log_accumulator_t;
+
+typedef struct {
+    // Aggregation and the page being filled; producer side, under log_lock
+    bool open;
+    uint32_t start_s;
+    log_accumulator_t channels[WINDOW_STATS_CHANNEL_COUNT];
+    log_page_t page;
+    uint32_t page_started_s;
+
+    // Flash position; writer side, under flash_lock
+    uint32_t first_segment;
+    bool have_head;
+    bool sealed;                               // Head segment already has its summary
+    uint32_t next_sequence;
+    uint32_t page_sequence;
+    log_accumulator_t segment_channels[WINDOW_STATS_CHANNEL_COUNT];  // Head segment so far
+} log_tier_t;
+
+// Query output being built up one step at a time
+typedef struct {
+    sample_log_record_t record;
+    log_accumulator_t values;
+    sample_log_visit_fn_t visit;
+    void *ctx;
+} log_bucket_t;
+
+static const uint32_t tier_intervals_s[SAMPLE_LOG_TIER_COUNT] = SAMPLE_LOG_TIER_INTERVALS_S;
+static const uint32_t tier_shares_pct[SAMPLE_LOG_TIER_COUNT] = SAMPLE_LOG_TIER_SHARES_PCT;
+
+static log_tier_t tiers[SAMPLE_LOG_TIER_COUNT];
+static log_index_entry_t segment_index[SAMPLE_LOG_MAX_SEGMENTS];
+static const esp_partition_t *partition = NULL;
+static QueueHandle_t page_queue = NULL;
+static SemaphoreHandle_t log_lock = NULL;
+static SemaphoreHandle_t flash_lock = NULL;
+static uint32_t now_s = 0;                     // Newest log time added so far
+static uint32_t pages_queued = 0;
+static uint32_t pages_done = 0;
+static sample_log_stats_t log_stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Function to compute the CRC of a segment header
+static uint32_t sample_log_header_crc(const log_segment_header_t *header) {
+    return esp_rom_crc32_le(0, (const uint8_t *)header, offsetof(log_segment_header_t, crc));
+}
+
+// Function to compute the CRC of a page, covering only the records in use
+static uint32_t sample_log_page_crc(const log_page_t *page) {
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)page, offsetof(log_page_t, crc));
+    return esp_rom_crc32_le(crc, (const uint8_t *)page->records, page->count * sizeof(sample_log_record_t));
+}
+
+static size_t sample_log_segment_offset(const log_tier_t *tier, uint32_t segment) {
+    return (size_t)(tier->first_segment + segment) * SAMPLE_LOG_SEGMENT_SIZE;
+}
+
+static log_index_entry_t *sample_log_index_entry(const log_tier_t *tier, uint32_t segment) {
+    return &segment_index[tier->first_segment + segment];
+}
+
+// Whether a header read back is this tier's and intact
+static bool sample_log_header_valid(const log_segment_header_t *header, uint8_t tier) {
+    return header->magic == SAMPLE_LOG_SEGMENT_MAGIC && header->version == SAMPLE_LOG_VERSION &&
+           header->tier == tier && header->record_size == sizeof(sample_log_record_t) &&
+           header->crc == sample_log_header_crc(header);
+}
+
+static bool sample_log_summary_valid(const log_segment_summary_t *summary) {
+    return summary->magic == SAMPLE_LOG_SUMMARY_MAGIC &&
+           summary->crc == esp_rom_crc32_le(0, (const uint8_t *)summary, offsetof(log_segment_summary_t, crc));
+}
+
+// Read a segment header; false if the segment is erased, torn or not this tier's
+static bool sample_log_read_header(uint8_t tier, uint32_t segment, log_segment_header_t *header) {
+    if (esp_partition_read(partition, sample_log_segment_offset(&tiers[tier], segment), header, sizeof(*header)) != ESP_OK) {
+        return false;
+    }
+    return sample_log_header_valid(header, tier);
+}
+
+// Read a segment's summary; false if it was never sealed
+static bool sample_log_read_summary(uint8_t tier, uint32_t segment, log_segment_summary_t *summary) {
+    size_t offset = sample_log_segment_offset(&tiers[tier], segment) + SAMPLE_LOG_SUMMARY_OFFSET;
+    return esp_partition_read(partition, offset, summary, sizeof(*summary)) == ESP_OK && sample_log_summary_valid(summary);
+}
+
+// Fold the records of a written page into the head segment's summary
+static void sample_log_fold_page(log_tier_t *tier, const log_page_t *page) {
+    for (uint8_t i = 0; i < page->count; i++) {
+        const sample_log_record_t *record = &page->records[i];
+        if (record->channel >= WINDOW_STATS_CHANNEL_COUNT) {
+            continue;
+        }
+        log_accumulator_t *accumulator = &tier->segment_channels[record->channel];
+        accumulator->min = accumulator->count == 0 || record->min < accumulator->min ? record->min : accumulator->min;
+        accumulator->max = accumulator->count == 0 || record->max > accumulator->max ? record->max : accumulator->max;
+        accumulator->count += record->count;
+        accumulator->sum += (int64_t)record->mean * record->count;
+    }
+}
+
+// Whether every byte of a page is still erased
+static bool sample_log_page_erased(const log_page_t *page) {
+    const uint32_t *words = (const uint32_t *)page;
+    for (size_t i = 0; i < sizeof(*page) / sizeof(uint32_t); i++) {
+        if (words[i] != 0xFFFFFFFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Whether a programmed page is intact
+static bool sample_log_page_valid(const log_page_t *page, uint8_t tier) {
+    return page->magic == SAMPLE_LOG_PAGE_MAGIC && page->tier == tier && page->count > 0 &&
+           page->count <= SAMPLE_LOG_RECORDS_PER_PAGE && page->crc == sample_log_page_crc(page);
+}
+
+// Index a tier from the first page of every segment, then find the first erased page of the newest
+static void sample_log_recover_tier(uint8_t index, uint32_t *reads) {
+    log_tier_t *tier = &tiers[index];
+    sample_log_tier_stats_t *stats = &log_stats.tiers[index];
+    uint32_t oldest_sequence = 0;
+    for (uint32_t segment = 0; segment < stats->segment_count; segment++) {
+        log_segment_start_t start;
+        log_index_entry_t *entry = sample_log_index_entry(tier, segment);
+        memset(entry, 0, sizeof(*entry));
+        (*reads)++;
+        if (esp_partition_read(partition, sample_log_segment_offset(tier, segment), &start, sizeof(start)) != ESP_OK ||
+            !sample_log_header_valid(&start.header, index)) {
+            continue;
+        }
+        const log_segment_header_t *header = &start.header;
+        entry->valid = true;
+        entry->first_time_s = header->first_time_s;
+        entry->summarised = sample_log_summary_valid(&start.summary);
+        entry->last_time_s = entry->summarised ? start.summary.last_time_s : header->first_time_s;
+        stats->segments_used++;
+        if (!tier->have_head || (int32_t)(header->sequence - tier->next_sequence) >= 0) {
+            tier->have_head = true;
+            tier->sealed = entry->summarised;
+            tier->next_sequence = header->sequence + 1;
+            tier->page_sequence = header->page_sequence;
+            stats->head_segment = segment;
+            stats->newest_time_s = header->first_time_s;
+        }
+        if (stats->segments_used == 1 || (int32_t)(header->sequence - oldest_sequence) < 0) {
+            oldest_sequence = header->sequence;
+            stats->oldest_time_s = header->first_time_s;
+        }
+    }
+    if (!tier->have_head) {
+        return;
+    }
+
+    // A segment cut off before it was sealed ends where the next one starts
+    for (uint32_t segment = 0; segment < stats->segment_count; segment++) {
+        log_index_entry_t *entry = sample_log_index_entry(tier, segment);
+        const log_index_entry_t *next = sample_log_index_entry(tier, (segment + 1) % stats->segment_count);
+        if (entry->valid && !entry->summarised && segment != stats->head_segment && next->valid && next->first_time_s > entry->first_time_s) {
+            entry->last_time_s = next->first_time_s;
+        }
+    }
+
+    // Pages go in order, so the first erased one is where writing resumes
+    stats->head_page = SAMPLE_LOG_PAGES_PER_SEGMENT;
+    for (uint32_t page_index = 1; page_index < SAMPLE_LOG_PAGES_PER_SEGMENT; page_index++) {
+        log_page_t page;
+        (*reads)++;
+        size_t offset = sample_log_segment_offset(tier, stats->head_segment) + page_index * SAMPLE_LOG_PAGE_SIZE;
+        if (esp_partition_read(partition, offset, &page, sizeof(page)) != ESP_OK) {
+            continue;
+        }
+        if (sample_log_page_erased(&page)) {
+            stats->head_page = page_index;
+            break;
+        }
+        if (!sample_log_page_valid(&page, index)) {
+            log_stats.corrupt_pages++;      // Torn by a reset mid-write; never rewritten
+            continue;
+        }
+        tier->page_sequence = page.sequence + 1;
+        stats->newest_time_s = page.records[page.count - 1].time_s;
+        sample_log_fold_page(tier, &page);
+    }
+    sample_log_index_entry(tier, stats->head_segment)->last_time_s = stats->newest_time_s;
+}
+
+// Program the head segment's summary into its first page, once it will take no more pages
+static void sample_log_seal_segment(uint8_t index) {
+    log_tier_t *tier = &tiers[index];
+    const sample_log_tier_stats_t *stats = &log_stats.tiers[index];
+    if (!tier->have_head || tier->sealed) {
+        return;
+    }
+    log_segment_summary_t summary;
+    memset(&summary, 0, sizeof(summary));
+    summary.magic = SAMPLE_LOG_SUMMARY_MAGIC;
+    summary.last_time_s = stats->newest_time_s;
+    for (int channel = 0; channel < WINDOW_STATS_CHANNEL_COUNT; channel++) {
+        const log_accumulator_t *accumulator = &tier->segment_channels[channel];
+        if (accumulator->count == 0) {
+            continue;
+        }
+        summary.channel_mask |= 1u << channel;
+        summary.channels[channel] = (log_channel_summary_t) {
+            .min = accumulator->min,
+            .max = accumulator->max,
+            .mean = (int32_t)(accumulator->sum / (int64_t)accumulator->count),
+            .count = accumulator->count,
+        };
+    }
+    summary.crc = esp_rom_crc32_le(0, (const uint8_t *)&summary, offsetof(log_segment_summary_t, crc));
+    size_t offset = sample_log_segment_offset(tier, stats->head_segment) + SAMPLE_LOG_SUMMARY_OFFSET;
+    esp_err_t ret = esp_partition_write(partition, offset, &summary, sizeof(summary));
+    tier->sealed = true;
+    sample_log_index_entry(tier, stats->head_segment)->summarised = ret == ESP_OK;
+}
+
+// Erase the segment after the head and start it; once the tier has wrapped this drops its oldest data
+static esp_err_t sample_log_open_segment(uint8_t index, uint32_t first_time_s) {
+    log_tier_t *tier = &tiers[index];
+    sample_log_tier_stats_t *stats = &log_stats.tiers[index];
+    sample_log_seal_segment(index);
+    uint32_t segment = tier->have_head ? (stats->head_segment + 1) % stats->segment_count : 0;
+    size_t offset = sample_log_segment_offset(tier, segment);
+
+    // Replacing a valid segment moves the start of the tier's history on by one
+    log_segment_header_t header;
+    bool replaced = sample_log_read_header(index, segment, &header);
+    uint32_t oldest_time_s = first_time_s;
+    bool have_oldest = !replaced && stats->segments_used == 0;
+    if (replaced && sample_log_read_header(index, (segment + 1) % stats->segment_count, &header)) {
+        oldest_time_s = header.first_time_s;
+        have_oldest = true;
+    }
+
+    esp_err_t ret = esp_partition_erase_range(partition, offset, SAMPLE_LOG_SEGMENT_SIZE);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    header = (log_segment_header_t) {
+        .magic = SAMPLE_LOG_SEGMENT_MAGIC,
+        .version = SAMPLE_LOG_VERSION,
+        .tier = index,
+        .record_size = sizeof(sample_log_record_t),
+        .sequence = tier->next_sequence,
+        .first_time_s = first_time_s,
+        .page_sequence = tier->page_sequence,
+    };
+    header.crc = sample_log_header_crc(&header);
+    ret = esp_partition_write(partition, offset, &header, sizeof(header));
+
+    // The segment is spent either way; a bad header only makes recovery skip it
+    tier->have_head = true;
+    tier->sealed = false;
+    tier->next_sequence++;
+    memset(tier->segment_channels, 0, sizeof(tier->segment_channels));
+    portENTER_CRITICAL(&stats_lock);
+    log_stats.segments_erased++;
+    stats->head_segment = segment;
+    stats->head_page = 1;
+    stats->segment_sequence = header.sequence;
+    stats->segments_used += replaced ? 0 : 1;
+    if (have_oldest) {
+        stats->oldest_time_s = oldest_time_s;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+    *sample_log_index_entry(tier, segment) = (log_index_entry_t) {
+        .first_time_s = first_time_s,
+        .last_time_s = first_time_s,
+        .valid = ret == ESP_OK,
+    };
+    return ret;
+}
+
+// Write one page at the head of its tier, starting a new segment when the head is full
+static esp_err_t sample_log_write_page(log_page_t *page) {
+    log_tier_t *tier = &tiers[page->tier];
+    sample_log_tier_stats_t *stats = &log_stats.tiers[page->tier];
+    if (!tier->have_head || stats->head_page >= SAMPLE_LOG_PAGES_PER_SEGMENT) {
+        esp_err_t ret = sample_log_open_segment(page->tier, page->records[0].time_s);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    page->sequence = tier->page_sequence++;
+    page->crc = sample_log_page_crc(page);
+    size_t offset = sample_log_segment_offset(tier, stats->head_segment) + stats->head_page * SAMPLE_LOG_PAGE_SIZE;
+    esp_err_t ret = esp_partition_write(partition, offset, page, sizeof(*page));
+
+    // A failed write may have programmed part of the page, so it is never reused
+    portENTER_CRITICAL(&stats_lock);
+    stats->head_page++;
+    if (ret == ESP_OK) {
+        stats->newest_time_s = page->records[page->count - 1].time_s;
+        log_stats.pages_written++;
+        log_stats.bytes_written += sizeof(*page);
+    }
+    portEXIT_CRITICAL(&stats_lock);
+    if (ret == ESP_OK) {
+        sample_log_fold_page(tier, page);
+        sample_log_index_entry(tier, stats->head_segment)->last_time_s = stats->newest_time_s;
+    }
+    return ret;
+}
+
+// Task that owns all flash writes, so erases never stall the sensor jobs
+static void sample_log_writer_task(void *arg) {
+    log_page_t page;
+    while (true) {
+        xQueueReceive(page_queue, &page, portMAX_DELAY);
+        xSemaphoreTake(flash_lock, portMAX_DELAY);
+        int64_t start_us = esp_timer_get_time();
+        esp_err_t ret = sample_log_write_page(&page);
+        int64_t elapsed_us = esp_timer_get_time() - start_us;
+        xSemaphoreGive(flash_lock);
+        if (ret != ESP_OK) {
+            DLOGE(TAG, "Failed to write tier %u page: %s", page.tier, esp_err_to_name(ret));
+        }
+        portENTER_CRITICAL(&stats_lock);
+        log_stats.write_us += elapsed_us;
+        log_stats.pages_dropped += ret != ESP_OK;
+        pages_done++;
+        portEXIT_CRITICAL(&stats_lock);
+    }
+}
+
+// Hand a tier's page to the writer and start an empty one; caller holds log_lock
+static void sample_log_queue_page(uint8_t index) {
+    log_tier_t *tier = &tiers[index];
+    if (tier->page.count == 0) {
+        return;
+    }
+    tier->page.magic = SAMPLE_LOG_PAGE_MAGIC;
+    tier->page.tier = index;
+    bool queued = xQueueSend(page_queue, &tier->page, 0) == pdTRUE;
+    portENTER_CRITICAL(&stats_lock);
+    pages_queued++;
+    if (!queued) {
+        log_stats.pages_dropped++;
+        pages_done++;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+    memset(&tier->page, 0xFF, sizeof(tier->page));
+    tier->page.count = 0;
+}
+
+// Add a record to a tier's page, queueing the page once it is full
+static void sample_log_append(uint8_t index, const sample_log_record_t *record) {
+    log_tier_t *tier = &tiers[index];
+    if (tier->page.count == 0) {
+        tier->page_started_s = now_s;
+    }
+    tier->page.records[tier->page.count++] = *record;
+    portENTER_CRITICAL(&stats_lock);
+    log_stats.records++;
+    portEXIT_CRITICAL(&stats_lock);
+    if (tier->page.count == SAMPLE_LOG_RECORDS_PER_PAGE) {
+        sample_log_queue_page(index);
+    }
+}
+
+static void sample_log_accumulate(uint8_t index, uint32_t time_s, window_stats_channel_t channel, const log_accumulator_t *value);
+
+// Log the aggregate of every channel over a tier's open interval and roll it into the next tier
+static void sample_log_close_interval(uint8_t index) {
+    log_tier_t *tier = &tiers[index];
+    for (int channel = 0; channel < WINDOW_STATS_CHANNEL_COUNT; channel++) {
+        log_accumulator_t *accumulator = &tier->channels[channel];
+        if (accumulator->count == 0) {
+            continue;
+        }
+        sample_log_record_t record = {
+            .time_s = tier->start_s,
+            .channel = (uint8_t)channel,
+            .tier = index,
+            .count = accumulator->count > UINT16_MAX ? UINT16_MAX : (uint16_t)accumulator->count,
+            .mean = (int32_t)(accumulator->sum / (int64_t)accumulator->count),
+            .min = accumulator->min,
+            .max = accumulator->max,
+        };
+        sample_log_append(index, &record);
+        if (index + 1 < SAMPLE_LOG_TIER_COUNT) {
+            sample_log_accumulate(index + 1, tier->start_s, (window_stats_channel_t)channel, accumulator);
+        }
+        memset(accumulator, 0, sizeof(*accumulator));
+    }
+    tier->open = false;
+}
+
+// Merge an aggregate into a tier's interval, closing the previous interval first if time moved on
+static void sample_log_accumulate(uint8_t index, uint32_t time_s, window_stats_channel_t channel, const log_accumulator_t *value) {
+    log_tier_t *tier = &tiers[index];
+    uint32_t start_s = time_s - time_s % tier_intervals_s[index];
+    // Sources are drained one after another, so a value may trail one from a
+    // newer interval; it counts towards the open interval rather than reopen its own
+    if (tier->open && start_s < tier->start_s) {
+        start_s = tier->start_s;
+    }
+    if (tier->open && start_s != tier->start_s) {
+        sample_log_close_interval(index);
+    }
+    tier->open = true;
+    tier->start_s = start_s;
+    log_accumulator_t *accumulator = &tier->channels[channel];
+    accumulator->min = accumulator->count == 0 || value->min < accumulator->min ? value->min : accumulator->min;
+    accumulator->max = accumulator->count == 0 || value->max > accumulator->max ? value->max : accumulator->max;
+    accumulator->count += value->count;
+    accumulator->sum += value->sum;
+}
+
+uint32_t sample_log_time_s(int64_t timestamp_us) {
+    return log_stats.clock_offset_s + (uint32_t)(timestamp_us / 1000000);
+}
+
+esp_err_t sample_log_init(void) {
+    if (partition != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    const esp_partition_t *found = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, SAMPLE_LOG_PARTITION_LABEL);
+    if (found == NULL) {
+        DLOGW(TAG, "No '%s' partition, history will not be kept", SAMPLE_LOG_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Carve the partition into one segment run per tier
+    uint32_t total_segments = found->size / SAMPLE_LOG_SEGMENT_SIZE;
+    if (total_segments > SAMPLE_LOG_MAX_SEGMENTS) {
+        DLOGW(TAG, "Using %d of the partition's %" PRIu32 " segments", SAMPLE_LOG_MAX_SEGMENTS, total_segments);
+        total_segments = SAMPLE_LOG_MAX_SEGMENTS;
+    }
+    uint32_t first_segment = 0;
+    memset(&log_stats, 0, sizeof(log_stats));
+    for (int index = 0; index < SAMPLE_LOG_TIER_COUNT; index++) {
+        uint32_t segment_count = total_segments * tier_shares_pct[index] / 100;
+        if (segment_count < SAMPLE_LOG_MIN_TIER_SEGMENTS) {
+            DLOGE(TAG, "Partition of %" PRIu32 " bytes is too small for tier %d", (uint32_t)found->size, index);
+            return ESP_ERR_INVALID_SIZE;
+        }
+        memset(&tiers[index], 0, sizeof(tiers[index]));
+        memset(&tiers[index].page, 0xFF, sizeof(tiers[index].page));
+        tiers[index].page.count = 0;
+        tiers[index].first_segment = first_segment;
+        log_stats.tiers[index].interval_s = tier_intervals_s[index];
+        log_stats.tiers[index].segment_count = segment_count;
+        first_segment += segment_count;
+    }
+
+    page_queue = xQueueCreate(SAMPLE_LOG_QUEUE_PAGES, sizeof(log_page_t));
+    log_lock = xSemaphoreCreateMutex();
+    flash_lock = xSemaphoreCreateMutex();
+    if (page_queue == NULL || log_lock == NULL || flash_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    partition = found;
+    log_stats.partition_size = found->size;
+
+    // Recovery reads the first page of every segment and at most one segment of pages per tier
+    int64_t start_us = esp_timer_get_time();
+    uint32_t reads = 0;
+    uint32_t clock_s = 0;
+    for (int index = 0; index < SAMPLE_LOG_TIER_COUNT; index++) {
+        sample_log_recover_tier((uint8_t)index, &reads);
+        const sample_log_tier_stats_t *stats = &log_stats.tiers[index];
+        if (tiers[index].have_head && stats->newest_time_s + stats->interval_s > clock_s) {
+            clock_s = stats->newest_time_s + stats->interval_s;
+        }
+        log_stats.tiers[index].segment_sequence = tiers[index].have_head ? tiers[index].next_sequence - 1 : 0;
+    }
+    // The time between the last record and now is unknown, so the clock picks up where the log stopped
+    log_stats.clock_offset_s = clock_s;
+    log_stats.recovery_us = esp_timer_get_time() - start_us;
+    log_stats.recovery_reads = reads;
+    log_stats.mounted = true;
+    DLOGI(TAG, "Recovered in %" PRId64 " us (%" PRIu32 " reads), log clock at %" PRIu32 " s",
+          log_stats.recovery_us, reads, clock_s);
+
+    if (xTaskCreate(sample_log_writer_task, "sample_log", SAMPLE_LOG_STACK_SIZE, NULL, SAMPLE_LOG_PRIORITY, NULL) != pdPASS) {
+        log_stats.mounted = false;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void sample_log_add(window_stats_channel_t channel, int64_t timestamp_us, int32_t value) {
+    if (!log_stats.mounted || channel >= WINDOW_STATS_CHANNEL_COUNT) {
+        return;
+    }
+    log_accumulator_t sample = {.count = 1, .sum = value, .min = value, .max = value};
+    xSemaphoreTake(log_lock, portMAX_DELAY);
+    uint32_t time_s = sample_log_time_s(timestamp_us);
+    now_s = time_s > now_s ? time_s : now_s;
+    sample_log_accumulate(0, time_s, channel, &sample);
+    for (int index = 0; index < SAMPLE_LOG_TIER_COUNT; index++) {
+        if (tiers[index].page.count > 0 && now_s - tiers[index].page_started_s >= SAMPLE_LOG_MAX_PAGE_AGE_S) {
+            sample_log_queue_page((uint8_t)index);
+        }
+    }
+    xSemaphoreGive(log_lock);
+}
+
+void sample_log_add_record(const sample_record_t *record) {
+    int32_t values[WINDOW_STATS_CHANNEL_COUNT];
+    uint32_t mask = window_stats_record_values(record, values);
+    for (int channel = 0; channel < WINDOW_STATS_CHANNEL_COUNT; channel++) {
+        if (mask & (1u << channel)) {
+            sample_log_add((window_stats_channel_t)channel, record->timestamp_us, values[channel]);
+        }
+    }
+}
+
+esp_err_t sample_log_flush(uint32_t timeout_ms) {
+    if (!log_stats.mounted) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // Open intervals stay open; only records already aggregated go out
+    xSemaphoreTake(log_lock, portMAX_DELAY);
+    for (int index = 0; index < SAMPLE_LOG_TIER_COUNT; index++) {
+        sample_log_queue_page((uint8_t)index);
+    }
+    portENTER_CRITICAL(&stats_lock);
+    uint32_t target = pages_queued;
+    portEXIT_CRITICAL(&stats_lock);
+    xSemaphoreGive(log_lock);
+
+    TickType_t waited = 0;
+    while (true) {
+        portENTER_CRITICAL(&stats_lock);
+        bool done = (int32_t)(pages_done - target) >= 0;
+        portEXIT_CRITICAL(&stats_lock);
+        if (done) {
+            return ESP_OK;
+        }
+        if (waited >= pdMS_TO_TICKS(timeout_ms)) {
+            return ESP_ERR_TIMEOUT;
+        }
+        vTaskDelay(1);
+        waited++;
+    }
+}
+
+esp_err_t sample_log_for_each(uint8_t tier, sample_log_visit_fn_t visit, void *ctx) {
+    if (tier >= SAMPLE_LOG_TIER_COUNT || visit == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!log_stats.mounted) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(flash_lock, portMAX_DELAY);
+    bool have_head = tiers[tier].have_head;
+    sample_log_tier_stats_t stats = log_stats.tiers[tier];
+    xSemaphoreGive(flash_lock);
+    if (!have_head) {
+        return ESP_OK;
+    }
+
+    // Oldest segment first: the one after the head, round to the head itself
+    bool have_previous = false;
+    uint32_t previous_sequence = 0;
+    for (uint32_t step = 1; step <= stats.segment_count; step++) {
+        uint32_t segment = (stats.head_segment + step) % stats.segment_count;
+        uint32_t end_page = segment == stats.head_segment ? stats.head_page : SAMPLE_LOG_PAGES_PER_SEGMENT;
+        log_segment_header_t header;
+        xSemaphoreTake(flash_lock, portMAX_DELAY);
+        bool valid = sample_log_read_header(tier, segment, &header);
+        xSemaphoreGive(flash_lock);
+        for (uint32_t page_index = 1; valid && page_index < end_page; page_index++) {
+            log_page_t page;
+            size_t offset = sample_log_segment_offset(&tiers[tier], segment) + page_index * SAMPLE_LOG_PAGE_SIZE;
+            xSemaphoreTake(flash_lock, portMAX_DELAY);
+            esp_err_t ret = esp_partition_read(partition, offset, &page, sizeof(page));
+            xSemaphoreGive(flash_lock);
+            if (ret != ESP_OK || sample_log_page_erased(&page)) {
+                break;
+            }
+            // A page older than the last one means the writer wrapped onto this segment meanwhile
+            if (!sample_log_page_valid(&page, tier) || (have_previous && (int32_t)(page.sequence - previous_sequence) <= 0)) {
+                continue;
+            }
+            have_previous = true;
+            previous_sequence = page.sequence;
+            for (uint8_t i = 0; i < page.count; i++) {
+                if (!visit(&page.records[i], ctx)) {
+                    return ESP_OK;
+                }
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+// Hand the finished bucket to the visitor and empty it
+static bool sample_log_bucket_emit(log_bucket_t *bucket) {
+    log_accumulator_t *values = &bucket->values;
+    bucket->record.count = values->count > UINT16_MAX ? UINT16_MAX : (uint16_t)values->count;
+    bucket->record.mean = (int32_t)(values->sum / (int64_t)values->count);
+    bucket->record.min = values->min;
+    bucket->record.max = values->max;
+    memset(values, 0, sizeof(*values));
+    return bucket->visit(&bucket->record, bucket->ctx);
+}
+
+// Coarsest tier no coarser than the step that still reaches back to from_s,
+// so the fewest records are read; when none reaches back, the coarsest such tier
+static uint8_t sample_log_pick_tier(uint32_t from_s, uint32_t step_s) {
+    uint8_t allowed = 0;
+    while (allowed + 1 < SAMPLE_LOG_TIER_COUNT && tier_intervals_s[allowed + 1] <= step_s) {
+        allowed++;
+    }
+    for (int index = allowed; index >= 0; index--) {
+        portENTER_CRITICAL(&stats_lock);
+        bool reaches = log_stats.tiers[index].segments_used > 0 && log_stats.tiers[index].oldest_time_s <= from_s;
+        portEXIT_CRITICAL(&stats_lock);
+        if (reaches) {
+            return (uint8_t)index;
+        }
+    }
+    return allowed;
+}
+
+// Merge an aggregate into the open bucket, handing the bucket on when start_s moves past it.
+// False once the visitor has asked to stop.
+static bool sample_log_bucket_add(log_bucket_t *bucket, uint32_t start_s, int32_t mean, int32_t min, int32_t max, uint32_t count) {
+    if (bucket->values.count > 0 && start_s != bucket->record.time_s && !sample_log_bucket_emit(bucket)) {
+        return false;
+    }
+    log_accumulator_t *values = &bucket->values;
+    bucket->record.time_s = start_s;
+    values->min = values->count == 0 || min < values->min ? min : values->min;
+    values->max = values->count == 0 || max > values->max ? max : values->max;
+    values->count += count;
+    values->sum += (int64_t)mean * count;
+    return true;
+}
+
+esp_err_t sample_log_query(const sample_log_query_t *query, sample_log_visit_fn_t visit, void *ctx, sample_log_query_stats_t *result) {
+    if (query == NULL || visit == NULL || result == NULL || query->channel >= WINDOW_STATS_CHANNEL_COUNT || query->from_s > query->to_s) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!log_stats.mounted) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int64_t start_us = esp_timer_get_time();
+    memset(result, 0, sizeof(*result));
+    uint8_t tier = sample_log_pick_tier(query->from_s, query->step_s);
+    result->tier = tier;
+    // A step no coarser than the tier's own interval returns the records as stored
+    uint32_t step_s = query->step_s > tier_intervals_s[tier] ? query->step_s : 0;
+    log_bucket_t bucket = {
+        .record = {.channel = query->channel, .tier = tier},
+        .visit = visit,
+        .ctx = ctx,
+    };
+
+    xSemaphoreTake(flash_lock, portMAX_DELAY);
+    bool have_head = tiers[tier].have_head;
+    sample_log_tier_stats_t stats = log_stats.tiers[tier];
+    xSemaphoreGive(flash_lock);
+    bool stopped = !have_head;
+
+    // Oldest segment first, as in sample_log_for_each; the index says which ones to open
+    bool have_previous = false;
+    uint32_t previous_sequence = 0;
+    for (uint32_t position = 1; !stopped && position <= stats.segment_count; position++) {
+        uint32_t segment = (stats.head_segment + position) % stats.segment_count;
+        uint32_t end_page = segment == stats.head_segment ? stats.head_page : SAMPLE_LOG_PAGES_PER_SEGMENT;
+        xSemaphoreTake(flash_lock, portMAX_DELAY);
+        log_index_entry_t entry = *sample_log_index_entry(&tiers[tier], segment);
+        xSemaphoreGive(flash_lock);
+        if (!entry.valid || entry.last_time_s < query->from_s) {
+            result->segments_skipped++;
+            continue;
+        }
+        // Segments are in time order, so nothing later can match either
+        if (entry.first_time_s > query->to_s) {
+            result->segments_skipped += stats.segment_count - position + 1;
+            break;
+        }
+
+        // A sealed segment inside the range and inside one step is answered by its summary alone
+        if (step_s > 0 && entry.summarised && entry.first_time_s >= query->from_s && entry.last_time_s <= query->to_s &&
+            entry.first_time_s / step_s == entry.last_time_s / step_s) {
+            log_segment_summary_t summary;
+            xSemaphoreTake(flash_lock, portMAX_DELAY);
+            bool valid = sample_log_read_summary(tier, segment, &summary);
+            xSemaphoreGive(flash_lock);
+            if (valid) {
+                const log_channel_summary_t *channel = &summary.channels[query->channel];
+                result->segments_summarised++;
+                if ((summary.channel_mask & (1u << query->channel)) &&
+                    !sample_log_bucket_add(&bucket, entry.first_time_s / step_s * step_s, channel->mean, channel->min, channel->max, channel->count)) {
+                    stopped = true;
+                }
+                continue;
+            }
+        }
+
+        // One page in RAM at a time
+        for (uint32_t page_index = 1; !stopped && page_index < end_page; page_index++) {
+            log_page_t page;
+            size_t offset = sample_log_segment_offset(&tiers[tier], segment) + page_index * SAMPLE_LOG_PAGE_SIZE;
+            xSemaphoreTake(flash_lock, portMAX_DELAY);
+            esp_err_t ret = esp_partition_read(partition, offset, &page, sizeof(page));
+            xSemaphoreGive(flash_lock);
+            result->pages_read++;
+            if (ret != ESP_OK || sample_log_page_erased(&page)) {
+                break;
+            }
+            if (!sample_log_page_valid(&page, tier) || (have_previous && (int32_t)(page.sequence - previous_sequence) <= 0)) {
+                continue;
+            }
+            have_previous = true;
+            previous_sequence = page.sequence;
+            for (uint8_t i = 0; i < page.count; i++) {
+                const sample_log_record_t *record = &page.records[i];
+                if (record->channel != query->channel || record->time_s < query->from_s || record->time_s > query->to_s) {
+                    continue;
+                }
+                result->records++;
+                bool more = step_s > 0 ? sample_log_bucket_add(&bucket, record->time_s / step_s * step_s, record->mean, record->min, record->max, record->count)
+                                       : visit(record, ctx);
+                if (!more) {
+                    stopped = true;
+                    break;
+                }
+            }
+        }
+    }
+    if (!stopped && bucket.values.count > 0) {
+        sample_log_bucket_emit(&bucket);
+    }
+    result->elapsed_us = esp_timer_get_time() - start_us;
+    return ESP_OK;
+}
+
+void sample_log_get_stats(sample_log_stats_t *stats) {
+    portENTER_CRITICAL(&stats_lock);
+    *stats = log_stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
@@ -0,0 +1,134 @@
+#ifndef SAMPLE_LOG_H
+#define SAMPLE_LOG_H
+
+#include "esp_err.h"
+#include "sample_bus.h"
+#include "window_stats.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Append-only history in its own data partition (see partitions.csv). The
+// partition is split into one circular run of segments per tier; a segment is
+// one erase sector and is erased only when the log wraps round to it again,
+// so the sectors of a tier wear evenly. Page 0 of a segment holds its header
+// and, once the segment is full, a per-channel summary of it; the rest take one
+// page-sized flush each.
+#define SAMPLE_LOG_PARTITION_LABEL "tslog"
+#define SAMPLE_LOG_SEGMENT_SIZE 4096           // Flash erase sector
+#define SAMPLE_LOG_PAGE_SIZE 256               // Flash program page; every write is one
+#define SAMPLE_LOG_PAGES_PER_SEGMENT (SAMPLE_LOG_SEGMENT_SIZE / SAMPLE_LOG_PAGE_SIZE)
+#define SAMPLE_LOG_RECORDS_PER_PAGE 12
+#define SAMPLE_LOG_VERSION 1
+
+// Segments covered by the in-RAM time index (8 bytes each plus flags); any
+// beyond this in a larger partition are left unused
+#define SAMPLE_LOG_MAX_SEGMENTS 256
+
+// Downsampling tiers: every channel is logged as one aggregate per interval,
+// and each tier is built from the one below. Shares are of the partition.
+// With the 960 KB partition that is about 2 days at 1 min, 2 weeks at 15 min
+// and 5 weeks at 1 h.
+#define SAMPLE_LOG_TIER_COUNT 3
+#define SAMPLE_LOG_TIER_INTERVALS_S {60, 900, 3600}
+#define SAMPLE_LOG_TIER_SHARES_PCT {50, 30, 20}
+
+// A part-filled page is flushed anyway once its oldest record is this old
+#define SAMPLE_LOG_MAX_PAGE_AGE_S 600
+
+// Pages waiting for the writer task; a full queue drops the page
+#define SAMPLE_LOG_QUEUE_PAGES 4
+#define SAMPLE_LOG_FLUSH_TIMEOUT_MS 2000
+#define SAMPLE_LOG_STACK_SIZE 3072
+#define SAMPLE_LOG_PRIORITY 3
+
+// One channel over one interval. time_s is on the log clock: seconds since the
+// log was created, carried on across reboots from the newest record found.
+typedef struct {
+    uint32_t time_s;                           // Start of the interval
+    uint8_t channel;                           // window_stats_channel_t
+    uint8_t tier;
+    uint16_t count;                            // Samples behind the aggregate, saturating
+    int32_t mean;                              // Channel units, as in window_stats
+    int32_t min;
+    int32_t max;
+} sample_log_record_t;
+
+// Where a tier stands on flash
+typedef struct {
+    uint32_t interval_s;
+    uint32_t segment_count;
+    uint32_t segments_used;                    // Segments holding a valid header
+    uint32_t head_segment;                     // Segment being filled, relative to the tier's first
+    uint32_t head_page;                        // Next page to write in it
+    uint32_t segment_sequence;
+    uint32_t oldest_time_s;
+    uint32_t newest_time_s;
+} sample_log_tier_stats_t;
+
+// Counters since boot, plus what recovery found
+typedef struct {
+    bool mounted;
+    uint32_t partition_size;
+    uint32_t clock_offset_s;                   // Log time at boot
+    int64_t recovery_us;
+    uint32_t recovery_reads;                   // Flash reads made while recovering
+    uint32_t corrupt_pages;                    // Pages that failed their CRC, skipped
+    uint32_t records;                          // Appended since boot
+    uint32_t pages_written;
+    uint32_t pages_dropped;                    // Lost to a full queue or a write error
+    uint32_t segments_erased;
+    uint64_t bytes_written;
+    int64_t write_us;                          // Writer time spent in flash calls
+    sample_log_tier_stats_t tiers[SAMPLE_LOG_TIER_COUNT];
+} sample_log_stats_t;
+
+// Called for each stored record, oldest first; return false to stop
+typedef bool (*sample_log_visit_fn_t)(const sample_log_record_t *record, void *ctx);
+
+// One channel between two log times, inclusive. A step of 0 returns records
+// as stored; a larger one merges them into step-aligned buckets, each handed
+// over as a record with time_s at the start of its bucket.
+typedef struct {
+    window_stats_channel_t channel;
+    uint32_t from_s;
+    uint32_t to_s;
+    uint32_t step_s;
+} sample_log_query_t;
+
+// What a query cost
+typedef struct {
+    uint8_t tier;                              // Tier the answer came from
+    uint32_t segments_skipped;                 // Outside the range by the index, never read
+    uint32_t segments_summarised;              // Answered by their summary alone
+    uint32_t pages_read;
+    uint32_t records;                          // Matching records read from pages
+    int64_t elapsed_us;
+} sample_log_query_stats_t;
+
+// Find the partition, recover the write position of every tier and start the writer task
+esp_err_t sample_log_init(void);
+
+// Fold one value into the current interval of the first tier
+void sample_log_add(window_stats_channel_t channel, int64_t timestamp_us, int32_t value);
+
+// Fold every channel of a sample bus record
+void sample_log_add_record(const sample_record_t *record);
+
+// Queue part-filled pages and wait up to timeout_ms for the writer to store them
+esp_err_t sample_log_flush(uint32_t timeout_ms);
+
+// Walk the stored records of a tier, oldest first, skipping pages that fail their CRC
+esp_err_t sample_log_for_each(uint8_t tier, sample_log_visit_fn_t visit, void *ctx);
+
+// Stream the records of a query, oldest first. The coarsest tier that reaches
+// back to from_s and is no coarser than the step answers it; segments outside
+// the range are skipped by the index and pages are read one at a time.
+esp_err_t sample_log_query(const sample_log_query_t *query, sample_log_visit_fn_t visit, void *ctx, sample_log_query_stats_t *result);
+
+// Read the counters
+void sample_log_get_stats(sample_log_stats_t *stats);
+
+// Log clock for an esp_timer time
+uint32_t sample_log_time_s(int64_t timestamp_us);
+
+#endif // SAMPLE_LOG_H
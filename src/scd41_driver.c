@@ -1,136 +1,702 @@
 #include "scd41_driver.h"
 #include "esp_log.h"
+#include "dlog.h"
+#include "esp_timer.h"
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "i2c_service.h"
-#include "crc.h"
+#include "sensirion_codec.h"
 
 static const char* TAG = "SCD41_DRIVER";
 
-// Helper function to send command
-esp_err_t scd41_send_command(i2c_master_dev_handle_t dev_handle, uint16_t command) {
-    uint8_t cmd[2];
-    cmd[0] = (command >> 8) & 0xFF;
-    cmd[1] = command & 0xFF;
-    return i2c_write_to_device(dev_handle, cmd, sizeof(cmd));
+// Acquisition state shared by the reader task and the console
+static struct {
+    scd41_mode_t mode;
+    uint32_t generation;            // Bumped on every mode change so waiting readers start over
+    int64_t next_sample_us;         // When the next periodic sample should be out
+    bool poll_late;                 // scd41_poll_sample found the due sample missing
+    uint32_t busy_jobs;             // Long commands queued or running; polls stay off the queue meanwhile
+    bool have_sample;
+    scd41_sample_t sample;
+    int64_t sample_us;
+    scd41_stats_t stats;
+} state;
+static portMUX_TYPE state_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// A queued command and where its result goes
+typedef struct {
+    i2c_master_dev_handle_t dev_handle;
+    scd41_command_t command;
+    scd41_command_cb_t done_cb;
+    void* ctx;
+} scd41_job_t;
+
+// Lets a blocking caller wait for its command
+typedef struct {
+    SemaphoreHandle_t done;
+    esp_err_t result;
+    uint16_t* words;
+} scd41_sync_ctx_t;
+
+static QueueHandle_t command_queue = NULL;
+static TaskHandle_t command_task_handle = NULL;
+
+// Where the poll path's commands complete. Static, because a command the
+// poller stopped waiting for still completes into it later.
+static struct {
+    SemaphoreHandle_t done;
+    StaticSemaphore_t done_buffer;
+    bool pending;                   // Submitted and not completed yet
+    esp_err_t result;
+    uint16_t words[SCD41_MAX_RESPONSE_WORDS];
+} poll_sync;
+
+// Commands a poll must not queue behind: they stop the measurement or take
+// longer than the poll waits
+static bool scd41_is_long_command(const scd41_command_t* command) {
+    return command->needs_idle || command->exec_ms > SCD41_POLL_WAIT_MS;
+}
+
+// Record a mode change and when its first sample is due
+static void scd41_set_state_mode(scd41_mode_t mode) {
+    uint32_t interval_ms = mode == SCD41_MODE_PERIODIC ? SCD41_PERIODIC_INTERVAL_MS :
+                           mode == SCD41_MODE_LOW_POWER_PERIODIC ? SCD41_LOW_POWER_INTERVAL_MS : 0;
+    portENTER_CRITICAL(&state_lock);
+    state.mode = mode;
+    state.generation++;
+    state.next_sample_us = esp_timer_get_time() + (int64_t)interval_ms * 1000;
+    portEXIT_CRITICAL(&state_lock);
+}
+
+// Sleep for at least ms, rounding up to whole ticks plus one for the partial tick
+static void scd41_sleep_ms(uint32_t ms) {
+    vTaskDelay((TickType_t)((ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS) + 1);
+}
+
+// Run one command on the bus: write it, let it execute, then read and check the reply
+static esp_err_t scd41_run_command(i2c_master_dev_handle_t dev_handle, const scd41_command_t* command, uint16_t* words) {
+    uint8_t tx[SENSIRION_FRAME_SIZE(1)];
+    uint8_t rx[SENSIRION_WORD_SIZE * SCD41_MAX_RESPONSE_WORDS];
+    size_t rx_size = SENSIRION_WORD_SIZE * command->response_words;
+    if (command->response_words > SCD41_MAX_RESPONSE_WORDS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t tx_size = sensirion_encode_command(command->command, &command->argument, command->has_argument ? 1 : 0, tx);
+
+    // The bus is released while the sensor works; even a 1 ms command sleeps
+    // rather than holding the bus for a tick or busy-waiting in the arbiter
+    esp_err_t ret = i2c_write_to_device(dev_handle, tx, tx_size);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (command->exec_ms > 0) {
+        scd41_sleep_ms(command->exec_ms);
+    }
+    if (rx_size > 0) {
+        ret = i2c_read_from_device(dev_handle, rx, rx_size);
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    size_t bad_word;
+    ret = sensirion_decode_words(rx, command->response_words, words, &bad_word);
+    if (ret != ESP_OK) {
+        DLOGE(TAG, "CRC mismatch in word %d of the reply to 0x%04X", (int)bad_word, command->command);
+        return ret;
+    }
+
+    // Mode changes only count once the sensor has accepted them
+    switch (command->command) {
+    case START_PERIODIC_MEASUREMENT:
+        scd41_set_state_mode(SCD41_MODE_PERIODIC);
+        break;
+    case START_LOW_POWER_PERIODIC_MEASUREMENT:
+        scd41_set_state_mode(SCD41_MODE_LOW_POWER_PERIODIC);
+        break;
+    case STOP_PERIODIC_MEASUREMENT:
+        scd41_set_state_mode(SCD41_MODE_IDLE);
+        break;
+    default:
+        break;
+    }
+    return ESP_OK;
 }
 
-// Helper function to read data
-esp_err_t scd41_read_data(i2c_master_dev_handle_t dev_handle, uint8_t* data, size_t len) {
-    return i2c_read_from_device(dev_handle, data, len);
+// Run a job, stopping periodic measurement around it when the command needs an idle sensor
+static void scd41_run_job(const scd41_job_t* job) {
+    uint16_t words[SCD41_MAX_RESPONSE_WORDS] = {0};
+    scd41_mode_t resume = job->command.needs_idle ? scd41_get_mode() : SCD41_MODE_IDLE;
+    esp_err_t ret = ESP_OK;
+
+    if (resume != SCD41_MODE_IDLE) {
+        const scd41_command_t stop = { .command = STOP_PERIODIC_MEASUREMENT, .exec_ms = SCD41_STOP_PERIODIC_EXEC_MS };
+        ret = scd41_run_command(job->dev_handle, &stop, NULL);
+    }
+    if (ret == ESP_OK) {
+        ret = scd41_run_command(job->dev_handle, &job->command, words);
+    }
+    if (resume != SCD41_MODE_IDLE && scd41_get_mode() == SCD41_MODE_IDLE) {
+        const scd41_command_t start = {
+            .command = resume == SCD41_MODE_PERIODIC ? START_PERIODIC_MEASUREMENT : START_LOW_POWER_PERIODIC_MEASUREMENT,
+        };
+        esp_err_t restart = scd41_run_command(job->dev_handle, &start, NULL);
+        if (restart != ESP_OK) {
+            DLOGE(TAG, "Failed to resume measurement after 0x%04X: %s", job->command.command, esp_err_to_name(restart));
+        }
+    }
+
+    if (scd41_is_long_command(&job->command)) {
+        portENTER_CRITICAL(&state_lock);
+        state.busy_jobs--;
+        portEXIT_CRITICAL(&state_lock);
+    }
+    if (job->done_cb != NULL) {
+        job->done_cb(ret, words, job->command.response_words, job->ctx);
+    }
+}
+
+// Task that executes queued commands one after another
+static void scd41_command_task(void* arg) {
+    scd41_job_t job;
+    while (true) {
+        if (xQueueReceive(command_queue, &job, portMAX_DELAY) == pdTRUE) {
+            scd41_run_job(&job);
+        }
+    }
+}
+
+static void scd41_sync_done(esp_err_t result, const uint16_t* words, size_t count, void* ctx) {
+    scd41_sync_ctx_t* sync = (scd41_sync_ctx_t*)ctx;
+    sync->result = result;
+    if (sync->words != NULL && result == ESP_OK) {
+        memcpy(sync->words, words, count * sizeof(uint16_t));
+    }
+    xSemaphoreGive(sync->done);
+}
+
+// Queue a command on the executor
+esp_err_t scd41_submit_command(i2c_master_dev_handle_t dev_handle, const scd41_command_t* command, scd41_command_cb_t done_cb, void* ctx) {
+    if (dev_handle == NULL || command == NULL || command->response_words > SCD41_MAX_RESPONSE_WORDS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (command_queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    scd41_job_t job = {
+        .dev_handle = dev_handle,
+        .command = *command,
+        .done_cb = done_cb,
+        .ctx = ctx,
+    };
+
+    // Mark the sensor busy before the job is visible, so no poll queues behind it
+    bool long_command = scd41_is_long_command(command);
+    if (long_command) {
+        portENTER_CRITICAL(&state_lock);
+        state.busy_jobs++;
+        portEXIT_CRITICAL(&state_lock);
+    }
+
+    // A callback already running on the executor would wait on itself, so run inline
+    if (xTaskGetCurrentTaskHandle() == command_task_handle) {
+        scd41_run_job(&job);
+        return ESP_OK;
+    }
+    if (xQueueSend(command_queue, &job, 0) != pdTRUE) {
+        if (long_command) {
+            portENTER_CRITICAL(&state_lock);
+            state.busy_jobs--;
+            portEXIT_CRITICAL(&state_lock);
+        }
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+// Queue a command and wait for it
+esp_err_t scd41_execute_command(i2c_master_dev_handle_t dev_handle, const scd41_command_t* command, uint16_t* words) {
+    StaticSemaphore_t done_buffer;
+    scd41_sync_ctx_t sync = {
+        .done = xSemaphoreCreateBinaryStatic(&done_buffer),
+        .result = ESP_FAIL,
+        .words = words,
+    };
+
+    esp_err_t ret = scd41_submit_command(dev_handle, command, scd41_sync_done, &sync);
+    if (ret == ESP_OK) {
+        xSemaphoreTake(sync.done, portMAX_DELAY);
+        ret = sync.result;
+    }
+    vSemaphoreDelete(sync.done);
+    return ret;
+}
+
+// Send a command word with no reply and wait out its execution time
+esp_err_t scd41_send_command(i2c_master_dev_handle_t dev_handle, uint16_t command, uint32_t exec_ms) {
+    const scd41_command_t cmd = { .command = command, .exec_ms = exec_ms };
+    return scd41_execute_command(dev_handle, &cmd, NULL);
+}
+
+// Send a read command and fetch its CRC-checked reply words
+static esp_err_t scd41_read_words(i2c_master_dev_handle_t dev_handle, uint16_t command, uint32_t exec_ms, uint16_t* words, size_t count) {
+    const scd41_command_t cmd = { .command = command, .exec_ms = exec_ms, .response_words = (uint8_t)count };
+    return scd41_execute_command(dev_handle, &cmd, words);
+}
+
+static void scd41_poll_done(esp_err_t result, const uint16_t* words, size_t count, void* ctx) {
+    portENTER_CRITICAL(&state_lock);
+    poll_sync.result = result;
+    memcpy(poll_sync.words, words, count * sizeof(uint16_t));
+    poll_sync.pending = false;
+    portEXIT_CRITICAL(&state_lock);
+    xSemaphoreGive(poll_sync.done);
+}
+
+// Send a read command for the poll path and wait at most SCD41_POLL_WAIT_MS for
+// its reply; ESP_ERR_TIMEOUT leaves the command to complete unobserved
+static esp_err_t scd41_poll_words(i2c_master_dev_handle_t dev_handle, uint16_t command, uint16_t* words, size_t count) {
+    portENTER_CRITICAL(&state_lock);
+    bool pending = poll_sync.pending;
+    poll_sync.pending = true;
+    portEXIT_CRITICAL(&state_lock);
+    if (pending) {
+        return ESP_ERR_NOT_FINISHED;  // The last one is still queued
+    }
+    // Drop the completion of a command given up on earlier
+    xSemaphoreTake(poll_sync.done, 0);
+
+    const scd41_command_t cmd = { .command = command, .exec_ms = SCD41_READ_EXEC_MS, .response_words = (uint8_t)count };
+    esp_err_t ret = scd41_submit_command(dev_handle, &cmd, scd41_poll_done, NULL);
+    if (ret != ESP_OK) {
+        portENTER_CRITICAL(&state_lock);
+        poll_sync.pending = false;
+        portEXIT_CRITICAL(&state_lock);
+        return ret;
+    }
+    if (xSemaphoreTake(poll_sync.done, pdMS_TO_TICKS(SCD41_POLL_WAIT_MS) ? pdMS_TO_TICKS(SCD41_POLL_WAIT_MS) : 1) != pdTRUE) {
+        DLOGW(TAG, "Gave up on 0x%04X after %d ms", command, SCD41_POLL_WAIT_MS);
+        return ESP_ERR_TIMEOUT;
+    }
+    if (poll_sync.result == ESP_OK) {
+        memcpy(words, poll_sync.words, count * sizeof(uint16_t));
+    }
+    return poll_sync.result;
 }
 
 // Initialize the SCD41
 esp_err_t scd41_init(i2c_master_bus_handle_t bus_handle, i2c_master_dev_handle_t* dev_handle) {
-    return add_i2c_device(bus_handle, dev_handle, SCD41_I2C_ADDRESS);
+    esp_err_t ret = add_i2c_device(bus_handle, dev_handle, SCD41_I2C_ADDRESS);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    if (command_queue == NULL) {
+        command_queue = xQueueCreate(SCD41_CMD_QUEUE_LEN, sizeof(scd41_job_t));
+        if (command_queue == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        if (xTaskCreate(scd41_command_task, "scd41_cmd", SCD41_CMD_STACK_SIZE, NULL, SCD41_CMD_PRIORITY, &command_task_handle) != pdPASS) {
+            return ESP_ERR_NO_MEM;
+        }
+        poll_sync.done = xSemaphoreCreateBinaryStatic(&poll_sync.done_buffer);
+    }
+
+    // The sensor keeps measuring across an MCU reset and then rejects the start command
+    ret = scd41_stop_periodic_measurement(*dev_handle);
+    if (ret != ESP_OK) {
+        DLOGW(TAG, "Stop before start failed: %s", esp_err_to_name(ret));
+    }
+    return scd41_start_periodic_measurement(*dev_handle);
 }
 
 // Start periodic measurement
 esp_err_t scd41_start_periodic_measurement(i2c_master_dev_handle_t dev_handle) {
-    return scd41_send_command(dev_handle, START_PERIODIC_MEASUREMENT);
+    return scd41_send_command(dev_handle, START_PERIODIC_MEASUREMENT, 0);
+}
+
+// Start low-power periodic measurement
+esp_err_t scd41_start_low_power_periodic_measurement(i2c_master_dev_handle_t dev_handle) {
+    return scd41_send_command(dev_handle, START_LOW_POWER_PERIODIC_MEASUREMENT, 0);
 }
 
 // Stop periodic measurement
 esp_err_t scd41_stop_periodic_measurement(i2c_master_dev_handle_t dev_handle) {
-    return scd41_send_command(dev_handle, STOP_PERIODIC_MEASUREMENT);
+    return scd41_send_command(dev_handle, STOP_PERIODIC_MEASUREMENT, SCD41_STOP_PERIODIC_EXEC_MS);
 }
 
-// Read measurement values
-esp_err_t scd41_read_measurement(i2c_master_dev_handle_t dev_handle, uint16_t* co2, float* temperature, float* humidity) {
-    uint8_t data[9];
-    esp_err_t ret = scd41_read_data(dev_handle, data, sizeof(data));
-    if (ret != ESP_OK) {
-        return ret;
+// Switch measurement mode
+esp_err_t scd41_set_mode(i2c_master_dev_handle_t dev_handle, scd41_mode_t mode) {
+    if (mode == scd41_get_mode()) {
+        return ESP_OK;
     }
+    if (scd41_get_mode() != SCD41_MODE_IDLE) {
+        esp_err_t ret = scd41_stop_periodic_measurement(dev_handle);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    switch (mode) {
+    case SCD41_MODE_PERIODIC:
+        return scd41_start_periodic_measurement(dev_handle);
+    case SCD41_MODE_LOW_POWER_PERIODIC:
+        return scd41_start_low_power_periodic_measurement(dev_handle);
+    default:
+        return ESP_OK;
+    }
+}
 
-    // Log raw data for debugging
-    ESP_LOGI(TAG, "Raw data: %02X %02X %02X %02X %02X %02X %02X %02X %02X",
-              data[0], data[1], data[2], data[3], data[4], data[5], data[6], data[7], data[8]);
+// Get the measurement mode
+scd41_mode_t scd41_get_mode(void) {
+    portENTER_CRITICAL(&state_lock);
+    scd41_mode_t mode = state.mode;
+    portEXIT_CRITICAL(&state_lock);
+    return mode;
+}
 
-    // Verify CRC
-    for (int i = 0; i < 3; i++) {
-        uint8_t calculated_crc = calculate_crc(data + (i * 3), 2);
-        if (calculated_crc != data[2 + 3 * i]) {
-            ESP_LOGE(TAG, "CRC mismatch at block %d: Calculated CRC: 0x%02X, Received CRC: 0x%02X", i, calculated_crc, data[2 + 3 * i]);
-            return ESP_ERR_INVALID_CRC;
-        }
+// Get the sample interval of the current mode
+uint32_t scd41_get_interval_ms(void) {
+    switch (state.mode) {
+    case SCD41_MODE_PERIODIC:
+        return SCD41_PERIODIC_INTERVAL_MS;
+    case SCD41_MODE_LOW_POWER_PERIODIC:
+        return SCD41_LOW_POWER_INTERVAL_MS;
+    default:
+        return 0;
     }
+}
 
-    *co2 = (data[0] << 8) | data[1];
-    uint16_t raw_temp = (data[3] << 8) | data[4];
-    uint16_t raw_hum = (data[6] << 8) | data[7];
+// Check whether the mode changed since generation was sampled
+static bool scd41_mode_changed(uint32_t generation) {
+    portENTER_CRITICAL(&state_lock);
+    bool changed = state.generation != generation;
+    portEXIT_CRITICAL(&state_lock);
+    return changed;
+}
 
-    *temperature = -45 + 175 * ((float)raw_temp / 65535);
-    *humidity = 100 * ((float)raw_hum / 65535);
+// Data is ready when any of the 11 least significant bits is set
+static bool scd41_status_ready(uint16_t status) {
+    return (status & 0x07FF) != 0;
+}
 
+// Check for a new measurement
+esp_err_t scd41_get_data_ready(i2c_master_dev_handle_t dev_handle, bool* ready) {
+    uint16_t status;
+    esp_err_t ret = scd41_read_words(dev_handle, GET_DATA_READY_STATUS, SCD41_READ_EXEC_MS, &status, 1);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    *ready = scd41_status_ready(status);
     return ESP_OK;
 }
 
-// Perform single-shot measurement
-esp_err_t scd41_measure_single_shot(i2c_master_dev_handle_t dev_handle) {
-    return scd41_send_command(dev_handle, MEASURE_SINGLE_SHOT);
+// Convert a temperature word: -45 + 175 * raw / 65535 degrees, with 175000 / 65536 as 21875 / 2^13
+int32_t scd41_temperature_mc(uint16_t raw) {
+    return ((21875 * (int32_t)raw) >> 13) - 45000;
 }
 
-// Perform self-test
-esp_err_t scd41_perform_self_test(i2c_master_dev_handle_t dev_handle, bool* malfunction) {
-    uint8_t data[3];
-    esp_err_t ret = scd41_send_command(dev_handle, PERFORM_SELF_TEST);
+// Convert a humidity word: 100 * raw / 65535 percent, with 100000 / 65536 as 12500 / 2^13
+int32_t scd41_humidity_mpct(uint16_t raw) {
+    return (12500 * (int32_t)raw) >> 13;
+}
+
+// Convert the measurement words and keep the sample as the last one read
+static void scd41_store_measurement(const uint16_t* words, scd41_sample_t* sample) {
+    sample->co2_ppm = words[0];
+    sample->temperature_mc = scd41_temperature_mc(words[1]);
+    sample->humidity_mpct = scd41_humidity_mpct(words[2]);
+
+    portENTER_CRITICAL(&state_lock);
+    state.have_sample = true;
+    state.sample = *sample;
+    state.sample_us = esp_timer_get_time();
+    state.stats.samples++;
+    portEXIT_CRITICAL(&state_lock);
+}
+
+// Read measurement values
+esp_err_t scd41_read_measurement(i2c_master_dev_handle_t dev_handle, scd41_sample_t* sample) {
+    uint16_t words[3];
+    esp_err_t ret = scd41_read_words(dev_handle, READ_MEASUREMENT, SCD41_READ_EXEC_MS, words, 3);
     if (ret != ESP_OK) {
         return ret;
     }
 
-    // Wait for 10 seconds for the self-test to complete
-    vTaskDelay(pdMS_TO_TICKS(10000));
+    scd41_store_measurement(words, sample);
+    return ESP_OK;
+}
 
-    ret = scd41_read_data(dev_handle, data, sizeof(data));
-    if (ret != ESP_OK) {
+// Read the next periodic sample on the sensor's own cadence
+esp_err_t scd41_read_next_sample(i2c_master_dev_handle_t dev_handle, scd41_sample_t* sample) {
+    while (true) {
+        portENTER_CRITICAL(&state_lock);
+        uint32_t generation = state.generation;
+        int64_t check_us = state.next_sample_us + SCD41_READ_MARGIN_MS * 1000;
+        portEXIT_CRITICAL(&state_lock);
+        uint32_t interval_ms = scd41_get_interval_ms();
+        if (interval_ms == 0) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        int64_t wait_us = check_us - esp_timer_get_time();
+        if (wait_us > 0) {
+            vTaskDelay(pdMS_TO_TICKS((wait_us + 999) / 1000) ? pdMS_TO_TICKS((wait_us + 999) / 1000) : 1);
+        }
+
+        // Normally the first check finds the sample; a late sample moves the schedule to it
+        bool ready = false;
+        bool late = false;
+        esp_err_t ret = ESP_OK;
+        for (int attempt = 0; attempt <= SCD41_READY_MAX_RETRIES; attempt++) {
+            ret = scd41_get_data_ready(dev_handle, &ready);
+            if (scd41_mode_changed(generation)) {
+                break;
+            }
+            portENTER_CRITICAL(&state_lock);
+            state.stats.ready_checks++;
+            if (ret == ESP_OK && !ready) {
+                state.stats.late_checks++;
+            }
+            portEXIT_CRITICAL(&state_lock);
+            if (ret != ESP_OK || ready) {
+                break;
+            }
+            late = true;
+            vTaskDelay(pdMS_TO_TICKS(SCD41_READY_RETRY_MS) ? pdMS_TO_TICKS(SCD41_READY_RETRY_MS) : 1);
+        }
+        // A self-test or recalibration restarted the measurement underneath us
+        if (scd41_mode_changed(generation)) {
+            continue;
+        }
+        if (ret == ESP_OK && !ready) {
+            ret = ESP_ERR_TIMEOUT;
+        }
+        if (ret == ESP_OK) {
+            ret = scd41_read_measurement(dev_handle, sample);
+        }
+
+        int64_t now_us = esp_timer_get_time();
+        portENTER_CRITICAL(&state_lock);
+        if (ret == ESP_OK && late) {
+            // The sample appeared within the last retry step
+            state.next_sample_us = now_us + (int64_t)interval_ms * 1000;
+        } else if (ret == ESP_OK) {
+            state.next_sample_us += (int64_t)(interval_ms - SCD41_PHASE_NUDGE_MS) * 1000;
+        } else {
+            state.stats.errors++;
+            // Keep the cadence through errors rather than hammering the sensor
+            while (state.next_sample_us <= now_us) {
+                state.next_sample_us += (int64_t)interval_ms * 1000;
+            }
+        }
+        portEXIT_CRITICAL(&state_lock);
+        return ret;
+    }
+}
+
+// Read the periodic sample if it is due, without waiting; for callers on a fixed schedule
+esp_err_t scd41_poll_sample(i2c_master_dev_handle_t dev_handle, scd41_sample_t* sample) {
+    if (scd41_get_interval_ms() == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    portENTER_CRITICAL(&state_lock);
+    uint32_t generation = state.generation;
+    int64_t check_us = state.next_sample_us + SCD41_READ_MARGIN_MS * 1000;
+    portEXIT_CRITICAL(&state_lock);
+    if (esp_timer_get_time() < check_us) {
+        return ESP_ERR_NOT_FINISHED;  // Not due, no bus traffic
+    }
+    // A self-test or recalibration would hold the poll for seconds; pick the sample up after it
+    portENTER_CRITICAL(&state_lock);
+    bool busy = state.busy_jobs > 0;
+    if (busy) {
+        state.stats.busy_skips++;
+    }
+    portEXIT_CRITICAL(&state_lock);
+    if (busy) {
+        return ESP_ERR_NOT_FINISHED;
+    }
+
+    uint16_t status;
+    bool ready = false;
+    esp_err_t ret = scd41_poll_words(dev_handle, GET_DATA_READY_STATUS, &status, 1);
+    if (ret == ESP_ERR_NOT_FINISHED) {
         return ret;
     }
+    if (ret == ESP_OK) {
+        ready = scd41_status_ready(status);
+    }
+    if (scd41_mode_changed(generation)) {
+        return ESP_ERR_NOT_FINISHED;
+    }
+    portENTER_CRITICAL(&state_lock);
+    state.stats.ready_checks++;
+    if (ret == ESP_OK && !ready) {
+        state.stats.late_checks++;
+        state.poll_late = true;
+    }
+    portEXIT_CRITICAL(&state_lock);
+    if (ret == ESP_OK && !ready) {
+        return ESP_ERR_NOT_FINISHED;  // Late; the next poll tries again
+    }
+    if (ret == ESP_OK) {
+        uint16_t words[3];
+        ret = scd41_poll_words(dev_handle, READ_MEASUREMENT, words, 3);
+        if (ret == ESP_OK) {
+            scd41_store_measurement(words, sample);
+        }
+    }
 
-    if (data[0] == 0 && data[1] == 0) {
-        *malfunction = false;
+    uint32_t interval_ms = scd41_get_interval_ms();
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&state_lock);
+    if (ret == ESP_OK && state.poll_late) {
+        // The sample appeared since the last poll; restart the cadence from here
+        state.next_sample_us = now_us + (int64_t)interval_ms * 1000;
+    } else if (ret == ESP_OK) {
+        state.next_sample_us += (int64_t)(interval_ms - SCD41_PHASE_NUDGE_MS) * 1000;
     } else {
-        *malfunction = true;
+        state.stats.errors++;
+    }
+    while (state.next_sample_us <= now_us) {
+        state.next_sample_us += (int64_t)interval_ms * 1000;
     }
+    state.poll_late = false;
+    portEXIT_CRITICAL(&state_lock);
+    return ret;
+}
 
+// Get the cached last measurement
+esp_err_t scd41_get_last_measurement(scd41_sample_t* sample, uint32_t* age_ms) {
+    portENTER_CRITICAL(&state_lock);
+    bool have_sample = state.have_sample;
+    *sample = state.sample;
+    int64_t sample_us = state.sample_us;
+    portEXIT_CRITICAL(&state_lock);
+    if (!have_sample) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *age_ms = (uint32_t)((esp_timer_get_time() - sample_us) / 1000);
+    return ESP_OK;
+}
+
+// Get the acquisition counters
+void scd41_get_stats(scd41_stats_t* stats) {
+    portENTER_CRITICAL(&state_lock);
+    *stats = state.stats;
+    portEXIT_CRITICAL(&state_lock);
+}
+
+// Perform single-shot measurement; returns once the sample is ready to read
+esp_err_t scd41_measure_single_shot(i2c_master_dev_handle_t dev_handle) {
+    return scd41_send_command(dev_handle, MEASURE_SINGLE_SHOT, SCD41_SINGLE_SHOT_EXEC_MS);
+}
+
+// Start the self-test in the background
+esp_err_t scd41_start_self_test(i2c_master_dev_handle_t dev_handle, scd41_command_cb_t done_cb, void* ctx) {
+    const scd41_command_t cmd = {
+        .command = PERFORM_SELF_TEST,
+        .exec_ms = SCD41_SELF_TEST_EXEC_MS,
+        .response_words = 1,
+        .needs_idle = true,
+    };
+    return scd41_submit_command(dev_handle, &cmd, done_cb, ctx);
+}
+
+// Perform self-test
+esp_err_t scd41_perform_self_test(i2c_master_dev_handle_t dev_handle, bool* malfunction) {
+    const scd41_command_t cmd = {
+        .command = PERFORM_SELF_TEST,
+        .exec_ms = SCD41_SELF_TEST_EXEC_MS,
+        .response_words = 1,
+        .needs_idle = true,
+    };
+    uint16_t result;
+    esp_err_t ret = scd41_execute_command(dev_handle, &cmd, &result);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    *malfunction = result != 0;
     return ESP_OK;
 }
 
 // Perform factory reset
 esp_err_t scd41_perform_factory_reset(i2c_master_dev_handle_t dev_handle) {
-    return scd41_send_command(dev_handle, PERFORM_FACTORY_RESET);
+    const scd41_command_t cmd = {
+        .command = PERFORM_FACTORY_RESET,
+        .exec_ms = SCD41_FACTORY_RESET_EXEC_MS,
+        .needs_idle = true,
+    };
+    return scd41_execute_command(dev_handle, &cmd, NULL);
 }
 
 // Reinitialize the sensor
 esp_err_t scd41_reinit(i2c_master_dev_handle_t dev_handle) {
-    return scd41_send_command(dev_handle, REINIT);
+    const scd41_command_t cmd = {
+        .command = REINIT,
+        .exec_ms = SCD41_REINIT_EXEC_MS,
+        .needs_idle = true,
+    };
+    return scd41_execute_command(dev_handle, &cmd, NULL);
 }
 
 // Function to start automatic self-calibration
 esp_err_t scd41_start_automatic_self_calibration(i2c_master_dev_handle_t dev_handle) {
-    uint8_t command[2] = {0x24, 0x16}; // Command to start ASC
-    esp_err_t ret = i2c_write_to_device(dev_handle, command, sizeof(command));
+    const scd41_command_t cmd = {
+        .command = SET_AUTOMATIC_SELF_CALIBRATION_ENABLED,
+        .argument = 1,
+        .has_argument = true,
+        .exec_ms = SCD41_SET_ASC_EXEC_MS,
+        .needs_idle = true,
+    };
+    esp_err_t ret = scd41_execute_command(dev_handle, &cmd, NULL);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to start automatic self-calibration: %s", esp_err_to_name(ret));
+        DLOGE(TAG, "Failed to start automatic self-calibration: %s", esp_err_to_name(ret));
     }
     return ret;
 }
 
-// Function to set forced recalibration
-esp_err_t scd41_set_forced_recalibration(i2c_master_dev_handle_t dev_handle, uint16_t target_co2_concentration) {
-    uint8_t command[2] = {0x36, 0x2F}; // Command to set FRC
-    uint8_t data[3];
-    data[0] = (target_co2_concentration >> 8) & 0xFF;
-    data[1] = target_co2_concentration & 0xFF;
-    data[2] = calculate_crc(data, 2);
-
-    // Append the data to the command
-    uint8_t buffer[5] = {command[0], command[1], data[0], data[1], data[2]};
+// Function to start forced recalibration in the background
+esp_err_t scd41_start_forced_recalibration(i2c_master_dev_handle_t dev_handle, uint16_t target_co2_concentration, scd41_command_cb_t done_cb, void* ctx) {
+    const scd41_command_t cmd = {
+        .command = PERFORM_FORCED_RECALIBRATION,
+        .argument = target_co2_concentration,
+        .has_argument = true,
+        .exec_ms = SCD41_FRC_EXEC_MS,
+        .response_words = 1,
+        .needs_idle = true,
+    };
+    return scd41_submit_command(dev_handle, &cmd, done_cb, ctx);
+}
 
-    esp_err_t ret = i2c_write_to_device(dev_handle, buffer, sizeof(buffer));
+// Function to set forced recalibration
+esp_err_t scd41_set_forced_recalibration(i2c_master_dev_handle_t dev_handle, uint16_t target_co2_concentration, int16_t* correction_ppm) {
+    const scd41_command_t cmd = {
+        .command = PERFORM_FORCED_RECALIBRATION,
+        .argument = target_co2_concentration,
+        .has_argument = true,
+        .exec_ms = SCD41_FRC_EXEC_MS,
+        .response_words = 1,
+        .needs_idle = true,
+    };
+    uint16_t reply;
+    esp_err_t ret = scd41_execute_command(dev_handle, &cmd, &reply);
+    if (ret == ESP_OK) {
+        ret = scd41_decode_frc_correction(reply, correction_ppm);
+    }
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to set forced recalibration: %s", esp_err_to_name(ret));
+        DLOGE(TAG, "Failed to set forced recalibration: %s", esp_err_to_name(ret));
     }
     return ret;
 }
+
+// Function to decode the forced recalibration reply
+esp_err_t scd41_decode_frc_correction(uint16_t reply, int16_t* correction_ppm) {
+    if (reply == SCD41_FRC_FAILED) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    *correction_ppm = (int16_t)((int32_t)reply - SCD41_FRC_OFFSET);
+    return ESP_OK;
+}
@@ -10,30 +10,152 @@
 
 // SCD41 command codes
 #define START_PERIODIC_MEASUREMENT 0x21B1
+#define START_LOW_POWER_PERIODIC_MEASUREMENT 0x21AC
 #define STOP_PERIODIC_MEASUREMENT 0x3F86
+#define READ_MEASUREMENT 0xEC05
+#define GET_DATA_READY_STATUS 0xE4B8
 #define MEASURE_SINGLE_SHOT 0x219D
 #define PERFORM_SELF_TEST 0x3639
+#define PERFORM_FORCED_RECALIBRATION 0x362F
+#define SET_AUTOMATIC_SELF_CALIBRATION_ENABLED 0x2416
 #define PERFORM_FACTORY_RESET 0x3632
 #define REINIT 0x3646
 
+// Sample intervals of the two periodic modes
+#define SCD41_PERIODIC_INTERVAL_MS 5000
+#define SCD41_LOW_POWER_INTERVAL_MS 30000
+
+// Command execution times from the datasheet
+#define SCD41_READ_EXEC_MS 1
+#define SCD41_STOP_PERIODIC_EXEC_MS 500
+#define SCD41_SINGLE_SHOT_EXEC_MS 5000
+#define SCD41_SELF_TEST_EXEC_MS 10000
+#define SCD41_FRC_EXEC_MS 400
+#define SCD41_SET_ASC_EXEC_MS 1
+#define SCD41_FACTORY_RESET_EXEC_MS 1200
+#define SCD41_REINIT_EXEC_MS 30
+
+// Forced recalibration reply: correction + 0x8000 ppm, or 0xFFFF when it failed
+#define SCD41_FRC_OFFSET 0x8000
+#define SCD41_FRC_FAILED 0xFFFF
+
+// Command executor
+#define SCD41_CMD_QUEUE_LEN 8
+#define SCD41_CMD_STACK_SIZE 3072
+#define SCD41_CMD_PRIORITY 5
+#define SCD41_MAX_RESPONSE_WORDS 3
+
+// Read scheduling: check a little after the expected sample, re-check in small steps
+// when it is late, and creep earlier after on-time samples to follow the sensor clock
+#define SCD41_READ_MARGIN_MS 20
+#define SCD41_READY_RETRY_MS 20
+#define SCD41_READY_MAX_RETRIES 50
+#define SCD41_PHASE_NUDGE_MS 2
+
+// scd41_poll_sample waits at most this long for a command. It does not poll
+// at all while a command it could not wait out, or one that stops the
+// measurement, is queued or running.
+#define SCD41_POLL_WAIT_MS 50
+
+// Measurement mode the driver has put the sensor in
+typedef enum {
+    SCD41_MODE_IDLE,
+    SCD41_MODE_PERIODIC,            // New sample every 5 s
+    SCD41_MODE_LOW_POWER_PERIODIC,  // New sample every 30 s
+} scd41_mode_t;
+
+// One measurement in integer units; convert to floats only for display
+typedef struct {
+    uint16_t co2_ppm;
+    int32_t temperature_mc;         // Milli-degrees Celsius
+    int32_t humidity_mpct;          // Milli-percent relative humidity
+} scd41_sample_t;
+
+// Acquisition counters
+typedef struct {
+    uint32_t samples;               // Measurements read
+    uint32_t ready_checks;          // Get-data-ready commands issued
+    uint32_t late_checks;           // Checks that found no new sample yet
+    uint32_t busy_skips;            // Due polls skipped while a long command had the sensor
+    uint32_t errors;
+} scd41_stats_t;
+
+// One sensor command and what the executor has to do around it
+typedef struct {
+    uint16_t command;
+    uint16_t argument;
+    bool has_argument;          // Send argument with its CRC after the command word
+    uint32_t exec_ms;           // Time before the reply is ready and the next command is accepted
+    uint8_t response_words;     // CRC-checked words to read back, at most SCD41_MAX_RESPONSE_WORDS
+    bool needs_idle;            // Stop periodic measurement around the command, then resume it
+} scd41_command_t;
+
+// Completion callback, invoked from the executor task with the words read back
+typedef void (*scd41_command_cb_t)(esp_err_t result, const uint16_t* words, size_t count, void* ctx);
+
 // Function declarations
 
-// Initialize the SCD41
+// Initialize the SCD41 and start periodic measurement
 esp_err_t scd41_init(i2c_master_bus_handle_t bus_handle, i2c_master_dev_handle_t* dev_handle);
 
+// Send a bare command word and wait out its execution time
+esp_err_t scd41_send_command(i2c_master_dev_handle_t dev_handle, uint16_t command, uint32_t exec_ms);
+
+// Queue a command on the executor. Commands run one at a time in submission
+// order; the executor sleeps through execution times without holding the bus
+// and calls done_cb once the reply has been read and CRC-checked.
+esp_err_t scd41_submit_command(i2c_master_dev_handle_t dev_handle, const scd41_command_t* command, scd41_command_cb_t done_cb, void* ctx);
+
+// Queue a command and block the calling task until it completes; words may be NULL
+esp_err_t scd41_execute_command(i2c_master_dev_handle_t dev_handle, const scd41_command_t* command, uint16_t* words);
+
 // Start periodic measurement
 esp_err_t scd41_start_periodic_measurement(i2c_master_dev_handle_t dev_handle);
 
-// Stop periodic measurement
+// Start low-power periodic measurement
+esp_err_t scd41_start_low_power_periodic_measurement(i2c_master_dev_handle_t dev_handle);
+
+// Stop periodic measurement; returns once the sensor accepts commands again
 esp_err_t scd41_stop_periodic_measurement(i2c_master_dev_handle_t dev_handle);
 
-// Read measurement values
-esp_err_t scd41_read_measurement(i2c_master_dev_handle_t dev_handle, uint16_t* co2, float* temperature, float* humidity);
+// Switch between idle, periodic and low-power periodic measurement
+esp_err_t scd41_set_mode(i2c_master_dev_handle_t dev_handle, scd41_mode_t mode);
+
+// Mode the sensor is in and its sample interval (0 when idle)
+scd41_mode_t scd41_get_mode(void);
+uint32_t scd41_get_interval_ms(void);
+
+// Ask whether a new measurement is waiting
+esp_err_t scd41_get_data_ready(i2c_master_dev_handle_t dev_handle, bool* ready);
+
+// Read measurement values. Fails if no new measurement is waiting.
+esp_err_t scd41_read_measurement(i2c_master_dev_handle_t dev_handle, scd41_sample_t* sample);
+
+// Block until the next periodic sample is out and read it, exactly once per sample
+esp_err_t scd41_read_next_sample(i2c_master_dev_handle_t dev_handle, scd41_sample_t* sample);
+
+// Read the next periodic sample only if it is due; ESP_ERR_NOT_FINISHED when
+// it is not, or while a long command has the sensor. Never blocks the caller
+// for more than about SCD41_POLL_WAIT_MS per command.
+esp_err_t scd41_poll_sample(i2c_master_dev_handle_t dev_handle, scd41_sample_t* sample);
+
+// Last sample read by the driver and its age in ms, without touching the bus
+esp_err_t scd41_get_last_measurement(scd41_sample_t* sample, uint32_t* age_ms);
+
+// Convert raw signal words to the sample units, in multiply-shift form
+int32_t scd41_temperature_mc(uint16_t raw);
+int32_t scd41_humidity_mpct(uint16_t raw);
+
+// Read the acquisition counters
+void scd41_get_stats(scd41_stats_t* stats);
 
 // Perform single-shot measurement
 esp_err_t scd41_measure_single_shot(i2c_master_dev_handle_t dev_handle);
 
-// Perform self-test
+// Start the 10 s self-test in the background; words[0] is 0 when the sensor is healthy
+esp_err_t scd41_start_self_test(i2c_master_dev_handle_t dev_handle, scd41_command_cb_t done_cb, void* ctx);
+
+// Perform self-test, blocking the caller for its 10 s
 esp_err_t scd41_perform_self_test(i2c_master_dev_handle_t dev_handle, bool* malfunction);
 
 // Perform factory reset
@@ -45,7 +167,15 @@ esp_err_t scd41_reinit(i2c_master_dev_handle_t dev_handle);
 // Function to start automatic self-calibration
 esp_err_t scd41_start_automatic_self_calibration(i2c_master_dev_handle_t dev_handle);
 
-// Function to set forced recalibration
-esp_err_t scd41_set_forced_recalibration(i2c_master_dev_handle_t dev_handle, uint16_t target_co2_concentration);
+// Function to start forced recalibration in the background. The sensor should
+// have measured at the target concentration for at least 3 minutes; words[0]
+// is the raw reply for scd41_decode_frc_correction.
+esp_err_t scd41_start_forced_recalibration(i2c_master_dev_handle_t dev_handle, uint16_t target_co2_concentration, scd41_command_cb_t done_cb, void* ctx);
+
+// Function to set forced recalibration and read back the applied correction
+esp_err_t scd41_set_forced_recalibration(i2c_master_dev_handle_t dev_handle, uint16_t target_co2_concentration, int16_t* correction_ppm);
+
+// Function to turn the forced recalibration reply into a correction in ppm
+esp_err_t scd41_decode_frc_correction(uint16_t reply, int16_t* correction_ppm);
 
 #endif // SCD41_DRIVER_H
@@ -0,0 +1,35 @@
+#include "sensirion_codec.h"
+#include "crc.h"
+
+// Function to encode words with their CRCs
+size_t sensirion_encode_words(const uint16_t *words, size_t count, uint8_t *buf) {
+    for (size_t i = 0; i < count; i++) {
+        uint8_t *word = buf + SENSIRION_WORD_SIZE * i;
+        word[0] = (uint8_t)(words[i] >> 8);
+        word[1] = (uint8_t)words[i];
+        word[2] = calculate_crc(word, 2);
+    }
+    return SENSIRION_WORD_SIZE * count;
+}
+
+// Function to encode a command and its arguments; the command word carries no CRC
+size_t sensirion_encode_command(uint16_t command, const uint16_t *args, size_t count, uint8_t *buf) {
+    buf[0] = (uint8_t)(command >> 8);
+    buf[1] = (uint8_t)command;
+    return SENSIRION_COMMAND_SIZE + sensirion_encode_words(args, count, buf + SENSIRION_COMMAND_SIZE);
+}
+
+// Function to verify and decode CRC-protected words
+esp_err_t sensirion_decode_words(const uint8_t *buf, size_t count, uint16_t *words, size_t *bad_word) {
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t *word = buf + SENSIRION_WORD_SIZE * i;
+        if (calculate_crc(word, 2) != word[2]) {
+            if (bad_word != NULL) {
+                *bad_word = i;
+            }
+            return ESP_ERR_INVALID_CRC;
+        }
+        words[i] = (uint16_t)((word[0] << 8) | word[1]);
+    }
+    return ESP_OK;
+}
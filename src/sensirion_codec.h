@@ -0,0 +1,25 @@
+#ifndef SENSIRION_CODEC_H
+#define SENSIRION_CODEC_H
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Sensirion sensors frame every 16-bit word as MSB, LSB, CRC-8 of the two
+#define SENSIRION_COMMAND_SIZE 2
+#define SENSIRION_WORD_SIZE 3
+
+// Bytes needed for a command word followed by count argument words
+#define SENSIRION_FRAME_SIZE(count) (SENSIRION_COMMAND_SIZE + SENSIRION_WORD_SIZE * (count))
+
+// Encode count words with their CRCs into buf; returns the bytes written
+size_t sensirion_encode_words(const uint16_t *words, size_t count, uint8_t *buf);
+
+// Encode a command word and count argument words into buf; returns the bytes written
+size_t sensirion_encode_command(uint16_t command, const uint16_t *args, size_t count, uint8_t *buf);
+
+// Verify and decode count words from buf. Fails with ESP_ERR_INVALID_CRC and
+// leaves the index of the first bad word in bad_word (when not NULL).
+esp_err_t sensirion_decode_words(const uint8_t *buf, size_t count, uint16_t *words, size_t *bad_word);
+
+#endif // SENSIRION_CODEC_H
@@ -0,0 +1,334 @@
+#include "sensor_jobs.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "dlog.h"
+#include "scd41_driver.h"
+#include "as7262_driver.h"
+#include "tds_sensor.h"
+#include "tds_calibration.h"
+#include "sensor_scheduler.h"
+#include "sample_bus.h"
+#include "window_stats.h"
+#include "sample_log.h"
+#include "telemetry.h"
+#include "console_out.h"
+#include "config_store.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char* TAG = "SENSOR_JOBS";
+
+// Devices the jobs read
+static i2c_master_dev_handle_t scd41_dev;
+static i2c_master_dev_handle_t as7262_dev;
+
+// Format a milli-unit value with two decimals without going through float
+static const char *format_milli(char *buf, size_t size, int32_t milli) {
+    uint32_t magnitude = milli < 0 ? (uint32_t)-milli : (uint32_t)milli;
+    snprintf(buf, size, "%s%lu.%02lu", milli < 0 ? "-" : "", (unsigned long)(magnitude / 1000), (unsigned long)(magnitude % 1000 / 10));
+    return buf;
+}
+
+// Format an esp_timer timestamp as seconds since boot with microseconds
+static const char *format_timestamp(char *buf, size_t size, int64_t timestamp_us) {
+    snprintf(buf, size, "%" PRId64 ".%06" PRId64, timestamp_us / 1000000, timestamp_us % 1000000);
+    return buf;
+}
+
+// Job to read the SCD41 once its next sample is out
+static void scd41_job(void *arg) {
+    if (scd41_get_mode() == SCD41_MODE_IDLE) {
+        sample_bus_report_error(SAMPLE_SOURCE_SCD41, ESP_ERR_INVALID_STATE);
+        return;
+    }
+    sample_record_t record = {.requested_us = esp_timer_get_time()};
+    esp_err_t ret = scd41_poll_sample(scd41_dev, &record.scd41);
+    if (ret == ESP_OK) {
+        record.timestamp_us = esp_timer_get_time();
+        sample_bus_publish(SAMPLE_SOURCE_SCD41, &record);
+        // There is no water probe; the air can be several degrees off the reservoir,
+        // so it only stands in for the water when the operator asks for it
+        if (config_get_i32(CONFIG_TDS_AIR_COMP) != 0) {
+            tds_calibration_set_temperature(record.scd41.temperature_mc);
+        }
+    } else if (ret != ESP_ERR_NOT_FINISHED) {
+        sample_bus_report_error(SAMPLE_SOURCE_SCD41, ret);
+        DLOGE(TAG, "Error reading SCD41 measurement, code: %s", esp_err_to_name(ret));
+    }
+}
+
+// Job to move frames from the AS7262 stream onto the sample bus
+static void as7262_job(void *arg) {
+    static as7262_stream_frame_t frames[AS7262_STREAM_CAPACITY];
+    static uint32_t read_errors = 0;
+    size_t count = as7262_stream_drain(frames, AS7262_STREAM_CAPACITY);
+    // The stream task reads the sensor; its failures reach the latest-value cache from here
+    as7262_stream_stats_t stats;
+    as7262_stream_get_stats(&stats);
+    if (count == 0 && (!stats.running || stats.read_errors > read_errors)) {
+        sample_bus_report_error(SAMPLE_SOURCE_AS7262, stats.running ? ESP_FAIL : ESP_ERR_INVALID_STATE);
+    }
+    read_errors = stats.read_errors;
+    for (size_t i = 0; i < count; i++) {
+        sample_record_t record = {
+            .requested_us = frames[i].requested_us,
+            .timestamp_us = frames[i].timestamp_us,
+            .as7262.range = frames[i].range,
+            .as7262.saturated = frames[i].saturated,
+        };
+        memcpy(record.as7262.raw, frames[i].raw, sizeof(record.as7262.raw));
+        sample_bus_publish(SAMPLE_SOURCE_AS7262, &record);
+    }
+}
+
+// Job to read the TDS value
+static void tds_job(void *arg) {
+    static bool have_previous = false;
+    static uint32_t previous_sequence;
+    tds_adc_value_t value;
+    esp_err_t ret = read_tds_raw(&value);
+    if (ret != ESP_OK) {
+        sample_bus_report_error(SAMPLE_SOURCE_TDS, ret);
+        DLOGE(TAG, "Failed to read TDS value.");
+        return;
+    }
+    // Publish each filtered window once; the record spans the conversions behind it
+    if (have_previous && value.sequence == previous_sequence) {
+        return;
+    }
+    have_previous = true;
+    previous_sequence = value.sequence;
+    sample_record_t record = {
+        .requested_us = value.start_us,
+        .timestamp_us = value.timestamp_us,
+        .tds.ppm = (int32_t)tds_calibration_to_ppm(value.value),
+        .tds.raw_q4 = value.value,
+    };
+    sample_bus_publish(SAMPLE_SOURCE_TDS, &record);
+}
+
+// Console lines travel as raw records and are formatted on the console_out
+// drain task, so the scheduler task pays for a copy rather than for printf
+typedef struct {
+    int64_t timestamp_us;
+    int32_t temperature_mc;
+    int32_t humidity_mpct;
+    uint16_t co2_ppm;
+} scd41_line_t;
+
+typedef struct {
+    int64_t timestamp_us;
+    int32_t ppm;
+} tds_line_t;
+
+typedef struct {
+    int64_t timestamp_us;
+    uint32_t normalized[AS7262_CHANNEL_COUNT];
+    float correction_factors[AS7262_CHANNEL_COUNT];
+    bool saturated;
+} as7262_corrected_line_t;
+
+typedef struct {
+    int64_t elapsed_us;
+    uint32_t frames;
+    uint32_t green_min;
+    uint32_t green_max;
+    as7262_range_t range;
+} as7262_range_line_t;
+
+_Static_assert(sizeof(as7262_corrected_line_t) <= CONSOLE_OUT_RECORD_MAX, "console records must fit a deferred slot");
+_Static_assert(sizeof(as7262_range_line_t) <= CONSOLE_OUT_RECORD_MAX, "console records must fit a deferred slot");
+
+static int format_scd41_line(char *line, size_t size, const void *record) {
+    const scd41_line_t *reading = record;
+    char temperature[16], humidity[16], stamp[24];
+    return snprintf(line, size, "[%s] SCD41 - CO2: %u ppm, Temperature: %s °C, Humidity: %s %%\n",
+                    format_timestamp(stamp, sizeof(stamp), reading->timestamp_us), reading->co2_ppm,
+                    format_milli(temperature, sizeof(temperature), reading->temperature_mc),
+                    format_milli(humidity, sizeof(humidity), reading->humidity_mpct));
+}
+
+static int format_tds_line(char *line, size_t size, const void *record) {
+    const tds_line_t *reading = record;
+    char stamp[24];
+    return snprintf(line, size, "[%s] TDS Value: %" PRId32 " ppm\n", format_timestamp(stamp, sizeof(stamp), reading->timestamp_us), reading->ppm);
+}
+
+static int format_as7262_corrected_line(char *line, size_t size, const void *record) {
+    const as7262_corrected_line_t *summary = record;
+    float calibrated_data[AS7262_CHANNEL_COUNT];
+    for (int i = 0; i < AS7262_CHANNEL_COUNT; i++) {
+        calibrated_data[i] = (float)summary->normalized[i] / (1 << AS7262_NORMALIZED_SHIFT) * summary->correction_factors[i];
+    }
+    char stamp[24];
+    return snprintf(line, size, "[%s] AS7262 - Corrected: V=%.2f, B=%.2f, G=%.2f, Y=%.2f, O=%.2f, R=%.2f%s\n",
+                    format_timestamp(stamp, sizeof(stamp), summary->timestamp_us), calibrated_data[0], calibrated_data[1], calibrated_data[2],
+                    calibrated_data[3], calibrated_data[4], calibrated_data[5], summary->saturated ? " (saturated)" : "");
+}
+
+static int format_as7262_range_line(char *line, size_t size, const void *record) {
+    const as7262_range_line_t *summary = record;
+    return snprintf(line, size, "AS7262 - gain %.1fx, integration %.1f ms, %lu frames (%.1f/s), green min=%.2f max=%.2f\n",
+                    as7262_gain_factor(summary->range.gain), as7262_integration_ms(summary->range), (unsigned long)summary->frames,
+                    summary->frames * 1e6f / (float)summary->elapsed_us,
+                    (float)summary->green_min / (1 << AS7262_NORMALIZED_SHIFT), (float)summary->green_max / (1 << AS7262_NORMALIZED_SHIFT));
+}
+
+// What the console consumer has seen of the AS7262 since its last summary
+static struct {
+    sample_consumer_t *cursors[SAMPLE_SOURCE_COUNT];
+    uint32_t frames;
+    uint32_t green_min;
+    uint32_t green_max;
+    sample_record_t latest;
+    int64_t start_us;
+} console_view;
+
+// Print the AS7262 summary for the frames seen since the last one
+static void print_as7262_summary(int64_t now_us) {
+    if (console_view.frames == 0) {
+        DLOGE(TAG, "No AS7262 frames in the last 5 seconds");
+        return;
+    }
+    // Normalised counts stay comparable when auto-ranging moves gain or integration
+    const sample_record_t *latest = &console_view.latest;
+    as7262_calibration_t calibration;
+    config_get(CONFIG_AS7262_CAL, &calibration, sizeof(calibration));
+    as7262_corrected_line_t corrected = {
+        .timestamp_us = latest->timestamp_us,
+        .saturated = latest->as7262.saturated,
+    };
+    as7262_normalize(latest->as7262.raw, latest->as7262.range, corrected.normalized);
+    memcpy(corrected.correction_factors, calibration.correction_factors, sizeof(corrected.correction_factors));
+    console_out_defer(format_as7262_corrected_line, &corrected, sizeof(corrected));
+    as7262_range_line_t range = {
+        .elapsed_us = now_us - console_view.start_us,
+        .frames = console_view.frames,
+        .green_min = console_view.green_min,
+        .green_max = console_view.green_max,
+        .range = latest->as7262.range,
+    };
+    console_out_defer(format_as7262_range_line, &range, sizeof(range));
+}
+
+// Job that consumes the sample bus for the console: prints SCD41 and TDS
+// readings as they arrive and summarises the AS7262 every 5 seconds, or in
+// telemetry mode sends every record as binary frames instead
+static void console_job(void *arg) {
+    static sample_record_t batch[SENSOR_JOBS_BATCH_RECORDS];
+    bool binary = telemetry_enabled();
+    for (int source = 0; source < SAMPLE_SOURCE_COUNT; source++) {
+        sample_consumer_t *cursor = console_view.cursors[source];
+        const sample_record_t *records;
+        size_t count;
+        while ((count = sample_bus_peek(cursor, &records)) > 0) {
+            count = count < SENSOR_JOBS_BATCH_RECORDS ? count : SENSOR_JOBS_BATCH_RECORDS;
+            memcpy(batch, records, count * sizeof(*records));
+            // Records the producer overwrote during the copy are torn and count as dropped
+            if (!sample_bus_release(cursor, count)) {
+                continue;
+            }
+            if (binary) {
+                telemetry_send((sample_source_t)source, batch, count);
+                continue;
+            }
+            for (size_t i = 0; i < count; i++) {
+                const sample_record_t *record = &batch[i];
+                if (source == SAMPLE_SOURCE_SCD41) {
+                    scd41_line_t reading = {
+                        .timestamp_us = record->timestamp_us,
+                        .temperature_mc = record->scd41.temperature_mc,
+                        .humidity_mpct = record->scd41.humidity_mpct,
+                        .co2_ppm = record->scd41.co2_ppm,
+                    };
+                    console_out_defer(format_scd41_line, &reading, sizeof(reading));
+                } else if (source == SAMPLE_SOURCE_TDS) {
+                    tds_line_t reading = {.timestamp_us = record->timestamp_us, .ppm = record->tds.ppm};
+                    console_out_defer(format_tds_line, &reading, sizeof(reading));
+                } else {
+                    uint32_t normalized[AS7262_CHANNEL_COUNT];
+                    as7262_normalize(record->as7262.raw, record->as7262.range, normalized);
+                    uint32_t green = normalized[2];
+                    bool first = console_view.frames == 0;
+                    console_view.green_min = first || green < console_view.green_min ? green : console_view.green_min;
+                    console_view.green_max = first || green > console_view.green_max ? green : console_view.green_max;
+                    console_view.latest = *record;
+                    console_view.frames++;
+                }
+            }
+        }
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    if (now_us - console_view.start_us >= AS7262_SUMMARY_US) {
+        if (!binary) {
+            print_as7262_summary(now_us);
+        }
+        console_view.frames = 0;
+        console_view.start_us = now_us;
+    }
+}
+
+// Bus cursors of the windowed statistics
+static sample_consumer_t *stats_cursors[SAMPLE_SOURCE_COUNT];
+
+// Job that folds every new reading into the windowed statistics and the flash log
+static void stats_job(void *arg) {
+    static sample_record_t batch[SENSOR_JOBS_BATCH_RECORDS];
+    for (int source = 0; source < SAMPLE_SOURCE_COUNT; source++) {
+        const sample_record_t *records;
+        size_t count;
+        while ((count = sample_bus_peek(stats_cursors[source], &records)) > 0) {
+            count = count < SENSOR_JOBS_BATCH_RECORDS ? count : SENSOR_JOBS_BATCH_RECORDS;
+            memcpy(batch, records, count * sizeof(*records));
+            // A torn copy must not reach the statistics or the log
+            if (!sample_bus_release(stats_cursors[source], count)) {
+                continue;
+            }
+            for (size_t i = 0; i < count; i++) {
+                window_stats_add_record(&batch[i]);
+                sample_log_add_record(&batch[i]);
+            }
+        }
+    }
+}
+
+// Start the AS7262 stream and put all periodic sensor work on the scheduler
+esp_err_t sensor_jobs_start(i2c_master_dev_handle_t scd41, i2c_master_dev_handle_t as7262, const as7262_stream_config_t *stream_config) {
+    scd41_dev = scd41;
+    as7262_dev = as7262;
+    esp_err_t ret = as7262_stream_start(as7262_dev, stream_config);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start AS7262 stream: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // The console and the statistics read the bus like any other consumer
+    for (int source = 0; source < SAMPLE_SOURCE_COUNT; source++) {
+        ret = sample_bus_subscribe("console", (sample_source_t)source, &console_view.cursors[source]);
+        if (ret == ESP_OK) {
+            ret = sample_bus_subscribe("stats", (sample_source_t)source, &stats_cursors[source]);
+        }
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    console_view.start_us = esp_timer_get_time();
+
+    // Periods changed from the console are kept in the config store
+    const sensor_job_config_t job_configs[] = {
+        {"scd41", (uint32_t)config_get_i32(CONFIG_SCHED_SCD41), SCD41_JOB_PHASE_MS, scd41_job, NULL},
+        {"as7262", (uint32_t)config_get_i32(CONFIG_SCHED_AS7262), AS7262_JOB_PHASE_MS, as7262_job, NULL},
+        {"tds", (uint32_t)config_get_i32(CONFIG_SCHED_TDS), TDS_JOB_PHASE_MS, tds_job, NULL},
+        {"console", (uint32_t)config_get_i32(CONFIG_SCHED_CONSOLE), CONSOLE_JOB_PHASE_MS, console_job, NULL},
+        {"stats", (uint32_t)config_get_i32(CONFIG_SCHED_STATS), STATS_JOB_PHASE_MS, stats_job, NULL},
+    };
+    for (size_t i = 0; i < sizeof(job_configs) / sizeof(job_configs[0]); i++) {
+        ret = sensor_scheduler_add(&job_configs[i]);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,25 @@
+#ifndef SENSOR_JOBS_H
+#define SENSOR_JOBS_H
+
+#include "esp_err.h"
+#include "i2c_service.h"
+#include "as7262_stream.h"
+
+// The periodic sensor work, shared by the firmware and the host simulation:
+// a job per sensor moves readings onto the sample bus, the console job prints
+// them (or sends them as telemetry) and the stats job folds them into the
+// windowed statistics and the history log. The default periods are stored
+// settings, see config_store.h; the phases keep the jobs from waking together.
+#define SCD41_JOB_PHASE_MS 0
+#define AS7262_JOB_PHASE_MS 333
+#define TDS_JOB_PHASE_MS 667
+#define CONSOLE_JOB_PHASE_MS 500
+#define STATS_JOB_PHASE_MS 750
+#define AS7262_SUMMARY_US 5000000
+#define SENSOR_JOBS_BATCH_RECORDS 8          // Records copied off the bus before a consumer uses them
+
+// Start the AS7262 stream and add the jobs to the sensor scheduler; the caller
+// starts the scheduler once any jobs of its own are added
+esp_err_t sensor_jobs_start(i2c_master_dev_handle_t scd41, i2c_master_dev_handle_t as7262, const as7262_stream_config_t *stream_config);
+
+#endif // SENSOR_JOBS_H
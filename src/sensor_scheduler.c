@@ -0,0 +1,245 @@
+#include "sensor_scheduler.h"
+#include "esp_log.h"
+#include "dlog.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <inttypes.h>
+#include <string.h>
+
+static const char *TAG = "SENSOR_SCHED";
+
+// A registered job and where its next deadline is
+typedef struct {
+    sensor_job_config_t config;
+    int64_t deadline_us;
+    int64_t released_us;                   // Deadline of the last run, 0 before the first
+    sensor_job_stats_t stats;
+} sensor_job_t;
+
+static sensor_job_t jobs[SENSOR_SCHED_MAX_JOBS];
+static size_t job_count = 0;
+static int64_t epoch_us = 0;
+static bool started = false;
+static TaskHandle_t scheduler_task_handle = NULL;
+static esp_timer_handle_t wake_timer = NULL;
+static esp_timer_handle_t budget_timer = NULL;
+static sensor_job_t *running_job = NULL;
+static portMUX_TYPE sched_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Wake-up timer fired: the earliest deadline has arrived
+static void sensor_scheduler_wake(void *arg) {
+    xTaskNotifyGive(scheduler_task_handle);
+}
+
+// Budget timer fired: the running job has used up its budget and every other job is waiting on it
+static void sensor_scheduler_overrun(void *arg) {
+    char name[SENSOR_SCHED_NAME_LEN] = "";
+    uint32_t budget_ms = 0;
+    portENTER_CRITICAL(&sched_lock);
+    if (running_job != NULL) {
+        memcpy(name, running_job->stats.name, sizeof(name));
+        budget_ms = running_job->stats.budget_ms;
+    }
+    portEXIT_CRITICAL(&sched_lock);
+    if (name[0] != '\0') {
+        DLOGW(TAG, "Job %s still running after its %" PRIu32 " ms budget", name, budget_ms);
+    }
+}
+
+// First deadline of a job at or after now, keeping its phase against the epoch
+static int64_t sensor_scheduler_first_deadline(const sensor_job_config_t *config, int64_t now_us) {
+    int64_t deadline_us = epoch_us + (int64_t)config->phase_ms * 1000;
+    if (deadline_us < now_us) {
+        int64_t period_us = (int64_t)config->period_ms * 1000;
+        deadline_us += ((now_us - deadline_us + period_us - 1) / period_us) * period_us;
+    }
+    return deadline_us;
+}
+
+// Function to run every job that is due, then sleep until the earliest deadline
+static void sensor_scheduler_task(void *arg) {
+    while (true) {
+        int64_t now_us = esp_timer_get_time();
+
+        // Earliest deadline first; ties go to the job registered first
+        portENTER_CRITICAL(&sched_lock);
+        sensor_job_t *next = NULL;
+        for (size_t i = 0; i < job_count; i++) {
+            if (next == NULL || jobs[i].deadline_us < next->deadline_us) {
+                next = &jobs[i];
+            }
+        }
+        int64_t deadline_us = next != NULL ? next->deadline_us : INT64_MAX;
+        sensor_job_config_t config = next != NULL ? next->config : (sensor_job_config_t){0};
+        portEXIT_CRITICAL(&sched_lock);
+
+        if (deadline_us > now_us) {
+            if (next != NULL) {
+                esp_timer_stop(wake_timer);
+                esp_timer_start_once(wake_timer, (uint64_t)(deadline_us - now_us));
+            }
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        portENTER_CRITICAL(&sched_lock);
+        running_job = next;
+        next->released_us = deadline_us;
+        uint32_t budget_ms = next->stats.budget_ms;
+        portEXIT_CRITICAL(&sched_lock);
+        esp_timer_start_once(budget_timer, (uint64_t)budget_ms * 1000);
+        config.fn(config.ctx);
+        esp_timer_stop(budget_timer);
+        int64_t end_us = esp_timer_get_time();
+
+        // Advance on the absolute grid; deadlines that already passed are skipped, not bunched up
+        portENTER_CRITICAL(&sched_lock);
+        running_job = NULL;
+        if (end_us - now_us > (int64_t)budget_ms * 1000) {
+            next->stats.overruns++;
+        }
+        uint32_t jitter_us = (uint32_t)(now_us - deadline_us);
+        uint32_t run_us = (uint32_t)(end_us - now_us);
+        next->stats.runs++;
+        next->stats.total_jitter_us += jitter_us;
+        next->stats.max_jitter_us = jitter_us > next->stats.max_jitter_us ? jitter_us : next->stats.max_jitter_us;
+        next->stats.max_run_us = run_us > next->stats.max_run_us ? run_us : next->stats.max_run_us;
+        // A period changed during the run has already set the next deadline
+        if (next->deadline_us == deadline_us) {
+            int64_t period_us = (int64_t)next->config.period_ms * 1000;
+            next->deadline_us += period_us;
+            if (next->deadline_us <= end_us) {
+                int64_t behind = (end_us - next->deadline_us) / period_us + 1;
+                next->stats.missed += (uint32_t)behind;
+                next->deadline_us += behind * period_us;
+            }
+        }
+        portEXIT_CRITICAL(&sched_lock);
+    }
+}
+
+esp_err_t sensor_scheduler_add(const sensor_job_config_t *config) {
+    if (config == NULL || config->fn == NULL || config->name == NULL ||
+        strlen(config->name) >= SENSOR_SCHED_NAME_LEN ||
+        config->period_ms < SENSOR_SCHED_MIN_PERIOD_MS || config->period_ms > SENSOR_SCHED_MAX_PERIOD_MS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&sched_lock);
+    if (job_count == SENSOR_SCHED_MAX_JOBS) {
+        portEXIT_CRITICAL(&sched_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    sensor_job_t *job = &jobs[job_count];
+    memset(job, 0, sizeof(*job));
+    job->config = *config;
+    strncpy(job->stats.name, config->name, SENSOR_SCHED_NAME_LEN - 1);
+    job->stats.period_ms = config->period_ms;
+    job->stats.phase_ms = config->phase_ms;
+    job->stats.budget_ms = config->budget_ms > 0 ? config->budget_ms : SENSOR_SCHED_DEFAULT_BUDGET_MS;
+    job->deadline_us = started ? sensor_scheduler_first_deadline(config, esp_timer_get_time()) : 0;
+    job_count++;
+    bool running = started;
+    portEXIT_CRITICAL(&sched_lock);
+
+    if (running) {
+        xTaskNotifyGive(scheduler_task_handle);
+    }
+    return ESP_OK;
+}
+
+esp_err_t sensor_scheduler_start(void) {
+    if (started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_timer_create_args_t timer_args = {
+        .callback = sensor_scheduler_wake,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "sensor_sched",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &wake_timer);
+    if (ret != ESP_OK) {
+        DLOGE(TAG, "Failed to create wake-up timer: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    timer_args.callback = sensor_scheduler_overrun;
+    timer_args.name = "sensor_budget";
+    ret = esp_timer_create(&timer_args, &budget_timer);
+    if (ret != ESP_OK) {
+        DLOGE(TAG, "Failed to create budget timer: %s", esp_err_to_name(ret));
+        esp_timer_delete(wake_timer);
+        wake_timer = NULL;
+        return ret;
+    }
+
+    // Phases count from here
+    portENTER_CRITICAL(&sched_lock);
+    epoch_us = esp_timer_get_time();
+    for (size_t i = 0; i < job_count; i++) {
+        jobs[i].deadline_us = epoch_us + (int64_t)jobs[i].config.phase_ms * 1000;
+    }
+    started = true;
+    portEXIT_CRITICAL(&sched_lock);
+
+    if (xTaskCreate(sensor_scheduler_task, "sensor_sched", SENSOR_SCHED_STACK_SIZE, NULL,
+                    SENSOR_SCHED_PRIORITY, &scheduler_task_handle) != pdPASS) {
+        DLOGE(TAG, "Failed to create scheduler task");
+        esp_timer_delete(wake_timer);
+        esp_timer_delete(budget_timer);
+        wake_timer = NULL;
+        budget_timer = NULL;
+        started = false;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t sensor_scheduler_set_period(const char *name, uint32_t period_ms) {
+    if (period_ms < SENSOR_SCHED_MIN_PERIOD_MS || period_ms > SENSOR_SCHED_MAX_PERIOD_MS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    portENTER_CRITICAL(&sched_lock);
+    for (size_t i = 0; i < job_count; i++) {
+        if (strcmp(jobs[i].config.name, name) == 0) {
+            sensor_job_t *job = &jobs[i];
+            // The next run is one new period after the last release; a job that has
+            // not run yet keeps its first deadline on the phase
+            if (started && job->released_us != 0) {
+                job->deadline_us = job->released_us + (int64_t)period_ms * 1000;
+            }
+            job->config.period_ms = period_ms;
+            job->stats.period_ms = period_ms;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    bool running = started;
+    portEXIT_CRITICAL(&sched_lock);
+
+    if (ret == ESP_OK && running) {
+        xTaskNotifyGive(scheduler_task_handle);
+    }
+    return ret;
+}
+
+size_t sensor_scheduler_get_stats(sensor_job_stats_t *stats, size_t max_jobs, bool reset) {
+    portENTER_CRITICAL(&sched_lock);
+    size_t count = job_count < max_jobs ? job_count : max_jobs;
+    for (size_t i = 0; i < count; i++) {
+        stats[i] = jobs[i].stats;
+    }
+    if (reset) {
+        for (size_t i = 0; i < job_count; i++) {
+            sensor_job_stats_t *job_stats = &jobs[i].stats;
+            job_stats->runs = 0;
+            job_stats->missed = 0;
+            job_stats->max_jitter_us = 0;
+            job_stats->total_jitter_us = 0;
+            job_stats->max_run_us = 0;
+            job_stats->overruns = 0;
+        }
+    }
+    portEXIT_CRITICAL(&sched_lock);
+    return count;
+}
@@ -0,0 +1,60 @@
+#ifndef SENSOR_SCHEDULER_H
+#define SENSOR_SCHEDULER_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SENSOR_SCHED_MAX_JOBS 8
+#define SENSOR_SCHED_NAME_LEN 12
+#define SENSOR_SCHED_STACK_SIZE 4096
+#define SENSOR_SCHED_PRIORITY 5
+#define SENSOR_SCHED_MIN_PERIOD_MS 10
+#define SENSOR_SCHED_MAX_PERIOD_MS 3600000
+#define SENSOR_SCHED_DEFAULT_BUDGET_MS 100   // Run time a job may use before it counts as an overrun
+
+// Job body; runs on the scheduler task and should not block for long. Every
+// other job waits while it runs, so blocking work belongs on its own task.
+typedef void (*sensor_job_fn_t)(void *ctx);
+
+// A periodic job. Deadlines sit at start + phase_ms + n * period_ms, so a slow
+// run never shifts the ones after it. A run longer than budget_ms (0 for
+// SENSOR_SCHED_DEFAULT_BUDGET_MS) is logged while it is still going and
+// counted as an overrun.
+typedef struct {
+    const char *name;
+    uint32_t period_ms;
+    uint32_t phase_ms;
+    sensor_job_fn_t fn;
+    void *ctx;
+    uint32_t budget_ms;
+} sensor_job_config_t;
+
+// Per-job timing counters
+typedef struct {
+    char name[SENSOR_SCHED_NAME_LEN];
+    uint32_t period_ms;
+    uint32_t phase_ms;
+    uint32_t runs;
+    uint32_t missed;              // Deadlines skipped because the scheduler was still busy past them
+    uint32_t max_jitter_us;       // Worst start delay after the deadline
+    uint64_t total_jitter_us;
+    uint32_t max_run_us;          // Longest execution
+    uint32_t budget_ms;
+    uint32_t overruns;            // Runs longer than the budget
+} sensor_job_stats_t;
+
+// Register a job; jobs added after start are scheduled from their next phase point
+esp_err_t sensor_scheduler_add(const sensor_job_config_t *config);
+
+// Start the scheduler task and its wake-up timer
+esp_err_t sensor_scheduler_start(void);
+
+// Change a job's period; the next run is due one new period after its last release
+esp_err_t sensor_scheduler_set_period(const char *name, uint32_t period_ms);
+
+// Copy the counters of up to max_jobs jobs and return how many were copied
+size_t sensor_scheduler_get_stats(sensor_job_stats_t *stats, size_t max_jobs, bool reset);
+
+#endif // SENSOR_SCHEDULER_H
@@ -0,0 +1,293 @@
+#include "tds_adc.h"
+#include "esp_adc/adc_continuous.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "dlog.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <string.h>
+
+static const char *TAG = "TDS_ADC";
+
+static adc_continuous_handle_t adc_handle = NULL;
+static tds_adc_config_t engine_config;
+static TaskHandle_t engine_task_handle = NULL;
+static SemaphoreHandle_t engine_exit = NULL;
+static volatile bool stop_requested = false;
+
+// Published value and counters, shared with readers
+static tds_adc_value_t latest;
+static bool have_latest = false;
+static tds_adc_stats_t engine_stats;
+static portMUX_TYPE engine_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Window being filled; only the median and trimmed mean keep the samples
+static uint16_t window_samples[TDS_ADC_MAX_WINDOW];
+static struct {
+    uint32_t count;
+    uint64_t sum;
+    uint16_t min;
+    uint16_t max;
+} window;
+
+// DMA frame done: wake the reducer, which drains every frame waiting by then
+static bool IRAM_ATTR tds_adc_conv_done(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata, void *user_data) {
+    BaseType_t higher_priority_woken = pdFALSE;
+    vTaskNotifyGiveFromISR(engine_task_handle, &higher_priority_woken);
+    return higher_priority_woken == pdTRUE;
+}
+
+// Pool full: the driver drops the frame, count it
+static bool IRAM_ATTR tds_adc_pool_overflow(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata, void *user_data) {
+    portENTER_CRITICAL_ISR(&engine_lock);
+    engine_stats.pool_overflows++;
+    portEXIT_CRITICAL_ISR(&engine_lock);
+    return false;
+}
+
+// Put the k-th smallest of samples[0..count) at index k, smaller ones before it, larger ones after
+static void tds_adc_select(uint16_t *samples, uint32_t count, uint32_t k) {
+    int32_t left = 0, right = (int32_t)count - 1;
+    while (left < right) {
+        uint16_t pivot = samples[left + (right - left) / 2];
+        int32_t i = left, j = right;
+        while (i <= j) {
+            while (samples[i] < pivot) i++;
+            while (samples[j] > pivot) j--;
+            if (i <= j) {
+                uint16_t tmp = samples[i];
+                samples[i++] = samples[j];
+                samples[j--] = tmp;
+            }
+        }
+        if ((int32_t)k <= j) {
+            right = j;
+        } else if ((int32_t)k >= i) {
+            left = i;
+        } else {
+            return;
+        }
+    }
+}
+
+// Reduce the full window to one value with TDS_ADC_VALUE_SHIFT fraction bits
+static uint32_t tds_adc_reduce(void) {
+    uint32_t n = window.count;
+    switch (engine_config.filter) {
+    case TDS_FILTER_MEDIAN: {
+        tds_adc_select(window_samples, n, n / 2);
+        uint32_t upper = window_samples[n / 2];
+        if (n % 2 != 0) {
+            return upper << TDS_ADC_VALUE_SHIFT;
+        }
+        // Even count: the lower middle is the largest of the lower half
+        uint32_t lower = 0;
+        for (uint32_t i = 0; i < n / 2; i++) {
+            lower = window_samples[i] > lower ? window_samples[i] : lower;
+        }
+        return (lower + upper) << (TDS_ADC_VALUE_SHIFT - 1);
+    }
+    case TDS_FILTER_TRIMMED_MEAN: {
+        uint32_t trim = n * engine_config.trim_percent / 100;
+        if (trim > 0) {
+            tds_adc_select(window_samples, n, trim);
+            tds_adc_select(window_samples + trim, n - trim, n - 2 * trim - 1);
+        }
+        uint64_t sum = 0;
+        for (uint32_t i = trim; i < n - trim; i++) {
+            sum += window_samples[i];
+        }
+        uint32_t kept = n - 2 * trim;
+        return (uint32_t)(((sum << TDS_ADC_VALUE_SHIFT) + kept / 2) / kept);
+    }
+    case TDS_FILTER_MEAN:
+    default:
+        return (uint32_t)(((window.sum << TDS_ADC_VALUE_SHIFT) + n / 2) / n);
+    }
+}
+
+// Fold one DMA frame into the window, publishing whenever it fills
+static void tds_adc_consume(const uint8_t *buf, uint32_t length) {
+    const adc_digi_output_data_t *out = (const adc_digi_output_data_t *)buf;
+    uint32_t count = length / SOC_ADC_DIGI_RESULT_BYTES;
+    uint32_t used = 0;
+    bool keep_samples = engine_config.filter != TDS_FILTER_MEAN;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (out[i].type1.channel != engine_config.channel) {
+            continue;
+        }
+        uint16_t raw = out[i].type1.data;
+        used++;
+        if (keep_samples) {
+            window_samples[window.count] = raw;
+        }
+        window.sum += raw;
+        window.min = window.count == 0 || raw < window.min ? raw : window.min;
+        window.max = window.count == 0 || raw > window.max ? raw : window.max;
+        if (++window.count < engine_config.window) {
+            continue;
+        }
+
+        // Conversions are evenly spaced, so the window start follows from its length
+        int64_t now_us = esp_timer_get_time();
+        tds_adc_value_t value = {
+            .start_us = now_us - (int64_t)engine_config.window * 1000000 / engine_config.sample_rate_hz,
+            .timestamp_us = now_us,
+            .value = tds_adc_reduce(),
+            .min = window.min,
+            .max = window.max,
+        };
+        portENTER_CRITICAL(&engine_lock);
+        value.sequence = engine_stats.windows++;
+        latest = value;
+        have_latest = true;
+        portEXIT_CRITICAL(&engine_lock);
+        memset(&window, 0, sizeof(window));
+    }
+
+    portENTER_CRITICAL(&engine_lock);
+    engine_stats.frames++;
+    engine_stats.samples += used;
+    engine_stats.foreign_samples += count - used;
+    portEXIT_CRITICAL(&engine_lock);
+}
+
+// Task that reduces frames as the DMA completes them, one wake per frame at most
+static void tds_adc_task(void *arg) {
+    static uint8_t frame[TDS_ADC_FRAME_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES];
+    // A missed notification costs at most one frame period of latency
+    TickType_t frame_ticks = pdMS_TO_TICKS(2 * 1000 * TDS_ADC_FRAME_SAMPLES / engine_config.sample_rate_hz) + 1;
+
+    while (!stop_requested) {
+        ulTaskNotifyTake(pdTRUE, frame_ticks);
+        uint32_t length = 0;
+        while (!stop_requested && adc_continuous_read(adc_handle, frame, sizeof(frame), &length, 0) == ESP_OK) {
+            tds_adc_consume(frame, length);
+        }
+    }
+
+    xSemaphoreGive(engine_exit);
+    vTaskDelete(NULL);
+}
+
+// Function to start continuous sampling
+esp_err_t tds_adc_start(const tds_adc_config_t *config) {
+    if (config == NULL || config->window == 0 || config->trim_percent > 49 ||
+        config->sample_rate_hz < SOC_ADC_SAMPLE_FREQ_THRES_LOW || config->sample_rate_hz > SOC_ADC_SAMPLE_FREQ_THRES_HIGH ||
+        (config->filter != TDS_FILTER_MEAN && config->window > TDS_ADC_MAX_WINDOW)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (engine_task_handle != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (engine_exit == NULL) {
+        engine_exit = xSemaphoreCreateBinary();
+        if (engine_exit == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    adc_continuous_handle_cfg_t handle_config = {
+        .max_store_buf_size = TDS_ADC_POOL_FRAMES * TDS_ADC_FRAME_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES,
+        .conv_frame_size = TDS_ADC_FRAME_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES,
+    };
+    esp_err_t ret = adc_continuous_new_handle(&handle_config, &adc_handle);
+    if (ret != ESP_OK) {
+        DLOGE(TAG, "Failed to create continuous ADC handle: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    adc_digi_pattern_config_t pattern = {
+        .atten = TDS_ADC_ATTEN,
+        .channel = config->channel,
+        .unit = ADC_UNIT_1,
+        .bit_width = 12,
+    };
+    adc_continuous_config_t adc_config = {
+        .pattern_num = 1,
+        .adc_pattern = &pattern,
+        .sample_freq_hz = config->sample_rate_hz,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = ADC_DIGI_OUTPUT_FORMAT_TYPE1,
+    };
+    adc_continuous_evt_cbs_t callbacks = {
+        .on_conv_done = tds_adc_conv_done,
+        .on_pool_ovf = tds_adc_pool_overflow,
+    };
+    ret = adc_continuous_config(adc_handle, &adc_config);
+    if (ret == ESP_OK) {
+        ret = adc_continuous_register_event_callbacks(adc_handle, &callbacks, NULL);
+    }
+    if (ret != ESP_OK) {
+        DLOGE(TAG, "Failed to configure continuous ADC: %s", esp_err_to_name(ret));
+        adc_continuous_deinit(adc_handle);
+        adc_handle = NULL;
+        return ret;
+    }
+
+    engine_config = *config;
+    memset(&window, 0, sizeof(window));
+    portENTER_CRITICAL(&engine_lock);
+    memset(&engine_stats, 0, sizeof(engine_stats));
+    engine_stats.running = true;
+    engine_stats.config = *config;
+    have_latest = false;
+    portEXIT_CRITICAL(&engine_lock);
+
+    // The task must exist before the first conversion-done callback
+    stop_requested = false;
+    if (xTaskCreate(tds_adc_task, "tds_adc", TDS_ADC_STACK_SIZE, NULL, TDS_ADC_PRIORITY, &engine_task_handle) != pdPASS) {
+        engine_task_handle = NULL;
+        adc_continuous_deinit(adc_handle);
+        adc_handle = NULL;
+        engine_stats.running = false;
+        return ESP_ERR_NO_MEM;
+    }
+    ret = adc_continuous_start(adc_handle);
+    if (ret != ESP_OK) {
+        DLOGE(TAG, "Failed to start continuous ADC: %s", esp_err_to_name(ret));
+        tds_adc_stop();
+        return ret;
+    }
+    DLOGI(TAG, "Sampling channel %d at %lu Hz, %lu-sample windows", (int)config->channel,
+          (unsigned long)config->sample_rate_hz, (unsigned long)config->window);
+    return ESP_OK;
+}
+
+// Function to stop sampling and wait for the reducer task to exit
+esp_err_t tds_adc_stop(void) {
+    if (engine_task_handle == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    adc_continuous_stop(adc_handle);
+    stop_requested = true;
+    xTaskNotifyGive(engine_task_handle);
+    xSemaphoreTake(engine_exit, portMAX_DELAY);
+    engine_task_handle = NULL;
+    adc_continuous_deinit(adc_handle);
+    adc_handle = NULL;
+
+    portENTER_CRITICAL(&engine_lock);
+    engine_stats.running = false;
+    portEXIT_CRITICAL(&engine_lock);
+    return ESP_OK;
+}
+
+// Function to read the latest filtered value
+esp_err_t tds_adc_get_latest(tds_adc_value_t *value) {
+    portENTER_CRITICAL(&engine_lock);
+    bool have = have_latest;
+    *value = latest;
+    portEXIT_CRITICAL(&engine_lock);
+    return have ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+// Function to read the engine counters
+void tds_adc_get_stats(tds_adc_stats_t *stats) {
+    portENTER_CRITICAL(&engine_lock);
+    *stats = engine_stats;
+    portEXIT_CRITICAL(&engine_lock);
+}
@@ -0,0 +1,75 @@
+#ifndef TDS_ADC_H
+#define TDS_ADC_H
+
+#include "esp_err.h"
+#include "hal/adc_types.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TDS_ADC_FRAME_SAMPLES 512        // Conversions per DMA frame; one task wake per frame
+#define TDS_ADC_POOL_FRAMES 4            // Finished frames the driver can hold
+#define TDS_ADC_MAX_WINDOW 2048          // Largest window the median and trimmed mean can sort
+#define TDS_ADC_STACK_SIZE 3072
+#define TDS_ADC_PRIORITY 4
+
+// Attenuation shared by both sampling paths and the voltage calibration
+#define TDS_ADC_ATTEN ADC_ATTEN_DB_0
+
+// 20 kHz is the ESP32 minimum; 2048-sample trimmed windows publish about 10 values per second
+#define TDS_ADC_DEFAULT_RATE_HZ 20000
+#define TDS_ADC_DEFAULT_WINDOW 2048
+#define TDS_ADC_DEFAULT_TRIM_PERCENT 10
+
+// Filtered values carry four extra bits gained by oversampling
+#define TDS_ADC_VALUE_SHIFT 4
+
+// How a window of conversions is reduced to one value
+typedef enum {
+    TDS_FILTER_MEAN,                     // Oversampling average, no sorting
+    TDS_FILTER_MEDIAN,                   // Rejects impulse noise
+    TDS_FILTER_TRIMMED_MEAN,             // Drops trim_percent from each end, averages the rest
+} tds_filter_t;
+
+// Continuous sampling setup
+typedef struct {
+    adc_channel_t channel;
+    uint32_t sample_rate_hz;             // 20 kHz to 2 MHz on the ESP32
+    uint32_t window;                     // Conversions per published value
+    tds_filter_t filter;
+    uint8_t trim_percent;                // Trimmed mean only, 0-49
+} tds_adc_config_t;
+
+// One filtered value
+typedef struct {
+    int64_t start_us;                    // esp_timer time of the window's first conversion
+    int64_t timestamp_us;                // esp_timer time the window closed
+    uint32_t sequence;
+    uint32_t value;                      // Filtered raw counts, TDS_ADC_VALUE_SHIFT fraction bits
+    uint16_t min;                        // Spread of the raw window
+    uint16_t max;
+} tds_adc_value_t;
+
+// Engine counters since the last start
+typedef struct {
+    bool running;
+    tds_adc_config_t config;
+    uint32_t frames;                     // DMA frames reduced
+    uint32_t samples;                    // Conversions used
+    uint32_t foreign_samples;            // Conversions of other channels, skipped
+    uint32_t windows;                    // Values published
+    uint32_t pool_overflows;             // Frames the driver dropped because the task fell behind
+} tds_adc_stats_t;
+
+// Start DMA sampling of config->channel and publish one filtered value per window
+esp_err_t tds_adc_start(const tds_adc_config_t *config);
+
+// Stop sampling and release the ADC unit
+esp_err_t tds_adc_stop(void);
+
+// Latest filtered value; ESP_ERR_NOT_FOUND until the first window has closed
+esp_err_t tds_adc_get_latest(tds_adc_value_t *value);
+
+// Read the engine counters
+void tds_adc_get_stats(tds_adc_stats_t *stats);
+
+#endif // TDS_ADC_H
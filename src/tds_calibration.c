@@ -0,0 +1,289 @@
+#include "tds_calibration.h"
+#include "tds_sensor.h"
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "esp_log.h"
+#include "dlog.h"
+#include "freertos/FreeRTOS.h"
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "TDS_CAL";
+
+// Gravity TDS probe: 0.5 x (133.42 V^3 - 255.86 V^2 + 857.39 V)
+static const float default_coefficients[4] = {0.0f, 428.695f, -127.93f, 66.71f};
+
+// One generation of lookup tables
+typedef struct {
+    uint16_t raw_to_mv[TDS_LUT_RAW_ENTRIES];      // Calibrated mV, TDS_MV_SHIFT fraction bits
+    uint16_t mv_to_ppm[TDS_LUT_PPM_ENTRIES];      // ppm at 25 °C
+} tds_lut_t;
+
+// Two generations so readers never see a table being rebuilt. The hot path
+// reads the table pointer and the compensation factor as single aligned
+// words without taking the lock; each is valid on its own.
+static tds_lut_t luts[2];
+static const tds_lut_t *volatile active_lut = NULL;
+static tds_calibration_t active_cal;
+static int32_t water_temperature_mc = TDS_CAL_REFERENCE_MC;
+static volatile uint32_t compensation_q16 = 1 << 16;
+static portMUX_TYPE cal_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static adc_cali_handle_t cali_handle = NULL;
+static bool cali_tried = false;
+
+// Function to create the chip's ADC calibration scheme, once
+static void tds_calibration_init_scheme(void) {
+    if (cali_tried) {
+        return;
+    }
+    cali_tried = true;
+    esp_err_t ret = ESP_ERR_NOT_SUPPORTED;
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+    adc_cali_curve_fitting_config_t cali_config = {
+        .unit_id = ADC_UNIT_1,
+        .chan = TDS_ADC_CHANNEL,
+        .atten = TDS_ADC_ATTEN,
+        .bitwidth = ADC_BITWIDTH_12,
+    };
+    ret = adc_cali_create_scheme_curve_fitting(&cali_config, &cali_handle);
+#elif ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+    adc_cali_line_fitting_config_t cali_config = {
+        .unit_id = ADC_UNIT_1,
+        .atten = TDS_ADC_ATTEN,
+        .bitwidth = ADC_BITWIDTH_12,
+#if CONFIG_IDF_TARGET_ESP32
+        .default_vref = 1100,
+#endif
+    };
+    ret = adc_cali_create_scheme_line_fitting(&cali_config, &cali_handle);
+#endif
+    if (ret != ESP_OK) {
+        cali_handle = NULL;
+        DLOGW(TAG, "ADC calibration unavailable (%s), assuming a nominal %d mV full scale",
+              esp_err_to_name(ret), TDS_CAL_NOMINAL_FULL_SCALE_MV);
+    }
+}
+
+// Function to evaluate the calibration polynomial at V volts
+static float tds_calibration_poly(const float *coefficients, float volts) {
+    return coefficients[0] + volts * (coefficients[1] + volts * (coefficients[2] + volts * coefficients[3]));
+}
+
+// Function to compute 1 / (1 + alpha (T - 25)) in Q16
+static uint32_t tds_calibration_compensation(float temp_coeff, int32_t temperature_mc) {
+    float factor = 1.0f + temp_coeff * (float)(temperature_mc - TDS_CAL_REFERENCE_MC) / 1000.0f;
+    return (uint32_t)lrintf(65536.0f / factor);
+}
+
+// Function to linearly interpolate a table at index + fraction / 2^fraction_bits
+static inline uint32_t tds_lut_lerp(const uint16_t *table, uint32_t entries, uint32_t position, uint32_t fraction_bits) {
+    uint32_t index = position >> fraction_bits;
+    if (index >= entries - 1) {
+        return table[entries - 1];
+    }
+    int32_t low = table[index];
+    int32_t high = table[index + 1];
+    int32_t fraction = (int32_t)(position & ((1u << fraction_bits) - 1));
+    return (uint32_t)(low + (((high - low) * fraction) >> fraction_bits));
+}
+
+// Function to rebuild one table generation from a calibration
+static void tds_calibration_build(tds_lut_t *lut, const tds_calibration_t *cal) {
+    for (uint32_t i = 0; i < TDS_LUT_RAW_ENTRIES; i++) {
+        int raw = (int)(i << TDS_LUT_RAW_STEP_SHIFT);
+        raw = raw > 4095 ? 4095 : raw;
+        int mv;
+        if (cali_handle == NULL || adc_cali_raw_to_voltage(cali_handle, raw, &mv) != ESP_OK) {
+            mv = (raw * TDS_CAL_NOMINAL_FULL_SCALE_MV + 2047) / 4095;
+        }
+        lut->raw_to_mv[i] = (uint16_t)(mv << TDS_MV_SHIFT);
+    }
+    // The last entry sits past the top code; extend the final slope rather than repeat it
+    lut->raw_to_mv[TDS_LUT_RAW_ENTRIES - 1] = (uint16_t)(2 * lut->raw_to_mv[TDS_LUT_RAW_ENTRIES - 2] - lut->raw_to_mv[TDS_LUT_RAW_ENTRIES - 3]);
+
+    for (uint32_t i = 0; i < TDS_LUT_PPM_ENTRIES; i++) {
+        float volts = (float)(i << TDS_LUT_MV_STEP_SHIFT) / 1000.0f;
+        float ppm = tds_calibration_poly(cal->coefficients, volts);
+        ppm = ppm < 0.0f ? 0.0f : ppm > 65535.0f ? 65535.0f : ppm;
+        lut->mv_to_ppm[i] = (uint16_t)lrintf(ppm);
+    }
+}
+
+void tds_calibration_defaults(tds_calibration_t *cal) {
+    memset(cal, 0, sizeof(*cal));
+    cal->version = TDS_CAL_VERSION;
+    memcpy(cal->coefficients, default_coefficients, sizeof(cal->coefficients));
+    cal->temp_coeff = TDS_CAL_DEFAULT_TEMP_COEFF;
+}
+
+esp_err_t tds_calibration_fit(tds_calibration_t *cal) {
+    if (cal->point_count > TDS_CAL_MAX_POINTS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (cal->point_count == 0) {
+        memcpy(cal->coefficients, default_coefficients, sizeof(cal->coefficients));
+        return ESP_OK;
+    }
+    if (cal->point_count == 1) {
+        // Single reference solution: keep the probe's curve shape, correct its slope
+        float volts = cal->points[0].mv / 1000.0f;
+        float nominal = tds_calibration_poly(default_coefficients, volts);
+        if (nominal <= 0.0f) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        float k = cal->points[0].ppm / nominal;
+        for (int i = 0; i < 4; i++) {
+            cal->coefficients[i] = default_coefficients[i] * k;
+        }
+        return ESP_OK;
+    }
+
+    // Least squares through the origin, ppm = sum c[j] V^j for j = 1..degree
+    int degree = cal->point_count < 3 ? cal->point_count : 3;
+    double a[3][4] = {{0}};
+    for (int p = 0; p < cal->point_count; p++) {
+        double v = cal->points[p].mv / 1000.0;
+        double powers[7] = {1.0};
+        for (int k = 1; k < 7; k++) {
+            powers[k] = powers[k - 1] * v;
+        }
+        for (int j = 0; j < degree; j++) {
+            for (int k = 0; k < degree; k++) {
+                a[j][k] += powers[j + k + 2];
+            }
+            a[j][degree] += cal->points[p].ppm * powers[j + 1];
+        }
+    }
+    for (int col = 0; col < degree; col++) {
+        int pivot = col;
+        for (int row = col + 1; row < degree; row++) {
+            if (fabs(a[row][col]) > fabs(a[pivot][col])) {
+                pivot = row;
+            }
+        }
+        if (fabs(a[pivot][col]) < 1e-12) {
+            return ESP_ERR_INVALID_ARG;  // Points at the same voltage
+        }
+        for (int k = 0; k <= degree; k++) {
+            double swap = a[col][k];
+            a[col][k] = a[pivot][k];
+            a[pivot][k] = swap;
+        }
+        for (int row = 0; row < degree; row++) {
+            if (row != col) {
+                double factor = a[row][col] / a[col][col];
+                for (int k = col; k <= degree; k++) {
+                    a[row][k] -= factor * a[col][k];
+                }
+            }
+        }
+    }
+    memset(cal->coefficients, 0, sizeof(cal->coefficients));
+    for (int j = 0; j < degree; j++) {
+        cal->coefficients[j + 1] = (float)(a[j][degree] / a[j][j]);
+    }
+    return ESP_OK;
+}
+
+esp_err_t tds_calibration_validate(const tds_calibration_t *cal) {
+    if (cal->version != TDS_CAL_VERSION || cal->point_count > TDS_CAL_MAX_POINTS ||
+        !(cal->temp_coeff >= 0.0f && cal->temp_coeff <= TDS_CAL_MAX_TEMP_COEFF)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < 4; i++) {
+        if (!isfinite(cal->coefficients[i])) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t tds_calibration_apply(const tds_calibration_t *cal) {
+    esp_err_t ret = tds_calibration_validate(cal);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    tds_calibration_init_scheme();
+
+    // Fill the generation readers are not using, then switch in one step
+    tds_lut_t *next = active_lut == &luts[0] ? &luts[1] : &luts[0];
+    tds_calibration_build(next, cal);
+
+    taskENTER_CRITICAL(&cal_lock);
+    active_cal = *cal;
+    active_lut = next;
+    compensation_q16 = tds_calibration_compensation(cal->temp_coeff, water_temperature_mc);
+    taskEXIT_CRITICAL(&cal_lock);
+    DLOGI(TAG, "Lookup tables rebuilt from %u calibration points", cal->point_count);
+    return ESP_OK;
+}
+
+void tds_calibration_get(tds_calibration_t *cal) {
+    taskENTER_CRITICAL(&cal_lock);
+    bool configured = active_lut != NULL;
+    *cal = active_cal;
+    taskEXIT_CRITICAL(&cal_lock);
+    if (!configured) {
+        tds_calibration_defaults(cal);
+    }
+}
+
+esp_err_t tds_calibration_add_point(tds_calibration_t *cal, uint32_t raw_q4, uint16_t ppm) {
+    if (cal->point_count >= TDS_CAL_MAX_POINTS) {
+        return ESP_ERR_NO_MEM;
+    }
+    // Refer the voltage to 25 °C with the calibration's own coefficient
+    uint32_t mv_q4 = tds_calibration_raw_to_mv(raw_q4);
+    uint32_t compensation = tds_calibration_compensation(cal->temp_coeff, tds_calibration_get_temperature());
+    uint32_t mv = (uint32_t)(((uint64_t)mv_q4 * compensation + (1u << (15 + TDS_MV_SHIFT))) >> (16 + TDS_MV_SHIFT));
+
+    tds_calibration_t candidate = *cal;
+    candidate.points[candidate.point_count].mv = (uint16_t)mv;
+    candidate.points[candidate.point_count].ppm = ppm;
+    candidate.point_count++;
+    esp_err_t ret = tds_calibration_fit(&candidate);
+    if (ret == ESP_OK) {
+        *cal = candidate;
+    }
+    return ret;
+}
+
+void tds_calibration_set_temperature(int32_t temperature_mc) {
+    temperature_mc = temperature_mc < TDS_CAL_MIN_TEMP_MC ? TDS_CAL_MIN_TEMP_MC : temperature_mc;
+    temperature_mc = temperature_mc > TDS_CAL_MAX_TEMP_MC ? TDS_CAL_MAX_TEMP_MC : temperature_mc;
+    taskENTER_CRITICAL(&cal_lock);
+    float temp_coeff = active_lut != NULL ? active_cal.temp_coeff : TDS_CAL_DEFAULT_TEMP_COEFF;
+    taskEXIT_CRITICAL(&cal_lock);
+    uint32_t compensation = tds_calibration_compensation(temp_coeff, temperature_mc);
+    taskENTER_CRITICAL(&cal_lock);
+    water_temperature_mc = temperature_mc;
+    compensation_q16 = compensation;
+    taskEXIT_CRITICAL(&cal_lock);
+}
+
+int32_t tds_calibration_get_temperature(void) {
+    taskENTER_CRITICAL(&cal_lock);
+    int32_t temperature_mc = water_temperature_mc;
+    taskEXIT_CRITICAL(&cal_lock);
+    return temperature_mc;
+}
+
+uint32_t tds_calibration_raw_to_mv(uint32_t raw_q4) {
+    const tds_lut_t *lut = active_lut;
+    if (lut == NULL) {
+        return (uint32_t)(((uint64_t)raw_q4 * TDS_CAL_NOMINAL_FULL_SCALE_MV) / 4095);
+    }
+    return tds_lut_lerp(lut->raw_to_mv, TDS_LUT_RAW_ENTRIES, raw_q4, TDS_ADC_VALUE_SHIFT + TDS_LUT_RAW_STEP_SHIFT);
+}
+
+uint32_t tds_calibration_to_ppm(uint32_t raw_q4) {
+    const tds_lut_t *lut = active_lut;
+    uint32_t compensation = compensation_q16;
+    if (lut == NULL) {
+        return 0;
+    }
+    uint32_t mv_q4 = tds_lut_lerp(lut->raw_to_mv, TDS_LUT_RAW_ENTRIES, raw_q4, TDS_ADC_VALUE_SHIFT + TDS_LUT_RAW_STEP_SHIFT);
+    uint32_t mv25_q4 = (uint32_t)(((uint64_t)mv_q4 * compensation) >> 16);
+    return tds_lut_lerp(lut->mv_to_ppm, TDS_LUT_PPM_ENTRIES, mv25_q4, TDS_MV_SHIFT + TDS_LUT_MV_STEP_SHIFT);
+}
@@ -0,0 +1,76 @@
+#ifndef TDS_CALIBRATION_H
+#define TDS_CALIBRATION_H
+
+#include "esp_err.h"
+#include <stdint.h>
+
+#define TDS_CAL_VERSION 1
+#define TDS_CAL_MAX_POINTS 4
+
+// Conductivity rises about 2 % per °C; readings are referred to 25 °C
+#define TDS_CAL_REFERENCE_MC 25000
+#define TDS_CAL_DEFAULT_TEMP_COEFF 0.02f
+#define TDS_CAL_MAX_TEMP_COEFF 0.03f
+#define TDS_CAL_MIN_TEMP_MC 0
+#define TDS_CAL_MAX_TEMP_MC 50000
+
+// Fallback when the chip has no ADC calibration eFuses: 0 dB full scale
+#define TDS_CAL_NOMINAL_FULL_SCALE_MV 950
+
+// Lookup tables, rebuilt whenever the calibration changes. Both interpolate
+// linearly between entries, so the hot path is two lookups and a multiply.
+#define TDS_LUT_RAW_STEP_SHIFT 4                                        // Raw -> mV entry every 16 counts
+#define TDS_LUT_RAW_ENTRIES ((4096 >> TDS_LUT_RAW_STEP_SHIFT) + 1)
+#define TDS_LUT_MV_STEP_SHIFT 2                                         // mV -> ppm entry every 4 mV
+#define TDS_LUT_MV_MAX 2048                                             // Covers cold water compensation at 0 dB
+#define TDS_LUT_PPM_ENTRIES ((TDS_LUT_MV_MAX >> TDS_LUT_MV_STEP_SHIFT) + 1)
+
+// Voltages carry four fraction bits, like the filtered raw counts
+#define TDS_MV_SHIFT 4
+
+// One captured reference solution, voltage already compensated to 25 °C
+typedef struct {
+    uint16_t mv;
+    uint16_t ppm;
+} tds_cal_point_t;
+
+// Persisted calibration; ppm = c[0] + c[1] V + c[2] V^2 + c[3] V^3 with V in volts at 25 °C
+typedef struct {
+    uint16_t version;
+    uint8_t point_count;
+    tds_cal_point_t points[TDS_CAL_MAX_POINTS];
+    float coefficients[4];
+    float temp_coeff;                    // Fractional change per °C
+} tds_calibration_t;
+
+// Probe defaults: the Gravity TDS cubic with a 0.5 TDS factor and no captured points
+void tds_calibration_defaults(tds_calibration_t *cal);
+
+// Refit the polynomial to the captured points: one point scales the default
+// curve, more fit a polynomial through the origin of up to third degree
+esp_err_t tds_calibration_fit(tds_calibration_t *cal);
+
+// Check a calibration's version, point count and coefficients
+esp_err_t tds_calibration_validate(const tds_calibration_t *cal);
+
+// Validate a calibration, rebuild the lookup tables and switch to them
+esp_err_t tds_calibration_apply(const tds_calibration_t *cal);
+
+// Copy of the calibration in use
+void tds_calibration_get(tds_calibration_t *cal);
+
+// Capture a reference solution from a filtered raw reading at the current
+// water temperature, then refit. The caller applies and saves the result.
+esp_err_t tds_calibration_add_point(tds_calibration_t *cal, uint32_t raw_q4, uint16_t ppm);
+
+// Water temperature used for compensation, in m°C, clamped to the probe range
+void tds_calibration_set_temperature(int32_t temperature_mc);
+int32_t tds_calibration_get_temperature(void);
+
+// Filtered raw counts (TDS_ADC_VALUE_SHIFT fraction bits) to calibrated probe voltage (TDS_MV_SHIFT fraction bits)
+uint32_t tds_calibration_raw_to_mv(uint32_t raw_q4);
+
+// Filtered raw counts to ppm at the current water temperature
+uint32_t tds_calibration_to_ppm(uint32_t raw_q4);
+
+#endif // TDS_CALIBRATION_H
@@ -1,51 +1,97 @@
 #include "tds_sensor.h"
+#include "tds_calibration.h"
 #include "esp_log.h"
+#include "dlog.h"
 #include "esp_adc/adc_oneshot.h"
 #include "esp_adc/adc_continuous.h"
-
-#define TDS_ADC_CHANNEL ADC_CHANNEL_6 // Adjust based on your actual ADC channel
+#include "esp_timer.h"
 
 static const char *TAG = "TDS_SENSOR";
 static adc_oneshot_unit_handle_t adc_handle = NULL;
 
 esp_err_t initialize_tds_sensor(void) {
+    tds_adc_config_t continuous_config = {
+        .channel = TDS_ADC_CHANNEL,
+        .sample_rate_hz = TDS_ADC_DEFAULT_RATE_HZ,
+        .window = TDS_ADC_DEFAULT_WINDOW,
+        .filter = TDS_FILTER_TRIMMED_MEAN,
+        .trim_percent = TDS_ADC_DEFAULT_TRIM_PERCENT,
+    };
+    esp_err_t ret = tds_adc_start(&continuous_config);
+    if (ret == ESP_OK) {
+        return ESP_OK;
+    }
+    DLOGW(TAG, "Continuous sampling unavailable (%s), using one-shot reads", esp_err_to_name(ret));
+
     adc_oneshot_unit_init_cfg_t init_config = {
         .unit_id = ADC_UNIT_1,
         .ulp_mode = ADC_ULP_MODE_DISABLE,
     };
-    esp_err_t ret = adc_oneshot_new_unit(&init_config, &adc_handle);
+    ret = adc_oneshot_new_unit(&init_config, &adc_handle);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to initialize ADC unit: %s", esp_err_to_name(ret));
+        DLOGE(TAG, "Failed to initialize ADC unit: %s", esp_err_to_name(ret));
         return ret;
     }
 
     adc_oneshot_chan_cfg_t config = {
         .bitwidth = ADC_BITWIDTH_DEFAULT,
-        .atten = ADC_ATTEN_DB_0,
+        .atten = TDS_ADC_ATTEN,
     };
     ret = adc_oneshot_config_channel(adc_handle, TDS_ADC_CHANNEL, &config);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to configure ADC channel: %s", esp_err_to_name(ret));
+        DLOGE(TAG, "Failed to configure ADC channel: %s", esp_err_to_name(ret));
         return ret;
     }
 
     return ESP_OK;
 }
 
-float read_tds_sensor(void) {
+esp_err_t read_tds_raw(tds_adc_value_t *value) {
+    // The continuous engine already has a filtered value
+    esp_err_t ret = tds_adc_get_latest(value);
+    if (ret == ESP_OK) {
+        if (esp_timer_get_time() - value->timestamp_us > TDS_STALE_MS * 1000) {
+            return ESP_ERR_TIMEOUT;
+        }
+        return ESP_OK;
+    }
+    tds_adc_stats_t stats;
+    tds_adc_get_stats(&stats);
+    if (stats.running) {
+        return ESP_ERR_NOT_FOUND;  // First window still filling
+    }
+
     if (adc_handle == NULL) {
-        ESP_LOGE(TAG, "ADC handle not initialized");
-        return -1.0;
+        DLOGE(TAG, "ADC handle not initialized");
+        return ESP_ERR_INVALID_STATE;
     }
 
+    static uint32_t oneshot_sequence = 0;
     int raw_value;
-    esp_err_t ret = adc_oneshot_read(adc_handle, TDS_ADC_CHANNEL, &raw_value);
+    int64_t start_us = esp_timer_get_time();
+    ret = adc_oneshot_read(adc_handle, TDS_ADC_CHANNEL, &raw_value);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to read ADC value: %s", esp_err_to_name(ret));
-        return -1.0;
+        DLOGE(TAG, "Failed to read ADC value: %s", esp_err_to_name(ret));
+        return ret;
     }
+    *value = (tds_adc_value_t) {
+        .start_us = start_us,
+        .timestamp_us = esp_timer_get_time(),
+        .sequence = oneshot_sequence++,
+        .value = (uint32_t)raw_value << TDS_ADC_VALUE_SHIFT,
+        .min = (uint16_t)raw_value,
+        .max = (uint16_t)raw_value,
+    };
+    return ESP_OK;
+}
 
-    // Convert the raw ADC value to TDS value here if needed
-    float tds_value = (float)raw_value; // Placeholder conversion
-    return tds_value;
+esp_err_t read_tds_sensor(int *tds_ppm) {
+    tds_adc_value_t value;
+    esp_err_t ret = read_tds_raw(&value);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    // Calibration, polynomial and temperature compensation are all precomputed into the tables
+    *tds_ppm = (int)tds_calibration_to_ppm(value.value);
+    return ESP_OK;
 }
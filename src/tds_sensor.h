@@ -2,8 +2,18 @@
 #define TDS_SENSOR_H
 
 #include "esp_err.h"
+#include "tds_adc.h"
 
+#define TDS_ADC_CHANNEL ADC_CHANNEL_6 // Adjust based on your actual ADC channel
+
+// A filtered value older than this means the continuous engine has stalled
+#define TDS_STALE_MS 1000
+
+// Start continuous filtered sampling, falling back to one-shot reads if DMA is unavailable
 esp_err_t initialize_tds_sensor(void);
-float read_tds_sensor(void);
+// Read the TDS value in ppm, compensated to 25 °C through the calibration tables
+esp_err_t read_tds_sensor(int *tds_ppm);
+// Read the filtered raw counts and the span they were sampled over; one-shot reads fill in a single conversion
+esp_err_t read_tds_raw(tds_adc_value_t *value);
 
 #endif // TDS_SENSOR_H
@@ -0,0 +1,206 @@
+#include "telemetry.h"
+#include "crc.h"
+#include "freertos/FreeRTOS.h"
+#include <string.h>
+
+// Frame being filled and the fields of its last record, for the deltas
+typedef struct {
+    uint8_t payload[TELEMETRY_MAX_PAYLOAD];
+    size_t length;
+    uint8_t count;
+    sample_source_t source;
+    uint32_t next_sequence;
+    uint32_t last_ms;
+    int32_t last_fields[TELEMETRY_MAX_FIELDS];
+} telemetry_frame_t;
+
+static portMUX_TYPE telemetry_lock = portMUX_INITIALIZER_UNLOCKED;
+static telemetry_write_fn_t telemetry_write = NULL;
+static void *telemetry_ctx = NULL;
+static telemetry_stats_t telemetry_stats;
+
+// Only one task sends, so one frame and one wire buffer serve every call
+static telemetry_frame_t frame;
+static uint8_t wire[TELEMETRY_WIRE_SIZE];
+
+// Largest record: the time step and every field, each a 5-byte varint at worst
+#define TELEMETRY_MAX_RECORD_SIZE ((TELEMETRY_MAX_FIELDS + 1) * 5)
+
+_Static_assert(TELEMETRY_MAX_PAYLOAD <= 254, "a frame must fit one COBS block");
+_Static_assert(TELEMETRY_HEADER_SIZE + TELEMETRY_MAX_RECORD_SIZE + TELEMETRY_CRC_SIZE <= TELEMETRY_MAX_PAYLOAD,
+               "a frame must hold at least one record");
+
+static size_t telemetry_put_varint(uint8_t *out, uint32_t value) {
+    size_t length = 0;
+    while (value >= 0x80) {
+        out[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (uint8_t)value;
+    return length;
+}
+
+static void telemetry_put_le32(uint8_t *out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+// Small changes either way become small unsigned numbers
+static uint32_t telemetry_zigzag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+size_t telemetry_cobs_encode(const uint8_t *data, size_t length, uint8_t *out) {
+    size_t code_at = 0;
+    size_t written = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < length; i++) {
+        if (data[i] == 0) {
+            out[code_at] = code;
+            code_at = written++;
+            code = 1;
+        } else {
+            out[written++] = data[i];
+            code++;
+        }
+    }
+    out[code_at] = code;
+    return written;
+}
+
+size_t telemetry_record_fields(const sample_record_t *record, int32_t *fields) {
+    switch (record->source) {
+    case SAMPLE_SOURCE_SCD41:
+        fields[0] = record->scd41.co2_ppm;
+        fields[1] = record->scd41.temperature_mc;
+        fields[2] = record->scd41.humidity_mpct;
+        return 3;
+    case SAMPLE_SOURCE_AS7262:
+        fields[0] = record->as7262.range.gain;
+        fields[1] = record->as7262.range.integration_time;
+        fields[2] = record->as7262.saturated;
+        for (int i = 0; i < AS7262_CHANNEL_COUNT; i++) {
+            fields[3 + i] = record->as7262.raw[i];
+        }
+        return 3 + AS7262_CHANNEL_COUNT;
+    case SAMPLE_SOURCE_TDS:
+        fields[0] = record->tds.ppm;
+        fields[1] = (int32_t)record->tds.raw_q4;
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+// Seal the frame with its CRC, frame it and write it out
+static void telemetry_emit(telemetry_write_fn_t write, void *ctx) {
+    if (frame.count == 0) {
+        return;
+    }
+    frame.payload[1] = frame.count;
+    uint16_t crc = crc16_ccitt(frame.payload, frame.length);
+    frame.payload[frame.length++] = (uint8_t)crc;
+    frame.payload[frame.length++] = (uint8_t)(crc >> 8);
+
+    // A leading delimiter ends whatever text went out since the last frame
+    wire[0] = 0;
+    size_t length = 1 + telemetry_cobs_encode(frame.payload, frame.length, wire + 1);
+    wire[length++] = 0;
+    write(wire, length, ctx);
+
+    portENTER_CRITICAL(&telemetry_lock);
+    telemetry_stats.frames++;
+    telemetry_stats.records += frame.count;
+    telemetry_stats.bytes += length;
+    portEXIT_CRITICAL(&telemetry_lock);
+    frame.count = 0;
+}
+
+// Start a frame with record as its first entry
+static void telemetry_begin(sample_source_t source, const sample_record_t *record) {
+    uint32_t time_ms = (uint32_t)(record->timestamp_us / 1000);
+    frame.source = source;
+    frame.payload[0] = (uint8_t)((TELEMETRY_VERSION << 4) | (source + 1));
+    telemetry_put_le32(&frame.payload[2], record->sequence);
+    telemetry_put_le32(&frame.payload[6], time_ms);
+    frame.length = TELEMETRY_HEADER_SIZE;
+    frame.count = 0;
+    frame.next_sequence = record->sequence;
+    frame.last_ms = time_ms;
+    memset(frame.last_fields, 0, sizeof(frame.last_fields));
+}
+
+void telemetry_send(sample_source_t source, const sample_record_t *records, size_t count) {
+    portENTER_CRITICAL(&telemetry_lock);
+    telemetry_write_fn_t write = telemetry_write;
+    void *ctx = telemetry_ctx;
+    portEXIT_CRITICAL(&telemetry_lock);
+    if (write == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const sample_record_t *record = &records[i];
+        uint32_t time_ms = (uint32_t)(record->timestamp_us / 1000);
+        // A lost record or a step back in time starts a new frame, as does a full one
+        if (frame.count > 0 && (frame.source != source || record->sequence != frame.next_sequence ||
+                                (int32_t)(time_ms - frame.last_ms) < 0 ||
+                                frame.length + TELEMETRY_MAX_RECORD_SIZE + TELEMETRY_CRC_SIZE > TELEMETRY_MAX_PAYLOAD ||
+                                frame.count == UINT8_MAX)) {
+            telemetry_emit(write, ctx);
+        }
+        if (frame.count == 0) {
+            telemetry_begin(source, record);
+        } else {
+            frame.length += telemetry_put_varint(&frame.payload[frame.length], time_ms - frame.last_ms);
+        }
+
+        int32_t fields[TELEMETRY_MAX_FIELDS];
+        size_t field_count = telemetry_record_fields(record, fields);
+        for (size_t field = 0; field < field_count; field++) {
+            int32_t delta = (int32_t)((uint32_t)fields[field] - (uint32_t)frame.last_fields[field]);
+            frame.length += telemetry_put_varint(&frame.payload[frame.length], telemetry_zigzag(delta));
+            frame.last_fields[field] = fields[field];
+        }
+        frame.count++;
+        frame.next_sequence = record->sequence + 1;
+        frame.last_ms = time_ms;
+    }
+    // Nothing waits for the next call; the records go out now
+    telemetry_emit(write, ctx);
+}
+
+esp_err_t telemetry_start(telemetry_write_fn_t write, void *ctx) {
+    if (write == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&telemetry_lock);
+    telemetry_write = write;
+    telemetry_ctx = ctx;
+    memset(&telemetry_stats, 0, sizeof(telemetry_stats));
+    telemetry_stats.enabled = true;
+    portEXIT_CRITICAL(&telemetry_lock);
+    return ESP_OK;
+}
+
+void telemetry_stop(void) {
+    portENTER_CRITICAL(&telemetry_lock);
+    telemetry_write = NULL;
+    telemetry_ctx = NULL;
+    telemetry_stats.enabled = false;
+    portEXIT_CRITICAL(&telemetry_lock);
+}
+
+bool telemetry_enabled(void) {
+    portENTER_CRITICAL(&telemetry_lock);
+    bool enabled = telemetry_write != NULL;
+    portEXIT_CRITICAL(&telemetry_lock);
+    return enabled;
+}
+
+void telemetry_get_stats(telemetry_stats_t *stats) {
+    portENTER_CRITICAL(&telemetry_lock);
+    *stats = telemetry_stats;
+    portEXIT_CRITICAL(&telemetry_lock);
+}
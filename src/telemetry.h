@@ -0,0 +1,69 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "esp_err.h"
+#include "sample_bus.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary alternative to the console's reading lines. Each frame carries a run
+// of consecutive records from one source:
+//
+//   type (1) | count (1) | first sequence (4) | first time ms (4) | records | CRC-16 (2)
+//
+// type is TELEMETRY_VERSION in the high nibble and the sample source + 1 in
+// the low one. Fixed fields are little-endian and the CRC is CRC-16/CCITT-FALSE
+// over everything before it. A record is its fields as zigzag varints, each
+// the change from the same field of the record before it in the frame (from
+// zero for the first); every record after the first leads with the ms since
+// the one before, as a plain varint. Sequences run on from the first, so a
+// gap between frames is a record lost on the node.
+//
+// Frames are COBS-encoded and sent between 0x00 delimiters: a receiver can
+// start at any delimiter, and log text printed between frames fails the CRC
+// and is skipped. host/telemetry_decode.cpp turns a capture back into records.
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_MAX_PAYLOAD 240              // Under 254, so COBS adds one byte per frame
+#define TELEMETRY_HEADER_SIZE 10
+#define TELEMETRY_CRC_SIZE 2
+#define TELEMETRY_MAX_FIELDS 9
+#define TELEMETRY_WIRE_SIZE (TELEMETRY_MAX_PAYLOAD + 3)  // COBS code byte and two delimiters
+
+// Fields per record, in order:
+//   SCD41:  co2_ppm, temperature_mc, humidity_mpct
+//   AS7262: gain, integration_time, saturated, raw violet..red
+//   TDS:    ppm, raw_q4
+
+// Hands encoded bytes to the transport, e.g. the console UART
+typedef void (*telemetry_write_fn_t)(const uint8_t *data, size_t length, void *ctx);
+
+typedef struct {
+    bool enabled;
+    uint32_t frames;
+    uint32_t records;
+    uint64_t bytes;                            // On the wire, delimiters included
+} telemetry_stats_t;
+
+// Switch to binary output through write; counters start again from zero
+esp_err_t telemetry_start(telemetry_write_fn_t write, void *ctx);
+
+// Switch back to text
+void telemetry_stop(void);
+
+bool telemetry_enabled(void);
+
+// Encode and write records of one source, as peeked from the sample bus.
+// Only one task may send.
+void telemetry_send(sample_source_t source, const sample_record_t *records, size_t count);
+
+// Fill fields (TELEMETRY_MAX_FIELDS long) with what a record sends and return how many
+size_t telemetry_record_fields(const sample_record_t *record, int32_t *fields);
+
+// COBS-encode length bytes (at most 254) into out, delimiters not included; returns length + 1
+size_t telemetry_cobs_encode(const uint8_t *data, size_t length, uint8_t *out);
+
+// Read the counters
+void telemetry_get_stats(telemetry_stats_t *stats);
+
+#endif // TELEMETRY_H
@@ -1,14 +1,30 @@
 #include "uart_commands.h"
 #include "tds_sensor.h"
+#include "tds_calibration.h"
+#include "sensor_scheduler.h"
+#include "sample_bus.h"
+#include "window_stats.h"
+#include "sample_log.h"
+#include "telemetry.h"
+#include "console_out.h"
+#include "config_store.h"
+#include "driver/uart.h"
 #include "esp_console.h"
 #include "esp_log.h"
 #include "nvs_service.h"
 #include "scd41_driver.h"
 #include "as7262_driver.h"
+#include "as7262_stream.h"
+#include "pins.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
 #include "esp_system.h"
+#include "esp_timer.h"
+#include "i2c_service.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
 
 #undef TAG
 #define TAG "UART_COMMANDS"
@@ -18,28 +34,23 @@
 extern i2c_master_dev_handle_t scd41_dev;
 extern i2c_master_dev_handle_t as7262_dev;
 
-static as7262_calibration_t calibration;
-
 // Function to apply correction factors
 void apply_correction_factors(float* data) {
-    for (int i = 0; i < 6; i++) {
+    as7262_calibration_t calibration;
+    load_as7262_calibration(&calibration);
+    for (int i = 0; i < AS7262_CHANNEL_COUNT; i++) {
         data[i] *= calibration.correction_factors[i];
     }
 }
 
-// Save calibration parameters to NVS
+// Save calibration parameters; they reach NVS with the next config batch
 esp_err_t save_as7262_calibration(const as7262_calibration_t* calibration) {
-    esp_err_t ret = nvs_service_set_blob("calibration", calibration, sizeof(as7262_calibration_t));
-    if (ret == ESP_OK) {
-        nvs_service_commit();
-    }
-    return ret;
+    return config_set(CONFIG_AS7262_CAL, calibration, sizeof(as7262_calibration_t));
 }
 
-// Load calibration parameters from NVS
+// Load calibration parameters from the config store
 esp_err_t load_as7262_calibration(as7262_calibration_t* calibration) {
-    size_t required_size = sizeof(as7262_calibration_t);
-    return nvs_service_get_blob("calibration", calibration, &required_size);
+    return config_get(CONFIG_AS7262_CAL, calibration, sizeof(as7262_calibration_t));
 }
 
 // Command handler for setting AS7262 calibration parameters
@@ -48,7 +59,8 @@ int cmd_set_as7262_calibration(int argc, char **argv) {
         printf("Usage: set_as7262_cal <V> <B> <G> <Y> <O> <R>\n");
         return 1;
     }
-    for (int i = 0; i < 6; i++) {
+    as7262_calibration_t calibration;
+    for (int i = 0; i < AS7262_CHANNEL_COUNT; i++) {
         calibration.correction_factors[i] = atof(argv[i + 1]);
     }
     esp_err_t ret = save_as7262_calibration(&calibration);
@@ -62,6 +74,7 @@ int cmd_set_as7262_calibration(int argc, char **argv) {
 
 // Command handler for getting AS7262 calibration parameters
 int cmd_get_as7262_calibration(int argc, char **argv) {
+    as7262_calibration_t calibration;
     esp_err_t ret = load_as7262_calibration(&calibration);
     if (ret == ESP_OK) {
         printf("Calibration parameters: V=%.2f, B=%.2f, G=%.2f, Y=%.2f, O=%.2f, R=%.2f\n",
@@ -74,58 +87,198 @@ int cmd_get_as7262_calibration(int argc, char **argv) {
     return ret == ESP_OK ? 0 : 1;
 }
 
+// Report the forced recalibration result from the SCD41 executor
+static void frc_done(esp_err_t result, const uint16_t *words, size_t count, void *ctx) {
+    int16_t correction;
+    if (result == ESP_OK) {
+        result = scd41_decode_frc_correction(words[0], &correction);
+    }
+    if (result == ESP_OK) {
+        ESP_LOGI(TAG, "Forced recalibration to %u ppm successful, correction %d ppm", (unsigned)(uintptr_t)ctx, correction);
+    } else {
+        ESP_LOGE(TAG, "Failed to set forced recalibration: %s", esp_err_to_name(result));
+    }
+}
+
 // Command handler for forced recalibration
 int cmd_forced_recalibration(int argc, char **argv) {
-    uint16_t target_co2 = 400; // Example target CO2 concentration
-    esp_err_t ret = scd41_set_forced_recalibration(scd41_dev, target_co2);
+    uint16_t target_co2 = 400; // Outdoor air unless a reference reading is given
+    if (argc == 2) {
+        target_co2 = (uint16_t)atoi(argv[1]);
+    }
+    // Runs in the background; the result is logged once the sensor has answered
+    esp_err_t ret = scd41_start_forced_recalibration(scd41_dev, target_co2, frc_done, (void *)(uintptr_t)target_co2);
     if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "Forced recalibration successful");
+        printf("Forced recalibration to %u ppm started\n", target_co2);
     } else {
         ESP_LOGE(TAG, "Failed to set forced recalibration: %s", esp_err_to_name(ret));
     }
     return ret == ESP_OK ? 0 : 1;
 }
 
-// Command handler for reading SCD41 measurements
-int cmd_read_scd41(int argc, char **argv) {
-    uint16_t co2;
-    float temperature, humidity;
-    esp_err_t ret = scd41_read_measurement(scd41_dev, &co2, &temperature, &humidity);
+// Report the self-test result from the SCD41 executor
+static void self_test_done(esp_err_t result, const uint16_t *words, size_t count, void *ctx) {
+    if (result != ESP_OK) {
+        ESP_LOGE(TAG, "SCD41 self-test failed to run: %s", esp_err_to_name(result));
+    } else if (words[0] != 0) {
+        ESP_LOGE(TAG, "SCD41 self-test detected a malfunction (0x%04X)", words[0]);
+    } else {
+        ESP_LOGI(TAG, "SCD41 self-test passed");
+    }
+}
+
+// Command handler for the SCD41 self-test
+int cmd_scd41_self_test(int argc, char **argv) {
+    esp_err_t ret = scd41_start_self_test(scd41_dev, self_test_done, NULL);
     if (ret == ESP_OK) {
-        printf("SCD41 - CO2: %u ppm, Temperature: %.2f °C, Humidity: %.2f %%\n", co2, temperature, humidity);
+        printf("SCD41 self-test started, result in about 11 s\n");
     } else {
-        ESP_LOGE(TAG, "Error reading SCD41 measurement, code: %s", esp_err_to_name(ret));
+        printf("Failed to start SCD41 self-test: %s\n", esp_err_to_name(ret));
     }
     return ret == ESP_OK ? 0 : 1;
 }
 
+// Print a source's cached reading with its age, or why there is none
+static esp_err_t print_latest(sample_source_t source) {
+    sample_latest_t latest;
+    esp_err_t ret = sample_bus_get_latest(source, &latest);
+    if (ret != ESP_OK) {
+        printf("%s - no reading yet\n", sample_bus_source_name(source));
+        return ret;
+    }
+    const sample_record_t *record = &latest.record;
+    switch (source) {
+    case SAMPLE_SOURCE_SCD41:
+        printf("SCD41 - CO2: %u ppm, Temperature: %.2f °C, Humidity: %.2f %%", record->scd41.co2_ppm,
+               record->scd41.temperature_mc / 1000.0f, record->scd41.humidity_mpct / 1000.0f);
+        break;
+    case SAMPLE_SOURCE_AS7262: {
+        float corrected[AS7262_CHANNEL_COUNT];
+        for (int i = 0; i < AS7262_CHANNEL_COUNT; i++) {
+            corrected[i] = (float)record->as7262.raw[i];
+        }
+        apply_correction_factors(corrected);
+        printf("AS7262 - Corrected: V=%.2f, B=%.2f, G=%.2f, Y=%.2f, O=%.2f, R=%.2f%s",
+               corrected[0], corrected[1], corrected[2], corrected[3], corrected[4], corrected[5],
+               record->as7262.saturated ? " (saturated)" : "");
+        break;
+    }
+    case SAMPLE_SOURCE_TDS:
+        printf("TDS Value: %" PRId32 " ppm", record->tds.ppm);
+        break;
+    default:
+        break;
+    }
+    printf(" (%" PRId64 " ms old)", latest.age_us / 1000);
+    if (!latest.valid) {
+        printf(" invalid: %" PRIu32 " failed reads since, last %s", latest.failures, esp_err_to_name(latest.last_error));
+    }
+    printf("\n");
+    return latest.valid ? ESP_OK : latest.last_error;
+}
+
+// Command handler for reading SCD41 measurements
+int cmd_read_scd41(int argc, char **argv) {
+    // The acquisition jobs keep the latest reading of every sensor, so reads never touch the bus
+    return print_latest(SAMPLE_SOURCE_SCD41) == ESP_OK ? 0 : 1;
+}
+
 // Command handler for reading AS7262 measurements
 int cmd_read_as7262(int argc, char **argv) {
-    uint16_t raw_channels[6];
-    esp_err_t ret = as7262_read_measurement(as7262_dev, raw_channels);
-    if (ret == ESP_OK) {
-        float calibrated_data[6];
-        for (int i = 0; i < 6; i++) {
-            calibrated_data[i] = (float)raw_channels[i];
-        }
-        apply_correction_factors(calibrated_data);
-        printf("AS7262 - Corrected: V=%.2f, B=%.2f, G=%.2f, Y=%.2f, O=%.2f, R=%.2f\n",
-               calibrated_data[0], calibrated_data[1], calibrated_data[2],
-               calibrated_data[3], calibrated_data[4], calibrated_data[5]);
-    } else {
-        ESP_LOGE(TAG, "Error reading AS7262 measurement, code: %s", esp_err_to_name(ret));
+    return print_latest(SAMPLE_SOURCE_AS7262) == ESP_OK ? 0 : 1;
+}
+
+// Command handler for starting, stopping and inspecting the AS7262 stream
+int cmd_as7262_stream(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "start") == 0 && argc <= 4) {
+        bool auto_range = argc == 3 && strcmp(argv[2], "auto") == 0;
+        as7262_stream_config_t config = {
+            .integration_time = argc >= 3 && !auto_range ? (uint8_t)atoi(argv[2]) : AS7262_STREAM_DEFAULT_INT_T,
+            .gain = argc >= 4 ? (uint8_t)atoi(argv[3]) : AS7262_STREAM_DEFAULT_GAIN,
+            .int_gpio = AS7262_INT_IO,
+            .auto_range = auto_range,
+        };
+        esp_err_t ret = as7262_stream_start(as7262_dev, &config);
+        if (ret == ESP_OK) {
+            printf("AS7262 streaming, one frame every %lu us%s\n", (unsigned long)as7262_stream_period_us(config.integration_time),
+                   auto_range ? " until auto-ranging adjusts it" : "");
+        } else {
+            printf("Failed to start AS7262 stream: %s\n", esp_err_to_name(ret));
+        }
+        return ret == ESP_OK ? 0 : 1;
     }
-    return ret == ESP_OK ? 0 : 1;
+    if (argc == 2 && strcmp(argv[1], "stop") == 0) {
+        esp_err_t ret = as7262_stream_stop();
+        if (ret != ESP_OK) {
+            printf("AS7262 stream is not running\n");
+        }
+        return ret == ESP_OK ? 0 : 1;
+    }
+    if (argc == 2 && strcmp(argv[1], "status") == 0) {
+        as7262_stream_stats_t stats;
+        as7262_stream_get_stats(&stats);
+        printf("AS7262 stream: %s, %s paced, period=%" PRIu32 "us buffered=%u/%u\n",
+               stats.running ? "running" : "stopped", stats.interrupt_paced ? "DATA_RDY" : "timer",
+               stats.period_us, (unsigned)as7262_stream_available(), (unsigned)AS7262_STREAM_CAPACITY);
+        printf("  gain=%.1fx integration=%.1fms range_changes=%" PRIu32 "\n",
+               as7262_gain_factor(stats.range.gain), as7262_integration_ms(stats.range), stats.range_changes);
+        printf("  frames=%" PRIu32 " overwritten=%" PRIu32 " read_errors=%" PRIu32 " overruns=%" PRIu32 "\n",
+               stats.frames, stats.overwritten, stats.read_errors, stats.overruns);
+        if (stats.frames > 0) {
+            printf("  per frame: %" PRIu64 " I2C transactions, %" PRIu64 " us on the bus\n",
+                   stats.transactions / stats.frames, stats.bus_us / stats.frames);
+        }
+        return 0;
+    }
+    printf("Usage: as7262_stream <start [auto | int_t [gain]] | stop | status>\n");
+    return 1;
+}
+
+// Command handler for showing or switching the SCD41 measurement mode
+int cmd_scd41_mode(int argc, char **argv) {
+    static const char *mode_names[] = {"idle", "periodic", "low_power"};
+    if (argc == 2) {
+        scd41_mode_t mode;
+        if (strcmp(argv[1], "idle") == 0) {
+            mode = SCD41_MODE_IDLE;
+        } else if (strcmp(argv[1], "periodic") == 0) {
+            mode = SCD41_MODE_PERIODIC;
+        } else if (strcmp(argv[1], "low_power") == 0) {
+            mode = SCD41_MODE_LOW_POWER_PERIODIC;
+        } else {
+            printf("Usage: scd41_mode [idle | periodic | low_power]\n");
+            return 1;
+        }
+        esp_err_t ret = scd41_set_mode(scd41_dev, mode);
+        if (ret != ESP_OK) {
+            printf("Failed to switch SCD41 mode: %s\n", esp_err_to_name(ret));
+            return 1;
+        }
+    } else if (argc != 1) {
+        printf("Usage: scd41_mode [idle | periodic | low_power]\n");
+        return 1;
+    }
+
+    scd41_stats_t stats;
+    scd41_get_stats(&stats);
+    printf("SCD41 mode: %s, interval %" PRIu32 " ms\n", mode_names[scd41_get_mode()], scd41_get_interval_ms());
+    printf("  samples=%" PRIu32 " ready_checks=%" PRIu32 " late_checks=%" PRIu32 " busy_skips=%" PRIu32 " errors=%" PRIu32 "\n",
+           stats.samples, stats.ready_checks, stats.late_checks, stats.busy_skips, stats.errors);
+    return 0;
 }
 
 // Command handler for help
 int cmd_help(int argc, char **argv) {
     printf("Available commands:\n");
     printf("  help - Show this help message\n");
-    printf("  frc - Trigger forced recalibration on the SCD41\n");
+    printf("  frc [target_ppm] - Trigger forced recalibration on the SCD41 (default 400)\n");
     printf("  read_scd41 - Read SCD41 sensor data\n");
+    printf("  scd41_mode - Show or switch the SCD41 measurement mode\n");
+    printf("  scd41_selftest - Run the SCD41 self-test in the background\n");
     printf("  read_as7262 - Read AS7262 sensor data\n");
     printf("  read_tds - Read TDS sensor value\n");
+    printf("  tds_adc - Show or change the continuous TDS filter\n");
+    printf("  tds_cal - Show TDS calibration or capture a reference solution (tds_cal add <ppm>)\n");
     printf("  nvs_set_i32 - Set an integer value in NVS\n");
     printf("  nvs_get_i32 - Get an integer value from NVS\n");
     printf("  nvs_set_str - Set a string value in NVS\n");
@@ -133,6 +286,19 @@ int cmd_help(int argc, char **argv) {
     printf("  nvs_stats - Print NVS statistics\n");
     printf("  set_as7262_cal - Set AS7262 calibration parameters\n");
     printf("  get_as7262_cal - Get AS7262 calibration parameters\n");
+    printf("  i2c_stats - Show per-device I2C bus usage (i2c_stats reset to clear)\n");
+    printf("  as7262_stream - Start, stop or show the AS7262 continuous stream\n");
+    printf("  latency - Show acquisition latency and sample interval jitter per sensor (latency reset to clear)\n");
+    printf("  stats - Show min, max, mean and spread per channel over the last 1m, 1h and 24h (stats [channel] [window])\n");
+    printf("  log - Show the flash history log (log flush to write out part-filled pages)\n");
+    printf("  history - Show a channel's stored history over a time range (history co2 -6h now [15m])\n");
+    printf("  telemetry - Switch readings to COBS-framed binary on the console UART (telemetry on|off)\n");
+    printf("  console_out - Show console output buffering or set the overflow policy (console_out drop|block|reset)\n");
+    printf("  log_mode - Log driver messages as text or as deferred binary records (log_mode text|deferred|reset)\n");
+    printf("  sample_bus - Show sample bus producers and consumer backlog\n");
+    printf("  sched - Show sensor job timing or change a job period (sched <job> <period_ms>)\n");
+    printf("  config - Show stored settings and their flash writes (config flush to write pending ones now)\n");
+    printf("  watch - Stream cached readings until a key is pressed (watch <sensor|all> [interval_ms])\n");
     printf("  reset - Reset the system\n");
     return 0;
 }
@@ -148,7 +314,7 @@ int cmd_nvs_set_i32(int argc, char **argv) {
     value = atoi(argv[2]);
     esp_err_t ret = nvs_service_set_i32(key, value);
     if (ret == ESP_OK) {
-        nvs_service_commit();
+        config_store_commit_later();
         printf("Set integer value: %" PRId32 " for key: %s\n", value, key);
     } else {
         printf("Failed to set integer value: %s\n", esp_err_to_name(ret));
@@ -183,7 +349,7 @@ int cmd_nvs_set_str(int argc, char **argv) {
     const char* value = argv[2];
     esp_err_t ret = nvs_service_set_str(key, value);
     if (ret == ESP_OK) {
-        nvs_service_commit();
+        config_store_commit_later();
         printf("Set string value: %s for key: %s\n", value, key);
     } else {
         printf("Failed to set string value: %s\n", esp_err_to_name(ret));
@@ -216,14 +382,708 @@ int cmd_nvs_stats(int argc, char **argv) {
 
 // Command handler for reading TDS sensor
 int cmd_read_tds(int argc, char **argv) {
-    float tds_value = read_tds_sensor();
-    printf("TDS Value: %.2f ppm\n", tds_value);
+    return print_latest(SAMPLE_SOURCE_TDS) == ESP_OK ? 0 : 1;
+}
+
+// Save TDS calibration; it reaches NVS with the next config batch
+esp_err_t save_tds_calibration(const tds_calibration_t* calibration) {
+    return config_set(CONFIG_TDS_CAL, calibration, sizeof(tds_calibration_t));
+}
+
+// Load TDS calibration from the config store; the probe defaults unless one was saved
+esp_err_t load_tds_calibration(tds_calibration_t* calibration) {
+    return config_get(CONFIG_TDS_CAL, calibration, sizeof(tds_calibration_t));
+}
+
+// Apply a TDS calibration and persist it
+static int tds_calibration_commit(const tds_calibration_t* calibration) {
+    esp_err_t ret = tds_calibration_apply(calibration);
+    if (ret == ESP_OK) {
+        ret = save_tds_calibration(calibration);
+    }
+    if (ret != ESP_OK) {
+        printf("Failed to update TDS calibration: %s\n", esp_err_to_name(ret));
+        return 1;
+    }
+    return 0;
+}
+
+// Command handler for capturing and showing TDS calibration points
+int cmd_tds_calibration(int argc, char **argv) {
+    tds_calibration_t calibration;
+    tds_calibration_get(&calibration);
+
+    if (argc == 3 && strcmp(argv[1], "add") == 0) {
+        int ppm = atoi(argv[2]);
+        tds_adc_value_t value;
+        if (ppm <= 0 || ppm > UINT16_MAX) {
+            printf("Reference must be between 1 and %u ppm\n", UINT16_MAX);
+            return 1;
+        }
+        esp_err_t ret = read_tds_raw(&value);
+        if (ret == ESP_OK) {
+            ret = tds_calibration_add_point(&calibration, value.value, (uint16_t)ppm);
+        }
+        if (ret != ESP_OK) {
+            printf("Failed to capture calibration point: %s\n", esp_err_to_name(ret));
+            return 1;
+        }
+        if (tds_calibration_commit(&calibration) != 0) {
+            return 1;
+        }
+    } else if (argc == 2 && strcmp(argv[1], "clear") == 0) {
+        float temp_coeff = calibration.temp_coeff;
+        tds_calibration_defaults(&calibration);
+        calibration.temp_coeff = temp_coeff;
+        if (tds_calibration_commit(&calibration) != 0) {
+            return 1;
+        }
+    } else if (argc == 3 && strcmp(argv[1], "alpha") == 0) {
+        calibration.temp_coeff = atof(argv[2]) / 100.0f;
+        if (tds_calibration_commit(&calibration) != 0) {
+            return 1;
+        }
+    } else if (argc == 3 && strcmp(argv[1], "air") == 0 && (strcmp(argv[2], "on") == 0 || strcmp(argv[2], "off") == 0)) {
+        bool air = strcmp(argv[2], "on") == 0;
+        esp_err_t ret = config_set_i32(CONFIG_TDS_AIR_COMP, air ? 1 : 0);
+        if (ret != ESP_OK) {
+            printf("Failed to save air compensation: %s\n", esp_err_to_name(ret));
+            return 1;
+        }
+        // Back to the reference until the next SCD41 sample, or for good
+        tds_calibration_set_temperature(TDS_CAL_REFERENCE_MC);
+    } else if (argc != 1) {
+        printf("Usage: tds_cal [add <reference_ppm> | clear | alpha <percent_per_C> | air on|off]\n");
+        return 1;
+    }
+
+    int32_t temperature_mc = tds_calibration_get_temperature();
+    bool air = config_get_i32(CONFIG_TDS_AIR_COMP) != 0;
+    printf("TDS calibration: %u points, alpha %.2f %%/C, water %ld.%01ld C (%s)\n", calibration.point_count,
+           calibration.temp_coeff * 100.0f, (long)(temperature_mc / 1000), (long)(temperature_mc % 1000 / 100),
+           air ? "SCD41 air temperature" : "reference, no water probe");
+    for (int i = 0; i < calibration.point_count; i++) {
+        printf("  point %d: %u mV at 25 C = %u ppm\n", i, calibration.points[i].mv, calibration.points[i].ppm);
+    }
+    printf("  ppm = %.3f + %.3f V + %.3f V^2 + %.3f V^3\n", calibration.coefficients[0], calibration.coefficients[1],
+           calibration.coefficients[2], calibration.coefficients[3]);
+    return 0;
+}
+
+// Command handler for showing or retuning the continuous TDS filter
+int cmd_tds_adc(int argc, char **argv) {
+    static const char *filter_names[] = {"mean", "median", "trimmed"};
+    if (argc >= 2) {
+        tds_adc_stats_t current;
+        tds_adc_get_stats(&current);
+        tds_adc_config_t config = current.config;
+        if (!current.running) {
+            printf("Continuous TDS sampling is not running\n");
+            return 1;
+        }
+        if (strcmp(argv[1], "mean") == 0) {
+            config.filter = TDS_FILTER_MEAN;
+        } else if (strcmp(argv[1], "median") == 0) {
+            config.filter = TDS_FILTER_MEDIAN;
+        } else if (strcmp(argv[1], "trimmed") == 0) {
+            config.filter = TDS_FILTER_TRIMMED_MEAN;
+        } else {
+            printf("Usage: tds_adc [mean | median | trimmed] [window]\n");
+            return 1;
+        }
+        if (argc == 3) {
+            config.window = (uint32_t)atoi(argv[2]);
+        }
+        tds_adc_stop();
+        esp_err_t ret = tds_adc_start(&config);
+        if (ret != ESP_OK) {
+            printf("Failed to restart TDS sampling: %s, restoring the previous filter\n", esp_err_to_name(ret));
+            tds_adc_start(&current.config);
+            return 1;
+        }
+    }
+
+    tds_adc_stats_t stats;
+    tds_adc_value_t value;
+    tds_adc_get_stats(&stats);
+    if (!stats.running) {
+        printf("Continuous TDS sampling is not running\n");
+        return 0;
+    }
+    printf("TDS ADC: %s over %" PRIu32 " samples at %" PRIu32 " Hz\n", filter_names[stats.config.filter],
+           stats.config.window, stats.config.sample_rate_hz);
+    printf("  frames=%" PRIu32 " samples=%" PRIu32 " windows=%" PRIu32 " pool_overflows=%" PRIu32 "\n",
+           stats.frames, stats.samples, stats.windows, stats.pool_overflows);
+    if (tds_adc_get_latest(&value) == ESP_OK) {
+        printf("  latest %.2f counts (window min %u, max %u)\n", (float)value.value / (1 << TDS_ADC_VALUE_SHIFT), value.min, value.max);
+    }
+    return 0;
+}
+
+// Command handler for printing (and optionally clearing) I2C bus usage
+int cmd_i2c_stats(int argc, char **argv) {
+    bool reset = false;
+    if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+        reset = true;
+    } else if (argc != 1) {
+        printf("Usage: i2c_stats [reset]\n");
+        return 1;
+    }
+
+    i2c_device_stats_t stats[8];
+    i2c_arbiter_stats_t arbiter;
+    size_t count = i2c_get_device_stats(stats, sizeof(stats) / sizeof(stats[0]), reset);
+    i2c_get_arbiter_stats(&arbiter, reset);
+    int64_t now_us = esp_timer_get_time();
+
+    for (size_t i = 0; i < count; i++) {
+        const i2c_device_stats_t *dev = &stats[i];
+        int64_t elapsed_us = now_us - dev->since_us;
+        uint32_t util_permille = elapsed_us > 0 ? (uint32_t)((dev->bus_time_us * 1000) / (uint64_t)elapsed_us) : 0;
+        printf("0x%02X: txn=%" PRIu32 " wr=%" PRIu32 "B rd=%" PRIu32 "B polls=%" PRIu32 " bus=%" PRIu64 "us util=%" PRIu32 ".%" PRIu32 "%%\n",
+               dev->address, dev->transactions, dev->bytes_written, dev->bytes_read, dev->poll_iterations,
+               dev->bus_time_us, util_permille / 10, util_permille % 10);
+        printf("      latency p50<=%" PRIu32 "us p99<=%" PRIu32 "us max<=%" PRIu32 "us\n",
+               i2c_latency_percentile(dev->latency_histogram, 50),
+               i2c_latency_percentile(dev->latency_histogram, 99),
+               i2c_latency_percentile(dev->latency_histogram, 100));
+        printf("      batches=%" PRIu32 " submit to done p50<=%" PRIu32 "us p99<=%" PRIu32 "us max<=%" PRIu32 "us\n",
+               dev->batches,
+               i2c_latency_percentile(dev->batch_latency_histogram, 50),
+               i2c_latency_percentile(dev->batch_latency_histogram, 99),
+               i2c_latency_percentile(dev->batch_latency_histogram, 100));
+        for (size_t e = 0; e < I2C_ERROR_SLOTS; e++) {
+            if (dev->errors[e].count > 0) {
+                printf("      error %s: %" PRIu32 "\n", esp_err_to_name(dev->errors[e].code), dev->errors[e].count);
+            }
+        }
+        if (dev->other_errors > 0) {
+            printf("      error (other): %" PRIu32 "\n", dev->other_errors);
+        }
+    }
+    printf("arbiter: batches=%" PRIu32 " txn=%" PRIu32 " errors=%" PRIu32 " retries=%" PRIu32 " deadline_misses=%" PRIu32 " recoveries=%" PRIu32 " max_latency=%" PRIu32 "us queue_hw=%" PRIu32 "\n",
+           arbiter.batches, arbiter.transactions, arbiter.errors, arbiter.retries,
+           arbiter.deadline_misses, arbiter.bus_recoveries, arbiter.max_latency_us, arbiter.queue_high_water);
+    if (reset) {
+        printf("I2C statistics reset.\n");
+    }
+    return 0;
+}
+
+// Find the stored period setting of a sensor job
+static esp_err_t sensor_period_setting(const char* job, config_id_t* id) {
+    char name[16];
+    snprintf(name, sizeof(name), "sched_%s", job);
+    return config_store_find(name, id);
+}
+
+// Save a sensor job period; it reaches NVS with the next config batch
+esp_err_t save_sensor_period(const char* job, uint32_t period_ms) {
+    config_id_t id;
+    esp_err_t ret = sensor_period_setting(job, &id);
+    return ret == ESP_OK ? config_set_i32(id, (int32_t)period_ms) : ret;
+}
+
+// Load a sensor job period, the job's default unless one was saved; 0, which
+// the scheduler rejects, for a job without a setting
+uint32_t load_sensor_period(const char* job) {
+    config_id_t id;
+    if (sensor_period_setting(job, &id) != ESP_OK) {
+        return 0;
+    }
+    return (uint32_t)config_get_i32(id);
+}
+
+// Save the console output overflow policy
+esp_err_t save_console_out_policy(console_out_policy_t policy) {
+    return config_set_i32(CONFIG_CONSOLE_OUT_POLICY, (int32_t)policy);
+}
+
+// Load the console output overflow policy; drop unless block was saved
+console_out_policy_t load_console_out_policy(void) {
+    return (console_out_policy_t)config_get_i32(CONFIG_CONSOLE_OUT_POLICY);
+}
+
+// Save the driver log mode
+esp_err_t save_log_mode(dlog_mode_t mode) {
+    return config_set_i32(CONFIG_LOG_MODE, (int32_t)mode);
+}
+
+// Load the driver log mode; text unless deferred was saved
+dlog_mode_t load_log_mode(void) {
+    return (dlog_mode_t)config_get_i32(CONFIG_LOG_MODE);
+}
+
+// Command handler for showing scheduler timing or changing a job period
+int cmd_sched(int argc, char **argv) {
+    bool reset = false;
+    if (argc == 3) {
+        uint32_t period_ms = (uint32_t)atoi(argv[2]);
+        esp_err_t ret = sensor_scheduler_set_period(argv[1], period_ms);
+        if (ret == ESP_OK) {
+            ret = save_sensor_period(argv[1], period_ms);
+        }
+        if (ret != ESP_OK) {
+            printf("Failed to set %s period: %s\n", argv[1], esp_err_to_name(ret));
+            return 1;
+        }
+    } else if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+        reset = true;
+    } else if (argc != 1) {
+        printf("Usage: sched [reset | <job> <period_ms>]\n");
+        return 1;
+    }
+
+    sensor_job_stats_t stats[SENSOR_SCHED_MAX_JOBS];
+    size_t count = sensor_scheduler_get_stats(stats, SENSOR_SCHED_MAX_JOBS, reset);
+    for (size_t i = 0; i < count; i++) {
+        const sensor_job_stats_t *job = &stats[i];
+        printf("%-8s period=%" PRIu32 "ms phase=%" PRIu32 "ms runs=%" PRIu32 " missed=%" PRIu32 " jitter avg=%" PRIu64 "us max=%" PRIu32 "us run max=%" PRIu32 "us overruns=%" PRIu32 "/%" PRIu32 "ms\n",
+               job->name, job->period_ms, job->phase_ms, job->runs, job->missed,
+               job->runs > 0 ? job->total_jitter_us / job->runs : 0, job->max_jitter_us, job->max_run_us, job->overruns, job->budget_ms);
+    }
+    if (reset) {
+        printf("Scheduler statistics reset.\n");
+    }
+    return 0;
+}
+
+// Command handler for showing sample bus producers and consumers
+int cmd_sample_bus(int argc, char **argv) {
+    for (int source = 0; source < SAMPLE_SOURCE_COUNT; source++) {
+        sample_source_stats_t stats;
+        sample_bus_get_source_stats((sample_source_t)source, &stats);
+        printf("%-7s published=%" PRIu32 " capacity=%" PRIu32 "\n", sample_bus_source_name((sample_source_t)source),
+               stats.published, stats.capacity);
+    }
+    sample_consumer_t consumers[SAMPLE_BUS_MAX_CONSUMERS];
+    size_t count = sample_bus_get_consumers(consumers, SAMPLE_BUS_MAX_CONSUMERS);
+    for (size_t i = 0; i < count; i++) {
+        sample_source_stats_t stats;
+        sample_bus_get_source_stats(consumers[i].source, &stats);
+        printf("  %-10s <- %-7s consumed=%" PRIu32 " lag=%" PRIu32 " overruns=%" PRIu32 " dropped=%" PRIu32 "\n",
+               consumers[i].name, sample_bus_source_name(consumers[i].source), consumers[i].consumed,
+               stats.published - consumers[i].position, consumers[i].overruns, consumers[i].dropped);
+    }
+    return 0;
+}
+
+// Command handler for showing per-sensor acquisition latency and sample interval
+int cmd_latency(int argc, char **argv) {
+    bool reset = false;
+    if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+        reset = true;
+    } else if (argc != 1) {
+        printf("Usage: latency [reset]\n");
+        return 1;
+    }
+
+    for (int source = 0; source < SAMPLE_SOURCE_COUNT; source++) {
+        sample_timing_t timing;
+        sample_bus_get_timing((sample_source_t)source, &timing, reset);
+        const running_stats_t *latency = &timing.latency;
+        const running_stats_t *interval = &timing.interval;
+        printf("%-7s %" PRIu32 " samples\n", sample_bus_source_name((sample_source_t)source), latency->count);
+        if (latency->count == 0) {
+            continue;
+        }
+        printf("  latency  mean=%" PRId64 "us sd=%" PRIu32 "us min=%" PRId64 "us max=%" PRId64 "us\n",
+               running_stats_mean(latency), running_stats_stddev(latency), latency->min, latency->max);
+        if (interval->count > 0) {
+            printf("  interval mean=%" PRId64 "us jitter sd=%" PRIu32 "us min=%" PRId64 "us max=%" PRId64 "us\n",
+                   running_stats_mean(interval), running_stats_stddev(interval), interval->min, interval->max);
+        }
+    }
+    if (reset) {
+        printf("Latency statistics reset from the next sample.\n");
+    }
+    return 0;
+}
+
+// Format a value held in 1/scale units, with as many decimals as the scale has zeros
+static const char *format_scaled(char *buf, size_t size, int64_t value, int32_t scale) {
+    if (scale <= 1) {
+        snprintf(buf, size, "%" PRId64, value);
+        return buf;
+    }
+    int decimals = 0;
+    for (int32_t s = scale; s > 1; s /= 10) {
+        decimals++;
+    }
+    uint64_t magnitude = value < 0 ? (uint64_t)-value : (uint64_t)value;
+    snprintf(buf, size, "%s%" PRIu64 ".%0*" PRIu64, value < 0 ? "-" : "", magnitude / (uint64_t)scale, decimals, magnitude % (uint64_t)scale);
+    return buf;
+}
+
+// Format a mean or spread held in 1/scale units, with at least two decimals
+static const char *format_scaled_double(char *buf, size_t size, double value, int32_t scale) {
+    int decimals = 0;
+    for (int32_t s = scale; s > 1; s /= 10) {
+        decimals++;
+    }
+    snprintf(buf, size, "%.*f", decimals > 2 ? decimals : 2, value / scale);
+    return buf;
+}
+
+// Command handler for showing windowed statistics of every sensor channel
+int cmd_stats(int argc, char **argv) {
+    if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+        window_stats_reset();
+        printf("Windowed statistics cleared.\n");
+        return 0;
+    }
+    int only_channel = -1, only_window = -1;
+    for (int arg = 1; arg < argc; arg++) {
+        bool matched = false;
+        for (int channel = 0; channel < WINDOW_STATS_CHANNEL_COUNT && !matched; channel++) {
+            if (strcmp(argv[arg], window_stats_channel_info((window_stats_channel_t)channel)->name) == 0) {
+                only_channel = channel;
+                matched = true;
+            }
+        }
+        for (int window = 0; window < WINDOW_STATS_WINDOW_COUNT && !matched; window++) {
+            if (strcmp(argv[arg], window_stats_window_name((window_stats_window_t)window)) == 0) {
+                only_window = window;
+                matched = true;
+            }
+        }
+        if (!matched) {
+            printf("Usage: stats [reset | <channel>] [1m|1h|24h]\n");
+            printf("Channels:");
+            for (int channel = 0; channel < WINDOW_STATS_CHANNEL_COUNT; channel++) {
+                printf(" %s", window_stats_channel_info((window_stats_channel_t)channel)->name);
+            }
+            printf("\n");
+            return 1;
+        }
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    char mean[24], min[24], max[24], stddev[24];
+    printf("%-9s %-4s %-4s %8s %12s %12s %12s %12s\n", "channel", "unit", "win", "samples", "mean", "min", "max", "stddev");
+    for (int channel = 0; channel < WINDOW_STATS_CHANNEL_COUNT; channel++) {
+        if (only_channel >= 0 && channel != only_channel) {
+            continue;
+        }
+        const window_stats_channel_info_t *info = window_stats_channel_info((window_stats_channel_t)channel);
+        for (int window = 0; window < WINDOW_STATS_WINDOW_COUNT; window++) {
+            if (only_window >= 0 && window != only_window) {
+                continue;
+            }
+            running_stats_t stats;
+            window_stats_query((window_stats_channel_t)channel, (window_stats_window_t)window, now_us, &stats);
+            if (stats.count == 0) {
+                printf("%-9s %-4s %-4s %8s\n", info->name, info->unit, window_stats_window_name((window_stats_window_t)window), "-");
+                continue;
+            }
+            printf("%-9s %-4s %-4s %8" PRIu32 " %12s %12s %12s %12s\n", info->name, info->unit,
+                   window_stats_window_name((window_stats_window_t)window), stats.count,
+                   format_scaled_double(mean, sizeof(mean), running_stats_mean_double(&stats), info->scale),
+                   format_scaled(min, sizeof(min), stats.min, info->scale),
+                   format_scaled(max, sizeof(max), stats.max, info->scale),
+                   format_scaled_double(stddev, sizeof(stddev), running_stats_stddev_double(&stats), info->scale));
+        }
+    }
+    return 0;
+}
+
+// Command handler for showing the flash history log or flushing it
+int cmd_log(int argc, char **argv) {
+    if (argc == 2 && strcmp(argv[1], "flush") == 0) {
+        esp_err_t ret = sample_log_flush(SAMPLE_LOG_FLUSH_TIMEOUT_MS);
+        if (ret != ESP_OK) {
+            printf("Failed to flush the log: %s\n", esp_err_to_name(ret));
+            return 1;
+        }
+    } else if (argc != 1) {
+        printf("Usage: log [flush]\n");
+        return 1;
+    }
+
+    sample_log_stats_t stats;
+    sample_log_get_stats(&stats);
+    if (!stats.mounted) {
+        printf("History log not mounted (no '%s' partition?)\n", SAMPLE_LOG_PARTITION_LABEL);
+        return 1;
+    }
+    printf("partition=%" PRIu32 " bytes, clock=%" PRIu32 " s (from %" PRIu32 " s at boot), recovery=%" PRId64 "us in %" PRIu32 " reads, corrupt pages=%" PRIu32 "\n",
+           stats.partition_size, sample_log_time_s(esp_timer_get_time()), stats.clock_offset_s, stats.recovery_us,
+           stats.recovery_reads, stats.corrupt_pages);
+    printf("records=%" PRIu32 " pages=%" PRIu32 " dropped=%" PRIu32 " bytes=%" PRIu64 " erases=%" PRIu32 " write time=%" PRId64 "us\n",
+           stats.records, stats.pages_written, stats.pages_dropped, stats.bytes_written, stats.segments_erased, stats.write_us);
+    for (int tier = 0; tier < SAMPLE_LOG_TIER_COUNT; tier++) {
+        const sample_log_tier_stats_t *t = &stats.tiers[tier];
+        printf("  tier %d every %" PRIu32 "s: segments %" PRIu32 "/%" PRIu32 " head=%" PRIu32 ":%" PRIu32 " seq=%" PRIu32 " span=%" PRIu32 "-%" PRIu32 " s\n",
+               tier, t->interval_s, t->segments_used, t->segment_count, t->head_segment, t->head_page, t->segment_sequence,
+               t->oldest_time_s, t->newest_time_s);
+    }
+    return 0;
+}
+
+// Parse a duration such as 90, 90s, 15m, 6h or 30d into seconds
+static bool parse_duration(const char *text, uint32_t *seconds) {
+    char *end;
+    unsigned long value = strtoul(text, &end, 10);
+    if (end == text) {
+        return false;
+    }
+    uint32_t unit = *end == 'd' ? 86400 : *end == 'h' ? 3600 : *end == 'm' ? 60 : 1;
+    if ((*end != '\0' && *end != 's' && unit == 1) || (*end != '\0' && end[1] != '\0') || value > UINT32_MAX / unit) {
+        return false;
+    }
+    *seconds = (uint32_t)value * unit;
+    return true;
+}
+
+// Parse a log time: "now", a duration back from now ("-6h") or seconds on the log clock
+static bool parse_log_time(const char *text, uint32_t now_s, uint32_t *time_s) {
+    if (strcmp(text, "now") == 0) {
+        *time_s = now_s;
+        return true;
+    }
+    uint32_t seconds;
+    if (text[0] == '-') {
+        if (!parse_duration(text + 1, &seconds)) {
+            return false;
+        }
+        *time_s = seconds < now_s ? now_s - seconds : 0;
+        return true;
+    }
+    if (!parse_duration(text, &seconds)) {
+        return false;
+    }
+    *time_s = seconds;
+    return true;
+}
+
+// Rows printed by the history command
+typedef struct {
+    const window_stats_channel_info_t *info;
+    uint32_t now_s;
+} history_print_t;
+
+static bool history_print_row(const sample_log_record_t *record, void *ctx) {
+    const history_print_t *print = ctx;
+    uint32_t age_s = print->now_s > record->time_s ? print->now_s - record->time_s : 0;
+    char mean[24], min[24], max[24];
+    printf("%10" PRIu32 " -%3" PRIu32 "d%02" PRIu32 ":%02" PRIu32 " %12s %12s %12s %6u\n", record->time_s,
+           age_s / 86400, age_s / 3600 % 24, age_s / 60 % 60,
+           format_scaled(mean, sizeof(mean), record->mean, print->info->scale),
+           format_scaled(min, sizeof(min), record->min, print->info->scale),
+           format_scaled(max, sizeof(max), record->max, print->info->scale), record->count);
+    return true;
+}
+
+// Command handler for reading a channel's stored history over a time range
+int cmd_history(int argc, char **argv) {
+    uint32_t now_s = sample_log_time_s(esp_timer_get_time());
+    sample_log_query_t query = {.channel = WINDOW_STATS_CHANNEL_COUNT};
+    if (argc >= 4 && argc <= 5) {
+        for (int channel = 0; channel < WINDOW_STATS_CHANNEL_COUNT; channel++) {
+            if (strcmp(argv[1], window_stats_channel_info((window_stats_channel_t)channel)->name) == 0) {
+                query.channel = (window_stats_channel_t)channel;
+            }
+        }
+    }
+    if (query.channel == WINDOW_STATS_CHANNEL_COUNT || !parse_log_time(argv[2], now_s, &query.from_s) ||
+        !parse_log_time(argv[3], now_s, &query.to_s) || (argc == 5 && !parse_duration(argv[4], &query.step_s)) ||
+        query.from_s > query.to_s) {
+        printf("Usage: history <channel> <from> <to> [step]\n");
+        printf("Times are now, -<duration> back from now or log clock seconds; durations take s, m, h or d (history co2 -6h now 15m)\n");
+        return 1;
+    }
+
+    history_print_t print = {
+        .info = window_stats_channel_info(query.channel),
+        .now_s = now_s,
+    };
+    sample_log_query_stats_t result;
+    printf("%-10s %-11s %12s %12s %12s %6s  (%s)\n", "time_s", "age", "mean", "min", "max", "count", print.info->unit);
+    esp_err_t ret = sample_log_query(&query, history_print_row, &print, &result);
+    if (ret != ESP_OK) {
+        printf("History query failed: %s\n", esp_err_to_name(ret));
+        return 1;
+    }
+    sample_log_stats_t stats;
+    sample_log_get_stats(&stats);
+    printf("tier %u (every %" PRIu32 "s): %" PRIu32 " records, %" PRIu32 " pages read, %" PRIu32 " segments by summary, %" PRIu32 " skipped, %" PRId64 "us\n",
+           result.tier, stats.tiers[result.tier].interval_s, result.records, result.pages_read,
+           result.segments_summarised, result.segments_skipped, result.elapsed_us);
+    return 0;
+}
+
+// Queue telemetry frames for the console UART as raw bytes; stdout would expand 0x0A to CR LF.
+// A frame dropped by a full buffer shows up as a sequence gap at the decoder.
+static void telemetry_console_write(const uint8_t *data, size_t length, void *ctx) {
+    console_out_write(data, length);
+}
+
+// Command handler for switching the console readings between text and binary telemetry
+int cmd_telemetry(int argc, char **argv) {
+    if (argc == 2 && strcmp(argv[1], "on") == 0) {
+        printf("Binary telemetry on; decode with host/telemetry_decode, 'telemetry off' for text.\n");
+        fflush(stdout);
+        console_out_flush(CONSOLE_OUT_BLOCK_TIMEOUT_MS);
+        telemetry_start(telemetry_console_write, NULL);
+        return 0;
+    } else if (argc == 2 && strcmp(argv[1], "off") == 0) {
+        telemetry_stop();
+        printf("Binary telemetry off.\n");
+    } else if (argc != 1) {
+        printf("Usage: telemetry [on|off]\n");
+        return 1;
+    }
+
+    telemetry_stats_t stats;
+    telemetry_get_stats(&stats);
+    printf("telemetry=%s frames=%" PRIu32 " records=%" PRIu32 " bytes=%" PRIu64, stats.enabled ? "on" : "off",
+           stats.frames, stats.records, stats.bytes);
+    if (stats.records > 0) {
+        printf(" (%" PRIu64 " per 10 records)", stats.bytes * 10 / stats.records);
+    }
+    printf("\n");
+    return 0;
+}
+
+// Command handler for showing the console output buffer or changing its overflow policy
+int cmd_console_out(int argc, char **argv) {
+    bool reset = false;
+    if (argc == 2 && (strcmp(argv[1], "drop") == 0 || strcmp(argv[1], "block") == 0)) {
+        console_out_policy_t policy = strcmp(argv[1], "drop") == 0 ? CONSOLE_OUT_DROP : CONSOLE_OUT_BLOCK;
+        console_out_set_policy(policy);
+        esp_err_t ret = save_console_out_policy(policy);
+        if (ret != ESP_OK) {
+            printf("Failed to save the policy: %s\n", esp_err_to_name(ret));
+            return 1;
+        }
+    } else if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+        reset = true;
+    } else if (argc != 1) {
+        printf("Usage: console_out [drop | block | reset]\n");
+        return 1;
+    }
+
+    console_out_stats_t stats;
+    console_out_get_stats(&stats, reset);
+    printf("policy=%s buffer=%d bytes high water=%" PRIu32 " messages=%" PRIu32 " bytes=%" PRIu64 " written=%" PRIu64 " write time=%" PRId64 "us\n",
+           console_out_policy_name(stats.policy), CONSOLE_OUT_BUFFER_SIZE, stats.high_water, stats.messages, stats.bytes,
+           stats.written, stats.write_us);
+    printf("deferred=%" PRIu32 " dropped=%" PRIu32 " (%" PRIu64 " bytes) truncated=%" PRIu32 " blocked=%" PRIu32 " (%" PRId64 "us)\n",
+           stats.deferred, stats.dropped, stats.dropped_bytes, stats.truncated, stats.blocked, stats.blocked_us);
+    if (reset) {
+        printf("Console output statistics reset.\n");
+    }
+    return 0;
+}
+
+// Command handler for switching driver log messages between text and deferred records
+int cmd_log_mode(int argc, char **argv) {
+    bool reset = false;
+    if (argc == 2 && (strcmp(argv[1], "text") == 0 || strcmp(argv[1], "deferred") == 0)) {
+        dlog_mode_t mode = strcmp(argv[1], "text") == 0 ? DLOG_MODE_TEXT : DLOG_MODE_DEFERRED;
+        esp_err_t ret = save_log_mode(mode);
+        if (mode == DLOG_MODE_DEFERRED) {
+            printf("Deferred logging on; expand with host/telemetry_decode --sites dlog_sites.txt.\n");
+        }
+        dlog_set_mode(mode);
+        if (ret != ESP_OK) {
+            printf("Failed to save the mode: %s\n", esp_err_to_name(ret));
+            return 1;
+        }
+    } else if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+        reset = true;
+    } else if (argc != 1) {
+        printf("Usage: log_mode [text | deferred | reset]\n");
+        return 1;
+    }
+
+    dlog_stats_t stats;
+    dlog_get_stats(&stats, reset);
+    printf("mode=%s records=%" PRIu32 " bytes=%" PRIu64 " dropped=%" PRIu32 " truncated=%" PRIu32 "\n",
+           dlog_mode_name(stats.mode), stats.records, stats.bytes, stats.dropped, stats.truncated);
+    if (reset) {
+        printf("Deferred log statistics reset.\n");
+    }
+    return 0;
+}
+
+// Command handler for streaming cached readings until a key is pressed
+int cmd_watch(int argc, char **argv) {
+    int first = SAMPLE_SOURCE_COUNT;
+    if (argc >= 2 && argc <= 3) {
+        for (int source = 0; source < SAMPLE_SOURCE_COUNT; source++) {
+            if (strcmp(argv[1], sample_bus_source_name((sample_source_t)source)) == 0) {
+                first = source;
+            }
+        }
+        if (strcmp(argv[1], "all") == 0) {
+            first = 0;
+        }
+    }
+    uint32_t interval_ms = argc == 3 ? (uint32_t)atoi(argv[2]) : WATCH_DEFAULT_INTERVAL_MS;
+    if (first == SAMPLE_SOURCE_COUNT || interval_ms < WATCH_MIN_INTERVAL_MS) {
+        printf("Usage: watch <scd41 | as7262 | tds | all> [interval_ms >= %d]\n", WATCH_MIN_INTERVAL_MS);
+        return 1;
+    }
+    int last = strcmp(argv[1], "all") == 0 ? SAMPLE_SOURCE_COUNT - 1 : first;
+
+    printf("Watching every %" PRIu32 " ms, press any key to stop\n", interval_ms);
+    size_t pending = 0;
+    while (pending == 0) {
+        for (int source = first; source <= last; source++) {
+            print_latest((sample_source_t)source);
+        }
+        vTaskDelay(pdMS_TO_TICKS(interval_ms));
+        uart_get_buffered_data_len(CONFIG_ESP_CONSOLE_UART_NUM, &pending);
+    }
+    // The key only stops the watch; keep it out of the next command line
+    uart_flush_input(CONFIG_ESP_CONSOLE_UART_NUM);
+    return 0;
+}
+
+// Command handler for listing stored settings and their flash writes
+int cmd_config(int argc, char **argv) {
+    bool reset = false;
+    if (argc == 2 && strcmp(argv[1], "flush") == 0) {
+        esp_err_t ret = config_store_flush();
+        if (ret != ESP_OK) {
+            printf("Failed to write settings: %s\n", esp_err_to_name(ret));
+            return 1;
+        }
+    } else if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+        reset = true;
+    } else if (argc != 1) {
+        printf("Usage: config [flush | reset]\n");
+        return 1;
+    }
+
+    for (int id = 0; id < CONFIG_ID_COUNT; id++) {
+        config_info_t info;
+        config_store_get_info((config_id_t)id, &info);
+        printf("%-14s %-8s %s", info.name, config_origin_name(info.origin), info.dirty ? "pending " : "        ");
+        if (info.type == CONFIG_TYPE_I32) {
+            printf("%" PRId32 "\n", config_get_i32((config_id_t)id));
+        } else {
+            printf("%u bytes\n", (unsigned)info.size);
+        }
+    }
+    config_store_stats_t stats;
+    config_store_get_stats(&stats, reset);
+    printf("changes=%" PRIu32 " unchanged=%" PRIu32 " coalesced=%" PRIu32 " writes=%" PRIu32 " commits=%" PRIu32 " errors=%" PRIu32 " (%" PRId64 "us)\n",
+           stats.changes, stats.unchanged, stats.coalesced, stats.writes, stats.commits, stats.write_errors, stats.write_us);
+    printf("at boot: migrated=%" PRIu32 " rejected=%" PRIu32 "\n", stats.migrated, stats.corrupt);
+    if (reset) {
+        printf("Config statistics reset.\n");
+    }
     return 0;
 }
 
 // Command handler for resetting the system
 int cmd_reset_system(int argc, char **argv) {
     printf("System reset initiated...\n");
+    config_store_flush();
+    sample_log_flush(SAMPLE_LOG_FLUSH_TIMEOUT_MS);
+    console_out_flush(CONSOLE_OUT_BLOCK_TIMEOUT_MS);
     esp_restart();
     return 0;
 }
@@ -243,7 +1103,7 @@ void register_commands() {
     cmd = (esp_console_cmd_t) {
         .command = "frc",
         .help = "Trigger forced recalibration on the SCD41",
-        .hint = NULL,
+        .hint = "[target_ppm]",
         .func = &cmd_forced_recalibration,
     };
     ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
@@ -256,6 +1116,22 @@ void register_commands() {
     };
     ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
 
+    cmd = (esp_console_cmd_t) {
+        .command = "scd41_mode",
+        .help = "Show or switch the SCD41 measurement mode",
+        .hint = "[idle | periodic | low_power]",
+        .func = &cmd_scd41_mode,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+
+    cmd = (esp_console_cmd_t) {
+        .command = "scd41_selftest",
+        .help = "Run the SCD41 self-test in the background",
+        .hint = NULL,
+        .func = &cmd_scd41_self_test,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+
     cmd = (esp_console_cmd_t) {
         .command = "read_as7262",
         .help = "Read AS7262 sensor data",
@@ -272,6 +1148,22 @@ void register_commands() {
     };
     ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
 
+    cmd = (esp_console_cmd_t) {
+        .command = "tds_adc",
+        .help = "Show or change the continuous TDS filter",
+        .hint = "[mean | median | trimmed] [window]",
+        .func = &cmd_tds_adc,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+
+    cmd = (esp_console_cmd_t) {
+        .command = "tds_cal",
+        .help = "Show TDS calibration or capture a reference solution",
+        .hint = "[add <reference_ppm> | clear | alpha <percent_per_C> | air on|off]",
+        .func = &cmd_tds_calibration,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+
     // Register NVS commands
     cmd = (esp_console_cmd_t) {
         .command = "nvs_set_i32",
@@ -330,6 +1222,110 @@ void register_commands() {
     };
     ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
 
+    cmd = (esp_console_cmd_t) {
+        .command = "i2c_stats",
+        .help = "Show per-device I2C bus usage",
+        .hint = "[reset]",
+        .func = &cmd_i2c_stats,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+
+    cmd = (esp_console_cmd_t) {
+        .command = "as7262_stream",
+        .help = "Start, stop or show the AS7262 continuous stream",
+        .hint = "<start [auto | int_t [gain]] | stop | status>",
+        .func = &cmd_as7262_stream,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+
+    cmd = (esp_console_cmd_t) {
+        .command = "sched",
+        .help = "Show sensor job timing or change a job period",
+        .hint = "[reset | <job> <period_ms>]",
+        .func = &cmd_sched,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+
+    cmd = (esp_console_cmd_t) {
+        .command = "sample_bus",
+        .help = "Show sample bus producers and consumer backlog",
+        .hint = NULL,
+        .func = &cmd_sample_bus,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+
+    cmd = (esp_console_cmd_t) {
+        .command = "latency",
+        .help = "Show acquisition latency and sample interval jitter per sensor",
+        .hint = "[reset]",
+        .func = &cmd_latency,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+
+    cmd = (esp_console_cmd_t) {
+        .command = "stats",
+        .help = "Show min, max, mean and spread per channel over the last 1m, 1h and 24h",
+        .hint = "[reset | <channel>] [1m|1h|24h]",
+        .func = &cmd_stats,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+
+    cmd = (esp_console_cmd_t) {
+        .command = "log",
+        .help = "Show the flash history log or write out part-filled pages",
+        .hint = "[flush]",
+        .func = &cmd_log,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+
+    cmd = (esp_console_cmd_t) {
+        .command = "history",
+        .help = "Show a channel's stored history between two times, optionally merged into steps",
+        .hint = "<channel> <from> <to> [step]",
+        .func = &cmd_history,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+
+    cmd = (esp_console_cmd_t) {
+        .command = "telemetry",
+        .help = "Switch readings between text lines and COBS-framed binary records on the console UART",
+        .hint = "[on|off]",
+        .func = &cmd_telemetry,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+
+    cmd = (esp_console_cmd_t) {
+        .command = "console_out",
+        .help = "Show console output buffering and drops, or set what a full buffer does",
+        .hint = "[drop | block | reset]",
+        .func = &cmd_console_out,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+
+    cmd = (esp_console_cmd_t) {
+        .command = "log_mode",
+        .help = "Show deferred logging counters, or switch driver log messages between text and binary records",
+        .hint = "[text | deferred | reset]",
+        .func = &cmd_log_mode,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+
+    cmd = (esp_console_cmd_t) {
+        .command = "config",
+        .help = "Show stored settings and their flash writes",
+        .hint = "[flush | reset]",
+        .func = &cmd_config,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+
+    cmd = (esp_console_cmd_t) {
+        .command = "watch",
+        .help = "Stream cached readings until a key is pressed",
+        .hint = "<scd41 | as7262 | tds | all> [interval_ms]",
+        .func = &cmd_watch,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+
     cmd = (esp_console_cmd_t) {
         .command = "reset",
         .help = "Reset the system",
@@ -9,27 +9,39 @@
 #include "as7262_driver.h"
 #include "nvs_service.h"
 #include "tds_sensor.h"
+#include "tds_calibration.h"
 #include "esp_console.h"
+#include "console_out.h"
+#include "dlog.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
 #include "esp_system.h"
 
+#define WATCH_DEFAULT_INTERVAL_MS 1000
+#define WATCH_MIN_INTERVAL_MS 100
+
 // Global device handles (extern to access from main.c)
 extern i2c_master_dev_handle_t scd41_dev;
 extern i2c_master_dev_handle_t as7262_dev;
 
-typedef struct {
-    float correction_factors[6];
-} as7262_calibration_t;
-
 void apply_correction_factors(float* data);
 esp_err_t save_as7262_calibration(const as7262_calibration_t* calibration);
 esp_err_t load_as7262_calibration(as7262_calibration_t* calibration);
+esp_err_t save_tds_calibration(const tds_calibration_t* calibration);
+esp_err_t load_tds_calibration(tds_calibration_t* calibration);
+esp_err_t save_sensor_period(const char* job, uint32_t period_ms);
+uint32_t load_sensor_period(const char* job);
+esp_err_t save_console_out_policy(console_out_policy_t policy);
+console_out_policy_t load_console_out_policy(void);
+esp_err_t save_log_mode(dlog_mode_t mode);
+dlog_mode_t load_log_mode(void);
 int cmd_set_as7262_calibration(int argc, char **argv);
 int cmd_get_as7262_calibration(int argc, char **argv);
 int cmd_forced_recalibration(int argc, char **argv);
 int cmd_read_scd41(int argc, char **argv);
+int cmd_scd41_mode(int argc, char **argv);
+int cmd_scd41_self_test(int argc, char **argv);
 int cmd_read_as7262(int argc, char **argv);
 int cmd_help(int argc, char **argv);
 int cmd_nvs_set_i32(int argc, char **argv);
@@ -38,7 +50,22 @@ int cmd_nvs_set_str(int argc, char **argv);
 int cmd_nvs_get_str(int argc, char **argv);
 int cmd_nvs_stats(int argc, char **argv);
 int cmd_read_tds(int argc, char **argv);
+int cmd_tds_adc(int argc, char **argv);
+int cmd_tds_calibration(int argc, char **argv);
 int cmd_reset_system(int argc, char **argv);
+int cmd_i2c_stats(int argc, char **argv);
+int cmd_as7262_stream(int argc, char **argv);
+int cmd_sched(int argc, char **argv);
+int cmd_sample_bus(int argc, char **argv);
+int cmd_latency(int argc, char **argv);
+int cmd_stats(int argc, char **argv);
+int cmd_log(int argc, char **argv);
+int cmd_history(int argc, char **argv);
+int cmd_telemetry(int argc, char **argv);
+int cmd_console_out(int argc, char **argv);
+int cmd_log_mode(int argc, char **argv);
+int cmd_config(int argc, char **argv);
+int cmd_watch(int argc, char **argv);
 void register_commands(void);
 
 #endif // UART_COMMANDS_H
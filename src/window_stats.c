@@ -0,0 +1,166 @@
+#include "window_stats.h"
+#include "freertos/FreeRTOS.h"
+#include <string.h>
+
+// One bucket's share of a window. Sums are relative to the bucket's first
+// value, so the squares stay small however far the channel drifts; a query
+// moves them onto one shift exactly before merging.
+typedef struct {
+    uint32_t count;
+    uint32_t index;                        // timestamp_us / bucket width the bucket was filled for
+    int32_t min;
+    int32_t max;
+    int32_t shift;
+    int64_t sum;                           // Sum of (value - shift)
+    uint64_t sum_squares;                  // Sum of (value - shift)^2
+} window_bucket_t;
+
+typedef struct {
+    window_bucket_t buckets[WINDOW_STATS_WINDOW_COUNT][WINDOW_STATS_BUCKETS];
+} window_channel_t;
+
+static window_channel_t channels[WINDOW_STATS_CHANNEL_COUNT];
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const int64_t window_spans_us[WINDOW_STATS_WINDOW_COUNT] = {
+    [WINDOW_STATS_MINUTE] = 60LL * 1000000,
+    [WINDOW_STATS_HOUR] = 3600LL * 1000000,
+    [WINDOW_STATS_DAY] = 86400LL * 1000000,
+};
+
+static const window_stats_channel_info_t channel_info[WINDOW_STATS_CHANNEL_COUNT] = {
+    [WINDOW_STATS_CO2] = {"co2", "ppm", 1},
+    [WINDOW_STATS_TEMPERATURE] = {"temp", "°C", 1000},
+    [WINDOW_STATS_HUMIDITY] = {"humidity", "%RH", 1000},
+    [WINDOW_STATS_VIOLET] = {"violet", "/ms", 100},
+    [WINDOW_STATS_BLUE] = {"blue", "/ms", 100},
+    [WINDOW_STATS_GREEN] = {"green", "/ms", 100},
+    [WINDOW_STATS_YELLOW] = {"yellow", "/ms", 100},
+    [WINDOW_STATS_ORANGE] = {"orange", "/ms", 100},
+    [WINDOW_STATS_RED] = {"red", "/ms", 100},
+    [WINDOW_STATS_TDS] = {"tds", "ppm", 1},
+};
+
+// Bucket index of a time in a window
+static uint32_t window_stats_bucket_index(window_stats_window_t window, int64_t timestamp_us) {
+    return (uint32_t)(timestamp_us / (window_spans_us[window] / WINDOW_STATS_BUCKETS));
+}
+
+void window_stats_add(window_stats_channel_t channel, int64_t timestamp_us, int32_t value) {
+    if (channel >= WINDOW_STATS_CHANNEL_COUNT || timestamp_us < 0) {
+        return;
+    }
+    window_channel_t *entry = &channels[channel];
+    portENTER_CRITICAL(&stats_lock);
+    for (int window = 0; window < WINDOW_STATS_WINDOW_COUNT; window++) {
+        uint32_t index = window_stats_bucket_index((window_stats_window_t)window, timestamp_us);
+        window_bucket_t *bucket = &entry->buckets[window][index % WINDOW_STATS_BUCKETS];
+        // A bucket left over from an earlier pass round the ring starts again
+        if (bucket->count == 0 || bucket->index != index) {
+            bucket->count = 0;
+            bucket->index = index;
+            bucket->min = value;
+            bucket->max = value;
+            bucket->shift = value;
+            bucket->sum = 0;
+            bucket->sum_squares = 0;
+        }
+        int64_t delta = (int64_t)value - bucket->shift;
+        bucket->count++;
+        bucket->sum += delta;
+        bucket->sum_squares += (uint64_t)(delta * delta);
+        bucket->min = value < bucket->min ? value : bucket->min;
+        bucket->max = value > bucket->max ? value : bucket->max;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+uint32_t window_stats_record_values(const sample_record_t *record, int32_t *values) {
+    switch (record->source) {
+    case SAMPLE_SOURCE_SCD41:
+        values[WINDOW_STATS_CO2] = record->scd41.co2_ppm;
+        values[WINDOW_STATS_TEMPERATURE] = record->scd41.temperature_mc;
+        values[WINDOW_STATS_HUMIDITY] = record->scd41.humidity_mpct;
+        return (1u << WINDOW_STATS_CO2) | (1u << WINDOW_STATS_TEMPERATURE) | (1u << WINDOW_STATS_HUMIDITY);
+    case SAMPLE_SOURCE_AS7262: {
+        // A clipped frame only gives a lower bound; it would drag the mean and max down
+        if (record->as7262.saturated) {
+            return 0;
+        }
+        uint32_t normalized[AS7262_CHANNEL_COUNT];
+        uint32_t mask = 0;
+        as7262_normalize(record->as7262.raw, record->as7262.range, normalized);
+        for (int i = 0; i < AS7262_CHANNEL_COUNT; i++) {
+            values[WINDOW_STATS_VIOLET + i] = (int32_t)(((uint64_t)normalized[i] * 100) >> AS7262_NORMALIZED_SHIFT);
+            mask |= 1u << (WINDOW_STATS_VIOLET + i);
+        }
+        return mask;
+    }
+    case SAMPLE_SOURCE_TDS:
+        values[WINDOW_STATS_TDS] = record->tds.ppm;
+        return 1u << WINDOW_STATS_TDS;
+    default:
+        return 0;
+    }
+}
+
+void window_stats_add_record(const sample_record_t *record) {
+    int32_t values[WINDOW_STATS_CHANNEL_COUNT];
+    uint32_t mask = window_stats_record_values(record, values);
+    for (int channel = 0; channel < WINDOW_STATS_CHANNEL_COUNT; channel++) {
+        if (mask & (1u << channel)) {
+            window_stats_add((window_stats_channel_t)channel, record->timestamp_us, values[channel]);
+        }
+    }
+}
+
+esp_err_t window_stats_query(window_stats_channel_t channel, window_stats_window_t window, int64_t now_us, running_stats_t *stats) {
+    if (channel >= WINDOW_STATS_CHANNEL_COUNT || window >= WINDOW_STATS_WINDOW_COUNT || stats == NULL || now_us < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    running_stats_reset(stats);
+    const window_channel_t *entry = &channels[channel];
+    uint32_t now_index = window_stats_bucket_index(window, now_us);
+
+    portENTER_CRITICAL(&stats_lock);
+    for (int i = 0; i < WINDOW_STATS_BUCKETS; i++) {
+        const window_bucket_t *bucket = &entry->buckets[window][i];
+        // Only buckets from the current one back through the span; newer ones are left for the next query
+        if (bucket->count == 0 || bucket->index > now_index || now_index - bucket->index >= WINDOW_STATS_BUCKETS) {
+            continue;
+        }
+        if (stats->count == 0) {
+            stats->shift = bucket->shift;
+        }
+        // Move the bucket's sums onto the common shift: with d = v - s and v - s' = d + k,
+        // the sum gains n*k and the squares 2*k*sum + n*k^2, all exact in integers
+        int64_t k = (int64_t)bucket->shift - stats->shift;
+        stats->min = stats->count == 0 || bucket->min < stats->min ? bucket->min : stats->min;
+        stats->max = stats->count == 0 || bucket->max > stats->max ? bucket->max : stats->max;
+        stats->count += bucket->count;
+        stats->sum += bucket->sum + (int64_t)bucket->count * k;
+        stats->sum_squares += bucket->sum_squares + (uint64_t)(2 * k * bucket->sum) + (uint64_t)bucket->count * (uint64_t)(k * k);
+    }
+    portEXIT_CRITICAL(&stats_lock);
+    return ESP_OK;
+}
+
+void window_stats_reset(void) {
+    portENTER_CRITICAL(&stats_lock);
+    memset(channels, 0, sizeof(channels));
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+const window_stats_channel_info_t *window_stats_channel_info(window_stats_channel_t channel) {
+    static const window_stats_channel_info_t unknown = {"?", "", 1};
+    return channel < WINDOW_STATS_CHANNEL_COUNT ? &channel_info[channel] : &unknown;
+}
+
+const char *window_stats_window_name(window_stats_window_t window) {
+    static const char *names[WINDOW_STATS_WINDOW_COUNT] = {"1m", "1h", "24h"};
+    return window < WINDOW_STATS_WINDOW_COUNT ? names[window] : "?";
+}
+
+int64_t window_stats_window_span_us(window_stats_window_t window) {
+    return window < WINDOW_STATS_WINDOW_COUNT ? window_spans_us[window] : 0;
+}
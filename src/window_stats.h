@@ -0,0 +1,68 @@
+#ifndef WINDOW_STATS_H
+#define WINDOW_STATS_H
+
+#include "esp_err.h"
+#include "sample_bus.h"
+#include "running_stats.h"
+#include <stdint.h>
+
+// Each window is a ring of buckets, each covering span / WINDOW_STATS_BUCKETS.
+// A sample updates one bucket per window and a query merges the buckets still
+// inside the span, so the window slides in steps of one bucket: 2.5 s for the
+// minute, 2.5 min for the hour and an hour for the day. Memory is fixed at
+// channels x windows x buckets x 40 bytes, about 28 KB.
+#define WINDOW_STATS_BUCKETS 24
+
+// Values kept per channel; each is an integer in its channel's unit times its scale
+typedef enum {
+    WINDOW_STATS_CO2,                      // ppm
+    WINDOW_STATS_TEMPERATURE,              // m°C
+    WINDOW_STATS_HUMIDITY,                 // m%RH
+    WINDOW_STATS_VIOLET,                   // Normalised counts per ms at 1x, hundredths
+    WINDOW_STATS_BLUE,
+    WINDOW_STATS_GREEN,
+    WINDOW_STATS_YELLOW,
+    WINDOW_STATS_ORANGE,
+    WINDOW_STATS_RED,
+    WINDOW_STATS_TDS,                      // ppm
+    WINDOW_STATS_CHANNEL_COUNT,
+} window_stats_channel_t;
+
+typedef enum {
+    WINDOW_STATS_MINUTE,
+    WINDOW_STATS_HOUR,
+    WINDOW_STATS_DAY,
+    WINDOW_STATS_WINDOW_COUNT,
+} window_stats_window_t;
+
+// How to show a channel: value / scale, in unit
+typedef struct {
+    const char *name;
+    const char *unit;
+    int32_t scale;
+} window_stats_channel_info_t;
+
+// Add one value to every window of a channel. Values of a channel must come in time order.
+void window_stats_add(window_stats_channel_t channel, int64_t timestamp_us, int32_t value);
+
+// Add every channel a sample bus record carries; saturated spectral frames are left out
+void window_stats_add_record(const sample_record_t *record);
+
+// Fill values (WINDOW_STATS_CHANNEL_COUNT long) with the channels a record
+// carries, in channel units, and return them as a bit mask of channels
+uint32_t window_stats_record_values(const sample_record_t *record, int32_t *values);
+
+// Merge the buckets of a window that are still inside its span at now_us
+esp_err_t window_stats_query(window_stats_channel_t channel, window_stats_window_t window, int64_t now_us, running_stats_t *stats);
+
+// Forget every value
+void window_stats_reset(void);
+
+// Name, unit and scale of a channel
+const window_stats_channel_info_t *window_stats_channel_info(window_stats_channel_t channel);
+
+// Short window name ("1m", "1h", "24h") and its span
+const char *window_stats_window_name(window_stats_window_t window);
+int64_t window_stats_window_span_us(window_stats_window_t window);
+
+#endif // WINDOW_STATS_H